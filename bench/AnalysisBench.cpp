@@ -0,0 +1,118 @@
+/*
+ * AnalysisBench.cpp - Access patterns of the clipping planes: packing the
+ * active ones into a FrameState as Rocket::publishFrameState() does, and
+ * reading them back as Rocket::display() does.  ClippingPlane needs the
+ * Vrui geometry headers, so these benchmarks are only built when they are
+ * installed (BENCH_CLIPPING_PLANE).
+ */
+#ifdef BENCH_CLIPPING_PLANE
+
+#include <ANALYSIS/ClippingPlane.h>
+#include <FrameState.h>
+#include <UTIL/System.h>
+
+#include "Benchmark.h"
+
+namespace {
+
+/*
+ * makePlanes - Returns the planes Rocket allocates, with \p numActive of
+ * them active.
+ */
+ClippingPlane* makePlanes(int numActive) {
+	ClippingPlane* planes = new ClippingPlane[FrameState::MAX_CLIPPING_PLANES];
+	for (int i = 0; i < FrameState::MAX_CLIPPING_PLANES; ++i) {
+		Vrui::Vector normal(0.0, 0.0, 0.0);
+		normal[i % 3] = 1.0;
+		planes[i].setAllocated(i < numActive);
+		planes[i].setActive(i < numActive);
+		planes[i].setPlane(Vrui::Plane(normal, Vrui::Scalar(i)));
+	}
+	return planes;
+}
+
+/*
+ * packLoop - Packs the active planes into a FrameState; one iteration is
+ * one frame.
+ */
+Uint64 packLoop(Uint64 iterations, Uint64 numActive) {
+	ClippingPlane* planes = makePlanes(int(numActive));
+	const Uint64 start = SystemPosix::getMonotonicNanoseconds();
+	for (Uint64 i = 0; i < iterations; ++i) {
+		FrameState state;
+		for (int p = 0; p < FrameState::MAX_CLIPPING_PLANES; ++p) {
+			if (planes[p].isActive()) {
+				const Vrui::Plane plane = planes[p].getPlane();
+				double* equation =
+						state.clippingPlanes[state.numberOfActiveClippingPlanes];
+				for (int j = 0; j < 3; ++j)
+					equation[j] = plane.getNormal()[j];
+				equation[3] = -plane.getOffset();
+				++state.numberOfActiveClippingPlanes;
+			}
+		}
+		doNotOptimize(state);
+	}
+	const Uint64 elapsed = SystemPosix::getMonotonicNanoseconds() - start;
+	delete[] planes;
+	return elapsed;
+}
+
+/*
+ * objectReadLoop - Reads the equations of the active planes from the
+ * ClippingPlane objects directly, as display() did before the frame state
+ * was packed.
+ */
+Uint64 objectReadLoop(Uint64 iterations, Uint64 numActive) {
+	ClippingPlane* planes = makePlanes(int(numActive));
+	double sum = 0.0;
+	const Uint64 start = SystemPosix::getMonotonicNanoseconds();
+	for (Uint64 i = 0; i < iterations; ++i) {
+		for (int p = 0; p < FrameState::MAX_CLIPPING_PLANES; ++p) {
+			if (planes[p].isActive()) {
+				const Vrui::Plane plane = planes[p].getPlane();
+				sum += plane.getNormal()[0] + plane.getNormal()[1]
+						+ plane.getNormal()[2] - plane.getOffset();
+			}
+		}
+	}
+	const Uint64 elapsed = SystemPosix::getMonotonicNanoseconds() - start;
+	doNotOptimize(sum);
+	delete[] planes;
+	return elapsed;
+}
+
+/*
+ * packedReadLoop - Reads the same equations from a packed FrameState.
+ */
+Uint64 packedReadLoop(Uint64 iterations, Uint64 numActive) {
+	FrameState state;
+	state.numberOfActiveClippingPlanes = int(numActive);
+	for (int p = 0; p < FrameState::MAX_CLIPPING_PLANES; ++p) {
+		for (int j = 0; j < 4; ++j) {
+			state.clippingPlanes[p][j] = j == p % 3 ? 1.0 : 0.0;
+		}
+	}
+	doNotOptimize(state);
+	double sum = 0.0;
+	const Uint64 start = SystemPosix::getMonotonicNanoseconds();
+	for (Uint64 i = 0; i < iterations; ++i) {
+		for (int p = 0; p < state.numberOfActiveClippingPlanes; ++p) {
+			const double* equation = state.clippingPlanes[p];
+			sum += equation[0] + equation[1] + equation[2] + equation[3];
+		}
+	}
+	const Uint64 elapsed = SystemPosix::getMonotonicNanoseconds() - start;
+	doNotOptimize(sum);
+	return elapsed;
+}
+
+}
+
+BENCHMARK("analysis/ClippingPlane/pack/0", packLoop, 0);
+BENCHMARK("analysis/ClippingPlane/pack/3", packLoop, 3);
+BENCHMARK("analysis/ClippingPlane/pack/6", packLoop, 6);
+BENCHMARK("analysis/ClippingPlane/read_objects/3", objectReadLoop, 3);
+BENCHMARK("analysis/ClippingPlane/read_packed/3", packedReadLoop, 3);
+
+#endif /* BENCH_CLIPPING_PLANE */
@@ -0,0 +1,173 @@
+/*
+ * Benchmark.cpp - Calibration, statistics and threads for the benchmarks.
+ */
+#include <algorithm>
+#include <cmath>
+#include <pthread.h>
+
+#include <SYNC/Barrier.h>
+#include <UTIL/System.h>
+
+#include "Benchmark.h"
+
+namespace {
+
+struct ThreadStart {
+	ThreadBody body;
+	void* context;
+	int thread;
+	Barrier* start;
+};
+
+void* threadMain(void* argument) {
+	ThreadStart* start = static_cast<ThreadStart*> (argument);
+	start->start->wait();
+	start->body(start->thread, start->context);
+	return NULL;
+}
+
+}
+
+/*
+ * run - Calibrates the iteration count, runs once to warm up, then runs
+ * \p repetitions times and computes the statistics.
+ *
+ * @param minimumTime Nanoseconds each run should take at least.
+ */
+void Benchmark::run(int repetitions, Uint64 minimumTime) {
+	iterations = fixedIterations;
+	if (iterations == 0) {
+		iterations = 1;
+		for (;;) {
+			const Uint64 elapsed = std::max(function(iterations, argument),
+					Uint64(1));
+			if (elapsed >= minimumTime) {
+				break;
+			}
+			// Aim 20% past the minimum, but grow at most tenfold per step.
+			const double factor = std::min(1.2 * double(minimumTime)
+					/ double(elapsed), 10.0);
+			iterations = std::max(Uint64(double(iterations) * factor),
+					iterations + 1);
+		}
+	}
+
+	function(iterations, argument);
+	samples.clear();
+	for (int r = 0; r < repetitions; ++r) {
+		const double result = double(function(iterations, argument));
+		if (bytesPerIteration != 0) {
+			// Bytes per nanosecond are GB/s.
+			samples.push_back(double(bytesPerIteration) * double(iterations)
+					/ std::max(result, 1.0));
+		} else {
+			samples.push_back(result / double(iterations));
+		}
+	}
+	computeStatistics();
+} // end run()
+
+/*
+ * computeStatistics - Derives mean, median, spread and the 95% confidence
+ * interval of the mean (Student's t) from the samples.
+ */
+void Benchmark::computeStatistics(void) {
+	const size_t count = samples.size();
+	mean = median = standardDeviation = minimum = maximum = 0.0;
+	confidenceLow = confidenceHigh = 0.0;
+	if (count == 0) {
+		return;
+	}
+
+	std::vector<double> sorted(samples);
+	std::sort(sorted.begin(), sorted.end());
+	minimum = sorted.front();
+	maximum = sorted.back();
+	median = count % 2 == 1 ? sorted[count / 2] : 0.5 * (sorted[count / 2
+			- 1] + sorted[count / 2]);
+
+	double sum = 0.0;
+	for (size_t s = 0; s < count; ++s) {
+		sum += samples[s];
+	}
+	mean = sum / double(count);
+
+	double squares = 0.0;
+	for (size_t s = 0; s < count; ++s) {
+		squares += (samples[s] - mean) * (samples[s] - mean);
+	}
+	standardDeviation = count > 1 ? std::sqrt(squares / double(count - 1))
+			: 0.0;
+
+	const double halfWidth = count > 1 ? getStudentT95(count - 1)
+			* standardDeviation / std::sqrt(double(count)) : 0.0;
+	confidenceLow = mean - halfWidth;
+	confidenceHigh = mean + halfWidth;
+} // end computeStatistics()
+
+/*
+ * BenchmarkRegistration - Constructor for BenchmarkRegistration class.
+ */
+BenchmarkRegistration::BenchmarkRegistration(const char* name,
+		BenchmarkFunction function, Uint64 argument, Uint64 fixedIterations,
+		const char* unit, Uint64 bytesPerIteration) {
+	Benchmark benchmark;
+	benchmark.name = name;
+	benchmark.function = function;
+	benchmark.argument = argument;
+	benchmark.fixedIterations = fixedIterations;
+	benchmark.unit = unit;
+	benchmark.bytesPerIteration = bytesPerIteration;
+	benchmark.iterations = 0;
+	benchmark.computeStatistics();
+	getBenchmarks().push_back(benchmark);
+} // end BenchmarkRegistration()
+
+/*
+ * getBenchmarks - Returns all registered benchmarks, in registration order.
+ */
+std::vector<Benchmark>& BenchmarkRegistration::getBenchmarks(void) {
+	static std::vector<Benchmark> benchmarks;
+	return benchmarks;
+} // end getBenchmarks()
+
+/*
+ * runThreads - Runs \p body on \p numThreads new threads, released together.
+ *
+ * @return The nanoseconds from the release until the last thread finished.
+ */
+Uint64 runThreads(int numThreads, ThreadBody body, void* context) {
+	Barrier start(numThreads + 1);
+	std::vector<ThreadStart> starts(numThreads);
+	std::vector<pthread_t> threads(numThreads);
+	for (int t = 0; t < numThreads; ++t) {
+		starts[t].body = body;
+		starts[t].context = context;
+		starts[t].thread = t;
+		starts[t].start = &start;
+		pthread_create(&threads[t], NULL, &threadMain, &starts[t]);
+	}
+
+	start.wait();
+	const Uint64 begin = SystemPosix::getMonotonicNanoseconds();
+	for (int t = 0; t < numThreads; ++t) {
+		pthread_join(threads[t], NULL);
+	}
+	return SystemPosix::getMonotonicNanoseconds() - begin;
+} // end runThreads()
+
+/*
+ * getStudentT95 - Returns the two-sided 95% critical value of Student's t
+ * distribution.
+ */
+double getStudentT95(size_t degreesOfFreedom) {
+	static const double table[] = { 0.0, 12.706, 4.303, 3.182, 2.776, 2.571,
+			2.447, 2.365, 2.306, 2.262, 2.228, 2.201, 2.179, 2.160, 2.145,
+			2.131, 2.120, 2.110, 2.101, 2.093, 2.086, 2.080, 2.074, 2.069,
+			2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042 };
+	if (degreesOfFreedom < sizeof(table) / sizeof(table[0])) {
+		return table[degreesOfFreedom];
+	}
+	return degreesOfFreedom < 60 ? 2.000 : (degreesOfFreedom < 120 ? 1.980
+			: 1.960);
+} // end getStudentT95()
@@ -0,0 +1,130 @@
+/*
+ * Benchmark.h - Micro-benchmark harness for the SYNC and UTIL primitives.
+ */
+#ifndef BENCHMARK_H_
+#define BENCHMARK_H_
+
+#include <string>
+#include <vector>
+
+/* Boost includes */
+#include <boost/preprocessor/cat.hpp>
+
+#include <UTIL/Types.h>
+
+/**
+ * @example "Example of a benchmark"
+ *
+ * A benchmark function runs the operation \p iterations times and returns
+ * how many nanoseconds that took, leaving setup out of the timed part:
+ *
+ * \code
+ * Uint64 lockUnlock(Uint64 iterations, Uint64) {
+ *     MutexPosix lock;
+ *     const Uint64 start = SystemPosix::getMonotonicNanoseconds();
+ *     for (Uint64 i = 0; i < iterations; ++i) {
+ *         Guard<MutexPosix> guard(lock);
+ *     }
+ *     return SystemPosix::getMonotonicNanoseconds() - start;
+ * }
+ * BENCHMARK("lock/MutexPosix/guard", lockUnlock, 0);
+ * \endcode
+ *
+ * The harness picks the iteration count so that one run takes at least the
+ * minimum time, then repeats the run and reports the time per iteration
+ * with its spread and a 95% confidence interval of the mean.
+ */
+#define BENCHMARK(name, function, argument) \
+	static BenchmarkRegistration BOOST_PP_CAT(benchmark, __LINE__)(name, \
+		&function, argument)
+
+/*
+ * BENCHMARK_FIXED - A benchmark that always runs \p iterations iterations,
+ * for expensive setups or functions that return something other than
+ * nanoseconds (named by \p unit, per iteration).
+ */
+#define BENCHMARK_FIXED(name, function, argument, iterations, unit) \
+	static BenchmarkRegistration BOOST_PP_CAT(benchmark, __LINE__)(name, \
+		&function, argument, iterations, unit)
+
+/*
+ * BENCHMARK_THROUGHPUT - A benchmark that processes \p bytes bytes per
+ * iteration and is reported in GB/s rather than time per iteration.
+ */
+#define BENCHMARK_THROUGHPUT(name, function, argument, bytes) \
+	static BenchmarkRegistration BOOST_PP_CAT(benchmark, __LINE__)(name, \
+		&function, argument, 0, "GB/s", bytes)
+
+/*
+ * BenchmarkFunction - Runs \p iterations iterations of the benchmark with
+ * the registered \p argument and returns the time they took in nanoseconds
+ * (or the total of the registered unit).
+ */
+typedef Uint64 (*BenchmarkFunction)(Uint64 iterations, Uint64 argument);
+
+/*
+ * Benchmark - A registered benchmark and, once run, its results.
+ */
+struct Benchmark {
+	std::string name;
+	BenchmarkFunction function;
+	Uint64 argument;
+	Uint64 fixedIterations; /**< 0 to calibrate */
+	std::string unit;
+	Uint64 bytesPerIteration; /**< Reported as GB/s if not 0 */
+
+	/* Results, per iteration: */
+	Uint64 iterations;
+	std::vector<double> samples;
+	double mean;
+	double median;
+	double standardDeviation;
+	double minimum;
+	double maximum;
+	double confidenceLow; /**< 95% confidence interval of the mean */
+	double confidenceHigh;
+
+	void run(int repetitions, Uint64 minimumTime);
+	void computeStatistics(void);
+};
+
+/*
+ * BenchmarkRegistration - Adds a benchmark to the list at static
+ * initialization.  Use BENCHMARK rather than this class directly.
+ */
+class BenchmarkRegistration {
+public:
+	BenchmarkRegistration(const char* name, BenchmarkFunction function,
+			Uint64 argument, Uint64 fixedIterations = 0, const char* unit =
+					"ns/op", Uint64 bytesPerIteration = 0);
+
+	static std::vector<Benchmark>& getBenchmarks(void);
+};
+
+/*
+ * ThreadBody - What each thread of runThreads() executes.
+ */
+typedef void (*ThreadBody)(int thread, void* context);
+
+Uint64 runThreads(int numThreads, ThreadBody body, void* context);
+double getStudentT95(size_t degreesOfFreedom);
+
+/*
+ * scaleElapsed - For benchmarks that work in whole batches and so ran
+ * \p performed iterations rather than the \p iterations asked for: scales
+ * the time they took to the iterations asked for.
+ */
+inline Uint64 scaleElapsed(Uint64 elapsed, Uint64 performed, Uint64 iterations) {
+	return Uint64(double(elapsed) * double(iterations) / double(performed));
+}
+
+/*
+ * doNotOptimize - Makes the compiler assume that \p value is used, so the
+ * computation of it is not removed.
+ */
+template<class T>
+inline void doNotOptimize(const T& value) {
+	asm volatile("" : : "r"(&value) : "memory");
+}
+
+#endif /* BENCHMARK_H_ */
@@ -0,0 +1,167 @@
+/*
+ * LockBench.cpp - Acquire/release cost of the locks, alone and contended.
+ */
+#include <SYNC/Guard.h>
+#include <SYNC/InstrumentedMutex.h>
+#include <SYNC/MutexPosix.h>
+#include <SYNC/NullMutex.h>
+#include <SYNC/ReadGuard.h>
+#include <SYNC/RWMutexPosix.h>
+#include <SYNC/SpinMutex.h>
+#include <SYNC/WriteGuard.h>
+#include <UTIL/System.h>
+
+#include "Benchmark.h"
+
+namespace {
+
+/*
+ * guardLoop - One uncontended acquire and release through a Guard per
+ * iteration.
+ */
+template<class LOCK_TYPE>
+Uint64 guardLoop(Uint64 iterations, Uint64) {
+	LOCK_TYPE lock;
+	volatile Uint64 counter = 0;
+	const Uint64 start = SystemPosix::getMonotonicNanoseconds();
+	for (Uint64 i = 0; i < iterations; ++i) {
+		Guard<LOCK_TYPE> guard(lock);
+		counter = counter + 1;
+	}
+	return SystemPosix::getMonotonicNanoseconds() - start;
+}
+
+/*
+ * acquireReleaseLoop - The same without the Guard, to show what it costs.
+ */
+template<class LOCK_TYPE>
+Uint64 acquireReleaseLoop(Uint64 iterations, Uint64) {
+	LOCK_TYPE lock;
+	volatile Uint64 counter = 0;
+	const Uint64 start = SystemPosix::getMonotonicNanoseconds();
+	for (Uint64 i = 0; i < iterations; ++i) {
+		lock.acquire();
+		counter = counter + 1;
+		lock.release();
+	}
+	return SystemPosix::getMonotonicNanoseconds() - start;
+}
+
+template<class LOCK_TYPE>
+Uint64 readGuardLoop(Uint64 iterations, Uint64) {
+	LOCK_TYPE lock;
+	volatile Uint64 counter = 0;
+	const Uint64 start = SystemPosix::getMonotonicNanoseconds();
+	for (Uint64 i = 0; i < iterations; ++i) {
+		ReadGuard<LOCK_TYPE> guard(lock);
+		counter = counter + 1;
+	}
+	return SystemPosix::getMonotonicNanoseconds() - start;
+}
+
+template<class LOCK_TYPE>
+Uint64 writeGuardLoop(Uint64 iterations, Uint64) {
+	LOCK_TYPE lock;
+	volatile Uint64 counter = 0;
+	const Uint64 start = SystemPosix::getMonotonicNanoseconds();
+	for (Uint64 i = 0; i < iterations; ++i) {
+		WriteGuard<LOCK_TYPE> guard(lock);
+		counter = counter + 1;
+	}
+	return SystemPosix::getMonotonicNanoseconds() - start;
+}
+
+/*
+ * Contention - Shared state of the contended benchmarks: every thread
+ * increments one counter under one lock.
+ */
+template<class LOCK_TYPE>
+struct Contention {
+	LOCK_TYPE lock;
+	volatile Uint64 counter;
+	Uint64 iterationsPerThread;
+	Uint64 data[8]; /**< What the readers read */
+};
+
+template<class LOCK_TYPE>
+void contendedBody(int, void* context) {
+	Contention<LOCK_TYPE>& shared = *static_cast<Contention<LOCK_TYPE>*> (
+			context);
+	for (Uint64 i = 0; i < shared.iterationsPerThread; ++i) {
+		Guard<LOCK_TYPE> guard(shared.lock);
+		shared.counter = shared.counter + 1;
+	}
+}
+
+/*
+ * contendedLoop - \p numThreads threads taking turns on one lock; the time
+ * per iteration is the inverse of the total throughput.
+ */
+template<class LOCK_TYPE>
+Uint64 contendedLoop(Uint64 iterations, Uint64 numThreads) {
+	Contention<LOCK_TYPE> shared;
+	shared.counter = 0;
+	shared.iterationsPerThread = iterations / numThreads + 1;
+	return runThreads(int(numThreads), &contendedBody<LOCK_TYPE>, &shared);
+}
+
+/*
+ * readMostlyBody - Readers sum the shared data under a read lock; one
+ * thread also writes it under a write lock every 64th iteration.
+ */
+template<class LOCK_TYPE>
+void readMostlyBody(int thread, void* context) {
+	Contention<LOCK_TYPE>& shared = *static_cast<Contention<LOCK_TYPE>*> (
+			context);
+	Uint64 sum = 0;
+	for (Uint64 i = 0; i < shared.iterationsPerThread; ++i) {
+		if (thread == 0 && (i & 63) == 0) {
+			WriteGuard<LOCK_TYPE> guard(shared.lock);
+			for (int d = 0; d < 8; ++d) {
+				shared.data[d] = i + d;
+			}
+		} else {
+			ReadGuard<LOCK_TYPE> guard(shared.lock);
+			for (int d = 0; d < 8; ++d) {
+				sum += shared.data[d];
+			}
+		}
+	}
+	doNotOptimize(sum);
+}
+
+template<class LOCK_TYPE>
+Uint64 readMostlyLoop(Uint64 iterations, Uint64 numThreads) {
+	Contention<LOCK_TYPE> shared;
+	shared.counter = 0;
+	shared.iterationsPerThread = iterations / numThreads + 1;
+	for (int d = 0; d < 8; ++d) {
+		shared.data[d] = d;
+	}
+	return runThreads(int(numThreads), &readMostlyBody<LOCK_TYPE>, &shared);
+}
+
+}
+
+BENCHMARK("lock/NullMutex/guard", guardLoop<NullMutex>, 0);
+BENCHMARK("lock/MutexPosix/guard", guardLoop<MutexPosix>, 0);
+BENCHMARK("lock/MutexPosix/acquire_release", acquireReleaseLoop<MutexPosix>, 0);
+BENCHMARK("lock/SpinMutex/guard", guardLoop<SpinMutex>, 0);
+BENCHMARK("lock/RWMutexPosix/read_guard", readGuardLoop<RWMutexPosix>, 0);
+BENCHMARK("lock/RWMutexPosix/write_guard", writeGuardLoop<RWMutexPosix>, 0);
+BENCHMARK("lock/InstrumentedMutex<MutexPosix>/guard",
+		guardLoop<InstrumentedMutex<MutexPosix> >, 0);
+
+BENCHMARK("lock/MutexPosix/contended/2", contendedLoop<MutexPosix>, 2);
+BENCHMARK("lock/MutexPosix/contended/4", contendedLoop<MutexPosix>, 4);
+BENCHMARK("lock/MutexPosix/contended/8", contendedLoop<MutexPosix>, 8);
+BENCHMARK("lock/SpinMutex/contended/2", contendedLoop<SpinMutex>, 2);
+BENCHMARK("lock/SpinMutex/contended/4", contendedLoop<SpinMutex>, 4);
+BENCHMARK("lock/SpinMutex/contended/8", contendedLoop<SpinMutex>, 8);
+
+BENCHMARK("lock/MutexPosix/read_mostly/1", readMostlyLoop<MutexPosix>, 1);
+BENCHMARK("lock/MutexPosix/read_mostly/4", readMostlyLoop<MutexPosix>, 4);
+BENCHMARK("lock/MutexPosix/read_mostly/16", readMostlyLoop<MutexPosix>, 16);
+BENCHMARK("lock/RWMutexPosix/read_mostly/1", readMostlyLoop<RWMutexPosix>, 1);
+BENCHMARK("lock/RWMutexPosix/read_mostly/4", readMostlyLoop<RWMutexPosix>, 4);
+BENCHMARK("lock/RWMutexPosix/read_mostly/16", readMostlyLoop<RWMutexPosix>, 16);
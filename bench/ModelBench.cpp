@@ -0,0 +1,156 @@
+/*
+ * ModelBench.cpp - Load times of a model through the reader plugin and
+ * through the ModelCache: cold (read by the plugin and stored) and warm
+ * (built from the cache entry).  The model is ROCKET_BENCH_MODEL, by
+ * default the hopper.  These benchmarks need the OSG headers and libraries,
+ * so they are only built when those are installed (BENCH_MODEL_CACHE).
+ */
+#ifdef BENCH_MODEL_CACHE
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <unistd.h>
+
+/* osg includes */
+#include <osg/Node>
+#include <osgDB/ReadFile>
+
+#include <MODEL/ModelCache.h>
+#include <UTIL/System.h>
+
+#include "Benchmark.h"
+
+namespace {
+
+std::string getModelPath(void) {
+	std::string path;
+	if (!SystemPosix::getenv("ROCKET_BENCH_MODEL", path)) {
+		path = "../data/Rocket/europa.3ds";
+	}
+	return path;
+}
+
+/*
+ * BenchCache - A cache in a directory of its own, deleted afterwards, so
+ * the benchmarks neither use nor disturb the user's cache.
+ */
+class BenchCache {
+public:
+	BenchCache(void) :
+		cache(makeDirectory(), Uint64(1) << 32) {
+	}
+
+	~BenchCache(void) {
+		cache.clear();
+		rmdir(cache.getDirectory().c_str());
+	}
+
+	ModelCache cache;
+
+private:
+	static std::string makeDirectory(void) {
+		char name[] = "/tmp/rocket-bench-cache-XXXXXX";
+		return mkdtemp(name) != NULL ? name : "";
+	}
+};
+
+/*
+ * pluginLoop - Reads the model with the reader plugin; one iteration is
+ * one load.
+ */
+Uint64 pluginLoop(Uint64 iterations, Uint64) {
+	const std::string path = getModelPath();
+	const Uint64 start = SystemPosix::getMonotonicNanoseconds();
+	for (Uint64 i = 0; i < iterations; ++i) {
+		osg::ref_ptr<osg::Node> node = osgDB::readNodeFile(path);
+		if (!node.valid()) {
+			fprintf(stderr, "Cannot read %s\n", path.c_str());
+			exit(EXIT_FAILURE);
+		}
+		doNotOptimize(node);
+	}
+	return SystemPosix::getMonotonicNanoseconds() - start;
+}
+
+/*
+ * coldLoop - Loads the model as ModelLoader does with an empty cache:
+ * hashes the file, misses, reads it with the plugin and stores it.
+ */
+Uint64 coldLoop(Uint64 iterations, Uint64) {
+	const std::string path = getModelPath();
+	BenchCache bench;
+	Uint64 elapsed = 0;
+	for (Uint64 i = 0; i < iterations; ++i) {
+		bench.cache.clear();
+		const Uint64 start = SystemPosix::getMonotonicNanoseconds();
+		Uint64 key;
+		if (!ModelCache::computeKey(path, "", key)) {
+			fprintf(stderr, "Cannot read %s\n", path.c_str());
+			exit(EXIT_FAILURE);
+		}
+		osg::ref_ptr<osg::Node> node = bench.cache.load(key);
+		if (!node.valid()) {
+			node = osgDB::readNodeFile(path);
+			if (node.valid()) {
+				bench.cache.store(key, *node);
+			}
+		}
+		elapsed += SystemPosix::getMonotonicNanoseconds() - start;
+		doNotOptimize(node);
+	}
+	return elapsed;
+}
+
+/*
+ * warmLoop - Loads the model from its cache entry, hashing the file
+ * included.
+ */
+Uint64 warmLoop(Uint64 iterations, Uint64) {
+	const std::string path = getModelPath();
+	BenchCache bench;
+	Uint64 key;
+	osg::ref_ptr<osg::Node> source = osgDB::readNodeFile(path);
+	if (!source.valid() || !ModelCache::computeKey(path, "", key)) {
+		fprintf(stderr, "Cannot read %s\n", path.c_str());
+		exit(EXIT_FAILURE);
+	}
+	if (!bench.cache.store(key, *source)) {
+		fprintf(stderr, "The model cache cannot store %s\n", path.c_str());
+		exit(EXIT_FAILURE);
+	}
+
+	const Uint64 start = SystemPosix::getMonotonicNanoseconds();
+	for (Uint64 i = 0; i < iterations; ++i) {
+		if (!ModelCache::computeKey(path, "", key)) {
+			exit(EXIT_FAILURE);
+		}
+		osg::ref_ptr<osg::Node> node = bench.cache.load(key);
+		doNotOptimize(node);
+	}
+	return SystemPosix::getMonotonicNanoseconds() - start;
+}
+
+/*
+ * keyLoop - Hashes the model file, the part of a warm load that is paid
+ * on every load.
+ */
+Uint64 keyLoop(Uint64 iterations, Uint64) {
+	const std::string path = getModelPath();
+	Uint64 key = 0;
+	const Uint64 start = SystemPosix::getMonotonicNanoseconds();
+	for (Uint64 i = 0; i < iterations; ++i) {
+		ModelCache::computeKey(path, "", key);
+		doNotOptimize(key);
+	}
+	return SystemPosix::getMonotonicNanoseconds() - start;
+}
+
+}
+
+BENCHMARK_FIXED("model/load/plugin", pluginLoop, 0, 10, "ns");
+BENCHMARK_FIXED("model/load/cold", coldLoop, 0, 10, "ns");
+BENCHMARK_FIXED("model/load/warm", warmLoop, 0, 10, "ns");
+BENCHMARK("model/ModelCache/computeKey", keyLoop, 0);
+
+#endif /* BENCH_MODEL_CACHE */
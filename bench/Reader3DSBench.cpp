@@ -0,0 +1,402 @@
+/*
+ * Reader3DSBench.cpp - Load times of 3DS files with Reader3DS and with the
+ * OSG plugin, on ROCKET_BENCH_MODEL (by default the hopper) and on a large
+ * generated file.  Before its first run on a file, the native reader's
+ * output is compared with the plugin's and any difference is reported.
+ * Built when the OSG headers and libraries are installed
+ * (BENCH_READER_3DS).
+ */
+#ifdef BENCH_READER_3DS
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <set>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+/* osg includes */
+#include <osg/Node>
+#include <osgDB/ReadFile>
+
+#include <MODEL/Reader3DS.h>
+#include <SYNC/ThreadPool.h>
+#include <UTIL/System.h>
+
+#include "Benchmark.h"
+
+namespace {
+
+/*
+ * ChunkWriter - Writes a 3DS file chunk by chunk.
+ */
+class ChunkWriter {
+public:
+	void begin(Uint16 id) {
+		starts.push_back(bytes.size());
+		writeUint16(id);
+		writeUint32(0);
+	}
+
+	void end(void) {
+		const size_t start = starts.back();
+		starts.pop_back();
+		const Uint32 length = Uint32(bytes.size() - start);
+		for (int i = 0; i < 4; ++i) {
+			bytes[start + 2 + i] = (unsigned char) (length >> 8 * i);
+		}
+	}
+
+	void writeByte(Uint8 value) {
+		bytes.push_back(value);
+	}
+
+	void writeUint16(Uint16 value) {
+		bytes.push_back((unsigned char) value);
+		bytes.push_back((unsigned char) (value >> 8));
+	}
+
+	void writeUint32(Uint32 value) {
+		for (int i = 0; i < 4; ++i) {
+			bytes.push_back((unsigned char) (value >> 8 * i));
+		}
+	}
+
+	void writeFloat(float value) {
+		Uint32 bits;
+		std::memcpy(&bits, &value, sizeof(bits));
+		writeUint32(bits);
+	}
+
+	void writeString(const std::string& text) {
+		bytes.insert(bytes.end(), text.begin(), text.end());
+		bytes.push_back(0);
+	}
+
+	bool save(const std::string& path) const {
+		FILE* file = fopen(path.c_str(), "wb");
+		if (file == NULL) {
+			return false;
+		}
+		const bool written = fwrite(&bytes[0], 1, bytes.size(), file)
+				== bytes.size();
+		return fclose(file) == 0 && written;
+	}
+
+private:
+	std::vector<unsigned char> bytes;
+	std::vector<size_t> starts;
+};
+
+const int NUM_MATERIALS = 4;
+
+/*
+ * writeSyntheticModel - Writes \p numObjects rippled grids of 2 * size *
+ * size triangles in two materials and two smoothing groups each, placed
+ * by a keyframer hierarchy with pivots and rotations if \p keyframer is
+ * set.  The surface is the same either way.
+ */
+bool writeSyntheticModel(const std::string& path, int numObjects, int size,
+		bool keyframer) {
+	ChunkWriter out;
+	out.begin(0x4d4d);
+	out.begin(0x3d3d);
+	for (int m = 0; m < NUM_MATERIALS; ++m) {
+		out.begin(0xafff);
+		out.begin(0xa000);
+		char name[16];
+		snprintf(name, sizeof(name), "material%d", m);
+		out.writeString(name);
+		out.end();
+		out.begin(0xa020);
+		out.begin(0x0011);
+		out.writeByte(Uint8(60 * m + 20));
+		out.writeByte(Uint8(200 - 40 * m));
+		out.writeByte(Uint8(30 * m));
+		out.end();
+		out.end();
+		out.begin(0xa040);
+		out.begin(0x0030);
+		out.writeUint16(Uint16(10 * m));
+		out.end();
+		out.end();
+		out.end();
+	}
+
+	const int numPoints = (size + 1) * (size + 1);
+	for (int o = 0; o < numObjects; ++o) {
+		char name[16];
+		snprintf(name, sizeof(name), "object%d", o);
+		const float angle = o % 3 == 0 ? 0.3f * o : 0.0f;
+		const float cosine = std::cos(angle);
+		const float sine = std::sin(angle);
+		const float offset[3] = { 3.0f * (o % 8), 3.0f * (o / 8), 0.5f * o };
+
+		out.begin(0x4000);
+		out.writeString(name);
+		out.begin(0x4100);
+		out.begin(0x4110);
+		out.writeUint16(Uint16(numPoints));
+		for (int y = 0; y <= size; ++y) {
+			for (int x = 0; x <= size; ++x) {
+				const float u = 2.0f * x / size;
+				const float v = 2.0f * y / size;
+				const float w = 0.1f * std::sin(6.0f * u) * std::cos(4.0f * v);
+				// Rotated about z, then moved: the mesh matrix below.
+				out.writeFloat(cosine * u - sine * v + offset[0]);
+				out.writeFloat(sine * u + cosine * v + offset[1]);
+				out.writeFloat(w + offset[2]);
+			}
+		}
+		out.end();
+		out.begin(0x4140);
+		out.writeUint16(Uint16(numPoints));
+		for (int y = 0; y <= size; ++y) {
+			for (int x = 0; x <= size; ++x) {
+				out.writeFloat(float(x) / size);
+				out.writeFloat(float(y) / size);
+			}
+		}
+		out.end();
+		out.begin(0x4160);
+		const float matrix[12] = { cosine, sine, 0.0f, -sine, cosine, 0.0f,
+				0.0f, 0.0f, 1.0f, offset[0], offset[1], offset[2] };
+		for (int i = 0; i < 12; ++i) {
+			out.writeFloat(matrix[i]);
+		}
+		out.end();
+
+		const int numFaces = 2 * size * size;
+		out.begin(0x4120);
+		out.writeUint16(Uint16(numFaces));
+		for (int y = 0; y < size; ++y) {
+			for (int x = 0; x < size; ++x) {
+				const Uint16 p = Uint16(y * (size + 1) + x);
+				const Uint16 q = Uint16(p + size + 1);
+				const Uint16 faces[2][3] = { { p, Uint16(p + 1), q }, { Uint16(
+						p + 1), Uint16(q + 1), q } };
+				for (int f = 0; f < 2; ++f) {
+					out.writeUint16(faces[f][0]);
+					out.writeUint16(faces[f][1]);
+					out.writeUint16(faces[f][2]);
+					out.writeUint16(7);
+				}
+			}
+		}
+		for (int half = 0; half < 2; ++half) {
+			snprintf(name, sizeof(name), "material%d", (o + half)
+					% NUM_MATERIALS);
+			out.begin(0x4130);
+			out.writeString(name);
+			out.writeUint16(Uint16(numFaces / 2));
+			for (int f = half * numFaces / 2; f < (half + 1) * numFaces / 2; ++f) {
+				out.writeUint16(Uint16(f));
+			}
+			out.end();
+		}
+		out.begin(0x4150);
+		for (int f = 0; f < numFaces; ++f) {
+			// A crease between the halves; the first row is faceted.
+			out.writeUint32(f < 2 * size ? 0 : f < numFaces / 2 ? 1 : 2);
+		}
+		out.end();
+		out.end();
+		out.end();
+		out.end();
+	}
+	out.end();
+
+	if (keyframer) {
+		out.begin(0xb000);
+		// The last object has no node and stays where its mesh matrix puts
+		// it.
+		for (int o = 0; o + 1 < numObjects; ++o) {
+			// Every third object hangs off the unrotated one before it, the
+			// others off the root; each has a pivot near its centre.
+			const bool rotated = o % 3 == 0;
+			const int parent = o % 3 == 2 ? o - 1 : -1;
+			const float angle = rotated ? 0.3f * o : 0.0f;
+			const float pivot[3] = { 1.0f, 1.0f, 0.0f };
+			float position[3] = { 3.0f * (o % 8), 3.0f * (o / 8), 0.5f * o };
+			// The world position of the node is where the pivot lands.
+			position[0] += std::cos(angle) * pivot[0] - std::sin(angle)
+					* pivot[1];
+			position[1] += std::sin(angle) * pivot[0] + std::cos(angle)
+					* pivot[1];
+			if (parent >= 0) {
+				position[0] -= 3.0f * (parent % 8) + pivot[0];
+				position[1] -= 3.0f * (parent / 8) + pivot[1];
+				position[2] -= 0.5f * parent;
+			}
+
+			char name[16];
+			snprintf(name, sizeof(name), "object%d", o);
+			out.begin(0xb002);
+			out.begin(0xb030);
+			out.writeUint16(Uint16(o));
+			out.end();
+			out.begin(0xb010);
+			out.writeString(name);
+			out.writeUint16(0);
+			out.writeUint16(0);
+			out.writeUint16(parent < 0 ? 0xffff : Uint16(parent));
+			out.end();
+			out.begin(0xb013);
+			for (int i = 0; i < 3; ++i) {
+				out.writeFloat(pivot[i]);
+			}
+			out.end();
+			out.begin(0xb020);
+			out.writeUint16(0);
+			out.writeUint32(0);
+			out.writeUint32(0);
+			out.writeUint32(1);
+			out.writeUint32(0);
+			out.writeUint16(0);
+			for (int i = 0; i < 3; ++i) {
+				out.writeFloat(position[i]);
+			}
+			out.end();
+			if (rotated) {
+				// 3DS angles turn clockwise about the axis.
+				out.begin(0xb021);
+				out.writeUint16(0);
+				out.writeUint32(0);
+				out.writeUint32(0);
+				out.writeUint32(1);
+				out.writeUint32(0);
+				out.writeUint16(0);
+				out.writeFloat(-angle);
+				out.writeFloat(0.0f);
+				out.writeFloat(0.0f);
+				out.writeFloat(1.0f);
+				out.end();
+			}
+			out.end();
+		}
+		out.end();
+	}
+	out.end();
+	return out.save(path);
+}
+
+std::string syntheticModel;
+
+void removeSyntheticModel(void) {
+	unlink(syntheticModel.c_str());
+}
+
+/*
+ * getSyntheticModel - Returns the path of the generated file, writing it
+ * on first use: 64 objects of 32768 triangles, about 50 MB.
+ */
+const std::string& getSyntheticModel(void) {
+	if (syntheticModel.empty()) {
+		char name[] = "/tmp/rocket-bench-XXXXXX.3ds";
+		const int fd = mkstemps(name, 4);
+		if (fd < 0 || close(fd) != 0 || !writeSyntheticModel(name, 64, 128,
+				true)) {
+			fprintf(stderr, "Cannot write %s\n", name);
+			exit(EXIT_FAILURE);
+		}
+		syntheticModel = name;
+		atexit(removeSyntheticModel);
+	}
+	return syntheticModel;
+}
+
+const std::string& getModelPath(Uint64 synthetic) {
+	static std::string path;
+	if (synthetic) {
+		return getSyntheticModel();
+	}
+	if (path.empty() && !SystemPosix::getenv("ROCKET_BENCH_MODEL", path)) {
+		path = "../data/Rocket/europa.3ds";
+	}
+	return path;
+}
+
+/*
+ * validate - Compares the native reader's output on \p path with the
+ * plugin's, once per file.
+ */
+void validate(const std::string& path, const osg::Node& node) {
+	static std::set<std::string> validated;
+	if (!validated.insert(path).second) {
+		return;
+	}
+	osg::ref_ptr<osg::Node> reference = osgDB::readNodeFile(path);
+	std::string differences;
+	if (!reference.valid()) {
+		fprintf(stderr, "The plugin cannot read %s\n", path.c_str());
+	} else if (!Reader3DS::compare(node, *reference, differences)) {
+		fprintf(stderr, "Reader3DS differs from the plugin on %s:\n%s",
+				path.c_str(), differences.c_str());
+	}
+}
+
+Uint64 readLoop(Uint64 iterations, Reader3DS& reader, const std::string& path) {
+	Uint64 elapsed = 0;
+	for (Uint64 i = 0; i < iterations; ++i) {
+		const Uint64 start = SystemPosix::getMonotonicNanoseconds();
+		osg::ref_ptr<osg::Node> node;
+		try {
+			node = reader.read(path);
+		} catch (const std::exception& e) {
+			fprintf(stderr, "%s\n", e.what());
+			exit(EXIT_FAILURE);
+		}
+		elapsed += SystemPosix::getMonotonicNanoseconds() - start;
+		validate(path, *node);
+	}
+	return elapsed;
+}
+
+/*
+ * nativeLoop - Reads the file with Reader3DS on the shared pool.
+ */
+Uint64 nativeLoop(Uint64 iterations, Uint64 synthetic) {
+	Reader3DS reader;
+	return readLoop(iterations, reader, getModelPath(synthetic));
+}
+
+/*
+ * oneWorkerLoop - Reads the file with Reader3DS on one worker and the
+ * calling thread, to show what the parallel decoding gains.
+ */
+Uint64 oneWorkerLoop(Uint64 iterations, Uint64 synthetic) {
+	ThreadPool pool(1);
+	Reader3DS reader(pool);
+	return readLoop(iterations, reader, getModelPath(synthetic));
+}
+
+/*
+ * pluginLoop - Reads the file with the OSG plugin.
+ */
+Uint64 pluginLoop(Uint64 iterations, Uint64 synthetic) {
+	const std::string& path = getModelPath(synthetic);
+	Uint64 elapsed = 0;
+	for (Uint64 i = 0; i < iterations; ++i) {
+		const Uint64 start = SystemPosix::getMonotonicNanoseconds();
+		osg::ref_ptr<osg::Node> node = osgDB::readNodeFile(path);
+		elapsed += SystemPosix::getMonotonicNanoseconds() - start;
+		if (!node.valid()) {
+			fprintf(stderr, "Cannot read %s\n", path.c_str());
+			exit(EXIT_FAILURE);
+		}
+	}
+	return elapsed;
+}
+
+}
+
+BENCHMARK_FIXED("model/3ds/native", nativeLoop, 0, 10, "ns");
+BENCHMARK_FIXED("model/3ds/native/1_worker", oneWorkerLoop, 0, 10, "ns");
+BENCHMARK_FIXED("model/3ds/plugin", pluginLoop, 0, 10, "ns");
+BENCHMARK_FIXED("model/3ds/native/large", nativeLoop, 1, 5, "ns");
+BENCHMARK_FIXED("model/3ds/native/large/1_worker", oneWorkerLoop, 1, 5, "ns");
+BENCHMARK_FIXED("model/3ds/plugin/large", pluginLoop, 1, 5, "ns");
+
+#endif /* BENCH_READER_3DS */
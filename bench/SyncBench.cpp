@@ -0,0 +1,548 @@
+/*
+ * SyncBench.cpp - Hand-off cost of the synchronization primitives: barriers,
+ * events, queues, the thread pool and the sequence lock.
+ */
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include <pthread.h>
+#include <unistd.h>
+
+#include <SYNC/Atomic.h>
+#include <SYNC/Barrier.h>
+#include <SYNC/BlockingQueue.h>
+#include <SYNC/CommandQueue.h>
+#include <SYNC/Event.h>
+#include <SYNC/SeqLock.h>
+#include <SYNC/ThreadPool.h>
+#include <UTIL/System.h>
+
+#include "Benchmark.h"
+
+namespace {
+
+struct BarrierRounds {
+	Barrier* barrier;
+	Uint64 rounds;
+};
+
+void barrierBody(int, void* context) {
+	BarrierRounds& shared = *static_cast<BarrierRounds*> (context);
+	for (Uint64 r = 0; r < shared.rounds; ++r) {
+		shared.barrier->wait();
+	}
+}
+
+/*
+ * barrierLoop - One iteration is one round of \p numThreads threads meeting
+ * at a barrier.
+ */
+Uint64 barrierLoop(Uint64 iterations, Uint64 numThreads) {
+	Barrier barrier(static_cast<int> (numThreads));
+	BarrierRounds shared;
+	shared.barrier = &barrier;
+	shared.rounds = iterations;
+	return runThreads(int(numThreads), &barrierBody, &shared);
+}
+
+struct PthreadBarrierRounds {
+	pthread_barrier_t* barrier;
+	Uint64 rounds;
+};
+
+void pthreadBarrierBody(int, void* context) {
+	PthreadBarrierRounds& shared =
+			*static_cast<PthreadBarrierRounds*> (context);
+	for (Uint64 r = 0; r < shared.rounds; ++r) {
+		pthread_barrier_wait(shared.barrier);
+	}
+}
+
+/*
+ * pthreadBarrierLoop - barrierLoop() with a pthread_barrier_t, which
+ * sleeps in the kernel right away instead of spinning first.
+ */
+Uint64 pthreadBarrierLoop(Uint64 iterations, Uint64 numThreads) {
+	pthread_barrier_t barrier;
+	pthread_barrier_init(&barrier, NULL, unsigned(numThreads));
+	PthreadBarrierRounds shared;
+	shared.barrier = &barrier;
+	shared.rounds = iterations;
+	const Uint64 elapsed = runThreads(int(numThreads), &pthreadBarrierBody,
+			&shared);
+	pthread_barrier_destroy(&barrier);
+	return elapsed;
+}
+
+struct PingPong {
+	Event* events[2];
+	Uint64 rounds;
+};
+
+void pingPongBody(int thread, void* context) {
+	PingPong& shared = *static_cast<PingPong*> (context);
+	Event& mine = *shared.events[thread];
+	Event& other = *shared.events[1 - thread];
+	for (Uint64 r = 0; r < shared.rounds; ++r) {
+		if (thread == 0) {
+			other.set();
+			mine.wait();
+		} else {
+			mine.wait();
+			other.set();
+		}
+	}
+}
+
+/*
+ * eventPingPongLoop - One iteration is a round trip between two threads
+ * over two auto-reset events: the wake-up latency, twice.
+ */
+Uint64 eventPingPongLoop(Uint64 iterations, Uint64) {
+	Event ping(Event::AUTO_RESET);
+	Event pong(Event::AUTO_RESET);
+	PingPong shared;
+	shared.events[0] = &ping;
+	shared.events[1] = &pong;
+	shared.rounds = iterations;
+	return runThreads(2, &pingPongBody, &shared);
+}
+
+/*
+ * ConditionEvent - An auto-reset event made of a mutex, a condition
+ * variable and a flag, the usual way to build one without futexes.
+ */
+struct ConditionEvent {
+	pthread_mutex_t mutex;
+	pthread_cond_t condition;
+	bool signaled;
+
+	void set(void) {
+		pthread_mutex_lock(&mutex);
+		signaled = true;
+		pthread_cond_signal(&condition);
+		pthread_mutex_unlock(&mutex);
+	}
+
+	void wait(void) {
+		pthread_mutex_lock(&mutex);
+		while (!signaled) {
+			pthread_cond_wait(&condition, &mutex);
+		}
+		signaled = false;
+		pthread_mutex_unlock(&mutex);
+	}
+};
+
+struct ConditionPingPong {
+	ConditionEvent events[2];
+	Uint64 rounds;
+};
+
+void conditionPingPongBody(int thread, void* context) {
+	ConditionPingPong& shared = *static_cast<ConditionPingPong*> (context);
+	ConditionEvent& mine = shared.events[thread];
+	ConditionEvent& other = shared.events[1 - thread];
+	for (Uint64 r = 0; r < shared.rounds; ++r) {
+		if (thread == 0) {
+			other.set();
+			mine.wait();
+		} else {
+			mine.wait();
+			other.set();
+		}
+	}
+}
+
+/*
+ * conditionPingPongLoop - eventPingPongLoop() with ConditionEvent.
+ */
+Uint64 conditionPingPongLoop(Uint64 iterations, Uint64) {
+	ConditionPingPong shared;
+	for (int e = 0; e < 2; ++e) {
+		pthread_mutex_init(&shared.events[e].mutex, NULL);
+		pthread_cond_init(&shared.events[e].condition, NULL);
+		shared.events[e].signaled = false;
+	}
+	shared.rounds = iterations;
+	const Uint64 elapsed = runThreads(2, &conditionPingPongBody, &shared);
+	for (int e = 0; e < 2; ++e) {
+		pthread_cond_destroy(&shared.events[e].condition);
+		pthread_mutex_destroy(&shared.events[e].mutex);
+	}
+	return elapsed;
+}
+
+struct QueueTraffic {
+	BlockingQueue<Uint64>* queue;
+	int numProducers;
+	Uint64 itemsPerProducer;
+	Uint64 itemsPerConsumer;
+};
+
+void queueBody(int thread, void* context) {
+	QueueTraffic& shared = *static_cast<QueueTraffic*> (context);
+	if (thread < shared.numProducers) {
+		for (Uint64 i = 0; i < shared.itemsPerProducer; ++i) {
+			shared.queue->push(i);
+		}
+	} else {
+		Uint64 item = 0;
+		for (Uint64 i = 0; i < shared.itemsPerConsumer; ++i) {
+			shared.queue->pop(item);
+		}
+		doNotOptimize(item);
+	}
+}
+
+/*
+ * blockingQueueLoop - \p pairs producers and as many consumers passing
+ * items through one BlockingQueue; one iteration is one item.
+ */
+Uint64 blockingQueueLoop(Uint64 iterations, Uint64 pairs) {
+	BlockingQueue<Uint64> queue(1024);
+	QueueTraffic shared;
+	shared.queue = &queue;
+	shared.numProducers = int(pairs);
+	shared.itemsPerProducer = iterations / pairs + 1;
+	shared.itemsPerConsumer = shared.itemsPerProducer;
+	return runThreads(int(2 * pairs), &queueBody, &shared);
+}
+
+struct CountCommands {
+	Uint64 sum;
+
+	void operator()(const Uint64& command) {
+		sum += command;
+	}
+};
+
+/*
+ * commandQueueLoop - Pushes batches of \p batch commands and drains them
+ * on the same thread, the uncontended cost per command.
+ */
+Uint64 commandQueueLoop(Uint64 iterations, Uint64 batch) {
+	CommandQueue<Uint64> queue(batch);
+	CountCommands handler;
+	handler.sum = 0;
+	const Uint64 start = SystemPosix::getMonotonicNanoseconds();
+	Uint64 performed = 0;
+	for (; performed < iterations; performed += batch) {
+		for (Uint64 c = 0; c < batch; ++c) {
+			queue.tryPush(c);
+		}
+		queue.drain(handler);
+	}
+	const Uint64 elapsed = SystemPosix::getMonotonicNanoseconds() - start;
+	doNotOptimize(handler.sum);
+	return scaleElapsed(elapsed, performed, iterations);
+}
+
+struct CommandTraffic {
+	CommandQueue<Uint64>* queue;
+	int numProducers;
+	Uint64 commandsPerProducer;
+	volatile Int32 producing;
+};
+
+void commandTrafficBody(int thread, void* context) {
+	CommandTraffic& shared = *static_cast<CommandTraffic*> (context);
+	if (thread < shared.numProducers) {
+		for (Uint64 i = 0; i < shared.commandsPerProducer; ++i) {
+			while (!shared.queue->tryPush(i)) {
+				Atomic::cpuRelax();
+			}
+		}
+		Atomic::fetchSub(&shared.producing, Int32(1));
+	} else {
+		CountCommands handler;
+		handler.sum = 0;
+		for (;;) {
+			const bool finished = Atomic::load(&shared.producing) == 0;
+			if (shared.queue->drain(handler) == 0 && finished) {
+				break;
+			}
+		}
+		doNotOptimize(handler.sum);
+	}
+}
+
+/*
+ * commandQueueContendedLoop - \p numProducers threads pushing into one
+ * CommandQueue that one consumer keeps draining; one iteration is one
+ * command.
+ */
+Uint64 commandQueueContendedLoop(Uint64 iterations, Uint64 numProducers) {
+	CommandQueue<Uint64> queue(4096);
+	CommandTraffic shared;
+	shared.queue = &queue;
+	shared.numProducers = int(numProducers);
+	shared.commandsPerProducer = iterations / numProducers + 1;
+	shared.producing = Int32(numProducers);
+	return runThreads(int(numProducers) + 1, &commandTrafficBody, &shared);
+}
+
+/*
+ * ToggleCommand - Stands in for Hopper::SceneCommand: the state a menu
+ * toggle asks for.
+ */
+struct ToggleCommand {
+	int toggle;
+	bool set;
+};
+
+struct ApplyToggles {
+	bool* scene;
+
+	void operator()(const ToggleCommand& command) {
+		scene[command.toggle] = command.set;
+	}
+};
+
+struct ToggleTraffic {
+	CommandQueue<ToggleCommand>* queue;
+	int numToggles;
+	Uint64 clicksPerToggle;
+	bool menu[16]; /**< What each toggle shows */
+	bool scene[16]; /**< What the consumer applied */
+	volatile Int32 clicking;
+	volatile Uint64 dropped;
+};
+
+void toggleTrafficBody(int thread, void* context) {
+	ToggleTraffic& shared = *static_cast<ToggleTraffic*> (context);
+	if (thread < shared.numToggles) {
+		// Clicks as Rocket::menuToggleSelectCallback() handles them: a
+		// dropped command puts the toggle back.
+		Uint64 dropped = 0;
+		for (Uint64 i = 0; i < shared.clicksPerToggle; ++i) {
+			ToggleCommand command;
+			command.toggle = thread;
+			command.set = !shared.menu[thread];
+			if (shared.queue->tryPush(command)) {
+				shared.menu[thread] = command.set;
+			} else {
+				++dropped;
+			}
+		}
+		Atomic::fetchAdd(&shared.dropped, dropped);
+		Atomic::fetchSub(&shared.clicking, Int32(1));
+	} else {
+		ApplyToggles handler;
+		handler.scene = shared.scene;
+		for (;;) {
+			const bool finished = Atomic::load(&shared.clicking) == 0;
+			if (shared.queue->drain(handler) == 0 && finished) {
+				break;
+			}
+		}
+	}
+}
+
+/*
+ * toggleStressLoop - \p numToggles threads clicking one menu toggle each
+ * into a small CommandQueue that one consumer keeps draining, so that
+ * commands get dropped; one iteration is one click.  Aborts if any toggle
+ * ends up showing another state than the one applied to the scene.
+ */
+Uint64 toggleStressLoop(Uint64 iterations, Uint64 numToggles) {
+	CommandQueue<ToggleCommand> queue(16);
+	ToggleTraffic shared;
+	shared.queue = &queue;
+	shared.numToggles = int(numToggles);
+	shared.clicksPerToggle = iterations / numToggles + 1;
+	for (int t = 0; t < 16; ++t) {
+		shared.menu[t] = false;
+		shared.scene[t] = false;
+	}
+	shared.clicking = Int32(numToggles);
+	shared.dropped = 0;
+	const Uint64 elapsed = runThreads(int(numToggles) + 1, &toggleTrafficBody,
+			&shared);
+
+	for (int t = 0; t < shared.numToggles; ++t) {
+		if (shared.menu[t] != shared.scene[t]) {
+			fprintf(stderr, "Toggle %d shows %d but the scene has %d "
+				"(%lu commands dropped)\n", t, int(shared.menu[t]),
+					int(shared.scene[t]), shared.dropped);
+			abort();
+		}
+	}
+	return elapsed;
+}
+
+/*
+ * SumRange - parallelFor body adding up part of an array.
+ */
+struct SumRange {
+	const std::vector<Uint64>* values;
+	volatile Uint64* total;
+
+	void operator()(size_t first, size_t last) const {
+		Uint64 sum = 0;
+		for (size_t i = first; i < last; ++i) {
+			sum += (*values)[i];
+		}
+		Atomic::fetchAdd(total, sum);
+	}
+};
+
+/*
+ * parallelForLoop - Sums 1M values with ThreadPool::parallelFor in
+ * subranges of \p grain values (or, for 0, in a plain loop); one iteration
+ * is one pass over all of them.
+ */
+Uint64 parallelForLoop(Uint64 iterations, Uint64 grain) {
+	static const size_t SIZE = 1 << 20;
+	static std::vector<Uint64> values(SIZE, 1);
+	volatile Uint64 total = 0;
+	SumRange body;
+	body.values = &values;
+	body.total = &total;
+
+	ThreadPool& pool = ThreadPool::instance();
+	const Uint64 start = SystemPosix::getMonotonicNanoseconds();
+	for (Uint64 i = 0; i < iterations; ++i) {
+		if (grain == 0) {
+			body(0, SIZE);
+		} else {
+			pool.parallelFor(0, SIZE, grain, body);
+		}
+	}
+	return SystemPosix::getMonotonicNanoseconds() - start;
+}
+
+/*
+ * MixRange - parallelFor body that hashes its part of an index range, so
+ * the work is bound by the cores and not by memory.
+ */
+struct MixRange {
+	volatile Uint64* total;
+
+	void operator()(size_t first, size_t last) const {
+		Uint64 sum = 0;
+		for (size_t i = first; i < last; ++i) {
+			Uint64 x = Uint64(i) * 0x9e3779b97f4a7c15ULL;
+			x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+			x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+			sum += x ^ (x >> 31);
+		}
+		Atomic::fetchAdd(total, sum);
+	}
+};
+
+/*
+ * scalingLoop - Hashes 1M indices with parallelFor on a pool of its own
+ * with \p numWorkers workers (or, for 0, one per online core); one
+ * iteration is one pass.  The calling thread helps, as the main thread does
+ * in the application.
+ */
+Uint64 scalingLoop(Uint64 iterations, Uint64 numWorkers) {
+	static const size_t SIZE = 1 << 20;
+	if (numWorkers == 0) {
+		numWorkers = Uint64(std::max(sysconf(_SC_NPROCESSORS_ONLN), 1L));
+	}
+	ThreadPool pool(static_cast<int> (numWorkers));
+	volatile Uint64 total = 0;
+	MixRange body;
+	body.total = &total;
+
+	const Uint64 start = SystemPosix::getMonotonicNanoseconds();
+	for (Uint64 i = 0; i < iterations; ++i) {
+		pool.parallelFor(0, SIZE, 4096, body);
+	}
+	return SystemPosix::getMonotonicNanoseconds() - start;
+}
+
+/*
+ * Snapshot - A snapshot the size of a typical published frame state.
+ */
+struct Snapshot {
+	Uint64 frame;
+	double values[15];
+};
+
+struct SeqLockTraffic {
+	SeqLock<Snapshot>* lock;
+	Uint64 reads;
+	volatile Int32 reading;
+};
+
+void seqLockBody(int thread, void* context) {
+	SeqLockTraffic& shared = *static_cast<SeqLockTraffic*> (context);
+	Snapshot state = Snapshot();
+	if (thread == 0) {
+		while (Atomic::load(&shared.reading) > 0) {
+			++state.frame;
+			shared.lock->publish(state);
+		}
+	} else {
+		for (Uint64 r = 0; r < shared.reads; ++r) {
+			shared.lock->read(state);
+		}
+		doNotOptimize(state);
+		Atomic::fetchSub(&shared.reading, Int32(1));
+	}
+}
+
+/*
+ * seqLockReadLoop - \p numReaders threads reading a SeqLock while one
+ * thread publishes as fast as it can (or, for 0, one thread reading with
+ * no writer); one iteration is one read.
+ */
+Uint64 seqLockReadLoop(Uint64 iterations, Uint64 numReaders) {
+	SeqLock<Snapshot> lock;
+	Snapshot state = Snapshot();
+	lock.publish(state);
+
+	if (numReaders == 0) {
+		const Uint64 start = SystemPosix::getMonotonicNanoseconds();
+		for (Uint64 r = 0; r < iterations; ++r) {
+			lock.read(state);
+			doNotOptimize(state);
+		}
+		return SystemPosix::getMonotonicNanoseconds() - start;
+	}
+
+	SeqLockTraffic shared;
+	shared.lock = &lock;
+	shared.reads = iterations / numReaders + 1;
+	shared.reading = Int32(numReaders);
+	return runThreads(int(numReaders) + 1, &seqLockBody, &shared);
+}
+
+}
+
+BENCHMARK("sync/Barrier/round/2", barrierLoop, 2);
+BENCHMARK("sync/Barrier/round/4", barrierLoop, 4);
+BENCHMARK("sync/Barrier/round/8", barrierLoop, 8);
+BENCHMARK("sync/pthread_barrier/round/2", pthreadBarrierLoop, 2);
+BENCHMARK("sync/pthread_barrier/round/4", pthreadBarrierLoop, 4);
+BENCHMARK("sync/pthread_barrier/round/8", pthreadBarrierLoop, 8);
+BENCHMARK("sync/Event/ping_pong", eventPingPongLoop, 0);
+BENCHMARK("sync/pthread_cond/ping_pong", conditionPingPongLoop, 0);
+
+BENCHMARK("sync/BlockingQueue/pairs/1", blockingQueueLoop, 1);
+BENCHMARK("sync/BlockingQueue/pairs/2", blockingQueueLoop, 2);
+BENCHMARK("sync/BlockingQueue/pairs/4", blockingQueueLoop, 4);
+BENCHMARK("sync/CommandQueue/push_drain/64", commandQueueLoop, 64);
+BENCHMARK("sync/CommandQueue/push_drain/1024", commandQueueLoop, 1024);
+BENCHMARK("sync/CommandQueue/producers/1", commandQueueContendedLoop, 1);
+BENCHMARK("sync/CommandQueue/producers/4", commandQueueContendedLoop, 4);
+BENCHMARK("sync/CommandQueue/toggle_stress/3", toggleStressLoop, 3);
+BENCHMARK("sync/CommandQueue/toggle_stress/8", toggleStressLoop, 8);
+
+BENCHMARK("sync/ThreadPool/sum/sequential", parallelForLoop, 0);
+BENCHMARK("sync/ThreadPool/sum/grain/1024", parallelForLoop, 1024);
+BENCHMARK("sync/ThreadPool/sum/grain/65536", parallelForLoop, 65536);
+BENCHMARK("sync/ThreadPool/scaling/1", scalingLoop, 1);
+BENCHMARK("sync/ThreadPool/scaling/2", scalingLoop, 2);
+BENCHMARK("sync/ThreadPool/scaling/4", scalingLoop, 4);
+BENCHMARK("sync/ThreadPool/scaling/8", scalingLoop, 8);
+BENCHMARK("sync/ThreadPool/scaling/16", scalingLoop, 16);
+BENCHMARK("sync/ThreadPool/scaling/N", scalingLoop, 0);
+
+BENCHMARK("sync/SeqLock/read/uncontended", seqLockReadLoop, 0);
+BENCHMARK("sync/SeqLock/read/publishing/1", seqLockReadLoop, 1);
+BENCHMARK("sync/SeqLock/read/publishing/4", seqLockReadLoop, 4);
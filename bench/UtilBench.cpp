@@ -0,0 +1,739 @@
+/*
+ * UtilBench.cpp - Cost of the utilities on the frame path: exceptions, byte
+ * swapping, hashing, the containers and allocators, logging, metrics and
+ * pacing.
+ */
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <boost/preprocessor/stringize.hpp>
+#include <boost/unordered_map.hpp>
+
+#include <SYNC/Atomic.h>
+#include <SYNC/Guard.h>
+#include <SYNC/MutexPosix.h>
+#include <UTIL/ByteOrder.h>
+#include <UTIL/Exception.h>
+#include <UTIL/FlatHashMap.h>
+#include <UTIL/FrameArena.h>
+#include <UTIL/Logger.h>
+#include <UTIL/Metrics.h>
+#include <UTIL/ObjectPool.h>
+#include <UTIL/System.h>
+#include <UTIL/Timer.h>
+
+#include "Benchmark.h"
+
+#ifdef __GLIBC__
+extern "C" {
+void* __libc_malloc(size_t size);
+void __libc_free(void* pointer);
+}
+#endif
+
+namespace {
+
+/*
+ * exceptionConstructLoop - Constructs and destroys an Exception, which
+ * includes capturing the stack trace.
+ */
+Uint64 exceptionConstructLoop(Uint64 iterations, Uint64) {
+	const Uint64 start = SystemPosix::getMonotonicNanoseconds();
+	for (Uint64 i = 0; i < iterations; ++i) {
+		Exception exception("Benchmark exception", LOCATION);
+		doNotOptimize(exception);
+	}
+	return SystemPosix::getMonotonicNanoseconds() - start;
+}
+
+void throwException(void) {
+	throw Exception("Benchmark exception", LOCATION);
+}
+
+/*
+ * exceptionThrowLoop - Throws an Exception through one call and catches it.
+ */
+Uint64 exceptionThrowLoop(Uint64 iterations, Uint64) {
+	Uint64 caught = 0;
+	const Uint64 start = SystemPosix::getMonotonicNanoseconds();
+	for (Uint64 i = 0; i < iterations; ++i) {
+		try {
+			throwException();
+		} catch (const Exception&) {
+			++caught;
+		}
+	}
+	const Uint64 elapsed = SystemPosix::getMonotonicNanoseconds() - start;
+	doNotOptimize(caught);
+	return elapsed;
+}
+
+/* The location as the throw sites built it before SourceLocation: */
+#define LEGACY_LOCATION std::string(__FILE__) + std::string(":") + \
+	std::string(BOOST_PP_STRINGIZE(__LINE__))
+
+/*
+ * LegacyException - Exception as it was before the call stack was captured
+ * lazily: the location arrives as a string, and the stack text is built in
+ * the constructor.  That text used to be a placeholder; with \p symbolize,
+ * it is the real stack, as an eager capture would have to build it.
+ */
+class LegacyException: public std::runtime_error {
+public:
+	LegacyException(const std::string& _description,
+			const std::string& _location, bool symbolize) throw () :
+		std::runtime_error(_description), description(_description),
+				location(_location), stackTrace(symbolize
+						? SystemBase::getCallStack() : std::string(
+								"Stack trace:\n   <Call stack printing not "
+									"supported>\n")) {
+	}
+
+	~LegacyException(void) throw () {
+	}
+
+private:
+	std::string description;
+	std::string location;
+	std::string stackTrace;
+};
+
+void throwLegacyException(bool symbolize) {
+	throw LegacyException("Benchmark exception", LEGACY_LOCATION, symbolize);
+}
+
+/*
+ * legacyThrowLoop - exceptionThrowLoop() with a LegacyException, which
+ * builds a real stack text if \p symbolize is set.
+ */
+Uint64 legacyThrowLoop(Uint64 iterations, Uint64 symbolize) {
+	Uint64 caught = 0;
+	const Uint64 start = SystemPosix::getMonotonicNanoseconds();
+	for (Uint64 i = 0; i < iterations; ++i) {
+		try {
+			throwLegacyException(symbolize != 0);
+		} catch (const LegacyException&) {
+			++caught;
+		}
+	}
+	const Uint64 elapsed = SystemPosix::getMonotonicNanoseconds() - start;
+	doNotOptimize(caught);
+	return elapsed;
+}
+
+/*
+ * legacyIsLittleEndian - The run-time test SystemBase::isLittleEndian()
+ * made before ByteOrder.
+ */
+bool legacyIsLittleEndian(void) {
+	union {
+		char c[sizeof(short)];
+		short value;
+	} endian;
+	endian.value = 256;
+	return endian.c[0] == 0;
+}
+
+/*
+ * legacyNtoh - The per-element conversions SystemPosix offered before
+ * ByteOrder.  Ntohs() and Ntohl() were inline ntohs() and ntohl() calls;
+ * Ntohll() was out of line, tested the byte order and swapped the two
+ * halves with Ntohl().
+ */
+inline Uint16 legacyNtoh(Uint16 conversion) {
+	return ntohs(conversion);
+}
+
+inline Uint32 legacyNtoh(Uint32 conversion) {
+	return ntohl(conversion);
+}
+
+__attribute__ ((noinline)) Uint64 legacyNtoh(Uint64 conversion) {
+	Uint32 halves[2];
+	std::memcpy(halves, &conversion, sizeof(halves));
+	Uint32 result[2];
+	if (legacyIsLittleEndian()) {
+		result[1] = ntohl(halves[0]);
+		result[0] = ntohl(halves[1]);
+	} else {
+		result[0] = ntohl(halves[0]);
+		result[1] = ntohl(halves[1]);
+	}
+	Uint64 value;
+	std::memcpy(&value, result, sizeof(value));
+	return value;
+}
+
+/*
+ * byteOrderPerElementLoop - Converts \p count big-endian values into
+ * another array one value at a time, the way it was done before
+ * ByteOrder; one iteration is one pass.
+ */
+template<class T>
+Uint64 byteOrderPerElementLoop(Uint64 iterations, Uint64 count) {
+	const std::vector<T> source(count, T(0x0102030405060708UL));
+	std::vector<T> destination(count);
+	const Uint64 start = SystemPosix::getMonotonicNanoseconds();
+	for (Uint64 i = 0; i < iterations; ++i) {
+		for (size_t v = 0; v < count; ++v) {
+			destination[v] = legacyNtoh(source[v]);
+		}
+		doNotOptimize(destination[0]);
+	}
+	return SystemPosix::getMonotonicNanoseconds() - start;
+}
+
+/*
+ * byteOrderBulkLoop - Converts the same arrays with one ByteOrder call.
+ */
+template<class T>
+Uint64 byteOrderBulkLoop(Uint64 iterations, Uint64 count) {
+	const std::vector<T> source(count, T(0x0102030405060708UL));
+	std::vector<T> destination(count);
+	const Uint64 start = SystemPosix::getMonotonicNanoseconds();
+	for (Uint64 i = 0; i < iterations; ++i) {
+		ByteOrder::networkToHost(&source[0], &destination[0], count);
+		doNotOptimize(destination[0]);
+	}
+	return SystemPosix::getMonotonicNanoseconds() - start;
+}
+
+Uint64 hashLoop(Uint64 iterations, Uint64) {
+	Uint64Hash hash;
+	Uint64 sum = 0;
+	const Uint64 start = SystemPosix::getMonotonicNanoseconds();
+	for (Uint64 i = 0; i < iterations; ++i) {
+		sum += hash(i);
+	}
+	const Uint64 elapsed = SystemPosix::getMonotonicNanoseconds() - start;
+	doNotOptimize(sum);
+	return elapsed;
+}
+
+/*
+ * getKeys - Returns \p count distinct keys in a random order, the same on
+ * every call.  Built once per count, so the calibration runs do not pay
+ * for it.
+ */
+const std::vector<Uint64>& getKeys(Uint64 count) {
+	static std::map<Uint64, std::vector<Uint64> > cache;
+	std::vector<Uint64>& keys = cache[count];
+	if (keys.empty()) {
+		keys.resize(count);
+		Uint64 state = 0x9e3779b97f4a7c15UL;
+		for (Uint64 k = 0; k < count; ++k) {
+			// Sparse ids, like the node and model ids the maps are keyed by.
+			keys[k] = k * 64 + 17;
+		}
+		for (Uint64 k = count - 1; k > 0; --k) {
+			state = state * 6364136223846793005UL + 1442695040888963407UL;
+			std::swap(keys[k], keys[(state >> 33) % (k + 1)]);
+		}
+	}
+	return keys;
+}
+
+/*
+ * getMap - Returns a map of type MAP holding the keys of getKeys(count),
+ * built once per type and count.
+ */
+template<class MAP>
+const MAP& getMap(Uint64 count) {
+	static std::map<Uint64, MAP> cache;
+	MAP& map = cache[count];
+	if (map.empty()) {
+		const std::vector<Uint64>& keys = getKeys(count);
+		for (size_t k = 0; k < keys.size(); ++k) {
+			map[keys[k]] = keys[k];
+		}
+	}
+	return map;
+}
+
+/*
+ * mapFindLoop - Looks up keys of a map of \p count entries in random
+ * order, alternating hits and misses.
+ */
+template<class MAP>
+Uint64 mapFindLoop(Uint64 iterations, Uint64 count) {
+	const std::vector<Uint64>& keys = getKeys(count);
+	const MAP& map = getMap<MAP> (count);
+	Uint64 found = 0;
+	size_t k = 0;
+	const Uint64 start = SystemPosix::getMonotonicNanoseconds();
+	for (Uint64 i = 0; i < iterations; ++i) {
+		found += map.find(keys[k] + (i & 1)) != map.end();
+		if (++k == keys.size()) {
+			k = 0;
+		}
+	}
+	const Uint64 elapsed = SystemPosix::getMonotonicNanoseconds() - start;
+	doNotOptimize(found);
+	return elapsed;
+}
+
+/*
+ * mapInsertLoop - Fills an empty map with \p count keys; one iteration is
+ * one insertion, including the growth of the map.
+ */
+template<class MAP>
+Uint64 mapInsertLoop(Uint64 iterations, Uint64 count) {
+	const std::vector<Uint64>& keys = getKeys(count);
+	Uint64 elapsed = 0;
+	Uint64 performed = 0;
+	for (; performed < iterations; performed += count) {
+		MAP map;
+		const Uint64 start = SystemPosix::getMonotonicNanoseconds();
+		for (size_t k = 0; k < keys.size(); ++k) {
+			map[keys[k]] = k;
+		}
+		elapsed += SystemPosix::getMonotonicNanoseconds() - start;
+	}
+	return scaleElapsed(elapsed, performed, iterations);
+}
+
+/*
+ * mapEraseLoop - Empties a copy of a map of \p count entries in random
+ * order; one iteration is one erasure.
+ */
+template<class MAP>
+Uint64 mapEraseLoop(Uint64 iterations, Uint64 count) {
+	const std::vector<Uint64>& keys = getKeys(count);
+	Uint64 elapsed = 0;
+	Uint64 performed = 0;
+	for (; performed < iterations; performed += count) {
+		MAP map(getMap<MAP> (count));
+		const Uint64 start = SystemPosix::getMonotonicNanoseconds();
+		for (size_t k = keys.size(); k > 0; --k) {
+			map.erase(keys[k - 1]);
+		}
+		elapsed += SystemPosix::getMonotonicNanoseconds() - start;
+		doNotOptimize(map);
+	}
+	return scaleElapsed(elapsed, performed, iterations);
+}
+
+typedef FlatHashMap<Uint64, Uint64> FlatMap;
+typedef boost::unordered_map<Uint64, Uint64, Uint64Hash> UnorderedMap;
+typedef std::map<Uint64, Uint64> TreeMap;
+
+/*
+ * Particle - An object the size of a small per-frame record.
+ */
+struct Particle {
+	double position[3];
+	double velocity[3];
+	Uint64 id;
+};
+
+/*
+ * newDeleteLoop - Allocates 64 objects with new and frees them; with
+ * ROCKET_ALLOC_TRACKING this includes the cost of counting them.
+ */
+Uint64 newDeleteLoop(Uint64 iterations, Uint64) {
+	Particle* particles[64];
+	Uint64 performed = 0;
+	const Uint64 start = SystemPosix::getMonotonicNanoseconds();
+	for (; performed < iterations; performed += 64) {
+		for (int p = 0; p < 64; ++p) {
+			particles[p] = new Particle();
+		}
+		doNotOptimize(particles);
+		for (int p = 0; p < 64; ++p) {
+			delete particles[p];
+		}
+	}
+	return scaleElapsed(SystemPosix::getMonotonicNanoseconds() - start,
+			performed, iterations);
+}
+
+/*
+ * mallocFreeLoop - Allocates 64 blocks of a Particle's size with malloc()
+ * and frees them.  With \p untracked, it calls glibc's own entry points,
+ * which ROCKET_ALLOC_TRACKING does not replace, so comparing the two in a
+ * tracking build gives the cost of the counting.
+ */
+Uint64 mallocFreeLoop(Uint64 iterations, Uint64 untracked) {
+	void* blocks[64];
+	Uint64 performed = 0;
+	const Uint64 start = SystemPosix::getMonotonicNanoseconds();
+	for (; performed < iterations; performed += 64) {
+		for (int b = 0; b < 64; ++b) {
+#ifdef __GLIBC__
+			blocks[b] = untracked ? __libc_malloc(sizeof(Particle))
+					: std::malloc(sizeof(Particle));
+#else
+			blocks[b] = std::malloc(sizeof(Particle));
+#endif
+		}
+		doNotOptimize(blocks);
+		for (int b = 0; b < 64; ++b) {
+#ifdef __GLIBC__
+			if (untracked) {
+				__libc_free(blocks[b]);
+				continue;
+			}
+#endif
+			std::free(blocks[b]);
+		}
+	}
+	return scaleElapsed(SystemPosix::getMonotonicNanoseconds() - start,
+			performed, iterations);
+}
+
+Uint64 objectPoolLoop(Uint64 iterations, Uint64) {
+	ObjectPool<Particle> pool;
+	Particle* particles[64];
+	Uint64 performed = 0;
+	const Uint64 start = SystemPosix::getMonotonicNanoseconds();
+	for (; performed < iterations; performed += 64) {
+		for (int p = 0; p < 64; ++p) {
+			particles[p] = pool.create();
+		}
+		doNotOptimize(particles);
+		for (int p = 0; p < 64; ++p) {
+			pool.destroy(particles[p]);
+		}
+	}
+	return scaleElapsed(SystemPosix::getMonotonicNanoseconds() - start,
+			performed, iterations);
+}
+
+/*
+ * frameArenaLoop - Allocates 64 objects from a FrameArena and resets it,
+ * as a frame does.
+ */
+Uint64 frameArenaLoop(Uint64 iterations, Uint64) {
+	FrameArena arena;
+	Particle* particles[64];
+	Uint64 performed = 0;
+	const Uint64 start = SystemPosix::getMonotonicNanoseconds();
+	for (; performed < iterations; performed += 64) {
+		for (int p = 0; p < 64; ++p) {
+			particles[p] = new (arena.allocateArray<Particle> (1)) Particle();
+		}
+		doNotOptimize(particles);
+		arena.reset();
+	}
+	return scaleElapsed(SystemPosix::getMonotonicNanoseconds() - start,
+			performed, iterations);
+}
+
+/*
+ * fillFrame - The transient containers of a frame: a list of 256 objects
+ * grown one at a time, and an index of 64 of them.
+ */
+template<class VECTOR, class MAP>
+Uint64 fillFrame(VECTOR& particles, MAP& index) {
+	for (Uint64 p = 0; p < 256; ++p) {
+		Particle particle = { { 0.0, 0.0, 0.0 }, { 0.0, 0.0, 0.0 }, p };
+		particles.push_back(particle);
+	}
+	for (Uint64 p = 0; p < 256; p += 4) {
+		index[particles[p].id] = p;
+	}
+	return index.size() + particles.size();
+}
+
+/*
+ * heapFrameLoop - One iteration is one frame of fillFrame() in standard
+ * containers on the heap.
+ */
+Uint64 heapFrameLoop(Uint64 iterations, Uint64) {
+	Uint64 sum = 0;
+	const Uint64 start = SystemPosix::getMonotonicNanoseconds();
+	for (Uint64 i = 0; i < iterations; ++i) {
+		std::vector<Particle> particles;
+		std::map<Uint64, Uint64> index;
+		sum += fillFrame(particles, index);
+	}
+	const Uint64 elapsed = SystemPosix::getMonotonicNanoseconds() - start;
+	doNotOptimize(sum);
+	return elapsed;
+}
+
+/*
+ * arenaFrameLoop - heapFrameLoop() with the containers in a FrameArena that
+ * is reset after each frame.
+ */
+Uint64 arenaFrameLoop(Uint64 iterations, Uint64) {
+	typedef ArenaAllocator<Particle> ParticleAllocator;
+	typedef ArenaAllocator<std::pair<const Uint64, Uint64> > IndexAllocator;
+	FrameArena arena;
+	Uint64 sum = 0;
+	const Uint64 start = SystemPosix::getMonotonicNanoseconds();
+	for (Uint64 i = 0; i < iterations; ++i) {
+		{
+			std::vector<Particle, ParticleAllocator> particles(
+					(ParticleAllocator(arena)));
+			std::map<Uint64, Uint64, std::less<Uint64>, IndexAllocator> index(
+					std::less<Uint64>(), (IndexAllocator(arena)));
+			sum += fillFrame(particles, index);
+		}
+		arena.reset();
+	}
+	const Uint64 elapsed = SystemPosix::getMonotonicNanoseconds() - start;
+	doNotOptimize(sum);
+	return elapsed;
+}
+
+/*
+ * logLoop - Logs one formatted message.  Only the caller's cost is timed;
+ * the logger thread writes to /dev/null behind it.
+ */
+Uint64 logLoop(Uint64 iterations, Uint64) {
+	static bool redirected = Logger::setOutput("/dev/null");
+	doNotOptimize(redirected);
+	const Uint64 start = SystemPosix::getMonotonicNanoseconds();
+	for (Uint64 i = 0; i < iterations; ++i) {
+		LOG_INFO("Benchmark message %lu of %lu", i, iterations);
+	}
+	const Uint64 elapsed = SystemPosix::getMonotonicNanoseconds() - start;
+	Logger::flush();
+	return elapsed;
+}
+
+/*
+ * streamLogLoop - logLoop() the way messages went to std::cerr before the
+ * logger: formatted on the calling thread and written at once, since cerr
+ * is unit-buffered.  The stream goes to /dev/null, so a terminal would
+ * only add to the cost.
+ */
+Uint64 streamLogLoop(Uint64 iterations, Uint64) {
+	std::ofstream stream("/dev/null");
+	stream << std::unitbuf;
+	const Uint64 start = SystemPosix::getMonotonicNanoseconds();
+	for (Uint64 i = 0; i < iterations; ++i) {
+		stream << "Benchmark message " << i << " of " << iterations
+				<< std::endl;
+	}
+	return SystemPosix::getMonotonicNanoseconds() - start;
+}
+
+Uint64 counterLoop(Uint64 iterations, Uint64) {
+	static const Counter counter = Metrics::counter(
+			"rocket_bench_operations_total", "Benchmark operations.");
+	const Uint64 start = SystemPosix::getMonotonicNanoseconds();
+	for (Uint64 i = 0; i < iterations; ++i) {
+		counter.add();
+	}
+	return SystemPosix::getMonotonicNanoseconds() - start;
+}
+
+struct CounterTraffic {
+	Uint64 increments; /**< Per thread */
+	const Counter* counter;
+	volatile Uint64 shared;
+	MutexPosix lock;
+	Uint64 locked;
+};
+
+void shardedCounterBody(int, void* context) {
+	CounterTraffic& traffic = *static_cast<CounterTraffic*> (context);
+	for (Uint64 i = 0; i < traffic.increments; ++i) {
+		traffic.counter->add();
+	}
+}
+
+void atomicCounterBody(int, void* context) {
+	CounterTraffic& traffic = *static_cast<CounterTraffic*> (context);
+	for (Uint64 i = 0; i < traffic.increments; ++i) {
+		Atomic::fetchAdd(&traffic.shared, Uint64(1));
+	}
+}
+
+void lockedCounterBody(int, void* context) {
+	CounterTraffic& traffic = *static_cast<CounterTraffic*> (context);
+	for (Uint64 i = 0; i < traffic.increments; ++i) {
+		Guard<MutexPosix> guard(traffic.lock);
+		++traffic.locked;
+	}
+}
+
+/*
+ * counterThreadsLoop - \p numThreads threads incrementing one count; one
+ * iteration is one increment.  The count is a Counter, a shared atomic
+ * or a mutex-guarded variable, depending on \p body.
+ */
+Uint64 counterThreadsLoop(Uint64 iterations, Uint64 numThreads,
+		ThreadBody body) {
+	static const Counter counter = Metrics::counter(
+			"rocket_bench_threaded_operations_total",
+			"Benchmark operations of several threads.");
+	CounterTraffic traffic;
+	traffic.increments = iterations / numThreads + 1;
+	traffic.counter = &counter;
+	traffic.shared = 0;
+	traffic.locked = 0;
+	return runThreads(int(numThreads), body, &traffic);
+}
+
+Uint64 shardedCounterLoop(Uint64 iterations, Uint64 numThreads) {
+	return counterThreadsLoop(iterations, numThreads, &shardedCounterBody);
+}
+
+Uint64 atomicCounterLoop(Uint64 iterations, Uint64 numThreads) {
+	return counterThreadsLoop(iterations, numThreads, &atomicCounterBody);
+}
+
+Uint64 lockedCounterLoop(Uint64 iterations, Uint64 numThreads) {
+	return counterThreadsLoop(iterations, numThreads, &lockedCounterBody);
+}
+
+Uint64 histogramLoop(Uint64 iterations, Uint64) {
+	static const Histogram histogram = Metrics::histogram(
+			"rocket_bench_duration_seconds", "Benchmark durations.",
+			Metrics::exponentialBounds(1e-6, 2.0, 20));
+	const Uint64 start = SystemPosix::getMonotonicNanoseconds();
+	for (Uint64 i = 0; i < iterations; ++i) {
+		histogram.observe(double(i & 0xfffff) * 1e-9);
+	}
+	return SystemPosix::getMonotonicNanoseconds() - start;
+}
+
+/*
+ * pacerLatenessLoop - Paces \p iterations wake-ups at the period given and
+ * returns their total lateness, so the result is nanoseconds late per
+ * wake-up rather than time per iteration.
+ */
+Uint64 pacerLatenessLoop(Uint64 iterations, Uint64 period) {
+	Pacer pacer("bench", period);
+	Uint64 lateness = 0;
+	pacer.wait();
+	for (Uint64 i = 0; i < iterations; ++i) {
+		const Uint64 deadline = pacer.getNextDeadline();
+		pacer.wait();
+		lateness += SystemPosix::getMonotonicNanoseconds() - deadline;
+	}
+	return lateness;
+}
+
+/*
+ * sleepingPacerLatenessLoop - pacerLatenessLoop() without the spin at the
+ * end of each wait, so every wake-up is up to the scheduler.
+ */
+Uint64 sleepingPacerLatenessLoop(Uint64 iterations, Uint64 period) {
+	Pacer pacer("bench_sleeping", period, 0);
+	Uint64 lateness = 0;
+	pacer.wait();
+	for (Uint64 i = 0; i < iterations; ++i) {
+		const Uint64 deadline = pacer.getNextDeadline();
+		pacer.wait();
+		lateness += SystemPosix::getMonotonicNanoseconds() - deadline;
+	}
+	return lateness;
+}
+
+/*
+ * usleepLatenessLoop - Paces the loop the way msleep() allowed before
+ * Pacer: by sleeping one period after each wake-up.  Lateness is measured
+ * against the deadlines a fixed period apart, so the drift of the relative
+ * sleeps adds up.
+ */
+Uint64 usleepLatenessLoop(Uint64 iterations, Uint64 period) {
+	Uint64 lateness = 0;
+	const Uint64 start = SystemPosix::getMonotonicNanoseconds();
+	for (Uint64 i = 0; i < iterations; ++i) {
+		::usleep(useconds_t(period / 1000));
+		const Uint64 now = SystemPosix::getMonotonicNanoseconds();
+		const Uint64 deadline = start + (i + 1) * period;
+		lateness += now > deadline ? now - deadline : 0;
+	}
+	return lateness;
+}
+
+}
+
+BENCHMARK("util/Exception/construct", exceptionConstructLoop, 0);
+BENCHMARK("util/Exception/throw_catch", exceptionThrowLoop, 0);
+BENCHMARK("util/Exception/throw_catch/legacy", legacyThrowLoop, 0);
+BENCHMARK("util/Exception/throw_catch/eager_stack", legacyThrowLoop, 1);
+
+/* 32 KB stay in the cache; 32 MB are bound by memory: */
+BENCHMARK_THROUGHPUT("util/ByteOrder/Uint16/per_element/32KB",
+		byteOrderPerElementLoop<Uint16>, 16384, 32768);
+BENCHMARK_THROUGHPUT("util/ByteOrder/Uint16/per_element/32MB",
+		byteOrderPerElementLoop<Uint16>, 16777216, 33554432);
+BENCHMARK_THROUGHPUT("util/ByteOrder/Uint16/bulk/32KB",
+		byteOrderBulkLoop<Uint16>, 16384, 32768);
+BENCHMARK_THROUGHPUT("util/ByteOrder/Uint16/bulk/32MB",
+		byteOrderBulkLoop<Uint16>, 16777216, 33554432);
+BENCHMARK_THROUGHPUT("util/ByteOrder/Uint32/per_element/32KB",
+		byteOrderPerElementLoop<Uint32>, 8192, 32768);
+BENCHMARK_THROUGHPUT("util/ByteOrder/Uint32/per_element/32MB",
+		byteOrderPerElementLoop<Uint32>, 8388608, 33554432);
+BENCHMARK_THROUGHPUT("util/ByteOrder/Uint32/bulk/32KB",
+		byteOrderBulkLoop<Uint32>, 8192, 32768);
+BENCHMARK_THROUGHPUT("util/ByteOrder/Uint32/bulk/32MB",
+		byteOrderBulkLoop<Uint32>, 8388608, 33554432);
+BENCHMARK_THROUGHPUT("util/ByteOrder/Uint64/per_element/32KB",
+		byteOrderPerElementLoop<Uint64>, 4096, 32768);
+BENCHMARK_THROUGHPUT("util/ByteOrder/Uint64/per_element/32MB",
+		byteOrderPerElementLoop<Uint64>, 4194304, 33554432);
+BENCHMARK_THROUGHPUT("util/ByteOrder/Uint64/bulk/32KB",
+		byteOrderBulkLoop<Uint64>, 4096, 32768);
+BENCHMARK_THROUGHPUT("util/ByteOrder/Uint64/bulk/32MB",
+		byteOrderBulkLoop<Uint64>, 4194304, 33554432);
+
+BENCHMARK("util/Uint64Hash", hashLoop, 0);
+
+BENCHMARK("util/FlatHashMap/find/1K", mapFindLoop<FlatMap>, 1000);
+BENCHMARK("util/FlatHashMap/find/100K", mapFindLoop<FlatMap>, 100000);
+BENCHMARK("util/FlatHashMap/find/10M", mapFindLoop<FlatMap>, 10000000);
+BENCHMARK("util/unordered_map/find/1K", mapFindLoop<UnorderedMap>, 1000);
+BENCHMARK("util/unordered_map/find/100K", mapFindLoop<UnorderedMap>, 100000);
+BENCHMARK("util/unordered_map/find/10M", mapFindLoop<UnorderedMap>, 10000000);
+BENCHMARK("util/map/find/1K", mapFindLoop<TreeMap>, 1000);
+BENCHMARK("util/map/find/100K", mapFindLoop<TreeMap>, 100000);
+BENCHMARK("util/map/find/10M", mapFindLoop<TreeMap>, 10000000);
+
+BENCHMARK("util/FlatHashMap/insert/1K", mapInsertLoop<FlatMap>, 1000);
+BENCHMARK("util/FlatHashMap/insert/100K", mapInsertLoop<FlatMap>, 100000);
+BENCHMARK("util/FlatHashMap/insert/10M", mapInsertLoop<FlatMap>, 10000000);
+BENCHMARK("util/unordered_map/insert/1K", mapInsertLoop<UnorderedMap>, 1000);
+BENCHMARK("util/unordered_map/insert/100K", mapInsertLoop<UnorderedMap>,
+		100000);
+BENCHMARK("util/unordered_map/insert/10M", mapInsertLoop<UnorderedMap>,
+		10000000);
+BENCHMARK("util/map/insert/1K", mapInsertLoop<TreeMap>, 1000);
+BENCHMARK("util/map/insert/100K", mapInsertLoop<TreeMap>, 100000);
+BENCHMARK("util/map/insert/10M", mapInsertLoop<TreeMap>, 10000000);
+
+BENCHMARK("util/FlatHashMap/erase/1K", mapEraseLoop<FlatMap>, 1000);
+BENCHMARK("util/FlatHashMap/erase/100K", mapEraseLoop<FlatMap>, 100000);
+BENCHMARK("util/FlatHashMap/erase/10M", mapEraseLoop<FlatMap>, 10000000);
+BENCHMARK("util/unordered_map/erase/1K", mapEraseLoop<UnorderedMap>, 1000);
+BENCHMARK("util/unordered_map/erase/100K", mapEraseLoop<UnorderedMap>, 100000);
+BENCHMARK("util/unordered_map/erase/10M", mapEraseLoop<UnorderedMap>, 10000000);
+BENCHMARK("util/map/erase/1K", mapEraseLoop<TreeMap>, 1000);
+BENCHMARK("util/map/erase/100K", mapEraseLoop<TreeMap>, 100000);
+BENCHMARK("util/map/erase/10M", mapEraseLoop<TreeMap>, 10000000);
+
+BENCHMARK("util/new_delete", newDeleteLoop, 0);
+BENCHMARK("util/malloc_free", mallocFreeLoop, 0);
+BENCHMARK("util/malloc_free/untracked", mallocFreeLoop, 1);
+BENCHMARK("util/ObjectPool/create_destroy", objectPoolLoop, 0);
+BENCHMARK("util/FrameArena/allocate", frameArenaLoop, 0);
+BENCHMARK("util/frame_containers/heap", heapFrameLoop, 0);
+BENCHMARK("util/frame_containers/arena", arenaFrameLoop, 0);
+
+BENCHMARK("util/Logger/info", logLoop, 0);
+BENCHMARK("util/ostream/info", streamLogLoop, 0);
+BENCHMARK("util/Metrics/Counter/add", counterLoop, 0);
+BENCHMARK("util/Metrics/Counter/add/threads/4", shardedCounterLoop, 4);
+BENCHMARK("util/atomic_counter/add/threads/4", atomicCounterLoop, 4);
+BENCHMARK("util/locked_counter/add/threads/4", lockedCounterLoop, 4);
+BENCHMARK("util/Metrics/Histogram/observe", histogramLoop, 0);
+
+BENCHMARK_FIXED("util/Pacer/lateness/1kHz", pacerLatenessLoop, 1000000, 500,
+		"ns late");
+BENCHMARK_FIXED("util/Pacer/lateness/1kHz/no_spin", sleepingPacerLatenessLoop,
+		1000000, 500, "ns late");
+BENCHMARK_FIXED("util/usleep/lateness/1kHz", usleepLatenessLoop, 1000000, 500,
+		"ns late");
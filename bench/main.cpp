@@ -0,0 +1,157 @@
+/*
+ * main.cpp - Runs the benchmarks and writes their results as JSON.
+ *
+ * Usage: RocketBench [--filter TEXT] [--repetitions N] [--min-time MS]
+ *                    [--output FILE] [--list]
+ */
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <unistd.h>
+
+#include <UTIL/ByteOrder.h>
+#include <UTIL/System.h>
+
+#include "Benchmark.h"
+
+namespace {
+
+void writeString(FILE* output, const std::string& text) {
+	fputc('"', output);
+	for (size_t c = 0; c < text.size(); ++c) {
+		if (text[c] == '"' || text[c] == '\\') {
+			fputc('\\', output);
+		}
+		fputc(text[c], output);
+	}
+	fputc('"', output);
+}
+
+/*
+ * getMacros - Returns the build macros that change what is measured.
+ */
+std::string getMacros(void) {
+	std::string macros;
+#ifdef DEBUG
+	macros += " DEBUG";
+#endif
+#ifdef ROCKET_LOCK_PROFILING
+	macros += " ROCKET_LOCK_PROFILING";
+#endif
+#ifdef ROCKET_PROFILING
+	macros += " ROCKET_PROFILING";
+#endif
+#ifdef ROCKET_ALLOC_TRACKING
+	macros += " ROCKET_ALLOC_TRACKING";
+#endif
+	return macros.empty() ? macros : macros.substr(1);
+}
+
+void writeResult(FILE* output, const Benchmark& benchmark) {
+	fprintf(output, "    { \"name\": ");
+	writeString(output, benchmark.name);
+	fprintf(output, ", \"unit\": ");
+	writeString(output, benchmark.unit);
+	fprintf(output, ", \"iterations\": %lu, \"repetitions\": %lu,\n",
+			benchmark.iterations, Uint64(benchmark.samples.size()));
+	fprintf(output, "      \"mean\": %.4g, \"median\": %.4g, \"stddev\": %.4g, "
+		"\"min\": %.4g, \"max\": %.4g, \"ci95\": [%.4g, %.4g],\n",
+			benchmark.mean, benchmark.median, benchmark.standardDeviation,
+			benchmark.minimum, benchmark.maximum, benchmark.confidenceLow,
+			benchmark.confidenceHigh);
+	fprintf(output, "      \"samples\": [");
+	for (size_t s = 0; s < benchmark.samples.size(); ++s) {
+		fprintf(output, "%s%.4g", s == 0 ? "" : ", ", benchmark.samples[s]);
+	}
+	fprintf(output, "] }");
+}
+
+void usage(const char* program) {
+	fprintf(stderr, "Usage: %s [--filter TEXT] [--repetitions N] "
+		"[--min-time MS] [--output FILE] [--list]\n", program);
+}
+
+}
+
+int main(int argc, char** argv) {
+	std::string filter;
+	int repetitions = 10;
+	Uint64 minimumTime = 50000000;
+	const char* outputName = NULL;
+	bool list = false;
+
+	for (int a = 1; a < argc; ++a) {
+		const bool hasValue = a + 1 < argc;
+		if (std::strcmp(argv[a], "--filter") == 0 && hasValue) {
+			filter = argv[++a];
+		} else if (std::strcmp(argv[a], "--repetitions") == 0 && hasValue) {
+			repetitions = std::max(std::atoi(argv[++a]), 1);
+		} else if (std::strcmp(argv[a], "--min-time") == 0 && hasValue) {
+			minimumTime = Uint64(std::max(std::atoi(argv[++a]), 1)) * 1000000;
+		} else if (std::strcmp(argv[a], "--output") == 0 && hasValue) {
+			outputName = argv[++a];
+		} else if (std::strcmp(argv[a], "--list") == 0) {
+			list = true;
+		} else {
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	std::vector<Benchmark>& benchmarks = BenchmarkRegistration::getBenchmarks();
+	std::vector<Benchmark*> selected;
+	for (size_t b = 0; b < benchmarks.size(); ++b) {
+		if (benchmarks[b].name.find(filter) != std::string::npos) {
+			selected.push_back(&benchmarks[b]);
+		}
+	}
+	if (list) {
+		for (size_t b = 0; b < selected.size(); ++b) {
+			printf("%s\n", selected[b]->name.c_str());
+		}
+		return 0;
+	}
+
+	FILE* output = outputName != NULL ? fopen(outputName, "w") : stdout;
+	if (output == NULL) {
+		perror(outputName);
+		return 1;
+	}
+
+	char date[32];
+	const time_t now = time(NULL);
+	strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+
+	fprintf(output, "{ \"host\": ");
+	writeString(output, SystemPosix::getHostname());
+	fprintf(output, ", \"date\": \"%s\", \"compiler\": ", date);
+	writeString(output, __VERSION__);
+	fprintf(output, ",\n  \"macros\": ");
+	writeString(output, getMacros());
+	fprintf(output, ", \"byte_order\": \"%s\", \"cpus\": %ld, "
+		"\"repetitions\": %d, \"min_time_ns\": %lu,\n  \"benchmarks\": [\n",
+			ByteOrder::getImplementation(), sysconf(_SC_NPROCESSORS_ONLN),
+			repetitions, minimumTime);
+
+	for (size_t b = 0; b < selected.size(); ++b) {
+		Benchmark& benchmark = *selected[b];
+		fprintf(stderr, "%-50s", benchmark.name.c_str());
+		benchmark.run(repetitions, minimumTime);
+		fprintf(stderr, "%12.2f %-10s +- %.2f\n", benchmark.mean,
+				benchmark.unit.c_str(), benchmark.confidenceHigh
+						- benchmark.mean);
+
+		writeResult(output, benchmark);
+		fprintf(output, "%s\n", b + 1 < selected.size() ? "," : "");
+		fflush(output);
+	}
+	fprintf(output, "  ]\n}\n");
+
+	if (output != stdout) {
+		fclose(output);
+	}
+	return 0;
+}
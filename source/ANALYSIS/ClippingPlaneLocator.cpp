@@ -17,6 +17,7 @@
 #include <ANALYSIS/ClippingPlane.h>
 #include <ANALYSIS/ClippingPlaneLocator.h>
 #include <Rocket.h>
+#include <UTIL/AllocationTracker.h>
 
 /*
  * ClippingPlaneLocator - Constructor for ClippingPlaneLocator class.
@@ -59,6 +60,9 @@ ClippingPlaneLocator::~ClippingPlaneLocator(void) {
  */
 void ClippingPlaneLocator::motionCallback(
 		Vrui::LocatorTool::MotionCallbackData* callbackData) {
+	ALLOCATION_PHASE(PHASE_CALLBACK);
+	NO_ALLOCATION_REGION("ClippingPlaneLocator::motionCallback");
+
 	if (clippingPlane!=0&&clippingPlane->isActive()) {
 		Vrui::Vector planeNormal=
 				callbackData->currentTransformation.transform(Vrui::Vector(0,
@@ -75,6 +79,7 @@ void ClippingPlaneLocator::motionCallback(
  */
 void ClippingPlaneLocator::buttonPressCallback(
 		Vrui::LocatorTool::ButtonPressCallbackData* callbackData) {
+	ALLOCATION_PHASE(PHASE_CALLBACK);
 	if (clippingPlane!=0)
 		clippingPlane->setActive(true);
 } // end buttonPressCallback()
@@ -86,6 +91,7 @@ void ClippingPlaneLocator::buttonPressCallback(
  */
 void ClippingPlaneLocator::buttonReleaseCallback(
 		Vrui::LocatorTool::ButtonReleaseCallbackData* callbackData) {
+	ALLOCATION_PHASE(PHASE_CALLBACK);
 	if (clippingPlane!=0)
 		clippingPlane->setActive(false);
 } // end buttonReleaseCallback()
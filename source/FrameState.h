@@ -0,0 +1,28 @@
+/*
+ * FrameState.h - Per-frame snapshot of the state that display() needs.
+ */
+#ifndef FRAMESTATE_H_
+#define FRAMESTATE_H_
+
+/*
+ * FrameState - Immutable view of one frame, published by Rocket::frame() and
+ * read by every Rocket::display() call of that frame.  Only the active
+ * clipping planes are stored, packed at the front of the array, already in
+ * the form glClipPlane() expects.  The render toggles reach the scene
+ * through Hopper's scene commands instead.
+ */
+struct FrameState {
+	enum {
+		MAX_CLIPPING_PLANES = 6
+	};
+
+	/* Active clipping planes as (nx, ny, nz, -offset): */
+	int numberOfActiveClippingPlanes;
+	double clippingPlanes[MAX_CLIPPING_PLANES][4];
+
+	FrameState(void) :
+		numberOfActiveClippingPlanes(0) {
+	}
+};
+
+#endif /*FRAMESTATE_H_*/
@@ -9,9 +9,14 @@
 
 /* System headers */
 #include <iostream>
+#include <unistd.h>
 
 /* Application headers */
 #include <SYNC/Guard.h>
+#include <UTIL/Exception.h>
+#include <UTIL/Logger.h>
+#include <UTIL/Profiler.h>
+#include <UTIL/System.h>
 
 /* Delta3D headers */
 #include <dtCore/camera.h>
@@ -21,6 +26,11 @@
 #include <dtCore/system.h>
 #include <dtCore/environment.h>
 
+/* osg headers */
+#include <osg/Geode>
+#include <osg/Geometry>
+#include <osg/MatrixTransform>
+
 /* ODE headers */
 #include <ode/ode.h>
 
@@ -29,6 +39,18 @@
 
 #include "Hopper.h"
 
+/* The model catalog, read by config() unless ROCKET_MODEL_MANIFEST names
+ another one: */
+static const char* const MANIFEST_FILE = "../data/Rocket/models.manifest";
+
+/* The hopper model, the only one in the catalog without a manifest: */
+static const char* const MODEL_FILE = "../data/Rocket/europa.3ds";
+
+/* Extent of the placeholder box shown until the model is loaded; only a
+ rough guess, it just has to show where the model will appear: */
+static const osg::BoundingBox PLACEHOLDER_BOX(-2.0f, -2.0f, 0.0f, 2.0f, 2.0f,
+		3.0f);
+
 static bool dophysics = false;
 static double lastTime = 0.0f;
 static double *simulationTime;
@@ -48,7 +70,9 @@ using namespace dtUtil;
 /*
  * DataItem constructor
  */
-Hopper::DataItem::DataItem(void) {
+Hopper::DataItem::DataItem(void) :
+	viewerLock("Hopper::DataItem::viewerLock"), contextId(0),
+			displayFrame(-1), displayPass(0) {
 } // end DataItem()
 
 /*
@@ -64,7 +88,9 @@ Hopper::DataItem::~DataItem(void) {
  * Hopper constructor
  */
 Hopper::Hopper(void) :
-		Application(true), drawMode(true), frameNumber(0) {
+		Application(true), drawMode(true), frameNumber(0), lastFrameTime(0.0),
+		sceneCommands(256), model(ModelCatalog::NOT_FOUND), modelSwapTime(0),
+		modelVersion(0) {
 
 	hopper = this;
 
@@ -90,6 +116,18 @@ Hopper::~Hopper(void) {
  Methods of class Hopper:
  *******************************/
 
+/*
+ * CommandExecutor - Adapter that lets the command queue hand drained
+ * commands back to the Hopper.
+ */
+struct Hopper::CommandExecutor {
+	Hopper* hopper;
+
+	void operator()(const SceneCommand& command) {
+		hopper->executeCommand(command);
+	}
+};
+
 /*
  * addObjects
  */
@@ -103,18 +141,64 @@ void Hopper::addObjects(void) {
 } // end addObjects()
 
 /*
- * createHopper
+ * createHopper - Creates the hopper object and selects its first model,
+ * the one named by ROCKET_MODEL or else the first of the catalog.  The
+ * model loads on the thread pool; frame() swaps it in when it is ready.
  */
 void Hopper::createHopper(void) {
 	europa = new Object("Hopper");
-	europa->LoadFile("../data/Rocket/europa.3ds");
+	loadCatalog();
+
+	size_t first = 0;
+	std::string name;
+	if (SystemPosix::getenv("ROCKET_MODEL", name)) {
+		first = models.find(name);
+		if (first == ModelCatalog::NOT_FOUND) {
+			LOG_WARNING("Model %s is not in the catalog", name.c_str());
+			first = 0;
+		}
+	}
+	setModel(first);
 } // end createHopper
 
+/*
+ * createPlaceholder - Creates the edges of \p box as unlit lines, cheap to
+ * draw while a model loads.
+ *
+ * parameter box - const osg::BoundingBox &
+ * return - osg::ref_ptr<osg::Node>
+ */
+osg::ref_ptr<osg::Node> Hopper::createPlaceholder(const osg::BoundingBox& box) {
+	/* Corner i has bit 0 set for max x, bit 1 for max y, bit 2 for max z: */
+	static const GLushort edges[24] = { 0, 1, 2, 3, 4, 5, 6, 7, 0, 2, 1, 3, 4,
+			6, 5, 7, 0, 4, 1, 5, 2, 6, 3, 7 };
+
+	osg::ref_ptr<osg::Vec3Array> corners = new osg::Vec3Array(8);
+	for (unsigned int i = 0; i < 8; ++i) {
+		(*corners)[i] = box.corner(i);
+	}
+	osg::ref_ptr<osg::Vec4Array> colors = new osg::Vec4Array(1);
+	(*colors)[0].set(0.6f, 0.6f, 0.6f, 1.0f);
+
+	osg::ref_ptr<osg::Geometry> geometry = new osg::Geometry();
+	geometry->setVertexArray(corners.get());
+	geometry->setColorArray(colors.get());
+	geometry->setColorBinding(osg::Geometry::BIND_OVERALL);
+	geometry->addPrimitiveSet(new osg::DrawElementsUShort(GL_LINES, 24, edges));
+
+	osg::ref_ptr<osg::Geode> geode = new osg::Geode();
+	geode->setName("Placeholder");
+	geode->addDrawable(geometry.get());
+	geode->getOrCreateStateSet()->setMode(GL_LIGHTING,
+			osg::StateAttribute::OFF);
+	return geode;
+} // end createPlaceholder()
+
 /*
  * config
  */
 void Hopper::config(void) {
-	/* Load the model files */
+	/* Start loading the model files */
 	createHopper();
 
 	addObjects();
@@ -130,8 +214,19 @@ void Hopper::display(GLContextData & glContextData) const {
 	/* Get context data item: */
 	DataItem* dataItem = glContextData.retrieveDataItem<DataItem> (this);
 
+	/* A context is drawn once per eye; count the passes of this frame: */
+	if (dataItem->displayFrame != frameNumber) {
+		dataItem->displayFrame = frameNumber;
+		dataItem->displayPass = 0;
+	} else {
+		++dataItem->displayPass;
+	}
+	PROFILE_CONTEXT(dataItem->contextId, dataItem->displayPass);
+	PROFILE_ZONE("Hopper::display");
+
 	dataItem->viewer->advance(lastFrameTime);
 	if (!dataItem->viewer->done()) {
+		PROFILE_ZONE("osgViewer::updateTraversal");
 		dataItem->viewer->updateTraversal();
 	}
 
@@ -146,14 +241,54 @@ void Hopper::display(GLContextData & glContextData) const {
 	dataItem->viewer->getCamera()->setViewMatrix(osg::Matrix(mv));
 
 	/* Render all opaque surfaces: */
-	dataItem->viewer->renderingTraversals();
+	{
+		PROFILE_ZONE("osgViewer::renderingTraversals");
+		dataItem->viewer->renderingTraversals();
+	}
 
 } // end display()
 
+/*
+ * executeCommand - Applies one deferred scene mutation.
+ *
+ * parameter command - const SceneCommand &
+ */
+void Hopper::executeCommand(const SceneCommand& command) {
+	switch (command.type) {
+	case SceneCommand::SHOW_HOPPER:
+		setHopperVisible(command.enabled);
+		break;
+	case SceneCommand::SHOW_LIGHT:
+		setLight(command.enabled);
+		break;
+	case SceneCommand::SHOW_WIREFRAME:
+		setWireframe(command.enabled);
+		break;
+	case SceneCommand::SELECT_MODEL:
+		setModel(command.model);
+		break;
+	}
+} // end executeCommand()
+
 /*
  * frame
  */
 void Hopper::frame(void) {
+	PROFILE_ZONE("Hopper::frame");
+
+	/* Apply the scene mutations posted since the last frame: */
+	CommandExecutor executor = { this };
+	sceneCommands.drain(executor);
+
+	/* Keep the models in memory under budget, and swap the model in for
+	 the placeholder once it has loaded, or for its previous version once
+	 its file was reloaded: */
+	models.update();
+	if (models.getState(model) != ModelCatalog::LOADING && (placeholder.valid()
+			|| models.getVersion(model) != modelVersion)) {
+		swapInModel();
+	}
+
 	/* Get the current application time: */
 	double newFrameTime = Vrui::getApplicationTime();
 
@@ -171,12 +306,45 @@ void Hopper::frame(void) {
 	lastFrameTime = newFrameTime;
 } // end frame()
 
+/*
+ * getModel - Returns the catalog index of the model shown, or being
+ * loaded to be shown.
+ *
+ * return - size_t
+ */
+size_t Hopper::getModel(void) const {
+	return model;
+} // end getModel()
+
+/*
+ * getModelCatalog
+ *
+ * return - const ModelCatalog &
+ */
+const ModelCatalog& Hopper::getModelCatalog(void) const {
+	return models;
+} // end getModelCatalog()
+
+/*
+ * getModelSwapTime - Returns the monotonic time frame() last swapped a model
+ * in for the placeholder, or 0 if it has not yet.
+ *
+ * return - Uint64
+ */
+Uint64 Hopper::getModelSwapTime(void) const {
+	return modelSwapTime;
+} // end getModelSwapTime()
+
 /*
  * initContext
  *
  * parameter glContextData - GLContextData &
  */
 void Hopper::initContext(GLContextData & glContextData) const {
+	/* Vrui initializes each context on the thread that renders it: */
+	SystemPosix::applyThreadRole("RENDER");
+	PROFILE_THREAD_NAME("Render");
+
 	/* Create a new context data item: */
 	DataItem* dataItem = new DataItem();
 
@@ -190,8 +358,9 @@ void Hopper::initContext(GLContextData & glContextData) const {
 	osg::ref_ptr<osgViewer::GraphicsWindowEmbedded> graphicsWindow =
 			new osgViewer::GraphicsWindowEmbedded(traits.get());
 	viewer->getCamera()->setGraphicsContext(graphicsWindow.get());
+	dataItem->contextId = osg::GraphicsContext::createNewContextID();
 	viewer->getCamera()->getGraphicsContext()->getState()->setContextID(
-			osg::GraphicsContext::createNewContextID());
+			dataItem->contextId);
 
 	viewer->getCamera()->setComputeNearFarMode(osgUtil::CullVisitor::DO_NOT_COMPUTE_NEAR_FAR);
 
@@ -204,7 +373,7 @@ void Hopper::initContext(GLContextData & glContextData) const {
 	root->addChild(hopper->GetRootNode());
 
 	// Add the tree to the viewer and set properties
-	Guard<MutexPosix> viewerGuard(dataItem->viewerLock);
+	Guard<InstrumentedMutex<MutexPosix> > viewerGuard(dataItem->viewerLock);
 	viewer->setSceneData(root);
 
 	dataItem->viewer = viewer;
@@ -212,30 +381,177 @@ void Hopper::initContext(GLContextData & glContextData) const {
 	glContextData.addDataItem(this, dataItem);
 } // end initContext()
 
+/*
+ * loadCatalog - Fills the model catalog from the manifest named by
+ * ROCKET_MODEL_MANIFEST, or from the default one if it exists.  Without
+ * models, the catalog gets the hopper alone.
+ */
+void Hopper::loadCatalog(void) {
+	std::string manifest;
+	const bool configured = SystemPosix::getenv("ROCKET_MODEL_MANIFEST",
+			manifest);
+	if (!configured) {
+		manifest = MANIFEST_FILE;
+	}
+	if (configured || access(manifest.c_str(), F_OK) == 0) {
+		try {
+			models.loadManifest(manifest);
+		} catch (const Exception& e) {
+			LOG_ERROR("%s", e.getDescription().c_str());
+		}
+	}
+	if (models.getNumModels() == 0) {
+		models.add("europa", MODEL_FILE);
+	}
+} // end loadCatalog()
+
+/*
+ * isModelPending - Tests whether the placeholder is still shown.
+ *
+ * return - bool
+ */
+bool Hopper::isModelPending(void) const {
+	return placeholder.valid();
+} // end isModelPending()
+
+/*
+ * postCommand - Queues a scene mutation for the next frame().  Safe to call
+ * from any thread; the scene graph itself is only changed in frame(), while
+ * no render context traverses it.
+ *
+ * parameter type - SceneCommand::Type
+ * parameter enabled - bool
+ * return - bool, false if the queue was full and the command was dropped
+ */
+bool Hopper::postCommand(SceneCommand::Type type, bool enabled) {
+	SceneCommand command;
+	command.type = type;
+	command.enabled = enabled;
+	command.model = 0;
+	return sceneCommands.tryPush(command);
+} // end postCommand()
+
+/*
+ * postSelectModel - Queues the switch to another model of the catalog for
+ * the next frame().  Safe to call from any thread.
+ *
+ * parameter index - size_t, the catalog index
+ * return - bool, false if the queue was full and the command was dropped
+ */
+bool Hopper::postSelectModel(size_t index) {
+	SceneCommand command;
+	command.type = SceneCommand::SELECT_MODEL;
+	command.enabled = true;
+	command.model = index;
+	return sceneCommands.tryPush(command);
+} // end postSelectModel()
+
+/*
+ * setHopperVisible
+ *
+ * parameter visible - bool
+ */
+void Hopper::setHopperVisible(bool visible) {
+	europa.get()->DeltaDrawable::SetActive(visible);
+} // end setHopperVisible()
+
+/*
+ * setLight
+ *
+ * parameter enabled - bool
+ */
+void Hopper::setLight(bool enabled) {
+	globalInfinite->SetEnabled(enabled);
+} // end setLight()
+
+/*
+ * setModel - Shows model \p index of the catalog in the hopper object.  The
+ * previous model is released to the catalog, which keeps it while the
+ * memory budget allows; until the new one is loaded, the placeholder is
+ * shown.
+ *
+ * parameter index - size_t
+ */
+void Hopper::setModel(size_t index) {
+	if (index == model) {
+		return;
+	}
+	if (index >= models.getNumModels()) {
+		LOG_WARNING("No model %lu in the catalog", Uint64(index));
+		return;
+	}
+
+	osg::MatrixTransform* transform = europa->GetMatrixNode();
+	if (modelNode.valid()) {
+		transform->removeChild(modelNode.get());
+		modelNode = NULL;
+	}
+	if (model != ModelCatalog::NOT_FOUND) {
+		models.release(model);
+	}
+	model = index;
+	models.acquire(model);
+	if (!placeholder.valid()) {
+		placeholder = createPlaceholder(PLACEHOLDER_BOX);
+		transform->addChild(placeholder.get());
+	}
+} // end setModel()
+
+/*
+ * setWireframe
+ *
+ * parameter wireframe - bool
+ */
+void Hopper::setWireframe(bool wireframe) {
+	if (wireframe) {
+		GetScene()->SetRenderState(dtCore::Scene::FRONT_AND_BACK, dtCore::Scene::LINE);
+	} else {
+		GetScene()->SetRenderState(dtCore::Scene::FRONT, dtCore::Scene::FILL);
+	}
+	drawMode = !wireframe;
+} // end setWireframe()
+
+/*
+ * swapInModel - Replaces the placeholder, or the previous version of the
+ * model after a reload, with the loaded model; if the load failed, just
+ * removes the placeholder, and the catalog logged why.  Called from
+ * frame(), while no render context traverses the scene, so the renderer
+ * never sees a half-swapped model.
+ */
+void Hopper::swapInModel(void) {
+	osg::MatrixTransform* transform = europa->GetMatrixNode();
+	if (modelNode.valid()) {
+		transform->removeChild(modelNode.get());
+	}
+	modelNode = models.getNode(model);
+	modelVersion = models.getVersion(model);
+	if (modelNode.valid()) {
+		transform->addChild(modelNode.get());
+	}
+	if (placeholder.valid()) {
+		transform->removeChild(placeholder.get());
+		placeholder = NULL;
+		modelSwapTime = SystemPosix::getMonotonicNanoseconds();
+	}
+} // end swapInModel()
+
 /*
  * toggleLight
  */
 void Hopper::toggleLight(void) {
-	globalInfinite->SetEnabled(!globalInfinite->GetEnabled());
-}
+	setLight(!globalInfinite->GetEnabled());
+} // end toggleLight()
 
 /*
  * toggleHopper
  */
 void Hopper::toggleHopper(void) {
-	europa.get()->DeltaDrawable::SetActive(
-			!europa.get()->DeltaDrawable::GetActive());
+	setHopperVisible(!europa.get()->DeltaDrawable::GetActive());
 } // end toggleHopper()
 
 /*
  * toggleWireframe
  */
 void Hopper::toggleWireframe(void) {
-	if (drawMode) {
-		GetScene()->SetRenderState(dtCore::Scene::FRONT_AND_BACK, dtCore::Scene::LINE);
-		drawMode = false;
-	} else {
-		GetScene()->SetRenderState(dtCore::Scene::FRONT, dtCore::Scene::FILL);
-		drawMode = true;
-	}
+	setWireframe(drawMode);
 } // end toggleWireframe()
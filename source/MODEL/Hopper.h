@@ -23,12 +23,16 @@
 #include <osg/Transform>
 #include <osg/Group>
 #include <osg/Node>
+#include <osg/BoundingBox>
 #include <osg/Camera>
 
 #include <osgUtil/UpdateVisitor>
 
 #include <osgViewer/Viewer>
 
+#include <MODEL/ModelCatalog.h>
+#include <SYNC/CommandQueue.h>
+#include <SYNC/InstrumentedMutex.h>
 #include <SYNC/MutexPosix.h>
 #include <SYNC/NullMutex.h>
 
@@ -56,17 +60,44 @@ private:
 		int data;
 		osg::Group * root;
 		osg::ref_ptr<osgViewer::Viewer> viewer;
-		MutexPosix viewerLock;
+		InstrumentedMutex<MutexPosix> viewerLock;
+		unsigned int contextId; // OSG context id, tags profiler zones
+		int displayFrame; // Frame of the last display() call
+		int displayPass; // Passes (eyes) drawn in displayFrame so far
 		/* Constructors and destructors: */
 		DataItem(void);
 		virtual ~DataItem(void);
 	};
 public:
+	/*
+	 * SceneCommand - A scene mutation deferred to the next frame().  Commands
+	 * carry the requested state rather than a toggle, so applying one twice
+	 * is harmless.
+	 */
+	struct SceneCommand {
+		enum Type {
+			SHOW_HOPPER, SHOW_LIGHT, SHOW_WIREFRAME, SELECT_MODEL
+		};
+		Type type;
+		bool enabled;
+		size_t model; /**< Catalog index, for SELECT_MODEL */
+	};
+
 	void addObjects(void);
 	virtual void config(void);
 	virtual void display(GLContextData& contextData) const;
 	void frame(void);
+	size_t getModel(void) const;
+	const ModelCatalog& getModelCatalog(void) const;
+	Uint64 getModelSwapTime(void) const;
 	virtual void initContext(GLContextData& contextData) const;
+	bool isModelPending(void) const;
+	bool postCommand(SceneCommand::Type type, bool enabled);
+	bool postSelectModel(size_t index);
+	void setHopperVisible(bool visible);
+	void setLight(bool enabled);
+	void setModel(size_t index);
+	void setWireframe(bool wireframe);
 	void toggleLight(void);
 	void toggleHopper(void);
 	void toggleWireframe(void);
@@ -80,6 +111,20 @@ public:
 	osg::ref_ptr<osg::NodeVisitor> updateVisitor;
 private:
 	void createHopper(void);
+	static osg::ref_ptr<osg::Node> createPlaceholder(
+			const osg::BoundingBox& box);
+	void executeCommand(const SceneCommand& command);
+	void loadCatalog(void);
+	void swapInModel(void);
+
+	struct CommandExecutor;
+	CommandQueue<SceneCommand> sceneCommands;
+	ModelCatalog models;
+	size_t model; /**< Catalog index of the model shown */
+	osg::ref_ptr<osg::Node> modelNode; /**< Its node, once swapped in */
+	osg::ref_ptr<osg::Node> placeholder; /**< Shown while the model loads */
+	Uint64 modelSwapTime; /**< When frame() last swapped a model in, or 0 */
+	Uint64 modelVersion; /**< Catalog version of modelNode */
 };
 
 #endif
@@ -0,0 +1,1430 @@
+/*
+ * ModelCache.cpp - Methods for the ModelCache class.
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <map>
+#include <vector>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+/* Boost includes */
+#include <boost/static_assert.hpp>
+
+/* osg includes */
+#include <osg/BlendFunc>
+#include <osg/CullFace>
+#include <osg/Geode>
+#include <osg/Geometry>
+#include <osg/Material>
+#include <osg/MatrixTransform>
+#include <osg/StateSet>
+#include <osg/Texture2D>
+#include <osgDB/ReadFile>
+
+#include <SYNC/Guard.h>
+#include <UTIL/Logger.h>
+#include <UTIL/System.h>
+
+#include "ModelCache.h"
+
+BOOST_STATIC_ASSERT(sizeof(osg::Vec2) == 2 * sizeof(float));
+BOOST_STATIC_ASSERT(sizeof(osg::Vec3) == 3 * sizeof(float));
+BOOST_STATIC_ASSERT(sizeof(osg::Vec4) == 4 * sizeof(float));
+
+namespace {
+
+/* Marks an absent index or reference in the records: */
+const Uint32 NONE = 0xffffffffU;
+
+const char MAGIC[4] = { 'R', 'K', 'M', 'C' };
+const Uint32 BYTE_ORDER_MARK = 0x01020304U;
+const char* const ENTRY_SUFFIX = ".rkmc";
+
+/* Temporary files of writers that died are removed after this long: */
+const time_t STALE_TEMPORARY_SECONDS = 3600;
+
+/*
+ * isClass - Tests whether \p object is exactly the osg class \p name, not a
+ * subclass that might carry more than the cache stores.
+ */
+bool isClass(const osg::Object& object, const char* name) {
+	return std::strcmp(object.libraryName(), "osg") == 0 && std::strcmp(
+			object.className(), name) == 0;
+}
+
+bool endsWith(const std::string& text, const std::string& suffix) {
+	return text.size() >= suffix.size() && text.compare(text.size()
+			- suffix.size(), suffix.size(), suffix) == 0;
+}
+
+/*
+ * makeDirectories - Creates \p path and its missing parents.
+ */
+bool makeDirectories(const std::string& path) {
+	for (size_t slash = path.find('/', 1); slash != std::string::npos; slash
+			= path.find('/', slash + 1)) {
+		mkdir(path.substr(0, slash).c_str(), 0755);
+	}
+	return mkdir(path.c_str(), 0755) == 0 || errno == EEXIST;
+}
+
+struct CacheFile {
+	std::string path;
+	time_t lastUse;
+	Uint64 size;
+
+	bool operator<(const CacheFile& other) const {
+		return lastUse < other.lastUse;
+	}
+};
+
+}
+
+/*****************************************
+ File format of ModelCache:
+ *****************************************/
+
+/*
+ * The entry file is the header followed by the tables it points to, each
+ * aligned to 8 bytes and the data to 16.  Everything is in host byte order;
+ * an entry written by a host of the other byte order is rejected.  Nodes
+ * are stored in preorder, so a parent always precedes its children.
+ * Strings are offsets into the string table, where offset 0 is "".
+ * Vertex and index arrays are offsets into the data section.
+ */
+struct ModelCache::Table {
+	Uint64 offset; /**< From the start of the file */
+	Uint64 count; /**< Records; bytes for strings and data */
+};
+
+struct ModelCache::FileHeader {
+	char magic[4];
+	Uint32 version;
+	Uint32 byteOrderMark;
+	Uint32 reserved;
+	Uint64 key;
+	Uint64 fileSize;
+	Table nodes;
+	Table matrices; /**< 16 doubles each, column-major as osg::Matrix */
+	Table geometries;
+	Table primitives;
+	Table states;
+	Table modes;
+	Table strings;
+	Table data;
+};
+
+struct ModelCache::NodeRecord {
+	enum Type {
+		GROUP, MATRIX_TRANSFORM, GEODE
+	};
+
+	Uint32 type;
+	Uint32 parent; /**< NONE for the root */
+	Uint32 name;
+	Uint32 state;
+	Uint32 matrix; /**< MATRIX_TRANSFORM only */
+	Uint32 nodeMask;
+};
+
+struct ModelCache::GeometryRecord {
+	enum Flags {
+		USE_DISPLAY_LIST = 1, USE_VERTEX_BUFFER_OBJECTS = 2
+	};
+
+	Uint32 geode;
+	Uint32 name;
+	Uint32 state;
+	Uint32 flags;
+	Uint32 numVertices;
+	Uint32 numNormals;
+	Uint32 normalBinding; /**< osg::Geometry::AttributeBinding */
+	Uint32 numColors;
+	Uint32 colorBinding;
+	Uint32 numTexCoords; /**< Unit 0; 0 or numVertices */
+	Uint32 firstPrimitive;
+	Uint32 numPrimitives;
+	Uint64 vertices; /**< Vec3 */
+	Uint64 normals; /**< Vec3 */
+	Uint64 colors; /**< Vec4 */
+	Uint64 texCoords; /**< Vec2 */
+};
+
+struct ModelCache::PrimitiveRecord {
+	Uint32 mode;
+	Uint32 first; /**< Arrays only */
+	Uint32 count;
+	Uint32 indexed;
+	Uint64 indices; /**< Uint32 each */
+};
+
+struct ModelCache::ModeRecord {
+	Uint32 mode;
+	Uint32 value;
+	Uint32 textureUnit; /**< NONE for a mode that is not per texture unit */
+};
+
+struct ModelCache::StateRecord {
+	enum Flags {
+		HAS_MATERIAL = 1, HAS_BLEND_FUNC = 2, HAS_CULL_FACE = 4, HAS_TEXTURE = 8
+	};
+	enum Attribute {
+		MATERIAL, BLEND_FUNC, CULL_FACE, TEXTURE, NUM_ATTRIBUTES
+	};
+
+	Uint32 flags;
+	Uint32 firstMode;
+	Uint32 numModes;
+	Int32 renderingHint;
+	Uint32 renderBinMode;
+	Int32 binNumber;
+	Uint32 binName;
+	Uint32 overrides[NUM_ATTRIBUTES];
+	/* Material, front and back: */
+	Uint32 colorMode;
+	float ambient[2][4];
+	float diffuse[2][4];
+	float specular[2][4];
+	float emission[2][4];
+	float shininess[2];
+	/* BlendFunc: source, destination, source alpha, destination alpha */
+	Uint32 blend[4];
+	/* CullFace: */
+	Uint32 cullFace;
+	/* Texture2D on unit 0: */
+	Uint32 image; /**< File name of the image */
+	Uint32 wrap[3]; /**< S, T, R */
+	Uint32 filter[2]; /**< Minification, magnification */
+	float maxAnisotropy;
+};
+
+namespace {
+
+/*
+ * isBindingValid - Tests whether \p count values are enough for the
+ * attribute binding \p binding of a geometry.
+ */
+bool isBindingValid(Uint32 binding, Uint32 count, Uint32 numVertices,
+		Uint32 numPrimitives) {
+	switch (binding) {
+	case osg::Geometry::BIND_OFF:
+		return true;
+	case osg::Geometry::BIND_OVERALL:
+		return count >= 1;
+	case osg::Geometry::BIND_PER_PRIMITIVE_SET:
+		return count >= numPrimitives;
+	case osg::Geometry::BIND_PER_VERTEX:
+		return count == numVertices;
+	default:
+		// Per-primitive bindings depend on the primitive types; not stored.
+		return false;
+	}
+} // end isBindingValid()
+
+void getColor(const osg::Vec4& color, float result[4]) {
+	for (int i = 0; i < 4; ++i) {
+		result[i] = color[i];
+	}
+}
+
+osg::Vec4 makeColor(const float color[4]) {
+	return osg::Vec4(color[0], color[1], color[2], color[3]);
+}
+
+}
+
+/*****************************************
+ Methods of class ModelCache::Writer:
+ *****************************************/
+
+/*
+ * Writer - Flattens a scene graph into the tables of an entry.
+ */
+class ModelCache::Writer {
+public:
+	Writer(void) :
+		strings(1, '\0') {
+	}
+
+	bool addNode(const osg::Node& node, Uint32 parent);
+	Uint64 getFileSize(void);
+	bool write(FILE* file, Uint64 key);
+
+	const std::string& getReason(void) const {
+		return reason;
+	}
+
+private:
+	bool addGeometry(const osg::Geometry& geometry, Uint32 geode);
+	bool addState(const osg::StateSet* stateSet, Uint32& index);
+	bool addTexture(const osg::StateAttribute& attribute, StateRecord& record);
+	Uint32 addString(const std::string& text);
+	Uint64 addData(const void* bytes, size_t size);
+	void layOut(FileHeader& header);
+	bool reject(const std::string& why);
+
+	template<class T>
+	static bool writeTable(FILE* file, const std::vector<T>& records,
+			const Table& table, Uint64& position);
+
+	std::vector<NodeRecord> nodes;
+	std::vector<double> matrices;
+	std::vector<GeometryRecord> geometries;
+	std::vector<PrimitiveRecord> primitives;
+	std::vector<StateRecord> states;
+	std::vector<ModeRecord> modes;
+	std::vector<char> strings;
+	std::vector<char> data;
+	std::map<const osg::StateSet*, Uint32> stateIndices;
+	std::string reason;
+};
+
+/*
+ * addNode - Adds \p node and everything below it.
+ *
+ * @return \c false is returned if the graph holds something the format
+ *         cannot represent; getReason() tells what.
+ */
+bool ModelCache::Writer::addNode(const osg::Node& node, Uint32 parent) {
+	if (node.getUpdateCallback() != NULL || node.getEventCallback() != NULL
+			|| node.getCullCallback() != NULL) {
+		return reject("node " + node.getName() + " has callbacks");
+	}
+
+	NodeRecord record;
+	record.parent = parent;
+	record.name = addString(node.getName());
+	record.matrix = NONE;
+	record.nodeMask = node.getNodeMask();
+	if (!addState(node.getStateSet(), record.state)) {
+		return false;
+	}
+
+	if (isClass(node, "MatrixTransform")) {
+		const osg::MatrixTransform& transform =
+				static_cast<const osg::MatrixTransform&> (node);
+		if (transform.getReferenceFrame() != osg::Transform::RELATIVE_RF) {
+			return reject("absolute transform " + node.getName());
+		}
+		record.type = NodeRecord::MATRIX_TRANSFORM;
+		record.matrix = Uint32(matrices.size() / 16);
+		const osg::Matrix::value_type* matrix = transform.getMatrix().ptr();
+		matrices.insert(matrices.end(), matrix, matrix + 16);
+	} else if (isClass(node, "Group")) {
+		record.type = NodeRecord::GROUP;
+	} else if (isClass(node, "Geode")) {
+		record.type = NodeRecord::GEODE;
+	} else {
+		return reject(std::string("node of class ") + node.libraryName()
+				+ "::" + node.className());
+	}
+
+	const Uint32 index = Uint32(nodes.size());
+	nodes.push_back(record);
+
+	if (record.type == NodeRecord::GEODE) {
+		const osg::Geode& geode = static_cast<const osg::Geode&> (node);
+		for (unsigned int i = 0; i < geode.getNumDrawables(); ++i) {
+			const osg::Drawable* drawable = geode.getDrawable(i);
+			if (!isClass(*drawable, "Geometry")) {
+				return reject(std::string("drawable of class ")
+						+ drawable->libraryName() + "::"
+						+ drawable->className());
+			}
+			if (!addGeometry(static_cast<const osg::Geometry&> (*drawable),
+					index)) {
+				return false;
+			}
+		}
+	} else {
+		const osg::Group& group = static_cast<const osg::Group&> (node);
+		for (unsigned int i = 0; i < group.getNumChildren(); ++i) {
+			if (!addNode(*group.getChild(i), index)) {
+				return false;
+			}
+		}
+	}
+	return true;
+} // end addNode()
+
+bool ModelCache::Writer::addGeometry(const osg::Geometry& geometry,
+		Uint32 geode) {
+	const std::string& name = geometry.getName();
+	if (geometry.getUpdateCallback() != NULL || geometry.getCullCallback()
+			!= NULL || geometry.getDrawCallback() != NULL
+			|| geometry.getComputeBoundingBoxCallback() != NULL) {
+		return reject("geometry " + name + " has callbacks");
+	}
+	if (geometry.getVertexIndices() != NULL || geometry.getNormalIndices()
+			!= NULL || geometry.getColorIndices() != NULL
+			|| geometry.getTexCoordIndices(0) != NULL) {
+		return reject("geometry " + name + " has index arrays");
+	}
+	if (geometry.getSecondaryColorArray() != NULL
+			|| geometry.getFogCoordArray() != NULL
+			|| geometry.getNumVertexAttribArrays() != 0) {
+		return reject("geometry " + name + " has unsupported arrays");
+	}
+	for (unsigned int unit = 1; unit < geometry.getNumTexCoordArrays(); ++unit) {
+		if (geometry.getTexCoordArray(unit) != NULL) {
+			return reject("geometry " + name + " has several texture units");
+		}
+	}
+
+	const osg::Array* vertices = geometry.getVertexArray();
+	const osg::Array* normals = geometry.getNormalArray();
+	const osg::Array* colors = geometry.getColorArray();
+	const osg::Array* texCoords = geometry.getNumTexCoordArrays() > 0 ? geometry.getTexCoordArray(
+			0)
+			: NULL;
+	if (vertices == NULL || vertices->getType() != osg::Array::Vec3ArrayType) {
+		return reject("geometry " + name + " has no Vec3 vertex array");
+	}
+	if (normals != NULL && normals->getType() != osg::Array::Vec3ArrayType) {
+		return reject("geometry " + name + " has no Vec3 normal array");
+	}
+	if (colors != NULL && colors->getType() != osg::Array::Vec4ArrayType
+			&& colors->getType() != osg::Array::Vec4ubArrayType) {
+		return reject("geometry " + name + " has no Vec4 color array");
+	}
+	if (texCoords != NULL && texCoords->getType() != osg::Array::Vec2ArrayType) {
+		return reject("geometry " + name + " has no Vec2 texture coordinates");
+	}
+
+	GeometryRecord record;
+	record.geode = geode;
+	record.name = addString(name);
+	if (!addState(geometry.getStateSet(), record.state)) {
+		return false;
+	}
+	record.flags = (geometry.getUseDisplayList() ? GeometryRecord::USE_DISPLAY_LIST
+			: 0) | (geometry.getUseVertexBufferObjects() ? GeometryRecord::USE_VERTEX_BUFFER_OBJECTS
+			: 0);
+
+	record.numVertices = vertices->getNumElements();
+	record.vertices = addData(vertices->getDataPointer(), record.numVertices
+			* sizeof(osg::Vec3));
+
+	record.numNormals = normals != NULL ? normals->getNumElements() : 0;
+	record.normalBinding = normals != NULL ? geometry.getNormalBinding()
+			: osg::Geometry::BIND_OFF;
+	record.normals = addData(normals != NULL ? normals->getDataPointer()
+			: NULL, record.numNormals * sizeof(osg::Vec3));
+
+	record.numColors = colors != NULL ? colors->getNumElements() : 0;
+	record.colorBinding = colors != NULL ? geometry.getColorBinding()
+			: osg::Geometry::BIND_OFF;
+	if (colors != NULL && colors->getType() == osg::Array::Vec4ubArrayType) {
+		const osg::Vec4ubArray& bytes =
+				static_cast<const osg::Vec4ubArray&> (*colors);
+		std::vector<osg::Vec4> converted(bytes.size());
+		for (size_t i = 0; i < bytes.size(); ++i) {
+			for (int c = 0; c < 4; ++c) {
+				converted[i][c] = float(bytes[i][c]) / 255.0f;
+			}
+		}
+		record.colors = addData(converted.empty() ? NULL : &converted[0],
+				converted.size() * sizeof(osg::Vec4));
+	} else {
+		record.colors = addData(colors != NULL ? colors->getDataPointer()
+				: NULL, record.numColors * sizeof(osg::Vec4));
+	}
+
+	record.numTexCoords = texCoords != NULL ? texCoords->getNumElements() : 0;
+	if (record.numTexCoords != 0 && record.numTexCoords != record.numVertices) {
+		return reject("geometry " + name
+				+ " has not one texture coordinate per vertex");
+	}
+	record.texCoords = addData(texCoords != NULL ? texCoords->getDataPointer()
+			: NULL, record.numTexCoords * sizeof(osg::Vec2));
+
+	record.firstPrimitive = Uint32(primitives.size());
+	for (unsigned int p = 0; p < geometry.getNumPrimitiveSets(); ++p) {
+		const osg::PrimitiveSet& set = *geometry.getPrimitiveSet(p);
+		PrimitiveRecord primitive;
+		primitive.mode = set.getMode();
+		primitive.first = 0;
+		primitive.indexed = 0;
+		primitive.indices = 0;
+
+		switch (set.getType()) {
+		case osg::PrimitiveSet::DrawArraysPrimitiveType: {
+			const osg::DrawArrays& arrays =
+					static_cast<const osg::DrawArrays&> (set);
+			primitive.first = arrays.getFirst();
+			primitive.count = arrays.getCount();
+			primitives.push_back(primitive);
+			break;
+		}
+		case osg::PrimitiveSet::DrawArrayLengthsPrimitiveType: {
+			// One plain run per length draws the same.
+			const osg::DrawArrayLengths& lengths =
+					static_cast<const osg::DrawArrayLengths&> (set);
+			primitive.first = lengths.getFirst();
+			for (size_t l = 0; l < lengths.size(); ++l) {
+				primitive.count = lengths[l];
+				primitives.push_back(primitive);
+				primitive.first += lengths[l];
+			}
+			break;
+		}
+		case osg::PrimitiveSet::DrawElementsUBytePrimitiveType:
+		case osg::PrimitiveSet::DrawElementsUShortPrimitiveType:
+		case osg::PrimitiveSet::DrawElementsUIntPrimitiveType: {
+			std::vector<Uint32> indices(set.getNumIndices());
+			for (size_t i = 0; i < indices.size(); ++i) {
+				indices[i] = set.index(i);
+			}
+			primitive.count = Uint32(indices.size());
+			primitive.indexed = 1;
+			primitive.indices = addData(indices.empty() ? NULL : &indices[0],
+					indices.size() * sizeof(Uint32));
+			primitives.push_back(primitive);
+			break;
+		}
+		default:
+			return reject("geometry " + name + " has unsupported primitives");
+		}
+	}
+	record.numPrimitives = Uint32(primitives.size()) - record.firstPrimitive;
+	if (!isBindingValid(record.normalBinding, record.numNormals,
+			record.numVertices, record.numPrimitives) || !isBindingValid(
+			record.colorBinding, record.numColors, record.numVertices,
+			record.numPrimitives)) {
+		return reject("geometry " + name + " has unsupported bindings");
+	}
+
+	geometries.push_back(record);
+	return true;
+} // end addGeometry()
+
+/*
+ * addState - Adds a state set, once however many nodes and geometries
+ * share it.
+ *
+ * @param index Set to the index of the state record, or NONE for NULL.
+ */
+bool ModelCache::Writer::addState(const osg::StateSet* stateSet,
+		Uint32& index) {
+	index = NONE;
+	if (stateSet == NULL) {
+		return true;
+	}
+	const std::map<const osg::StateSet*, Uint32>::const_iterator known =
+			stateIndices.find(stateSet);
+	if (known != stateIndices.end()) {
+		index = known->second;
+		return true;
+	}
+
+	if (!stateSet->getUniformList().empty() || stateSet->getUpdateCallback()
+			!= NULL || stateSet->getEventCallback() != NULL) {
+		return reject("state set with uniforms or callbacks");
+	}
+
+	StateRecord record;
+	std::memset(&record, 0, sizeof(record));
+	record.renderingHint = stateSet->getRenderingHint();
+	record.renderBinMode = stateSet->getRenderBinMode();
+	record.binNumber = stateSet->getBinNumber();
+	record.binName = addString(stateSet->getBinName());
+	record.image = 0;
+
+	record.firstMode = Uint32(modes.size());
+	const osg::StateSet::ModeList& modeList = stateSet->getModeList();
+	for (osg::StateSet::ModeList::const_iterator m = modeList.begin(); m
+			!= modeList.end(); ++m) {
+		const ModeRecord mode = { m->first, m->second, NONE };
+		modes.push_back(mode);
+	}
+	const osg::StateSet::TextureModeList& textureModes =
+			stateSet->getTextureModeList();
+	for (size_t unit = 0; unit < textureModes.size(); ++unit) {
+		for (osg::StateSet::ModeList::const_iterator m =
+				textureModes[unit].begin(); m != textureModes[unit].end(); ++m) {
+			if (unit > 0) {
+				return reject("state set with several texture units");
+			}
+			const ModeRecord mode = { m->first, m->second, Uint32(unit) };
+			modes.push_back(mode);
+		}
+	}
+	record.numModes = Uint32(modes.size()) - record.firstMode;
+
+	const osg::StateSet::AttributeList& attributes =
+			stateSet->getAttributeList();
+	for (osg::StateSet::AttributeList::const_iterator a = attributes.begin(); a
+			!= attributes.end(); ++a) {
+		const osg::StateAttribute& attribute = *a->second.first;
+		if (isClass(attribute, "Material")) {
+			const osg::Material& material =
+					static_cast<const osg::Material&> (attribute);
+			const osg::Material::Face faces[2] = { osg::Material::FRONT,
+					osg::Material::BACK };
+			for (int f = 0; f < 2; ++f) {
+				getColor(material.getAmbient(faces[f]), record.ambient[f]);
+				getColor(material.getDiffuse(faces[f]), record.diffuse[f]);
+				getColor(material.getSpecular(faces[f]), record.specular[f]);
+				getColor(material.getEmission(faces[f]), record.emission[f]);
+				record.shininess[f] = material.getShininess(faces[f]);
+			}
+			record.colorMode = material.getColorMode();
+			record.flags |= StateRecord::HAS_MATERIAL;
+			record.overrides[StateRecord::MATERIAL] = a->second.second;
+		} else if (isClass(attribute, "BlendFunc")) {
+			const osg::BlendFunc& blend =
+					static_cast<const osg::BlendFunc&> (attribute);
+			record.blend[0] = blend.getSource();
+			record.blend[1] = blend.getDestination();
+			record.blend[2] = blend.getSourceAlpha();
+			record.blend[3] = blend.getDestinationAlpha();
+			record.flags |= StateRecord::HAS_BLEND_FUNC;
+			record.overrides[StateRecord::BLEND_FUNC] = a->second.second;
+		} else if (isClass(attribute, "CullFace")) {
+			record.cullFace
+					= static_cast<const osg::CullFace&> (attribute).getMode();
+			record.flags |= StateRecord::HAS_CULL_FACE;
+			record.overrides[StateRecord::CULL_FACE] = a->second.second;
+		} else {
+			return reject(std::string("state attribute of class ")
+					+ attribute.libraryName() + "::" + attribute.className());
+		}
+	}
+
+	const osg::StateSet::TextureAttributeList& textures =
+			stateSet->getTextureAttributeList();
+	for (size_t unit = 0; unit < textures.size(); ++unit) {
+		for (osg::StateSet::AttributeList::const_iterator a =
+				textures[unit].begin(); a != textures[unit].end(); ++a) {
+			if (unit > 0) {
+				return reject("state set with several texture units");
+			}
+			if (!addTexture(*a->second.first, record)) {
+				return false;
+			}
+			record.overrides[StateRecord::TEXTURE] = a->second.second;
+		}
+	}
+
+	index = Uint32(states.size());
+	states.push_back(record);
+	stateIndices[stateSet] = index;
+	return true;
+} // end addState()
+
+bool ModelCache::Writer::addTexture(const osg::StateAttribute& attribute,
+		StateRecord& record) {
+	if (!isClass(attribute, "Texture2D")) {
+		return reject(std::string("texture attribute of class ")
+				+ attribute.libraryName() + "::" + attribute.className());
+	}
+	const osg::Texture2D& texture =
+			static_cast<const osg::Texture2D&> (attribute);
+	const osg::Image* image = texture.getImage();
+	if (image == NULL || image->getFileName().empty()) {
+		return reject("texture without an image file");
+	}
+	record.image = addString(image->getFileName());
+	record.wrap[0] = texture.getWrap(osg::Texture::WRAP_S);
+	record.wrap[1] = texture.getWrap(osg::Texture::WRAP_T);
+	record.wrap[2] = texture.getWrap(osg::Texture::WRAP_R);
+	record.filter[0] = texture.getFilter(osg::Texture::MIN_FILTER);
+	record.filter[1] = texture.getFilter(osg::Texture::MAG_FILTER);
+	record.maxAnisotropy = texture.getMaxAnisotropy();
+	record.flags |= StateRecord::HAS_TEXTURE;
+	return true;
+} // end addTexture()
+
+Uint32 ModelCache::Writer::addString(const std::string& text) {
+	if (text.empty()) {
+		return 0;
+	}
+	const Uint32 offset = Uint32(strings.size());
+	strings.insert(strings.end(), text.begin(), text.end());
+	strings.push_back('\0');
+	return offset;
+} // end addString()
+
+/*
+ * addData - Appends \p size bytes to the data section, aligned to 16.
+ *
+ * @return The offset of the bytes in the data section.
+ */
+Uint64 ModelCache::Writer::addData(const void* bytes, size_t size) {
+	data.resize((data.size() + 15) & ~size_t(15));
+	const Uint64 offset = data.size();
+	if (size != 0) {
+		const char* begin = static_cast<const char*> (bytes);
+		data.insert(data.end(), begin, begin + size);
+	}
+	return offset;
+} // end addData()
+
+bool ModelCache::Writer::reject(const std::string& why) {
+	reason = why;
+	return false;
+} // end reject()
+
+/*
+ * layOut - Fills in the tables of \p header: where each one goes and how
+ * long the file is.
+ */
+void ModelCache::Writer::layOut(FileHeader& header) {
+	std::memset(&header, 0, sizeof(header));
+	Uint64 position = (sizeof(FileHeader) + 7) & ~Uint64(7);
+	Table* tables[] = { &header.nodes, &header.matrices, &header.geometries,
+			&header.primitives, &header.states, &header.modes,
+			&header.strings, &header.data };
+	const Uint64 counts[] = { nodes.size(), matrices.size() / 16,
+			geometries.size(), primitives.size(), states.size(), modes.size(),
+			strings.size(), data.size() };
+	const Uint64 sizes[] = { sizeof(NodeRecord), 16 * sizeof(double),
+			sizeof(GeometryRecord), sizeof(PrimitiveRecord),
+			sizeof(StateRecord), sizeof(ModeRecord), 1, 1 };
+	for (int t = 0; t < 8; ++t) {
+		const Uint64 alignment = tables[t] == &header.data ? 16 : 8;
+		position = (position + alignment - 1) & ~(alignment - 1);
+		tables[t]->offset = position;
+		tables[t]->count = counts[t];
+		position += counts[t] * sizes[t];
+	}
+	header.fileSize = position;
+} // end layOut()
+
+Uint64 ModelCache::Writer::getFileSize(void) {
+	FileHeader header;
+	layOut(header);
+	return header.fileSize;
+} // end getFileSize()
+
+template<class T>
+bool ModelCache::Writer::writeTable(FILE* file, const std::vector<T>& records,
+		const Table& table, Uint64& position) {
+	static const char zeros[16] = { 0 };
+	if (fwrite(zeros, 1, table.offset - position, file) != table.offset
+			- position) {
+		return false;
+	}
+	const size_t size = records.size() * sizeof(T);
+	position = table.offset + size;
+	return size == 0 || fwrite(&records[0], 1, size, file) == size;
+} // end writeTable()
+
+/*
+ * write - Writes the entry for \p key to \p file.
+ */
+bool ModelCache::Writer::write(FILE* file, Uint64 key) {
+	FileHeader header;
+	layOut(header);
+	std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+	header.version = FORMAT_VERSION;
+	header.byteOrderMark = BYTE_ORDER_MARK;
+	header.key = key;
+
+	Uint64 position = sizeof(header);
+	return fwrite(&header, sizeof(header), 1, file) == 1 && writeTable(file,
+			nodes, header.nodes, position) && writeTable(file, matrices,
+			header.matrices, position) && writeTable(file, geometries,
+			header.geometries, position) && writeTable(file, primitives,
+			header.primitives, position) && writeTable(file, states,
+			header.states, position) && writeTable(file, modes, header.modes,
+			position) && writeTable(file, strings, header.strings, position)
+			&& writeTable(file, data, header.data, position);
+} // end write()
+
+/*****************************************
+ Methods of class ModelCache::Reader:
+ *****************************************/
+
+/*
+ * Reader - Rebuilds a scene graph from a mapped entry.  Every offset and
+ * count is checked against the file before it is used, so a truncated or
+ * corrupt entry is rejected instead of crashing the renderer.
+ */
+class ModelCache::Reader {
+public:
+	Reader(const char* _base, Uint64 _size) :
+		base(_base), size(_size), header(NULL), nodes(NULL), matrices(NULL),
+				geometries(NULL), primitives(NULL), states(NULL), modes(NULL),
+				strings(NULL), data(NULL) {
+	}
+
+	bool read(Uint64 key, osg::ref_ptr<osg::Node>& root);
+
+	const std::string& getReason(void) const {
+		return reason;
+	}
+
+private:
+	template<class T>
+	bool getTable(const Table& table, Uint64 recordSize, const T*& records);
+	bool getString(Uint32 offset, std::string& text);
+	bool getData(Uint64 offset, Uint64 bytes, const char*& pointer);
+	bool buildState(Uint32 index, osg::ref_ptr<osg::StateSet>& stateSet);
+	bool buildGeometry(const GeometryRecord& record,
+			osg::ref_ptr<osg::Geometry>& geometry);
+	bool buildPrimitive(const PrimitiveRecord& record, Uint32 numVertices,
+			osg::ref_ptr<osg::PrimitiveSet>& primitive);
+	bool reject(const std::string& why);
+
+	template<class ARRAY>
+	bool buildArray(Uint64 offset, Uint32 count, osg::ref_ptr<ARRAY>& array);
+
+	const char* const base;
+	const Uint64 size;
+	const FileHeader* header;
+	const NodeRecord* nodes;
+	const double* matrices;
+	const GeometryRecord* geometries;
+	const PrimitiveRecord* primitives;
+	const StateRecord* states;
+	const ModeRecord* modes;
+	const char* strings;
+	const char* data;
+	std::vector<osg::ref_ptr<osg::StateSet> > stateSets;
+	std::map<std::string, osg::ref_ptr<osg::Image> > images;
+	std::string reason;
+};
+
+/*
+ * read - Checks the header and builds the graph.
+ *
+ * @param key The key the entry must have been written for.
+ */
+bool ModelCache::Reader::read(Uint64 key, osg::ref_ptr<osg::Node>& root) {
+	if (size < sizeof(FileHeader)) {
+		return reject("truncated header");
+	}
+	header = reinterpret_cast<const FileHeader*> (base);
+	if (std::memcmp(header->magic, MAGIC, sizeof(MAGIC)) != 0
+			|| header->version != FORMAT_VERSION || header->byteOrderMark
+			!= BYTE_ORDER_MARK) {
+		return reject("not an entry of this format, version and byte order");
+	}
+	if (header->key != key || header->fileSize != size) {
+		return reject("wrong key or size");
+	}
+	if (!getTable(header->nodes, sizeof(NodeRecord), nodes) || !getTable(
+			header->matrices, 16 * sizeof(double), matrices) || !getTable(
+			header->geometries, sizeof(GeometryRecord), geometries)
+			|| !getTable(header->primitives, sizeof(PrimitiveRecord),
+					primitives) || !getTable(header->states,
+			sizeof(StateRecord), states) || !getTable(header->modes,
+			sizeof(ModeRecord), modes) || !getTable(header->strings, 1,
+			strings) || !getTable(header->data, 1, data)) {
+		return reject("table out of bounds");
+	}
+	if (header->nodes.count == 0 || header->strings.count == 0
+			|| strings[header->strings.count - 1] != '\0') {
+		return reject("no nodes or unterminated strings");
+	}
+	stateSets.resize(header->states.count);
+
+	std::vector<osg::ref_ptr<osg::Node> > built(header->nodes.count);
+	for (Uint64 n = 0; n < header->nodes.count; ++n) {
+		const NodeRecord& record = nodes[n];
+		if (n == 0 ? record.parent != NONE : record.parent >= n
+				|| built[record.parent]->asGroup() == NULL) {
+			return reject("node with a bad parent");
+		}
+
+		switch (record.type) {
+		case NodeRecord::GROUP:
+			built[n] = new osg::Group();
+			break;
+		case NodeRecord::MATRIX_TRANSFORM:
+			if (record.matrix >= header->matrices.count) {
+				return reject("transform with a bad matrix");
+			} else {
+				osg::MatrixTransform* transform = new osg::MatrixTransform();
+				transform->setMatrix(osg::Matrix(osg::Matrixd(matrices + 16
+						* record.matrix)));
+				built[n] = transform;
+			}
+			break;
+		case NodeRecord::GEODE:
+			built[n] = new osg::Geode();
+			break;
+		default:
+			return reject("node of unknown type");
+		}
+
+		std::string name;
+		osg::ref_ptr<osg::StateSet> stateSet;
+		if (!getString(record.name, name) || !buildState(record.state,
+				stateSet)) {
+			return false;
+		}
+		built[n]->setName(name);
+		built[n]->setNodeMask(record.nodeMask);
+		built[n]->setStateSet(stateSet.get());
+		if (n != 0) {
+			built[record.parent]->asGroup()->addChild(built[n].get());
+		}
+	}
+
+	for (Uint64 g = 0; g < header->geometries.count; ++g) {
+		const GeometryRecord& record = geometries[g];
+		if (record.geode >= header->nodes.count || nodes[record.geode].type
+				!= NodeRecord::GEODE) {
+			return reject("geometry outside a geode");
+		}
+		osg::ref_ptr<osg::Geometry> geometry;
+		if (!buildGeometry(record, geometry)) {
+			return false;
+		}
+		static_cast<osg::Geode*> (built[record.geode].get())->addDrawable(
+				geometry.get());
+	}
+
+	root = built[0];
+	return true;
+} // end read()
+
+template<class T>
+bool ModelCache::Reader::getTable(const Table& table, Uint64 recordSize,
+		const T*& records) {
+	if (table.offset % 8 != 0 || table.offset > size || table.count > (size
+			- table.offset) / recordSize) {
+		return false;
+	}
+	records = reinterpret_cast<const T*> (base + table.offset);
+	return true;
+} // end getTable()
+
+bool ModelCache::Reader::getString(Uint32 offset, std::string& text) {
+	if (offset >= header->strings.count) {
+		return reject("string out of bounds");
+	}
+	text = strings + offset;
+	return true;
+} // end getString()
+
+bool ModelCache::Reader::getData(Uint64 offset, Uint64 bytes,
+		const char*& pointer) {
+	if (offset % 4 != 0 || offset > header->data.count || bytes
+			> header->data.count - offset) {
+		return reject("data out of bounds");
+	}
+	pointer = data + offset;
+	return true;
+} // end getData()
+
+/*
+ * buildArray - Copies \p count elements from the data section into a new
+ * array of that size.
+ */
+template<class ARRAY>
+bool ModelCache::Reader::buildArray(Uint64 offset, Uint32 count,
+		osg::ref_ptr<ARRAY>& array) {
+	typedef typename ARRAY::ElementDataType Element;
+	const char* source;
+	if (!getData(offset, Uint64(count) * sizeof(Element), source)) {
+		return false;
+	}
+	array = new ARRAY(count);
+	if (count != 0) {
+		std::memcpy(&(*array)[0], source, count * sizeof(Element));
+	}
+	return true;
+} // end buildArray()
+
+bool ModelCache::Reader::buildState(Uint32 index,
+		osg::ref_ptr<osg::StateSet>& stateSet) {
+	if (index == NONE) {
+		stateSet = NULL;
+		return true;
+	}
+	if (index >= header->states.count) {
+		return reject("state out of bounds");
+	}
+	if (stateSets[index].valid()) {
+		stateSet = stateSets[index];
+		return true;
+	}
+
+	const StateRecord& record = states[index];
+	if (record.firstMode > header->modes.count || record.numModes
+			> header->modes.count - record.firstMode) {
+		return reject("modes out of bounds");
+	}
+	stateSet = new osg::StateSet();
+
+	for (Uint32 m = record.firstMode; m < record.firstMode + record.numModes; ++m) {
+		if (modes[m].textureUnit == NONE) {
+			stateSet->setMode(modes[m].mode, modes[m].value);
+		} else {
+			stateSet->setTextureMode(modes[m].textureUnit, modes[m].mode,
+					modes[m].value);
+		}
+	}
+
+	if (record.flags & StateRecord::HAS_MATERIAL) {
+		osg::Material* material = new osg::Material();
+		material->setColorMode(osg::Material::ColorMode(record.colorMode));
+		const osg::Material::Face faces[2] = { osg::Material::FRONT,
+				osg::Material::BACK };
+		for (int f = 0; f < 2; ++f) {
+			material->setAmbient(faces[f], makeColor(record.ambient[f]));
+			material->setDiffuse(faces[f], makeColor(record.diffuse[f]));
+			material->setSpecular(faces[f], makeColor(record.specular[f]));
+			material->setEmission(faces[f], makeColor(record.emission[f]));
+			material->setShininess(faces[f], record.shininess[f]);
+		}
+		stateSet->setAttribute(material, record.overrides[StateRecord::MATERIAL]);
+	}
+	if (record.flags & StateRecord::HAS_BLEND_FUNC) {
+		stateSet->setAttribute(new osg::BlendFunc(record.blend[0],
+				record.blend[1], record.blend[2], record.blend[3]),
+				record.overrides[StateRecord::BLEND_FUNC]);
+	}
+	if (record.flags & StateRecord::HAS_CULL_FACE) {
+		stateSet->setAttribute(new osg::CullFace(osg::CullFace::Mode(
+				record.cullFace)), record.overrides[StateRecord::CULL_FACE]);
+	}
+	if (record.flags & StateRecord::HAS_TEXTURE) {
+		std::string fileName;
+		if (!getString(record.image, fileName)) {
+			return false;
+		}
+		osg::ref_ptr<osg::Image>& image = images[fileName];
+		if (!image.valid()) {
+			image = osgDB::readImageFile(fileName);
+			if (!image.valid()) {
+				return reject("cannot read texture image " + fileName);
+			}
+		}
+		osg::Texture2D* texture = new osg::Texture2D(image.get());
+		texture->setWrap(osg::Texture::WRAP_S, osg::Texture::WrapMode(
+				record.wrap[0]));
+		texture->setWrap(osg::Texture::WRAP_T, osg::Texture::WrapMode(
+				record.wrap[1]));
+		texture->setWrap(osg::Texture::WRAP_R, osg::Texture::WrapMode(
+				record.wrap[2]));
+		texture->setFilter(osg::Texture::MIN_FILTER, osg::Texture::FilterMode(
+				record.filter[0]));
+		texture->setFilter(osg::Texture::MAG_FILTER, osg::Texture::FilterMode(
+				record.filter[1]));
+		texture->setMaxAnisotropy(record.maxAnisotropy);
+		// The texture modes were restored above, so only set the attribute.
+		stateSet->setTextureAttribute(0, texture,
+				record.overrides[StateRecord::TEXTURE]);
+	}
+
+	std::string binName;
+	if (!getString(record.binName, binName)) {
+		return false;
+	}
+	stateSet->setRenderingHint(record.renderingHint);
+	stateSet->setRenderBinDetails(record.binNumber, binName,
+			osg::StateSet::RenderBinMode(record.renderBinMode));
+
+	stateSets[index] = stateSet;
+	return true;
+} // end buildState()
+
+bool ModelCache::Reader::buildGeometry(const GeometryRecord& record,
+		osg::ref_ptr<osg::Geometry>& geometry) {
+	std::string name;
+	osg::ref_ptr<osg::StateSet> stateSet;
+	osg::ref_ptr<osg::Vec3Array> vertices;
+	osg::ref_ptr<osg::Vec3Array> normals;
+	osg::ref_ptr<osg::Vec4Array> colors;
+	osg::ref_ptr<osg::Vec2Array> texCoords;
+	if (!getString(record.name, name) || !buildState(record.state, stateSet)
+			|| !buildArray(record.vertices, record.numVertices, vertices)
+			|| !buildArray(record.normals, record.numNormals, normals)
+			|| !buildArray(record.colors, record.numColors, colors)
+			|| !buildArray(record.texCoords, record.numTexCoords, texCoords)) {
+		return false;
+	}
+	if (!isBindingValid(record.normalBinding, record.numNormals,
+			record.numVertices, record.numPrimitives) || !isBindingValid(
+			record.colorBinding, record.numColors, record.numVertices,
+			record.numPrimitives) || (record.numTexCoords != 0 && record.numTexCoords
+					!= record.numVertices)) {
+		return reject("geometry " + name + " with inconsistent arrays");
+	}
+	if (record.firstPrimitive > header->primitives.count
+			|| record.numPrimitives > header->primitives.count
+					- record.firstPrimitive) {
+		return reject("primitives out of bounds");
+	}
+
+	geometry = new osg::Geometry();
+	geometry->setName(name);
+	geometry->setStateSet(stateSet.get());
+	geometry->setUseDisplayList((record.flags
+			& GeometryRecord::USE_DISPLAY_LIST) != 0);
+	geometry->setUseVertexBufferObjects((record.flags
+			& GeometryRecord::USE_VERTEX_BUFFER_OBJECTS) != 0);
+	geometry->setVertexArray(vertices.get());
+	if (record.numNormals != 0) {
+		geometry->setNormalArray(normals.get());
+		geometry->setNormalBinding(osg::Geometry::AttributeBinding(
+				record.normalBinding));
+	}
+	if (record.numColors != 0) {
+		geometry->setColorArray(colors.get());
+		geometry->setColorBinding(osg::Geometry::AttributeBinding(
+				record.colorBinding));
+	}
+	if (record.numTexCoords != 0) {
+		geometry->setTexCoordArray(0, texCoords.get());
+	}
+
+	for (Uint32 p = record.firstPrimitive; p < record.firstPrimitive
+			+ record.numPrimitives; ++p) {
+		osg::ref_ptr<osg::PrimitiveSet> primitive;
+		if (!buildPrimitive(primitives[p], record.numVertices, primitive)) {
+			return false;
+		}
+		geometry->addPrimitiveSet(primitive.get());
+	}
+	return true;
+} // end buildGeometry()
+
+/*
+ * buildPrimitive - Builds a primitive set, with the smallest index type
+ * that can address \p numVertices vertices.
+ */
+bool ModelCache::Reader::buildPrimitive(const PrimitiveRecord& record,
+		Uint32 numVertices, osg::ref_ptr<osg::PrimitiveSet>& primitive) {
+	if (!record.indexed) {
+		if (record.first > numVertices || record.count > numVertices
+				- record.first) {
+			return reject("primitive out of bounds");
+		}
+		primitive = new osg::DrawArrays(record.mode, record.first,
+				record.count);
+		return true;
+	}
+
+	const char* source;
+	if (!getData(record.indices, Uint64(record.count) * sizeof(Uint32), source)) {
+		return false;
+	}
+	const Uint32* indices = reinterpret_cast<const Uint32*> (source);
+	for (Uint32 i = 0; i < record.count; ++i) {
+		if (indices[i] >= numVertices) {
+			return reject("index out of bounds");
+		}
+	}
+
+	if (numVertices <= 0x10000) {
+		osg::DrawElementsUShort* elements = new osg::DrawElementsUShort(
+				record.mode, record.count);
+		for (Uint32 i = 0; i < record.count; ++i) {
+			(*elements)[i] = GLushort(indices[i]);
+		}
+		primitive = elements;
+	} else {
+		primitive = new osg::DrawElementsUInt(record.mode, record.count,
+				reinterpret_cast<const GLuint*> (indices));
+	}
+	return true;
+} // end buildPrimitive()
+
+bool ModelCache::Reader::reject(const std::string& why) {
+	reason = why;
+	return false;
+} // end reject()
+
+/*****************************************
+ Methods of class ModelCache:
+ *****************************************/
+
+/*
+ * ModelCache - Constructor for ModelCache class.
+ *
+ * @param _directory Where the entries are kept; created if missing.  An
+ *                   empty string disables the cache.
+ * @param _maxBytes  The size limit of all entries together.
+ */
+ModelCache::ModelCache(const std::string& _directory, Uint64 _maxBytes) :
+	directory(!_directory.empty() && makeDirectories(_directory) ? _directory
+			: std::string()), maxBytes(_maxBytes) {
+	if (!_directory.empty() && directory.empty()) {
+		LOG_WARNING("Model cache disabled: cannot create %s: %s",
+				_directory.c_str(), strerror(errno));
+	}
+
+	hitsMetric = Metrics::counter("rocket_model_cache_hits_total",
+			"Model loads served from the model cache");
+	missesMetric = Metrics::counter("rocket_model_cache_misses_total",
+			"Model loads that found no usable cache entry");
+	storesMetric = Metrics::counter("rocket_model_cache_stores_total",
+			"Entries written to the model cache");
+	rejectsMetric = Metrics::counter("rocket_model_cache_rejects_total",
+			"Models the model cache cannot represent");
+	evictionsMetric = Metrics::counter("rocket_model_cache_evictions_total",
+			"Entries deleted to keep the model cache under its limit");
+	bytesMetric = Metrics::gauge("rocket_model_cache_bytes",
+			"Size of the model cache entries at the last check");
+} // end ModelCache()
+
+/*
+ * instance - Returns the cache shared by the application, configured from
+ * the environment.  It is created on first use and never destroyed.
+ */
+ModelCache& ModelCache::instance(void) {
+	static ModelCache* cache = NULL;
+	if (cache == NULL) {
+		std::string path;
+		std::string value;
+		if (SystemPosix::getenv("ROCKET_MODEL_CACHE", path)) {
+			if (path == "off") {
+				path.clear();
+			}
+		} else if (SystemPosix::getenv("XDG_CACHE_HOME", value)
+				&& !value.empty()) {
+			path = value + "/rocket/models";
+		} else if (SystemPosix::getenv("HOME", value) && !value.empty()) {
+			path = value + "/.cache/rocket/models";
+		}
+
+		Uint64 megabytes = 1024;
+		if (SystemPosix::getenv("ROCKET_MODEL_CACHE_MB", value)) {
+			megabytes = std::strtoul(value.c_str(), NULL, 10);
+		}
+		cache = new ModelCache(path, megabytes << 20);
+	}
+	return *cache;
+} // end instance()
+
+bool ModelCache::isEnabled(void) const {
+	return !directory.empty();
+} // end isEnabled()
+
+const std::string& ModelCache::getDirectory(void) const {
+	return directory;
+} // end getDirectory()
+
+Uint64 ModelCache::getMaxBytes(void) const {
+	return maxBytes;
+} // end getMaxBytes()
+
+/*
+ * computeKey - Computes the key of the model file \p path as read with the
+ * reader \p options: a hash of its contents, the options and the format
+ * version.
+ *
+ * @return \c false is returned if the file cannot be read.
+ */
+bool ModelCache::computeKey(const std::string& path,
+		const std::string& options, Uint64& key) {
+	const int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0) {
+		return false;
+	}
+	struct stat status;
+	if (fstat(fd, &status) != 0) {
+		close(fd);
+		return false;
+	}
+
+	key = hashBytes(options.data(), options.size(), FORMAT_VERSION);
+	bool result = true;
+	if (status.st_size > 0) {
+		void* contents = mmap(NULL, status.st_size, PROT_READ, MAP_PRIVATE, fd,
+				0);
+		if (contents == MAP_FAILED) {
+			result = false;
+		} else {
+			madvise(contents, status.st_size, MADV_SEQUENTIAL);
+			key = hashBytes(contents, status.st_size, key);
+			munmap(contents, status.st_size);
+		}
+	}
+	close(fd);
+	return result;
+} // end computeKey()
+
+/*
+ * load - Builds the graph stored under \p key.  A corrupt entry is deleted.
+ *
+ * @return The root node, or NULL on a miss.
+ */
+osg::ref_ptr<osg::Node> ModelCache::load(Uint64 key) {
+	osg::ref_ptr<osg::Node> root;
+	if (!isEnabled()) {
+		return root;
+	}
+
+	const std::string path = getEntryPath(key);
+	const int fd = open(path.c_str(), O_RDONLY);
+	struct stat status;
+	if (fd < 0 || fstat(fd, &status) != 0 || status.st_size == 0) {
+		if (fd >= 0) {
+			close(fd);
+		}
+		missesMetric.add();
+		return root;
+	}
+
+	void* contents = mmap(NULL, status.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (contents == MAP_FAILED) {
+		missesMetric.add();
+		return root;
+	}
+	madvise(contents, status.st_size, MADV_WILLNEED);
+
+	Reader reader(static_cast<const char*> (contents), status.st_size);
+	const bool valid = reader.read(key, root);
+	munmap(contents, status.st_size);
+
+	if (!valid) {
+		LOG_WARNING("Deleting model cache entry %s: %s", path.c_str(),
+				reader.getReason().c_str());
+		unlink(path.c_str());
+		root = NULL;
+		missesMetric.add();
+		return root;
+	}
+
+	// The modification time orders the entries for eviction.
+	utimes(path.c_str(), NULL);
+	hitsMetric.add();
+	return root;
+} // end load()
+
+/*
+ * store - Writes \p node to the cache under \p key, then evicts entries
+ * if the cache grew past its limit.
+ *
+ * @return \c false is returned if the graph cannot be represented, is
+ *         larger than the whole cache may be, or cannot be written.
+ */
+bool ModelCache::store(Uint64 key, const osg::Node& node) {
+	if (!isEnabled()) {
+		return false;
+	}
+
+	Writer writer;
+	if (!writer.addNode(node, NONE)) {
+		LOG_INFO("Not caching %s: %s", node.getName().c_str(),
+				writer.getReason().c_str());
+		rejectsMetric.add();
+		return false;
+	}
+	if (writer.getFileSize() > maxBytes) {
+		LOG_INFO("Not caching %s: larger than the cache limit",
+				node.getName().c_str());
+		return false;
+	}
+
+	const std::string path = getEntryPath(key);
+	std::vector<char> temporary(path.begin(), path.end());
+	const char suffix[] = ".XXXXXX";
+	temporary.insert(temporary.end(), suffix, suffix + sizeof(suffix));
+	const int fd = mkstemp(&temporary[0]);
+	if (fd < 0) {
+		LOG_WARNING("Cannot write model cache entry %s: %s", path.c_str(),
+				strerror(errno));
+		return false;
+	}
+	fchmod(fd, 0644);
+
+	FILE* file = fdopen(fd, "wb");
+	bool written = file != NULL && writer.write(file, key);
+	if (file != NULL) {
+		written = fclose(file) == 0 && written;
+	} else {
+		close(fd);
+	}
+	if (!written || rename(&temporary[0], path.c_str()) != 0) {
+		LOG_WARNING("Cannot write model cache entry %s: %s", path.c_str(),
+				strerror(errno));
+		unlink(&temporary[0]);
+		return false;
+	}
+
+	storesMetric.add();
+	enforceLimit();
+	return true;
+} // end store()
+
+/*
+ * clear - Deletes all entries.
+ */
+void ModelCache::clear(void) {
+	if (!isEnabled()) {
+		return;
+	}
+	Guard<MutexPosix> guard(evictionLock);
+	DIR* entries = opendir(directory.c_str());
+	if (entries == NULL) {
+		return;
+	}
+	for (struct dirent* entry = readdir(entries); entry != NULL; entry
+			= readdir(entries)) {
+		if (endsWith(entry->d_name, ENTRY_SUFFIX)) {
+			unlink((directory + "/" + entry->d_name).c_str());
+		}
+	}
+	closedir(entries);
+	bytesMetric.set(0.0);
+} // end clear()
+
+std::string ModelCache::getEntryPath(Uint64 key) const {
+	char name[32];
+	snprintf(name, sizeof(name), "/%016lx", key);
+	return directory + name + ENTRY_SUFFIX;
+} // end getEntryPath()
+
+/*
+ * enforceLimit - Deletes the least recently used entries until the rest
+ * fit the limit, and the temporary files of writers that died.
+ */
+void ModelCache::enforceLimit(void) {
+	Guard<MutexPosix> guard(evictionLock);
+	DIR* entries = opendir(directory.c_str());
+	if (entries == NULL) {
+		return;
+	}
+
+	std::vector<CacheFile> files;
+	Uint64 total = 0;
+	const time_t now = time(NULL);
+	for (struct dirent* entry = readdir(entries); entry != NULL; entry
+			= readdir(entries)) {
+		const std::string name = entry->d_name;
+		const std::string path = directory + "/" + name;
+		struct stat status;
+		if (name.find(ENTRY_SUFFIX) == std::string::npos || stat(path.c_str(),
+				&status) != 0) {
+			continue;
+		}
+		if (!endsWith(name, ENTRY_SUFFIX)) {
+			if (now - status.st_mtime > STALE_TEMPORARY_SECONDS) {
+				unlink(path.c_str());
+			}
+			continue;
+		}
+		const CacheFile file = { path, status.st_mtime, Uint64(status.st_size) };
+		files.push_back(file);
+		total += file.size;
+	}
+	closedir(entries);
+
+	std::sort(files.begin(), files.end());
+	for (size_t f = 0; f < files.size() && total > maxBytes; ++f) {
+		if (unlink(files[f].path.c_str()) == 0) {
+			LOG_INFO("Evicted model cache entry %s", files[f].path.c_str());
+			total -= files[f].size;
+			evictionsMetric.add();
+		}
+	}
+	bytesMetric.set(double(total));
+} // end enforceLimit()
@@ -0,0 +1,102 @@
+/*
+ * ModelCache.h - Content-addressed on-disk cache of converted models.
+ */
+
+#ifndef MODELCACHE_H_
+#define MODELCACHE_H_
+
+#include <string>
+
+/* Boost includes */
+#include <boost/noncopyable.hpp>
+
+/* osg includes */
+#include <osg/Node>
+#include <osg/ref_ptr>
+
+#include <SYNC/MutexPosix.h>
+#include <UTIL/Metrics.h>
+#include <UTIL/Types.h>
+
+namespace osg {
+class Geode;
+class Geometry;
+class StateSet;
+}
+
+/*
+ * ModelCache - Keeps the scene graphs the OSG readers built from model
+ * files in a compact binary form, so later loads of the same file skip the
+ * reader plugin: the file is mapped and its vertex and index arrays are
+ * copied straight into pre-sized OSG arrays.
+ *
+ * Entries are keyed by a hash of the contents of the source file, the
+ * reader options and the format version, so an edited file or changed
+ * options miss instead of returning stale data, and renamed or copied
+ * files still hit.  Each entry is one file, <key>.rkmc, in the cache
+ * directory; it is written to a temporary file and renamed into place, so
+ * concurrent writers and readers (several processes of a cluster on one
+ * shared directory included) never see a partial entry.  A hit refreshes
+ * the modification time of its entry; when the entries exceed the size
+ * limit, the ones unused for longest are deleted.
+ *
+ * Only graphs of Group, MatrixTransform and Geode nodes with Geometry
+ * drawables are cached, with vertices, normals, colors and one set of
+ * texture coordinates, and state sets made of modes, Material, BlendFunc,
+ * CullFace and one Texture2D whose image is read again by file name.  The
+ * 3DS reader builds nothing else; anything else is loaded from the source
+ * file every time.  Nodes shared by several parents are stored once per
+ * parent; state sets stay shared.
+ *
+ * instance() returns the cache shared by the application.  Its directory
+ * is ROCKET_MODEL_CACHE ("off" disables it), by default
+ * $XDG_CACHE_HOME/rocket/models or ~/.cache/rocket/models, and its limit
+ * ROCKET_MODEL_CACHE_MB megabytes, 1024 by default.  All methods are
+ * thread-safe.
+ */
+class ModelCache: boost::noncopyable {
+public:
+	ModelCache(const std::string& _directory, Uint64 _maxBytes);
+
+	static ModelCache& instance(void);
+
+	bool isEnabled(void) const;
+	const std::string& getDirectory(void) const;
+	Uint64 getMaxBytes(void) const;
+
+	static bool computeKey(const std::string& path,
+			const std::string& options, Uint64& key);
+	osg::ref_ptr<osg::Node> load(Uint64 key);
+	bool store(Uint64 key, const osg::Node& node);
+	void clear(void);
+
+private:
+	struct Table;
+	struct FileHeader;
+	struct NodeRecord;
+	struct GeometryRecord;
+	struct PrimitiveRecord;
+	struct StateRecord;
+	struct ModeRecord;
+	class Reader;
+	class Writer;
+
+	enum {
+		FORMAT_VERSION = 1
+	};
+
+	std::string getEntryPath(Uint64 key) const;
+	void enforceLimit(void);
+
+	const std::string directory; /**< Empty if the cache is disabled */
+	const Uint64 maxBytes;
+	MutexPosix evictionLock; /**< Serializes enforceLimit() */
+	Counter hitsMetric;
+	Counter missesMetric;
+	Counter storesMetric;
+	Counter rejectsMetric; /**< Graphs the format cannot represent */
+	Counter evictionsMetric;
+	Gauge bytesMetric;
+};
+
+#endif /* MODELCACHE_H_ */
@@ -0,0 +1,860 @@
+/*
+ * ModelCatalog.cpp - Methods for the ModelCatalog class.
+ */
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <set>
+#include <sstream>
+
+/* osg includes */
+#include <osg/Geode>
+#include <osg/Geometry>
+#include <osg/Image>
+#include <osg/StateSet>
+#include <osg/Texture>
+
+#include <UTIL/Exception.h>
+#include <UTIL/Logger.h>
+#include <UTIL/Profiler.h>
+#include <UTIL/System.h>
+
+#include "ModelCatalog.h"
+
+const size_t ModelCatalog::NOT_FOUND;
+
+namespace {
+
+/*
+ * MemoryEstimate - Sums up the arrays and images of a graph, each shared
+ * one once.
+ */
+struct MemoryEstimate {
+	std::set<const osg::Referenced*> seen;
+	Uint64 cpuBytes;
+	Uint64 gpuBytes;
+
+	MemoryEstimate(void) :
+		cpuBytes(0), gpuBytes(0) {
+	}
+
+	bool isNew(const osg::Referenced* object) {
+		return object != NULL && seen.insert(object).second;
+	}
+
+	void addBuffer(Uint64 bytes) {
+		cpuBytes += bytes;
+		gpuBytes += bytes;
+	}
+
+	void addArray(const osg::Array* array) {
+		if (isNew(array)) {
+			addBuffer(array->getTotalDataSize());
+		}
+	}
+
+	void addPrimitiveSet(const osg::PrimitiveSet* set) {
+		if (!isNew(set)) {
+			return;
+		}
+		switch (set->getType()) {
+		case osg::PrimitiveSet::DrawElementsUBytePrimitiveType:
+			addBuffer(Uint64(set->getNumIndices()));
+			break;
+		case osg::PrimitiveSet::DrawElementsUShortPrimitiveType:
+			addBuffer(Uint64(set->getNumIndices()) * 2);
+			break;
+		case osg::PrimitiveSet::DrawElementsUIntPrimitiveType:
+			addBuffer(Uint64(set->getNumIndices()) * 4);
+			break;
+		default:
+			// Draw calls without indices have nothing to upload.
+			break;
+		}
+	}
+
+	void addStateSet(const osg::StateSet* stateSet) {
+		if (!isNew(stateSet)) {
+			return;
+		}
+		const osg::StateSet::TextureAttributeList& textures =
+				stateSet->getTextureAttributeList();
+		for (size_t unit = 0; unit < textures.size(); ++unit) {
+			const osg::Texture* texture =
+					dynamic_cast<const osg::Texture*> (stateSet->getTextureAttribute(
+							unit, osg::StateAttribute::TEXTURE));
+			if (!isNew(texture)) {
+				continue;
+			}
+			for (unsigned int i = 0; i < texture->getNumImages(); ++i) {
+				const osg::Image* image = texture->getImage(i);
+				if (!isNew(image)) {
+					continue;
+				}
+				const Uint64 bytes = image->getTotalSizeInBytes();
+				// The image may be dropped once uploaded; the mipmaps that OSG
+				// builds by default add a third on the GPU.
+				if (image->data() != NULL) {
+					cpuBytes += bytes;
+				}
+				gpuBytes += bytes + bytes / 3;
+			}
+		}
+	}
+
+	void addGeometry(const osg::Geometry& geometry) {
+		addStateSet(geometry.getStateSet());
+		addArray(geometry.getVertexArray());
+		addArray(geometry.getNormalArray());
+		addArray(geometry.getColorArray());
+		addArray(geometry.getSecondaryColorArray());
+		addArray(geometry.getFogCoordArray());
+		for (unsigned int i = 0; i < geometry.getNumTexCoordArrays(); ++i) {
+			addArray(geometry.getTexCoordArray(i));
+		}
+		for (unsigned int i = 0; i < geometry.getNumVertexAttribArrays(); ++i) {
+			addArray(geometry.getVertexAttribArray(i));
+		}
+		for (unsigned int i = 0; i < geometry.getNumPrimitiveSets(); ++i) {
+			addPrimitiveSet(geometry.getPrimitiveSet(i));
+		}
+	}
+
+	void addNode(const osg::Node& node) {
+		if (!isNew(&node)) {
+			return;
+		}
+		addStateSet(node.getStateSet());
+		const osg::Geode* geode = dynamic_cast<const osg::Geode*> (&node);
+		if (geode != NULL) {
+			for (unsigned int d = 0; d < geode->getNumDrawables(); ++d) {
+				const osg::Drawable* drawable = geode->getDrawable(d);
+				const osg::Geometry* geometry =
+						dynamic_cast<const osg::Geometry*> (drawable);
+				if (geometry != NULL && isNew(geometry)) {
+					addGeometry(*geometry);
+				}
+			}
+		}
+		const osg::Group* group = node.asGroup();
+		if (group != NULL) {
+			for (unsigned int c = 0; c < group->getNumChildren(); ++c) {
+				addNode(*group->getChild(c));
+			}
+		}
+	}
+};
+
+/*
+ * ManifestEntry - One model line of a manifest.
+ */
+struct ManifestEntry {
+	std::string name;
+	std::string path;
+	std::string options;
+	std::string hints; /**< The prefetch attribute, still comma-separated */
+	int line;
+};
+
+/*
+ * splitFields - Splits a manifest line at white space outside double
+ * quotes, dropping the quotes.
+ *
+ * @return \c false is returned if a quote is not closed.
+ */
+bool splitFields(const std::string& line, std::vector<std::string>& fields) {
+	fields.clear();
+	std::string field;
+	bool inField = false;
+	bool quoted = false;
+	for (size_t i = 0; i < line.size(); ++i) {
+		const char c = line[i];
+		if (c == '"') {
+			quoted = !quoted;
+			inField = true;
+		} else if (!quoted && (c == ' ' || c == '\t' || c == '\r')) {
+			if (inField) {
+				fields.push_back(field);
+				field.clear();
+				inField = false;
+			}
+		} else {
+			field += c;
+			inField = true;
+		}
+	}
+	if (inField) {
+		fields.push_back(field);
+	}
+	return !quoted;
+}
+
+/*
+ * isHotReloadEnabled - Tells whether ROCKET_HOT_RELOAD leaves hot reload
+ * on.
+ */
+bool isHotReloadEnabled(void) {
+	std::string value;
+	return !(SystemPosix::getenv("ROCKET_HOT_RELOAD", value) && value == "off");
+}
+
+/*
+ * readBudget - Returns the megabytes in the environment variable \p name
+ * as bytes, or \p defaultBytes.
+ */
+Uint64 readBudget(const char* name, Uint64 defaultBytes) {
+	std::string value;
+	if (SystemPosix::getenv(name, value)) {
+		char* end;
+		const unsigned long megabytes = std::strtoul(value.c_str(), &end, 10);
+		if (end != value.c_str() && *end == '\0') {
+			return Uint64(megabytes) << 20;
+		}
+		LOG_WARNING("Ignoring %s=%s", name, value.c_str());
+	}
+	return defaultBytes;
+}
+
+}
+
+/*
+ * ModelCatalog - Constructor for ModelCatalog class.
+ *
+ * @param _budget The memory the loaded models may take.
+ * @param _pool   The pool whose workers read the files.
+ * @param _cache  The cache of converted models.
+ */
+ModelCatalog::ModelCatalog(const Budget& _budget, ThreadPool& _pool,
+		ModelCache& _cache) :
+	pool(_pool), cache(_cache), budget(_budget), hotReload(
+			isHotReloadEnabled()), useClock(0), numLoading(0) {
+	statistics.hits = 0;
+	statistics.misses = 0;
+	statistics.loads = 0;
+	statistics.failures = 0;
+	statistics.prefetches = 0;
+	statistics.prefetchHits = 0;
+	statistics.gpuEvictions = 0;
+	statistics.cpuEvictions = 0;
+	statistics.reloads = 0;
+	statistics.keptMeshes = 0;
+	statistics.rebuiltMeshes = 0;
+	statistics.cpuBytes = 0;
+	statistics.gpuBytes = 0;
+
+	hitsMetric = Metrics::counter("rocket_model_catalog_requests_total",
+			"Models acquired from the catalog", "result=\"hit\"");
+	missesMetric = Metrics::counter("rocket_model_catalog_requests_total",
+			"Models acquired from the catalog", "result=\"miss\"");
+	failuresMetric = Metrics::counter("rocket_model_catalog_failures_total",
+			"Catalog models that could not be loaded");
+	prefetchesMetric = Metrics::counter(
+			"rocket_model_catalog_prefetches_total",
+			"Catalog models loaded on a prefetch hint");
+	prefetchHitsMetric = Metrics::counter(
+			"rocket_model_catalog_prefetch_hits_total",
+			"Prefetched catalog models that were acquired");
+	const char* const evictionsHelp =
+			"Catalog models evicted to stay under the memory budget";
+	gpuEvictionsMetric = Metrics::counter(
+			"rocket_model_catalog_evictions_total", evictionsHelp,
+			"memory=\"gpu\"");
+	cpuEvictionsMetric = Metrics::counter(
+			"rocket_model_catalog_evictions_total", evictionsHelp,
+			"memory=\"cpu\"");
+	reloadsMetric = Metrics::counter("rocket_model_catalog_reloads_total",
+			"Catalog models reloaded after their file changed");
+	const char* const meshesHelp = "Meshes of reloaded catalog models";
+	keptMeshesMetric = Metrics::counter(
+			"rocket_model_catalog_reload_meshes_total", meshesHelp,
+			"result=\"kept\"");
+	rebuiltMeshesMetric = Metrics::counter(
+			"rocket_model_catalog_reload_meshes_total", meshesHelp,
+			"result=\"rebuilt\"");
+	const char* const bytesHelp = "Estimated size of the catalog models";
+	cpuBytesMetric = Metrics::gauge("rocket_model_catalog_bytes", bytesHelp,
+			"memory=\"cpu\"");
+	gpuBytesMetric = Metrics::gauge("rocket_model_catalog_bytes", bytesHelp,
+			"memory=\"gpu\"");
+	residentMetric = Metrics::gauge("rocket_model_catalog_loaded_models",
+			"Catalog models in memory");
+	const char* const budgetHelp = "Memory budget of the catalog models";
+	Metrics::gauge("rocket_model_catalog_budget_bytes", budgetHelp,
+			"memory=\"cpu\"").set(double(budget.cpuBytes));
+	Metrics::gauge("rocket_model_catalog_budget_bytes", budgetHelp,
+			"memory=\"gpu\"").set(double(budget.gpuBytes));
+} // end ModelCatalog()
+
+/*
+ * ~ModelCatalog - Destructor for ModelCatalog class.  Waits for the loads
+ * in progress.
+ */
+ModelCatalog::~ModelCatalog(void) {
+	for (size_t i = 0; i < models.size(); ++i) {
+		delete models[i].loader;
+	}
+} // end ~ModelCatalog()
+
+/*
+ * getDefaultBudget - Returns the budget set by ROCKET_MODEL_CPU_MB and
+ * ROCKET_MODEL_GPU_MB.
+ */
+ModelCatalog::Budget ModelCatalog::getDefaultBudget(void) {
+	Budget result;
+	result.cpuBytes = readBudget("ROCKET_MODEL_CPU_MB", Uint64(2048) << 20);
+	result.gpuBytes = readBudget("ROCKET_MODEL_GPU_MB", Uint64(1024) << 20);
+	return result;
+} // end getDefaultBudget()
+
+/*
+ * estimateMemory - Estimates the memory \p node takes: its vertex and index
+ * arrays and texture images in \p cpuBytes, and the buffers and textures
+ * they become once drawn in \p gpuBytes.
+ */
+void ModelCatalog::estimateMemory(const osg::Node& node, Uint64& cpuBytes,
+		Uint64& gpuBytes) {
+	MemoryEstimate estimate;
+	estimate.addNode(node);
+	cpuBytes = estimate.cpuBytes;
+	gpuBytes = estimate.gpuBytes;
+} // end estimateMemory()
+
+/*
+ * loadManifest - Adds the models listed in the manifest \p path.
+ *
+ * @throw Exception is thrown if the manifest cannot be read, is malformed
+ *        or names a model twice; no model is added then.
+ */
+void ModelCatalog::loadManifest(const std::string& path) {
+	std::ifstream file(path.c_str());
+	if (!file) {
+		throw Exception("Cannot open the model manifest " + path, LOCATION);
+	}
+	const size_t slash = path.rfind('/');
+	const std::string directory = slash != std::string::npos ? path.substr(0,
+			slash + 1) : "";
+
+	/* Parse the whole file before adding anything: */
+	std::vector<ManifestEntry> entries;
+	std::set<std::string> newNames;
+	std::string line;
+	std::vector<std::string> fields;
+	for (int number = 1; std::getline(file, line); ++number) {
+		std::ostringstream where;
+		where << path << ":" << number << ": ";
+		const size_t comment = line.find('#');
+		if (!splitFields(line.substr(0, comment), fields)) {
+			throw Exception(where.str() + "unterminated quote", LOCATION);
+		}
+		if (fields.empty()) {
+			continue;
+		}
+		if (fields.size() < 2) {
+			throw Exception(where.str() + "expected a name and a file",
+					LOCATION);
+		}
+
+		ManifestEntry entry;
+		entry.name = fields[0];
+		entry.path = fields[1][0] == '/' ? fields[1] : directory + fields[1];
+		entry.line = number;
+		for (size_t f = 2; f < fields.size(); ++f) {
+			const size_t equals = fields[f].find('=');
+			const std::string key = fields[f].substr(0, equals);
+			const std::string value = equals != std::string::npos
+					? fields[f].substr(equals + 1) : "";
+			if (key == "options") {
+				entry.options = value;
+			} else if (key == "prefetch") {
+				entry.hints = value;
+			} else {
+				throw Exception(where.str() + "unknown attribute " + key,
+						LOCATION);
+			}
+		}
+		if (find(entry.name) != NOT_FOUND || !newNames.insert(entry.name).second) {
+			throw Exception(where.str() + "model " + entry.name
+					+ " is already in the catalog", LOCATION);
+		}
+		entries.push_back(entry);
+	}
+	if (file.bad()) {
+		throw Exception("Cannot read the model manifest " + path, LOCATION);
+	}
+
+	/* Hints may name models further down, so check them once all are known: */
+	for (size_t e = 0; e < entries.size(); ++e) {
+		std::istringstream hints(entries[e].hints);
+		std::string hint;
+		while (std::getline(hints, hint, ',')) {
+			if (!hint.empty() && find(hint) == NOT_FOUND && newNames.count(
+					hint) == 0) {
+				std::ostringstream message;
+				message << path << ":" << entries[e].line
+						<< ": prefetch hint names the unknown model " << hint;
+				throw Exception(message.str(), LOCATION);
+			}
+		}
+	}
+
+	for (size_t e = 0; e < entries.size(); ++e) {
+		add(entries[e].name, entries[e].path, entries[e].options);
+	}
+	for (size_t e = 0; e < entries.size(); ++e) {
+		std::istringstream hints(entries[e].hints);
+		std::string hint;
+		while (std::getline(hints, hint, ',')) {
+			if (!hint.empty()) {
+				addPrefetchHint(find(entries[e].name), find(hint));
+			}
+		}
+	}
+	LOG_INFO("Model catalog: %lu models from %s", Uint64(entries.size()),
+			path.c_str());
+} // end loadManifest()
+
+/*
+ * add - Adds a model, unloaded.
+ *
+ * @param options The options string passed to the reader plugin.
+ * @return The index of the model.
+ * @throw Exception is thrown if the catalog has a model of that name.
+ */
+size_t ModelCatalog::add(const std::string& name, const std::string& path,
+		const std::string& options) {
+	if (find(name) != NOT_FOUND) {
+		throw Exception("Model " + name + " is already in the catalog",
+				LOCATION);
+	}
+	Model model;
+	model.name = name;
+	model.path = path;
+	model.options = options;
+	model.state = UNLOADED;
+	model.loader = NULL;
+	model.cached = false;
+	model.loadStartTime = 0;
+	model.loadFinishTime = 0;
+	model.cpuBytes = 0;
+	model.gpuBytes = 0;
+	model.onGpu = false;
+	model.prefetched = false;
+	model.users = 0;
+	model.lastUse = 0;
+	model.version = 0;
+	model.changeTime = 0;
+	model.reloading = false;
+	models.push_back(model);
+	names[name] = models.size() - 1;
+	return models.size() - 1;
+} // end add()
+
+/*
+ * addPrefetchHint - Makes acquire() of \p model prefetch \p hint.
+ */
+void ModelCatalog::addPrefetchHint(size_t model, size_t hint) {
+	getModel(hint);
+	if (hint != model) {
+		getModel(model).hints.push_back(hint);
+	}
+} // end addPrefetchHint()
+
+/*
+ * find - Returns the index of the model named \p name, or NOT_FOUND.
+ */
+size_t ModelCatalog::find(const std::string& name) const {
+	const std::map<std::string, size_t>::const_iterator i = names.find(name);
+	return i != names.end() ? i->second : NOT_FOUND;
+} // end find()
+
+size_t ModelCatalog::getNumModels(void) const {
+	return models.size();
+} // end getNumModels()
+
+const std::string& ModelCatalog::getName(size_t model) const {
+	return getModel(model).name;
+} // end getName()
+
+const std::string& ModelCatalog::getPath(size_t model) const {
+	return getModel(model).path;
+} // end getPath()
+
+ModelCatalog::State ModelCatalog::getState(size_t model) const {
+	return getModel(model).state;
+} // end getState()
+
+/*
+ * getError - Returns why the last load of \p model failed.
+ */
+const std::string& ModelCatalog::getError(size_t model) const {
+	return getModel(model).error;
+} // end getError()
+
+/*
+ * wasCached - Tells whether the last load of \p model was served by the
+ * model cache.
+ */
+bool ModelCatalog::wasCached(size_t model) const {
+	return getModel(model).cached;
+} // end wasCached()
+
+/*
+ * getLoadStartTime - Returns the monotonic time the last load of \p model
+ * started, or 0 if it was never loaded.
+ */
+Uint64 ModelCatalog::getLoadStartTime(size_t model) const {
+	return getModel(model).loadStartTime;
+} // end getLoadStartTime()
+
+/*
+ * getLoadFinishTime - Returns the monotonic time the last load of \p model
+ * finished, or 0 while it runs.
+ */
+Uint64 ModelCatalog::getLoadFinishTime(size_t model) const {
+	return getModel(model).loadFinishTime;
+} // end getLoadFinishTime()
+
+/*
+ * getVersion - Returns how many times \p model got a node.  A change tells
+ * that the node returned by getNode() was replaced by a reload.
+ */
+Uint64 ModelCatalog::getVersion(size_t model) const {
+	return getModel(model).version;
+} // end getVersion()
+
+/*
+ * acquire - Marks \p model as in use, so it is not evicted until released,
+ * starts loading it if it is not loaded (again, if it failed before) and
+ * queues its prefetch hints.
+ */
+void ModelCatalog::acquire(size_t model) {
+	Model& entry = getModel(model);
+	++entry.users;
+	entry.lastUse = ++useClock;
+	if (entry.state == UNLOADED || entry.state == FAILED) {
+		++statistics.misses;
+		missesMetric.add();
+		startLoad(entry, false);
+	} else {
+		++statistics.hits;
+		hitsMetric.add();
+		if (entry.prefetched) {
+			++statistics.prefetchHits;
+			prefetchHitsMetric.add();
+		}
+	}
+	entry.prefetched = false;
+
+	for (size_t h = 0; h < entry.hints.size(); ++h) {
+		prefetch(entry.hints[h]);
+	}
+} // end acquire()
+
+/*
+ * release - Undoes one acquire() of \p model.  It stays loaded until the
+ * budget needs its memory.
+ */
+void ModelCatalog::release(size_t model) {
+	Model& entry = getModel(model);
+	if (entry.users > 0) {
+		--entry.users;
+	}
+} // end release()
+
+/*
+ * prefetch - Queues a load of \p model.  Queued loads start when no other
+ * load runs, so they never delay an acquired model, and only if the model,
+ * at its last known size, fits in what is left of the CPU budget.
+ */
+void ModelCatalog::prefetch(size_t model) {
+	const Model& entry = getModel(model);
+	if (entry.state == UNLOADED) {
+		prefetchQueue.push_back(model);
+	}
+} // end prefetch()
+
+/*
+ * getNode - Returns the node of \p model, or NULL unless it is LOADED.
+ * The node is then counted as drawn, against the GPU budget.
+ */
+osg::ref_ptr<osg::Node> ModelCatalog::getNode(size_t model) {
+	Model& entry = getModel(model);
+	if (entry.state != LOADED) {
+		return NULL;
+	}
+	if (!entry.onGpu) {
+		entry.onGpu = true;
+		statistics.gpuBytes += entry.gpuBytes;
+		publishUsage();
+	}
+	return entry.node;
+} // end getNode()
+
+/*
+ * update - Collects the finished loads, starts the reloads of changed files
+ * and a queued prefetch if no load runs, and evicts models until the budget
+ * is met.  Called once a frame.
+ */
+void ModelCatalog::update(void) {
+	PROFILE_ZONE("ModelCatalog::update");
+	if (numLoading > 0) {
+		for (size_t i = 0; i < models.size(); ++i) {
+			if (models[i].loader != NULL && models[i].loader->getState()
+					!= ModelLoader::LOADING) {
+				finishLoad(models[i]);
+			}
+		}
+	}
+
+	if (hotReload) {
+		pollChanges();
+	}
+
+	while (numLoading == 0 && !prefetchQueue.empty()) {
+		Model& entry = models[prefetchQueue.front()];
+		prefetchQueue.pop_front();
+		if (entry.state == UNLOADED && statistics.cpuBytes + entry.cpuBytes
+				<= budget.cpuBytes) {
+			++statistics.prefetches;
+			prefetchesMetric.add();
+			entry.lastUse = ++useClock;
+			startLoad(entry, false);
+			entry.prefetched = true;
+		}
+	}
+
+	size_t victim;
+	while (statistics.gpuBytes > budget.gpuBytes && (victim = findVictim(
+			true)) != NOT_FOUND) {
+		evict(models[victim], true);
+	}
+	while (statistics.cpuBytes > budget.cpuBytes && (victim = findVictim(
+			false)) != NOT_FOUND) {
+		evict(models[victim], false);
+	}
+} // end update()
+
+const ModelCatalog::Budget& ModelCatalog::getBudget(void) const {
+	return budget;
+} // end getBudget()
+
+const ModelCatalog::Statistics& ModelCatalog::getStatistics(void) const {
+	return statistics;
+} // end getStatistics()
+
+ModelCatalog::Model& ModelCatalog::getModel(size_t model) {
+	if (model >= models.size()) {
+		throw Exception("No such model in the catalog", LOCATION);
+	}
+	return models[model];
+} // end getModel()
+
+const ModelCatalog::Model& ModelCatalog::getModel(size_t model) const {
+	if (model >= models.size()) {
+		throw Exception("No such model in the catalog", LOCATION);
+	}
+	return models[model];
+} // end getModel()
+
+/*
+ * startLoad - Starts reading the file of \p model, to replace its node if
+ * \p reload is set.
+ */
+void ModelCatalog::startLoad(Model& model, bool reload) {
+	if (hotReload) {
+		watcher.watch(model.path);
+	}
+	model.loader = new ModelLoader(pool, cache);
+	model.loader->setFingerprinting(hotReload);
+	model.loader->load(model.path, model.options);
+	model.reloading = reload;
+	if (!reload) {
+		model.state = LOADING;
+	}
+	model.error.clear();
+	model.loadStartTime = model.loader->getStartTime();
+	model.loadFinishTime = 0;
+	++numLoading;
+} // end startLoad()
+
+/*
+ * finishLoad - Takes the node, or the error, from the finished loader of
+ * \p model.
+ */
+void ModelCatalog::finishLoad(Model& model) {
+	ModelLoader& loader = *model.loader;
+	model.cached = loader.wasCached();
+	model.loadFinishTime = loader.getFinishTime();
+	const double milliseconds = double(model.loadFinishTime
+			- model.loadStartTime) * 1e-6;
+	if (model.reloading) {
+		finishReload(model);
+	} else if (loader.getState() == ModelLoader::LOADED) {
+		model.node = loader.takeNode();
+		model.fingerprints = loader.getFingerprints();
+		estimateMemory(*model.node, model.cpuBytes, model.gpuBytes);
+		model.state = LOADED;
+		++model.version;
+		++statistics.loads;
+		statistics.cpuBytes += model.cpuBytes;
+		LOG_INFO("Loaded model %s in %.1f ms%s%s, about %.1f MB",
+				model.name.c_str(), milliseconds,
+				model.cached ? " from the model cache" : "",
+				model.prefetched ? " (prefetched)" : "",
+				double(model.cpuBytes) / double(1 << 20));
+	} else {
+		model.error = loader.getError();
+		model.state = FAILED;
+		++statistics.failures;
+		failuresMetric.add();
+		LOG_ERROR("Cannot load model %s from %s: %s", model.name.c_str(),
+				model.path.c_str(), model.error.c_str());
+	}
+	delete model.loader;
+	model.loader = NULL;
+	model.reloading = false;
+	--numLoading;
+	publishUsage();
+} // end finishLoad()
+
+/*
+ * finishReload - Replaces the node of \p model by the one read again,
+ * carrying the unchanged meshes over from the previous node; if the reload
+ * failed, the previous node stays.
+ */
+void ModelCatalog::finishReload(Model& model) {
+	ModelLoader& loader = *model.loader;
+	const double milliseconds = double(model.loadFinishTime
+			- model.loadStartTime) * 1e-6;
+	if (loader.getState() != ModelLoader::LOADED) {
+		model.error = loader.getError();
+		++statistics.failures;
+		failuresMetric.add();
+		LOG_ERROR("Cannot reload model %s from %s, keeping the previous "
+			"version: %s", model.name.c_str(), model.path.c_str(),
+				model.error.c_str());
+		return;
+	}
+
+	PROFILE_ZONE("ModelDiff::merge");
+	osg::ref_ptr<osg::Node> node = loader.takeNode();
+	const ModelDiff::Fingerprints& fingerprints = loader.getFingerprints();
+	const size_t kept = ModelDiff::merge(*node, fingerprints, *model.node,
+			model.fingerprints);
+	const size_t rebuilt = fingerprints.size() - std::min(kept,
+			fingerprints.size());
+
+	/* The new node takes the place of the previous one, drawn or not: */
+	statistics.cpuBytes -= model.cpuBytes;
+	if (model.onGpu) {
+		statistics.gpuBytes -= model.gpuBytes;
+	}
+	estimateMemory(*node, model.cpuBytes, model.gpuBytes);
+	statistics.cpuBytes += model.cpuBytes;
+	if (model.onGpu) {
+		statistics.gpuBytes += model.gpuBytes;
+	}
+	model.node = node;
+	model.fingerprints = fingerprints;
+	++model.version;
+
+	++statistics.reloads;
+	statistics.keptMeshes += kept;
+	statistics.rebuiltMeshes += rebuilt;
+	reloadsMetric.add();
+	keptMeshesMetric.add(kept);
+	rebuiltMeshesMetric.add(rebuilt);
+	LOG_INFO("Reloaded model %s in %.1f ms%s: %lu meshes kept, %lu rebuilt",
+			model.name.c_str(), milliseconds,
+			model.cached ? " from the model cache" : "", Uint64(kept),
+			Uint64(rebuilt));
+} // end finishReload()
+
+/*
+ * pollChanges - Notes the models whose files changed, and starts loading
+ * again those whose files were then left alone for RELOAD_DELAY: loaded
+ * models, and failed ones still acquired.
+ */
+void ModelCatalog::pollChanges(void) {
+	std::vector<std::string> changed;
+	watcher.poll(changed);
+	const Uint64 now = SystemPosix::getMonotonicNanoseconds();
+	for (size_t c = 0; c < changed.size(); ++c) {
+		for (size_t i = 0; i < models.size(); ++i) {
+			if (models[i].path == changed[c]) {
+				models[i].changeTime = now;
+			}
+		}
+	}
+
+	for (size_t i = 0; i < models.size(); ++i) {
+		Model& model = models[i];
+		if (model.changeTime == 0 || now - model.changeTime < RELOAD_DELAY
+				|| model.loader != NULL) {
+			continue;
+		}
+		model.changeTime = 0;
+		if (model.state == LOADED) {
+			startLoad(model, true);
+		} else if (model.state == FAILED && model.users > 0) {
+			startLoad(model, false);
+		}
+	}
+} // end pollChanges()
+
+/*
+ * findVictim - Returns the least recently used model that is loaded but
+ * not acquired, and drawn if \p onGpu is set; NOT_FOUND if there is none.
+ */
+size_t ModelCatalog::findVictim(bool onGpu) const {
+	size_t victim = NOT_FOUND;
+	for (size_t i = 0; i < models.size(); ++i) {
+		const Model& model = models[i];
+		if (model.state == LOADED && model.users == 0 && model.loader == NULL
+				&& (model.onGpu
+				|| !onGpu) && (victim == NOT_FOUND || model.lastUse
+				< models[victim].lastUse)) {
+			victim = i;
+		}
+	}
+	return victim;
+} // end findVictim()
+
+/*
+ * evict - Releases the GL objects of \p model and, unless \p keepNode is
+ * set, drops its node.  The render contexts delete the GL objects in their
+ * next frame.
+ */
+void ModelCatalog::evict(Model& model, bool keepNode) {
+	if (model.onGpu) {
+		model.node->releaseGLObjects();
+		model.onGpu = false;
+		statistics.gpuBytes -= model.gpuBytes;
+		++statistics.gpuEvictions;
+		gpuEvictionsMetric.add();
+	}
+	if (!keepNode) {
+		model.node = NULL;
+		model.state = UNLOADED;
+		model.prefetched = false;
+		statistics.cpuBytes -= model.cpuBytes;
+		++statistics.cpuEvictions;
+		cpuEvictionsMetric.add();
+	}
+	LOG_INFO("Evicted model %s from %s memory", model.name.c_str(),
+			keepNode ? "GPU" : "CPU");
+	publishUsage();
+} // end evict()
+
+void ModelCatalog::publishUsage(void) {
+	size_t loaded = 0;
+	for (size_t i = 0; i < models.size(); ++i) {
+		if (models[i].state == LOADED) {
+			++loaded;
+		}
+	}
+	cpuBytesMetric.set(double(statistics.cpuBytes));
+	gpuBytesMetric.set(double(statistics.gpuBytes));
+	residentMetric.set(double(loaded));
+} // end publishUsage()
@@ -0,0 +1,200 @@
+/*
+ * ModelCatalog.h - Named models loaded on demand under a memory budget.
+ */
+
+#ifndef MODELCATALOG_H_
+#define MODELCATALOG_H_
+
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+/* Boost includes */
+#include <boost/noncopyable.hpp>
+
+/* osg includes */
+#include <osg/Node>
+#include <osg/ref_ptr>
+
+#include <SYNC/ThreadPool.h>
+#include <UTIL/FileWatcher.h>
+#include <UTIL/Metrics.h>
+#include <UTIL/Types.h>
+
+#include "ModelCache.h"
+#include "ModelDiff.h"
+#include "ModelLoader.h"
+
+/*
+ * ModelCatalog - The models a session may show, by name, read from a
+ * manifest.  Nothing is loaded until a model is acquired or prefetched; it
+ * is then read by a ModelLoader on the pool, and kept after it is released
+ * so that switching back to it is instant.
+ *
+ * Models are kept at two levels, each with its own budget.  A model that
+ * was handed out by getNode() is counted against the GPU budget, since
+ * whoever drew it compiled its geometry and textures; one that is only in
+ * memory counts against the CPU budget alone.  update() keeps both under
+ * budget by evicting the least recently used models that are not acquired:
+ * first their GL objects are released, and if memory is still short their
+ * nodes are dropped.  A model over budget by itself stays loaded while it
+ * is acquired.
+ *
+ * The files of loaded models are watched (unless ROCKET_HOT_RELOAD is
+ * "off").  When one is rewritten, the model is loaded again on the pool
+ * while the previous version stays in use, and the meshes ModelDiff finds
+ * unchanged are carried over from it, GL objects included.  getVersion()
+ * then changes, and whoever shows the model swaps in the new node.  A
+ * failed reload keeps the previous version.
+ *
+ * The manifest is a text file with one model per line:
+ *
+ *   # name     file                    attributes
+ *   europa     europa.3ds              prefetch=lander,site
+ *   lander     hoppers/lander.3ds      options="noRotation"
+ *
+ * Files are relative to the manifest.  "options" is passed to the reader
+ * plugin, and "prefetch" names the models likely to be shown after this
+ * one; they are loaded in the background when it is acquired, as long as
+ * they fit in the CPU budget.  Fields with spaces are double-quoted.
+ *
+ * The budgets are ROCKET_MODEL_CPU_MB and ROCKET_MODEL_GPU_MB megabytes,
+ * 2048 and 1024 by default.  All methods must be called from one thread,
+ * with no render context traversing the nodes handed out (Hopper::frame()).
+ */
+class ModelCatalog: boost::noncopyable {
+public:
+	enum State {
+		UNLOADED, LOADING, LOADED, FAILED
+	};
+
+	struct Budget {
+		Uint64 cpuBytes;
+		Uint64 gpuBytes;
+	};
+
+	/*
+	 * Statistics - What the catalog did since it was created.
+	 */
+	struct Statistics {
+		Uint64 hits; /**< Acquired models that were loaded or loading */
+		Uint64 misses; /**< Acquired models that had to be loaded */
+		Uint64 loads;
+		Uint64 failures;
+		Uint64 prefetches;
+		Uint64 prefetchHits; /**< Prefetched models acquired later */
+		Uint64 gpuEvictions;
+		Uint64 cpuEvictions;
+		Uint64 reloads;
+		Uint64 keptMeshes; /**< Meshes carried over by reloads */
+		Uint64 rebuiltMeshes; /**< Meshes reloads had to replace */
+		Uint64 cpuBytes; /**< Estimated size of the loaded models */
+		Uint64 gpuBytes; /**< Estimated size of their GL objects */
+	};
+
+	static const size_t NOT_FOUND = ~size_t(0);
+
+	explicit ModelCatalog(const Budget& _budget = getDefaultBudget(),
+			ThreadPool& _pool = ThreadPool::instance(), ModelCache& _cache =
+					ModelCache::instance());
+	~ModelCatalog(void);
+
+	static Budget getDefaultBudget(void);
+	static void estimateMemory(const osg::Node& node, Uint64& cpuBytes,
+			Uint64& gpuBytes);
+
+	void loadManifest(const std::string& path);
+	size_t add(const std::string& name, const std::string& path,
+			const std::string& options = "");
+	void addPrefetchHint(size_t model, size_t hint);
+
+	size_t find(const std::string& name) const;
+	size_t getNumModels(void) const;
+	const std::string& getName(size_t model) const;
+	const std::string& getPath(size_t model) const;
+	State getState(size_t model) const;
+	const std::string& getError(size_t model) const;
+	bool wasCached(size_t model) const;
+	Uint64 getLoadStartTime(size_t model) const;
+	Uint64 getLoadFinishTime(size_t model) const;
+	Uint64 getVersion(size_t model) const;
+
+	void acquire(size_t model);
+	void release(size_t model);
+	void prefetch(size_t model);
+	osg::ref_ptr<osg::Node> getNode(size_t model);
+	void update(void);
+
+	const Budget& getBudget(void) const;
+	const Statistics& getStatistics(void) const;
+
+private:
+	/*
+	 * Model - One entry of the catalog.
+	 */
+	struct Model {
+		std::string name;
+		std::string path;
+		std::string options;
+		std::vector<size_t> hints; /**< Models to prefetch after this one */
+		State state;
+		ModelLoader* loader; /**< Only while LOADING */
+		osg::ref_ptr<osg::Node> node; /**< Only while LOADED */
+		std::string error;
+		bool cached;
+		Uint64 loadStartTime;
+		Uint64 loadFinishTime;
+		Uint64 cpuBytes;
+		Uint64 gpuBytes;
+		bool onGpu; /**< Handed out since its GL objects were released */
+		bool prefetched; /**< Loaded on a hint and not acquired since */
+		int users; /**< acquire() calls not yet released */
+		Uint64 lastUse; /**< Value of useClock when last acquired */
+		ModelDiff::Fingerprints fingerprints; /**< Of the node */
+		Uint64 version; /**< Loads and reloads that produced a node */
+		Uint64 changeTime; /**< When its file last changed, 0 if handled */
+		bool reloading; /**< The loader replaces a LOADED node */
+	};
+
+	enum {
+		RELOAD_DELAY = 250000000 /**< Nanoseconds a file must be left alone */
+	};
+
+	Model& getModel(size_t model);
+	const Model& getModel(size_t model) const;
+	void startLoad(Model& model, bool reload);
+	void finishLoad(Model& model);
+	void finishReload(Model& model);
+	void pollChanges(void);
+	size_t findVictim(bool onGpu) const;
+	void evict(Model& model, bool keepNode);
+	void publishUsage(void);
+
+	ThreadPool& pool;
+	ModelCache& cache;
+	const Budget budget;
+	const bool hotReload;
+	FileWatcher watcher;
+	std::vector<Model> models;
+	std::map<std::string, size_t> names;
+	std::deque<size_t> prefetchQueue; /**< Hints waiting for idle loaders */
+	Uint64 useClock;
+	size_t numLoading;
+	Statistics statistics;
+	Counter hitsMetric;
+	Counter missesMetric;
+	Counter failuresMetric;
+	Counter prefetchesMetric;
+	Counter prefetchHitsMetric;
+	Counter gpuEvictionsMetric;
+	Counter cpuEvictionsMetric;
+	Counter reloadsMetric;
+	Counter keptMeshesMetric;
+	Counter rebuiltMeshesMetric;
+	Gauge cpuBytesMetric;
+	Gauge gpuBytesMetric;
+	Gauge residentMetric;
+};
+
+#endif /* MODELCATALOG_H_ */
@@ -0,0 +1,367 @@
+/*
+ * ModelDiff.cpp - Methods for the ModelDiff class.
+ */
+
+#include <cstdio>
+#include <cstring>
+
+/* osg includes */
+#include <osg/BlendFunc>
+#include <osg/CullFace>
+#include <osg/Geode>
+#include <osg/Geometry>
+#include <osg/Material>
+#include <osg/StateSet>
+#include <osg/Texture2D>
+
+#include "ModelDiff.h"
+
+namespace {
+
+/*
+ * isClass - Tests whether \p object is exactly the osg class \p name; a
+ * subclass may carry more than its fingerprint covers.
+ */
+bool isClass(const osg::Object& object, const char* name) {
+	return std::strcmp(object.libraryName(), "osg") == 0 && std::strcmp(
+			object.className(), name) == 0;
+}
+
+Uint64 hashValue(Uint64 value, Uint64 hash) {
+	return hashBytes(&value, sizeof(value), hash);
+}
+
+Uint64 hashColor(const osg::Vec4& color, Uint64 hash) {
+	const float values[4] = { color[0], color[1], color[2], color[3] };
+	return hashBytes(values, sizeof(values), hash);
+}
+
+Uint64 hashString(const std::string& text, Uint64 hash) {
+	return hashBytes(text.data(), text.size(), hash);
+}
+
+Uint64 hashArray(const osg::Array* array, Uint64 hash) {
+	if (array == NULL) {
+		return hashValue(0, hash);
+	}
+	hash = hashValue(Uint64(array->getType()) + 1, hash);
+	return hashBytes(array->getDataPointer(), array->getTotalDataSize(), hash);
+}
+
+template<class T>
+Uint64 hashVector(const std::vector<T>& values, Uint64 hash) {
+	return values.empty() ? hashValue(0, hash) : hashBytes(&values.front(),
+			values.size() * sizeof(T), hash);
+}
+
+bool hashAttribute(const osg::StateAttribute& attribute, Uint64& hash) {
+	hash = hashString(attribute.className(), hash);
+	if (isClass(attribute, "Material")) {
+		const osg::Material& material =
+				static_cast<const osg::Material&> (attribute);
+		hash = hashValue(material.getColorMode(), hash);
+		const osg::Material::Face faces[2] = { osg::Material::FRONT,
+				osg::Material::BACK };
+		for (int f = 0; f < 2; ++f) {
+			hash = hashColor(material.getAmbient(faces[f]), hash);
+			hash = hashColor(material.getDiffuse(faces[f]), hash);
+			hash = hashColor(material.getSpecular(faces[f]), hash);
+			hash = hashColor(material.getEmission(faces[f]), hash);
+			const float shininess = material.getShininess(faces[f]);
+			hash = hashBytes(&shininess, sizeof(shininess), hash);
+		}
+	} else if (isClass(attribute, "BlendFunc")) {
+		const osg::BlendFunc& blend =
+				static_cast<const osg::BlendFunc&> (attribute);
+		hash = hashValue(blend.getSource(), hash);
+		hash = hashValue(blend.getDestination(), hash);
+		hash = hashValue(blend.getSourceAlpha(), hash);
+		hash = hashValue(blend.getDestinationAlpha(), hash);
+	} else if (isClass(attribute, "CullFace")) {
+		hash = hashValue(
+				static_cast<const osg::CullFace&> (attribute).getMode(), hash);
+	} else if (isClass(attribute, "Texture2D")) {
+		const osg::Texture2D& texture =
+				static_cast<const osg::Texture2D&> (attribute);
+		// The image is known by its file; texture files are not watched.
+		const osg::Image* image = texture.getImage();
+		if (image == NULL || image->getFileName().empty()) {
+			return false;
+		}
+		hash = hashString(image->getFileName(), hash);
+		hash = hashValue(texture.getWrap(osg::Texture::WRAP_S), hash);
+		hash = hashValue(texture.getWrap(osg::Texture::WRAP_T), hash);
+		hash = hashValue(texture.getWrap(osg::Texture::WRAP_R), hash);
+		hash = hashValue(texture.getFilter(osg::Texture::MIN_FILTER), hash);
+		hash = hashValue(texture.getFilter(osg::Texture::MAG_FILTER), hash);
+		const float anisotropy = texture.getMaxAnisotropy();
+		hash = hashBytes(&anisotropy, sizeof(anisotropy), hash);
+	} else {
+		return false;
+	}
+	return true;
+}
+
+bool hashAttributes(const osg::StateSet::AttributeList& attributes,
+		Uint64& hash) {
+	hash = hashValue(attributes.size(), hash);
+	for (osg::StateSet::AttributeList::const_iterator a = attributes.begin(); a
+			!= attributes.end(); ++a) {
+		if (!hashAttribute(*a->second.first, hash)) {
+			return false;
+		}
+		hash = hashValue(a->second.second, hash);
+	}
+	return true;
+}
+
+Uint64 hashModes(const osg::StateSet::ModeList& modes, Uint64 hash) {
+	hash = hashValue(modes.size(), hash);
+	for (osg::StateSet::ModeList::const_iterator m = modes.begin(); m
+			!= modes.end(); ++m) {
+		hash = hashValue(m->first, hash);
+		hash = hashValue(m->second, hash);
+	}
+	return hash;
+}
+
+bool hashStateSet(const osg::StateSet* stateSet, Uint64& hash) {
+	if (stateSet == NULL) {
+		hash = hashValue(0, hash);
+		return true;
+	}
+	if (!stateSet->getUniformList().empty() || stateSet->getUpdateCallback()
+			!= NULL || stateSet->getEventCallback() != NULL) {
+		return false;
+	}
+	hash = hashValue(1, hash);
+	hash = hashValue(stateSet->getRenderingHint(), hash);
+	hash = hashValue(stateSet->getRenderBinMode(), hash);
+	hash = hashValue(stateSet->getBinNumber(), hash);
+	hash = hashString(stateSet->getBinName(), hash);
+	hash = hashModes(stateSet->getModeList(), hash);
+	const osg::StateSet::TextureModeList& textureModes =
+			stateSet->getTextureModeList();
+	hash = hashValue(textureModes.size(), hash);
+	for (size_t unit = 0; unit < textureModes.size(); ++unit) {
+		hash = hashModes(textureModes[unit], hash);
+	}
+	if (!hashAttributes(stateSet->getAttributeList(), hash)) {
+		return false;
+	}
+	const osg::StateSet::TextureAttributeList& textures =
+			stateSet->getTextureAttributeList();
+	hash = hashValue(textures.size(), hash);
+	for (size_t unit = 0; unit < textures.size(); ++unit) {
+		if (!hashAttributes(textures[unit], hash)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool hashPrimitiveSet(const osg::PrimitiveSet& set, Uint64& hash) {
+	hash = hashValue(set.getType(), hash);
+	hash = hashValue(set.getMode(), hash);
+	switch (set.getType()) {
+	case osg::PrimitiveSet::DrawArraysPrimitiveType: {
+		const osg::DrawArrays& arrays =
+				static_cast<const osg::DrawArrays&> (set);
+		hash = hashValue(arrays.getFirst(), hash);
+		hash = hashValue(arrays.getCount(), hash);
+		break;
+	}
+	case osg::PrimitiveSet::DrawArrayLengthsPrimitiveType: {
+		const osg::DrawArrayLengths& lengths =
+				static_cast<const osg::DrawArrayLengths&> (set);
+		hash = hashValue(lengths.getFirst(), hash);
+		hash = hashVector<GLsizei> (lengths, hash);
+		break;
+	}
+	case osg::PrimitiveSet::DrawElementsUBytePrimitiveType:
+		hash = hashVector<GLubyte> (
+				static_cast<const osg::DrawElementsUByte&> (set), hash);
+		break;
+	case osg::PrimitiveSet::DrawElementsUShortPrimitiveType:
+		hash = hashVector<GLushort> (
+				static_cast<const osg::DrawElementsUShort&> (set), hash);
+		break;
+	case osg::PrimitiveSet::DrawElementsUIntPrimitiveType:
+		hash = hashVector<GLuint> (
+				static_cast<const osg::DrawElementsUInt&> (set), hash);
+		break;
+	default:
+		return false;
+	}
+	return true;
+}
+
+bool hashGeometry(const osg::Geometry& geometry, Uint64& hash) {
+	if (geometry.getUpdateCallback() != NULL || geometry.getCullCallback()
+			!= NULL || geometry.getDrawCallback() != NULL
+			|| geometry.getSecondaryColorArray() != NULL
+			|| geometry.getFogCoordArray() != NULL
+			|| geometry.getNumVertexAttribArrays() > 0
+			|| geometry.getVertexIndices() != NULL
+			|| geometry.getNormalIndices() != NULL
+			|| geometry.getColorIndices() != NULL) {
+		return false;
+	}
+	if (!hashStateSet(geometry.getStateSet(), hash)) {
+		return false;
+	}
+	hash = hashArray(geometry.getVertexArray(), hash);
+	hash = hashArray(geometry.getNormalArray(), hash);
+	hash = hashValue(geometry.getNormalBinding(), hash);
+	hash = hashArray(geometry.getColorArray(), hash);
+	hash = hashValue(geometry.getColorBinding(), hash);
+	hash = hashValue(geometry.getNumTexCoordArrays(), hash);
+	for (unsigned int i = 0; i < geometry.getNumTexCoordArrays(); ++i) {
+		if (geometry.getTexCoordIndices(i) != NULL) {
+			return false;
+		}
+		hash = hashArray(geometry.getTexCoordArray(i), hash);
+	}
+	hash = hashValue(geometry.getNumPrimitiveSets(), hash);
+	for (unsigned int i = 0; i < geometry.getNumPrimitiveSets(); ++i) {
+		if (!hashPrimitiveSet(*geometry.getPrimitiveSet(i), hash)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/*
+ * hashGeode - Returns the fingerprint of \p geode, or 0 if it has anything
+ * the fingerprint does not cover.
+ */
+Uint64 hashGeode(const osg::Geode& geode) {
+	if (!isClass(geode, "Geode")) {
+		return 0;
+	}
+	Uint64 hash = hashString(geode.getName(), 0);
+	if (!hashStateSet(geode.getStateSet(), hash)) {
+		return 0;
+	}
+	hash = hashValue(geode.getNumDrawables(), hash);
+	for (unsigned int d = 0; d < geode.getNumDrawables(); ++d) {
+		const osg::Drawable* drawable = geode.getDrawable(d);
+		if (!isClass(*drawable, "Geometry") || !hashGeometry(
+				static_cast<const osg::Geometry&> (*drawable), hash)) {
+			return 0;
+		}
+	}
+	return hash != 0 ? hash : 1;
+}
+
+/*
+ * visitMeshes - Calls \p visitor with each Geode under \p node, its key and
+ * where it hangs: child \p index of \p parent.
+ */
+template<class Visitor>
+void visitMeshes(osg::Node& node, const std::string& key, osg::Group* parent,
+		unsigned int index, Visitor& visitor) {
+	osg::Geode* geode = dynamic_cast<osg::Geode*> (&node);
+	if (geode != NULL) {
+		visitor(*geode, key, parent, index);
+		return;
+	}
+	osg::Group* group = node.asGroup();
+	if (group == NULL) {
+		return;
+	}
+	std::map<std::string, unsigned int> names;
+	for (unsigned int c = 0; c < group->getNumChildren(); ++c) {
+		// The visitor may replace the child.
+		osg::ref_ptr<osg::Node> child = group->getChild(c);
+		std::string childKey = key + "/" + child->getName();
+		const unsigned int same = names[child->getName()]++;
+		if (same > 0) {
+			char number[16];
+			snprintf(number, sizeof(number), "#%u", same);
+			childKey += number;
+		}
+		visitMeshes(*child, childKey, group, c, visitor);
+	}
+}
+
+struct Fingerprinter {
+	ModelDiff::Fingerprints& fingerprints;
+
+	void operator()(osg::Geode& geode, const std::string& key, osg::Group*,
+			unsigned int) {
+		fingerprints[key] = hashGeode(geode);
+	}
+};
+
+struct MeshCollector {
+	std::map<std::string, osg::Geode*> meshes;
+
+	void operator()(osg::Geode& geode, const std::string& key, osg::Group*,
+			unsigned int) {
+		meshes[key] = &geode;
+	}
+};
+
+/*
+ * MeshMerger - Puts the previous Geode in place of each new one with the
+ * same key and fingerprint.
+ */
+struct MeshMerger {
+	const ModelDiff::Fingerprints& fingerprints;
+	const ModelDiff::Fingerprints& previousFingerprints;
+	const std::map<std::string, osg::Geode*>& previousMeshes;
+	size_t kept;
+
+	void operator()(osg::Geode& geode, const std::string& key,
+			osg::Group* parent, unsigned int index) {
+		if (parent == NULL) {
+			return;
+		}
+		const ModelDiff::Fingerprints::const_iterator fingerprint =
+				fingerprints.find(key);
+		const ModelDiff::Fingerprints::const_iterator previousFingerprint =
+				previousFingerprints.find(key);
+		const std::map<std::string, osg::Geode*>::const_iterator previous =
+				previousMeshes.find(key);
+		if (fingerprint == fingerprints.end() || fingerprint->second == 0
+				|| previousFingerprint == previousFingerprints.end()
+				|| previousFingerprint->second != fingerprint->second
+				|| previous == previousMeshes.end() || previous->second
+				== &geode) {
+			return;
+		}
+		parent->setChild(index, previous->second);
+		++kept;
+	}
+};
+
+}
+
+/*
+ * fingerprint - Fills \p fingerprints with the fingerprint of each mesh of
+ * the graph \p root, by key.
+ */
+void ModelDiff::fingerprint(const osg::Node& root, Fingerprints& fingerprints) {
+	fingerprints.clear();
+	Fingerprinter fingerprinter = { fingerprints };
+	// The fingerprinter only reads the graph.
+	visitMeshes(const_cast<osg::Node&> (root), "", NULL, 0, fingerprinter);
+} // end fingerprint()
+
+/*
+ * merge - Replaces each mesh of \p root that has the same key and
+ * fingerprint as a mesh of \p previous by that mesh, which thereby becomes
+ * part of both graphs.  The fingerprints are those of the two graphs.
+ *
+ * @return The number of meshes replaced.
+ */
+size_t ModelDiff::merge(osg::Node& root, const Fingerprints& fingerprints,
+		osg::Node& previous, const Fingerprints& previousFingerprints) {
+	MeshCollector collector;
+	visitMeshes(previous, "", NULL, 0, collector);
+	MeshMerger merger = { fingerprints, previousFingerprints,
+			collector.meshes, 0 };
+	visitMeshes(root, "", NULL, 0, merger);
+	return merger.kept;
+} // end merge()
@@ -0,0 +1,37 @@
+/*
+ * ModelDiff.h - Finds the meshes of a model that changed between two loads.
+ */
+
+#ifndef MODELDIFF_H_
+#define MODELDIFF_H_
+
+#include <map>
+#include <string>
+
+/* osg includes */
+#include <osg/Node>
+
+#include <UTIL/Types.h>
+
+/*
+ * ModelDiff - Fingerprints the meshes (Geodes) of a model, so that when its
+ * file is loaded again the meshes that did not change can be kept, with
+ * the GL objects already made for them, and only the others uploaded.
+ *
+ * A mesh is known by the names on its path from the root, numbered where
+ * siblings share a name.  Its fingerprint covers its geometry arrays,
+ * primitive sets and state; a mesh with anything the fingerprint cannot
+ * cover gets fingerprint 0 and is never kept.  fingerprint() only reads the
+ * graph and may run on a worker; merge() changes both graphs and must run
+ * while neither is traversed.
+ */
+class ModelDiff {
+public:
+	typedef std::map<std::string, Uint64> Fingerprints;
+
+	static void fingerprint(const osg::Node& root, Fingerprints& fingerprints);
+	static size_t merge(osg::Node& root, const Fingerprints& fingerprints,
+			osg::Node& previous, const Fingerprints& previousFingerprints);
+};
+
+#endif /* MODELDIFF_H_ */
@@ -0,0 +1,283 @@
+/*
+ * ModelLoader.cpp - Methods for the ModelLoader class.
+ */
+
+#include <exception>
+
+/* osg includes */
+#include <osgDB/ReadFile>
+#include <osgDB/ReaderWriter>
+
+#include <SYNC/Atomic.h>
+#include <UTIL/Exception.h>
+#include <UTIL/Logger.h>
+#include <UTIL/Profiler.h>
+#include <UTIL/System.h>
+
+#include "ModelLoader.h"
+
+namespace {
+
+/*
+ * useReader3DS - Tells whether \p path is read by Reader3DS rather than by
+ * the reader plugin.
+ */
+bool useReader3DS(const std::string& path) {
+	std::string value;
+	return Reader3DS::canRead(path) && !(SystemPosix::getenv(
+			"ROCKET_3DS_READER", value) && value == "plugin");
+}
+
+}
+
+/*
+ * LoadTask - Runs ModelLoader::run() on a worker.
+ */
+class ModelLoader::LoadTask: public Task {
+public:
+	explicit LoadTask(ModelLoader& _loader) :
+		loader(_loader) {
+	}
+
+	virtual void execute(void) {
+		loader.run();
+	}
+
+private:
+	ModelLoader& loader;
+};
+
+/*
+ * ModelLoader - Constructor for ModelLoader class.
+ *
+ * @param _pool  The pool whose workers read the files.
+ * @param _cache The cache of converted models.
+ */
+ModelLoader::ModelLoader(ThreadPool& _pool, ModelCache& _cache) :
+	group(_pool), reader3DS(_pool), cache(_cache), state(IDLE),
+			fingerprinting(false), cached(false), startTime(0), finishTime(0) {
+	const std::vector<double> bounds = Metrics::exponentialBounds(0.001, 2.0,
+			16);
+	const char* const help = "Time to load a model on a worker";
+	cacheLoadMetric = Metrics::histogram("rocket_model_load_seconds", help,
+			bounds, "source=\"cache\"");
+	fileLoadMetric = Metrics::histogram("rocket_model_load_seconds", help,
+			bounds, "source=\"file\"");
+} // end ModelLoader()
+
+/*
+ * ~ModelLoader - Destructor for ModelLoader class.  Waits for a load in
+ * progress.
+ */
+ModelLoader::~ModelLoader(void) {
+	// The task writes members that are destroyed before the group.
+	try {
+		wait();
+	} catch (const Exception&) {
+	}
+} // end ~ModelLoader()
+
+/*
+ * load - Starts reading \p _path in the background.  A node loaded before
+ * and not taken is dropped.
+ *
+ * @param _options The options string passed to the reader plugin; part of
+ *                 the cache key.
+ * @throw Exception is thrown if a load is still in progress.
+ */
+void ModelLoader::load(const std::string& _path,
+		const std::string& _options) {
+	if (getState() == LOADING) {
+		throw Exception("Cannot load " + _path + " while " + path
+				+ " is loading", LOCATION);
+	}
+	// The previous task may still be returning after it published its state.
+	wait();
+
+	path = _path;
+	options = _options;
+	node = NULL;
+	fingerprints.clear();
+	error.clear();
+	cached = false;
+	startTime = SystemPosix::getMonotonicNanoseconds();
+	finishTime = 0;
+	Atomic::store(&state, Int32(LOADING));
+	group.run(new LoadTask(*this));
+} // end load()
+
+/*
+ * run - Builds the node from the cache, or reads the file and caches it.
+ * Runs on a worker.
+ */
+void ModelLoader::run(void) {
+	PROFILE_ZONE("ModelLoader::run");
+	State result = FAILED;
+	try {
+		osg::ref_ptr<osg::Node> loaded = readFile();
+		if (loaded.valid()) {
+			// Computing the bounds here spares the first frame that culls it.
+			loaded->getBound();
+			if (fingerprinting) {
+				PROFILE_ZONE("ModelDiff::fingerprint");
+				ModelDiff::fingerprint(*loaded, fingerprints);
+			}
+			node = loaded;
+			result = LOADED;
+		} else {
+			error = "no reader could load the file";
+		}
+	} catch (const Exception& e) {
+		error = e.getDescription();
+	} catch (const std::exception& e) {
+		error = e.what();
+	}
+	finishTime = SystemPosix::getMonotonicNanoseconds();
+	(cached ? cacheLoadMetric : fileLoadMetric).observe(double(finishTime
+			- startTime) * 1e-9);
+	Atomic::store(&state, Int32(result));
+} // end run()
+
+/*
+ * readFile - Returns the cached node for the file, or reads it with
+ * Reader3DS or the reader plugin and stores it in the cache.
+ */
+osg::ref_ptr<osg::Node> ModelLoader::readFile(void) {
+	const bool native = useReader3DS(path);
+	// The two readers build different graphs, so they get separate entries.
+	Uint64 key = 0;
+	const bool hasKey = cache.isEnabled() && ModelCache::computeKey(path,
+			native ? options + "\nReader3DS" : options, key);
+	if (hasKey) {
+		PROFILE_ZONE("ModelCache::load");
+		osg::ref_ptr<osg::Node> loaded = cache.load(key);
+		if (loaded.valid()) {
+			cached = true;
+			return loaded;
+		}
+	}
+
+	osg::ref_ptr<osg::Node> loaded;
+	if (native) {
+		{
+			PROFILE_ZONE("Reader3DS::read");
+			loaded = reader3DS.read(path);
+		}
+		std::string value;
+		if (SystemPosix::getenv("ROCKET_3DS_VALIDATE", value)) {
+			validate(*loaded);
+		}
+	} else {
+		osg::ref_ptr<osgDB::ReaderWriter::Options> readerOptions;
+		if (!options.empty()) {
+			readerOptions = new osgDB::ReaderWriter::Options(options);
+		}
+		PROFILE_ZONE("osgDB::readNodeFile");
+		loaded = osgDB::readNodeFile(path, readerOptions.get());
+	}
+	if (loaded.valid() && hasKey) {
+		PROFILE_ZONE("ModelCache::store");
+		if (!cache.store(key, *loaded)) {
+			LOG_INFO("Model %s is read from the file every time", path.c_str());
+		}
+	}
+	return loaded;
+} // end readFile()
+
+/*
+ * validate - Reads the file with the reader plugin as well and logs where
+ * \p loaded differs from it.
+ */
+void ModelLoader::validate(const osg::Node& loaded) const {
+	PROFILE_ZONE("ModelLoader::validate");
+	osg::ref_ptr<osg::Node> reference = osgDB::readNodeFile(path);
+	std::string differences;
+	if (!reference.valid()) {
+		LOG_WARNING("Cannot validate %s: the reader plugin cannot load it",
+				path.c_str());
+	} else if (!Reader3DS::compare(loaded, *reference, differences)) {
+		LOG_WARNING("Reader3DS and the reader plugin differ on %s:\n%s",
+				path.c_str(), differences.c_str());
+	} else {
+		LOG_INFO("Reader3DS and the reader plugin agree on %s", path.c_str());
+	}
+} // end validate()
+
+/*
+ * takeNode - Hands over the loaded node and returns the loader to IDLE.
+ *
+ * @return The node, or NULL unless the state is LOADED.
+ */
+osg::ref_ptr<osg::Node> ModelLoader::takeNode(void) {
+	osg::ref_ptr<osg::Node> result;
+	if (getState() == LOADED) {
+		result = node;
+		node = NULL;
+		Atomic::store(&state, Int32(IDLE));
+	}
+	return result;
+} // end takeNode()
+
+/*
+ * getFingerprints - Returns the fingerprints of the last node loaded, if
+ * fingerprinting was set when it was; valid once the state is LOADED.
+ */
+const ModelDiff::Fingerprints& ModelLoader::getFingerprints(void) const {
+	return fingerprints;
+} // end getFingerprints()
+
+/*
+ * setFingerprinting - Sets whether the next loads compute fingerprints.
+ */
+void ModelLoader::setFingerprinting(bool enabled) {
+	fingerprinting = enabled;
+} // end setFingerprinting()
+
+/*
+ * wait - Waits until the load in progress, if any, has finished.
+ */
+void ModelLoader::wait(void) {
+	group.wait();
+} // end wait()
+
+/*
+ * getState - Returns what the loader is doing.  Once it returns LOADED or
+ * FAILED, the node, the error and the finish time are valid.
+ */
+ModelLoader::State ModelLoader::getState(void) const {
+	return State(Atomic::load(&state));
+} // end getState()
+
+const std::string& ModelLoader::getPath(void) const {
+	return path;
+} // end getPath()
+
+/*
+ * getError - Returns why the last load failed.
+ */
+const std::string& ModelLoader::getError(void) const {
+	return error;
+} // end getError()
+
+/*
+ * wasCached - Tells whether the last node was built from the cache rather
+ * than read from the file.
+ */
+bool ModelLoader::wasCached(void) const {
+	return cached;
+} // end wasCached()
+
+/*
+ * getStartTime - Returns the monotonic time the last load started.
+ */
+Uint64 ModelLoader::getStartTime(void) const {
+	return startTime;
+} // end getStartTime()
+
+/*
+ * getFinishTime - Returns the monotonic time the last load finished, or 0
+ * while it runs.
+ */
+Uint64 ModelLoader::getFinishTime(void) const {
+	return finishTime;
+} // end getFinishTime()
@@ -0,0 +1,112 @@
+/*
+ * ModelLoader.h - Loads model files on the thread pool.
+ */
+
+#ifndef MODELLOADER_H_
+#define MODELLOADER_H_
+
+#include <string>
+
+/* Boost includes */
+#include <boost/noncopyable.hpp>
+
+/* osg includes */
+#include <osg/Node>
+#include <osg/ref_ptr>
+
+#include <SYNC/ThreadPool.h>
+#include <UTIL/Metrics.h>
+#include <UTIL/Types.h>
+
+#include "ModelCache.h"
+#include "ModelDiff.h"
+#include "Reader3DS.h"
+
+/**
+ * @example "Example of loading a model in the background"
+ *
+ * The load runs on a worker while the main thread goes on; the loaded node
+ * is picked up at a frame boundary, where changing the scene is safe:
+ *
+ * \code
+ * loader.load("../data/Rocket/europa.3ds");
+ * ...
+ * void Hopper::frame(void) {
+ *     if (loader.getState() == ModelLoader::LOADED) {
+ *         transform->addChild(loader.takeNode().get());
+ *     }
+ * }
+ * \endcode
+ */
+
+/*
+ * ModelLoader - Reads one model file at a time with the OSG reader plugins
+ * on a ThreadPool worker.  The node is read and its bounds computed off the
+ * main thread; it is not attached to any scene, so whoever takes it decides
+ * when it becomes visible.  Files converted before are built from the
+ * ModelCache instead of the reader plugin, and files read by the plugin are
+ * added to it.
+ *
+ * With fingerprinting set, the loader also computes the ModelDiff
+ * fingerprints of the node on the worker, for reloads to compare against.
+ *
+ * 3DS files are read by Reader3DS, which spreads the work over the pool,
+ * unless ROCKET_3DS_READER is "plugin".  With ROCKET_3DS_VALIDATE set, each
+ * 3DS file is also read by the plugin and differences are logged.
+ *
+ * load(), takeNode() and the destructor must be called from one thread;
+ * getState() may be polled from any thread.
+ */
+class ModelLoader: boost::noncopyable {
+public:
+	enum State {
+		IDLE, /**< Nothing loaded, or the node was taken */
+		LOADING,
+		LOADED,
+		FAILED
+	};
+
+	explicit ModelLoader(ThreadPool& _pool = ThreadPool::instance(),
+			ModelCache& _cache = ModelCache::instance());
+	~ModelLoader(void);
+
+	void load(const std::string& _path, const std::string& _options = "");
+	osg::ref_ptr<osg::Node> takeNode(void);
+	const ModelDiff::Fingerprints& getFingerprints(void) const;
+	void setFingerprinting(bool enabled);
+	void wait(void);
+
+	State getState(void) const;
+	const std::string& getPath(void) const;
+	const std::string& getError(void) const;
+	bool wasCached(void) const;
+	Uint64 getStartTime(void) const;
+	Uint64 getFinishTime(void) const;
+
+private:
+	class LoadTask;
+
+	void run(void);
+
+	osg::ref_ptr<osg::Node> readFile(void);
+	void validate(const osg::Node& loaded) const;
+
+	TaskGroup group;
+	Reader3DS reader3DS;
+	ModelCache& cache;
+	volatile Int32 state;
+	std::string path;
+	std::string options; /**< Reader plugin options */
+	bool fingerprinting;
+	/* Written by the worker before it publishes LOADED or FAILED: */
+	osg::ref_ptr<osg::Node> node;
+	ModelDiff::Fingerprints fingerprints;
+	std::string error;
+	bool cached; /**< The node was built from the cache */
+	Uint64 startTime;
+	Uint64 finishTime;
+	Histogram cacheLoadMetric;
+	Histogram fileLoadMetric;
+};
+
+#endif /* MODELLOADER_H_ */
@@ -0,0 +1,1324 @@
+/*
+ * Reader3DS.cpp - Methods for the Reader3DS class.
+ */
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <sstream>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* osg includes */
+#include <osg/Geode>
+#include <osg/Geometry>
+#include <osg/Material>
+#include <osg/MatrixTransform>
+#include <osg/StateSet>
+#include <osg/Texture2D>
+#include <osgDB/ReadFile>
+
+#include <UTIL/Exception.h>
+#include <UTIL/Profiler.h>
+
+#include "Reader3DS.h"
+
+namespace {
+
+const Uint32 NONE = 0xffffffffU;
+
+/* The chunks the reader decodes; all others are skipped. */
+enum ChunkId {
+	COLOR_F = 0x0010,
+	COLOR_24 = 0x0011,
+	LIN_COLOR_24 = 0x0012,
+	LIN_COLOR_F = 0x0013,
+	INT_PERCENTAGE = 0x0030,
+	FLOAT_PERCENTAGE = 0x0031,
+	MAIN = 0x4d4d,
+	EDITOR = 0x3d3d,
+	NAMED_OBJECT = 0x4000,
+	TRIANGLE_OBJECT = 0x4100,
+	POINT_ARRAY = 0x4110,
+	FACE_ARRAY = 0x4120,
+	MESH_MATERIAL_GROUP = 0x4130,
+	TEXTURE_VERTICES = 0x4140,
+	SMOOTH_GROUP = 0x4150,
+	MESH_MATRIX = 0x4160,
+	MATERIAL = 0xafff,
+	MATERIAL_NAME = 0xa000,
+	MATERIAL_AMBIENT = 0xa010,
+	MATERIAL_DIFFUSE = 0xa020,
+	MATERIAL_SPECULAR = 0xa030,
+	MATERIAL_SHININESS = 0xa040,
+	MATERIAL_SHININESS_STRENGTH = 0xa041,
+	MATERIAL_TRANSPARENCY = 0xa050,
+	MATERIAL_TWO_SIDED = 0xa081,
+	MATERIAL_TEXTURE_MAP = 0xa200,
+	MATERIAL_MAP_NAME = 0xa300,
+	KEYFRAMER = 0xb000,
+	FIRST_NODE_TAG = 0xb001,
+	OBJECT_NODE_TAG = 0xb002,
+	LAST_NODE_TAG = 0xb007,
+	NODE_HEADER = 0xb010,
+	INSTANCE_NAME = 0xb011,
+	PIVOT = 0xb013,
+	POSITION_TRACK = 0xb020,
+	ROTATION_TRACK = 0xb021,
+	SCALE_TRACK = 0xb022,
+	NODE_ID = 0xb030
+};
+
+/* 3DS files are little-endian whatever the host. */
+inline Uint16 getUint16(const unsigned char* bytes) {
+	return Uint16(bytes[0] | bytes[1] << 8);
+}
+
+inline Uint32 getUint32(const unsigned char* bytes) {
+	return Uint32(bytes[0]) | Uint32(bytes[1]) << 8 | Uint32(bytes[2]) << 16
+			| Uint32(bytes[3]) << 24;
+}
+
+inline float getFloat(const unsigned char* bytes) {
+	const Uint32 bits = getUint32(bytes);
+	float value;
+	std::memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+inline osg::Vec3 getVec3(const unsigned char* bytes) {
+	return osg::Vec3(getFloat(bytes), getFloat(bytes + 4), getFloat(bytes + 8));
+}
+
+/*
+ * Chunk - A chunk of the mapped file: its id and the bytes after its
+ * header, fields and sub-chunks.
+ */
+struct Chunk {
+	Uint16 id;
+	const unsigned char* begin;
+	const unsigned char* end;
+
+	size_t getSize(void) const {
+		return end - begin;
+	}
+};
+
+/*
+ * ChunkCursor - Reads the fields of a chunk, then its sub-chunks.  Every
+ * read is checked against the end of the chunk.
+ */
+class ChunkCursor {
+public:
+	explicit ChunkCursor(const Chunk& chunk) :
+		position(chunk.begin), end(chunk.end) {
+	}
+
+	const unsigned char* readBytes(size_t size) {
+		if (size > size_t(end - position)) {
+			throw Exception("Corrupt 3DS file: field past the end of its chunk",
+					LOCATION);
+		}
+		const unsigned char* bytes = position;
+		position += size;
+		return bytes;
+	}
+
+	Uint16 readUint16(void) {
+		return getUint16(readBytes(2));
+	}
+
+	Uint32 readUint32(void) {
+		return getUint32(readBytes(4));
+	}
+
+	float readFloat(void) {
+		return getFloat(readBytes(4));
+	}
+
+	std::string readString(void) {
+		const unsigned char* terminator = static_cast<const unsigned char*> (
+				std::memchr(position, '\0', end - position));
+		if (terminator == NULL) {
+			throw Exception("Corrupt 3DS file: unterminated string", LOCATION);
+		}
+		const std::string text(reinterpret_cast<const char*> (position),
+				terminator - position);
+		position = terminator + 1;
+		return text;
+	}
+
+	/*
+	 * nextChunk - Steps to the next sub-chunk.  A few stray bytes at the end
+	 * of a chunk, as some exporters write, are ignored.
+	 *
+	 * @return \c false is returned after the last sub-chunk.
+	 */
+	bool nextChunk(Chunk& chunk) {
+		if (end - position < 6) {
+			position = end;
+			return false;
+		}
+		const Uint32 length = getUint32(position + 2);
+		if (length < 6 || length > size_t(end - position)) {
+			throw Exception("Corrupt 3DS file: chunk larger than its parent",
+					LOCATION);
+		}
+		chunk.id = getUint16(position);
+		chunk.begin = position + 6;
+		chunk.end = position + length;
+		position = chunk.end;
+		return true;
+	}
+
+private:
+	const unsigned char* position;
+	const unsigned char* const end;
+};
+
+/*
+ * MappedFile - A file mapped read-only for the lifetime of the object.
+ */
+class MappedFile: boost::noncopyable {
+public:
+	explicit MappedFile(const std::string& path) :
+		contents(NULL), size(0) {
+		const int fd = open(path.c_str(), O_RDONLY);
+		struct stat status;
+		if (fd < 0 || fstat(fd, &status) != 0) {
+			if (fd >= 0) {
+				close(fd);
+			}
+			throw Exception("Cannot open " + path, LOCATION);
+		}
+		size = status.st_size;
+		if (size > 0) {
+			void* mapping = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (mapping == MAP_FAILED) {
+				close(fd);
+				throw Exception("Cannot map " + path, LOCATION);
+			}
+			// The workers read all of it, in no particular order.
+			madvise(mapping, size, MADV_WILLNEED);
+			contents = static_cast<const unsigned char*> (mapping);
+		}
+		close(fd);
+	}
+
+	~MappedFile(void) {
+		if (contents != NULL) {
+			munmap(const_cast<unsigned char*> (contents), size);
+		}
+	}
+
+	Chunk getChunk(void) const {
+		const Chunk chunk = { 0, contents, contents + size };
+		return chunk;
+	}
+
+private:
+	const unsigned char* contents;
+	size_t size;
+};
+
+struct MaterialJob {
+	Chunk chunk;
+	/* Results: */
+	std::string name;
+	osg::ref_ptr<osg::StateSet> stateSet;
+};
+
+struct MeshJob {
+	std::string name;
+	Chunk chunk; /**< The TRIANGLE_OBJECT chunk */
+	/* Results: */
+	osg::Matrix matrix; /**< Of the mesh; the vertices are relative to it */
+	osg::ref_ptr<osg::Geode> geode;
+};
+
+/*
+ * KeyframeNode - An object node of the keyframer, at frame 0.
+ */
+struct KeyframeNode {
+	Uint32 id;
+	Uint32 parent; /**< Id of the parent, or NONE */
+	std::string name; /**< Of the mesh; "$$$DUMMY" for none */
+	std::string instanceName;
+	osg::Vec3 pivot;
+	osg::Vec3 position;
+	float angle;
+	osg::Vec3 axis;
+	osg::Vec3 scale;
+};
+
+/*
+ * Model - The chunks of a file, found by a walk of the chunk tree, and what
+ * the jobs decoded from them.
+ */
+struct Model {
+	Model(void) :
+		hasKeyframer(false) {
+	}
+
+	std::string directory; /**< Of the file, for texture images */
+	std::vector<MaterialJob> materials;
+	std::vector<MeshJob> meshes;
+	bool hasKeyframer;
+	Chunk keyframer;
+	std::vector<KeyframeNode> nodes;
+};
+
+/*
+ * readColor - Reads the color sub-chunk of a material color, preferring
+ * the linear color if both are present, as lib3ds does.
+ */
+osg::Vec3 readColor(const Chunk& chunk, const osg::Vec3& defaultColor) {
+	osg::Vec3 color = defaultColor;
+	bool linear = false;
+	ChunkCursor cursor(chunk);
+	Chunk sub;
+	while (cursor.nextChunk(sub)) {
+		ChunkCursor fields(sub);
+		const bool isLinear = sub.id == LIN_COLOR_F || sub.id == LIN_COLOR_24;
+		if (linear && !isLinear) {
+			continue;
+		}
+		if (sub.id == COLOR_F || sub.id == LIN_COLOR_F) {
+			color = getVec3(fields.readBytes(12));
+			linear = isLinear;
+		} else if (sub.id == COLOR_24 || sub.id == LIN_COLOR_24) {
+			const unsigned char* bytes = fields.readBytes(3);
+			color.set(bytes[0] / 255.0f, bytes[1] / 255.0f, bytes[2] / 255.0f);
+			linear = isLinear;
+		}
+	}
+	return color;
+}
+
+/*
+ * readPercentage - Reads the percentage sub-chunk of a material property
+ * as a fraction.
+ */
+float readPercentage(const Chunk& chunk, float defaultValue) {
+	float value = defaultValue;
+	ChunkCursor cursor(chunk);
+	Chunk sub;
+	while (cursor.nextChunk(sub)) {
+		ChunkCursor fields(sub);
+		if (sub.id == INT_PERCENTAGE) {
+			value = Int16(fields.readUint16()) / 100.0f;
+		} else if (sub.id == FLOAT_PERCENTAGE) {
+			value = fields.readFloat();
+		}
+	}
+	return value;
+}
+
+/*
+ * decodeMaterial - Builds the state set of a material as the plugin does.
+ */
+void decodeMaterial(MaterialJob& material, const std::string& directory) {
+	PROFILE_ZONE("Reader3DS::decodeMaterial");
+	// The defaults of lib3ds, which the plugin uses:
+	osg::Vec3 ambient(0.588235f, 0.588235f, 0.588235f);
+	osg::Vec3 diffuse(0.588235f, 0.588235f, 0.588235f);
+	osg::Vec3 specular(0.898039f, 0.898039f, 0.898039f);
+	float shininess = 0.1f;
+	float shininessStrength = 0.0f;
+	float transparency = 0.0f;
+	bool twoSided = false;
+	std::string textureName;
+
+	ChunkCursor cursor(material.chunk);
+	Chunk chunk;
+	while (cursor.nextChunk(chunk)) {
+		switch (chunk.id) {
+		case MATERIAL_NAME:
+			material.name = ChunkCursor(chunk).readString();
+			break;
+		case MATERIAL_AMBIENT:
+			ambient = readColor(chunk, ambient);
+			break;
+		case MATERIAL_DIFFUSE:
+			diffuse = readColor(chunk, diffuse);
+			break;
+		case MATERIAL_SPECULAR:
+			specular = readColor(chunk, specular);
+			break;
+		case MATERIAL_SHININESS:
+			shininess = readPercentage(chunk, shininess);
+			break;
+		case MATERIAL_SHININESS_STRENGTH:
+			shininessStrength = readPercentage(chunk, shininessStrength);
+			break;
+		case MATERIAL_TRANSPARENCY:
+			transparency = readPercentage(chunk, transparency);
+			break;
+		case MATERIAL_TWO_SIDED:
+			twoSided = true;
+			break;
+		case MATERIAL_TEXTURE_MAP: {
+			ChunkCursor map(chunk);
+			Chunk sub;
+			while (map.nextChunk(sub)) {
+				if (sub.id == MATERIAL_MAP_NAME) {
+					textureName = ChunkCursor(sub).readString();
+				}
+			}
+			break;
+		}
+		}
+	}
+
+	const float alpha = 1.0f - transparency;
+	const osg::Vec3 shine = specular * shininessStrength;
+	osg::Material* attribute = new osg::Material();
+	attribute->setName(material.name);
+	attribute->setAmbient(osg::Material::FRONT_AND_BACK, osg::Vec4(ambient,
+			alpha));
+	attribute->setDiffuse(osg::Material::FRONT_AND_BACK, osg::Vec4(diffuse,
+			alpha));
+	attribute->setSpecular(osg::Material::FRONT_AND_BACK,
+			osg::Vec4(shine, alpha));
+	attribute->setShininess(osg::Material::FRONT_AND_BACK, shininess * 128.0f);
+
+	material.stateSet = new osg::StateSet();
+	material.stateSet->setAttribute(attribute);
+	if (twoSided) {
+		material.stateSet->setMode(GL_CULL_FACE, osg::StateAttribute::OFF);
+	}
+
+	bool textureTransparency = false;
+	if (!textureName.empty()) {
+		osg::ref_ptr<osg::Image> image = osgDB::readImageFile(directory
+				+ textureName);
+		if (!image.valid()) {
+			image = osgDB::readImageFile(textureName);
+		}
+		if (image.valid()) {
+			osg::Texture2D* texture = new osg::Texture2D(image.get());
+			texture->setWrap(osg::Texture::WRAP_S, osg::Texture::REPEAT);
+			texture->setWrap(osg::Texture::WRAP_T, osg::Texture::REPEAT);
+			texture->setWrap(osg::Texture::WRAP_R, osg::Texture::REPEAT);
+			material.stateSet->setTextureAttributeAndModes(0, texture,
+					osg::StateAttribute::ON);
+			textureTransparency = image->isImageTranslucent();
+		}
+	}
+	if (transparency > 0.0f || textureTransparency) {
+		material.stateSet->setMode(GL_BLEND, osg::StateAttribute::ON);
+		material.stateSet->setRenderingHint(osg::StateSet::TRANSPARENT_BIN);
+	}
+} // end decodeMaterial()
+
+/*
+ * MaterialGroup - The faces of a mesh that use one material.
+ */
+struct MaterialGroup {
+	std::string name; /**< Empty for the faces without a material */
+	const unsigned char* faces; /**< Uint16 face indices */
+	Uint32 numFaces;
+};
+
+/*
+ * MeshBuilder - Decodes the chunks of one mesh and builds a Geometry per
+ * material.  The vertices of a Geometry are the points its faces use, split
+ * where the smoothing groups of the faces around a point differ.  Everything
+ * but the results is reused from one Geometry to the next.
+ */
+class MeshBuilder: boost::noncopyable {
+public:
+	MeshBuilder(void) :
+		points(NULL), numPoints(0), texCoords(NULL), faces(NULL), numFaces(0),
+				smoothing(NULL) {
+	}
+
+	void build(MeshJob& mesh, bool relative);
+
+private:
+	void readChunks(const Chunk& object, osg::Matrix& matrix);
+	void prepare(const osg::Matrix& transform);
+	osg::Geometry* buildGeometry(const std::vector<Uint32>& groupFaces,
+			size_t first, size_t last);
+
+	Uint32 getSmoothing(Uint32 face) const {
+		return smoothing != NULL ? getUint32(smoothing + 4 * face) : 0;
+	}
+
+	/* Chunk data, in the mapped file: */
+	const unsigned char* points;
+	Uint32 numPoints;
+	const unsigned char* texCoords; /**< NULL unless one per point */
+	const unsigned char* faces;
+	Uint32 numFaces;
+	const unsigned char* smoothing; /**< Uint32 per face, or NULL */
+	std::vector<MaterialGroup> groups;
+
+	/* Decoded mesh: */
+	std::vector<osg::Vec3> positions;
+	std::vector<Uint32> corners; /**< Three points per face */
+	std::vector<osg::Vec3> faceNormals; /**< Not normalized */
+	std::vector<Uint32> adjacencyStart; /**< Per point, into adjacency */
+	std::vector<Uint32> adjacency; /**< Faces around each point */
+
+	/* Per Geometry: */
+	std::vector<Uint32> vertexPoints;
+	std::vector<Uint32> vertexFaces; /**< A face whose corner it is */
+	std::vector<Uint32> vertexNext; /**< Next vertex of the same point */
+	std::vector<Uint32> pointVertex; /**< First vertex of each point */
+	std::vector<Uint32> indices;
+};
+
+/*
+ * build - Builds the Geode of \p mesh.
+ *
+ * @param relative Whether to transform the vertices into the frame of the
+ *                 mesh matrix, for the keyframer nodes to place them.
+ */
+void MeshBuilder::build(MeshJob& mesh, bool relative) {
+	PROFILE_ZONE("Reader3DS::buildMesh");
+	readChunks(mesh.chunk, mesh.matrix);
+
+	osg::Matrix transform;
+	if (!relative || !transform.invert(mesh.matrix)) {
+		// A singular mesh matrix places the vertices where they are.
+		transform.makeIdentity();
+		mesh.matrix.makeIdentity();
+	}
+	prepare(transform);
+
+	// Sort the faces by material group; a face in no group, or listed in
+	// a group out of range, goes into the last one.
+	MaterialGroup noMaterial = { std::string(), NULL, 0 };
+	groups.push_back(noMaterial);
+	const Uint32 numGroups = Uint32(groups.size());
+	std::vector<Uint32> faceGroups(numFaces, NONE);
+	for (Uint32 g = 0; g + 1 < numGroups; ++g) {
+		for (Uint32 i = 0; i < groups[g].numFaces; ++i) {
+			const Uint32 face = getUint16(groups[g].faces + 2 * i);
+			if (face < numFaces && faceGroups[face] == NONE) {
+				faceGroups[face] = g;
+			}
+		}
+	}
+	std::vector<Uint32> groupStart(numGroups + 1, 0);
+	for (Uint32 f = 0; f < numFaces; ++f) {
+		if (faceGroups[f] == NONE) {
+			faceGroups[f] = numGroups - 1;
+		}
+		++groupStart[faceGroups[f] + 1];
+	}
+	for (Uint32 g = 0; g < numGroups; ++g) {
+		groupStart[g + 1] += groupStart[g];
+	}
+	std::vector<Uint32> groupFaces(numFaces);
+	std::vector<Uint32> fill(groupStart.begin(), groupStart.end() - 1);
+	for (Uint32 f = 0; f < numFaces; ++f) {
+		groupFaces[fill[faceGroups[f]]++] = f;
+	}
+
+	mesh.geode = new osg::Geode();
+	mesh.geode->setName(mesh.name);
+	pointVertex.assign(numPoints, NONE);
+	for (Uint32 g = 0; g < numGroups; ++g) {
+		if (groupStart[g] != groupStart[g + 1]) {
+			osg::Geometry* geometry = buildGeometry(groupFaces, groupStart[g],
+					groupStart[g + 1]);
+			// The name binds the material when the model is put together.
+			geometry->setName(groups[g].name);
+			mesh.geode->addDrawable(geometry);
+		}
+	}
+} // end build()
+
+/*
+ * readChunks - Finds the data of the mesh in its chunks, without copying.
+ */
+void MeshBuilder::readChunks(const Chunk& object, osg::Matrix& matrix) {
+	Uint32 numTexCoords = 0;
+	matrix.makeIdentity();
+
+	ChunkCursor cursor(object);
+	Chunk chunk;
+	while (cursor.nextChunk(chunk)) {
+		ChunkCursor fields(chunk);
+		switch (chunk.id) {
+		case POINT_ARRAY:
+			numPoints = fields.readUint16();
+			points = fields.readBytes(12 * numPoints);
+			break;
+		case TEXTURE_VERTICES:
+			numTexCoords = fields.readUint16();
+			texCoords = fields.readBytes(8 * numTexCoords);
+			break;
+		case MESH_MATRIX: {
+			float m[12];
+			for (int i = 0; i < 12; ++i) {
+				m[i] = fields.readFloat();
+			}
+			matrix.set(m[0], m[1], m[2], 0.0f, m[3], m[4], m[5], 0.0f, m[6],
+					m[7], m[8], 0.0f, m[9], m[10], m[11], 1.0f);
+			break;
+		}
+		case FACE_ARRAY: {
+			// The material and smoothing groups index this array, so those
+			// of an earlier one go with it.
+			numFaces = fields.readUint16();
+			faces = fields.readBytes(8 * numFaces);
+			smoothing = NULL;
+			groups.clear();
+			Chunk sub;
+			while (fields.nextChunk(sub)) {
+				ChunkCursor subFields(sub);
+				if (sub.id == MESH_MATERIAL_GROUP) {
+					MaterialGroup group;
+					group.name = subFields.readString();
+					group.numFaces = subFields.readUint16();
+					group.faces = subFields.readBytes(2 * group.numFaces);
+					groups.push_back(group);
+				} else if (sub.id == SMOOTH_GROUP) {
+					smoothing = subFields.readBytes(4 * numFaces);
+				}
+			}
+			break;
+		}
+		}
+	}
+	if (numTexCoords < numPoints) {
+		texCoords = NULL;
+	}
+} // end readChunks()
+
+/*
+ * prepare - Decodes the points and faces, and finds the faces around each
+ * point if the smoothing groups need them.
+ */
+void MeshBuilder::prepare(const osg::Matrix& transform) {
+	positions.resize(numPoints);
+	const bool identity = transform.isIdentity();
+	for (Uint32 p = 0; p < numPoints; ++p) {
+		positions[p] = getVec3(points + 12 * p);
+		if (!identity) {
+			positions[p] = positions[p] * transform;
+		}
+	}
+
+	corners.resize(3 * numFaces);
+	faceNormals.resize(numFaces);
+	for (Uint32 f = 0; f < numFaces; ++f) {
+		const unsigned char* face = faces + 8 * f;
+		for (int k = 0; k < 3; ++k) {
+			corners[3 * f + k] = getUint16(face + 2 * k);
+			if (corners[3 * f + k] >= numPoints) {
+				throw Exception("Corrupt 3DS file: face with a missing point",
+						LOCATION);
+			}
+		}
+		const osg::Vec3& a = positions[corners[3 * f]];
+		faceNormals[f] = (positions[corners[3 * f + 1]] - a)
+				^ (positions[corners[3 * f + 2]] - a);
+	}
+
+	adjacencyStart.clear();
+	adjacency.clear();
+	if (smoothing != NULL) {
+		adjacencyStart.assign(numPoints + 1, 0);
+		for (size_t c = 0; c < corners.size(); ++c) {
+			++adjacencyStart[corners[c] + 1];
+		}
+		for (Uint32 p = 0; p < numPoints; ++p) {
+			adjacencyStart[p + 1] += adjacencyStart[p];
+		}
+		adjacency.resize(corners.size());
+		std::vector<Uint32> fill(adjacencyStart.begin(), adjacencyStart.end()
+				- 1);
+		for (size_t c = 0; c < corners.size(); ++c) {
+			adjacency[fill[corners[c]]++] = Uint32(c / 3);
+		}
+	}
+} // end prepare()
+
+/*
+ * buildGeometry - Builds the Geometry of the faces groupFaces[first, last).
+ */
+osg::Geometry* MeshBuilder::buildGeometry(
+		const std::vector<Uint32>& groupFaces, size_t first, size_t last) {
+	vertexPoints.clear();
+	vertexFaces.clear();
+	vertexNext.clear();
+	indices.clear();
+
+	// A corner reuses the vertex of its point made for a face with the same
+	// smoothing groups; faces in no group share no vertices.
+	for (size_t i = first; i < last; ++i) {
+		const Uint32 face = groupFaces[i];
+		const Uint32 mask = getSmoothing(face);
+		for (int k = 0; k < 3; ++k) {
+			const Uint32 point = corners[3 * face + k];
+			Uint32 vertex = NONE;
+			if (mask != 0) {
+				for (Uint32 v = pointVertex[point]; v != NONE; v
+						= vertexNext[v]) {
+					if (getSmoothing(vertexFaces[v]) == mask) {
+						vertex = v;
+						break;
+					}
+				}
+			}
+			if (vertex == NONE) {
+				vertex = Uint32(vertexPoints.size());
+				vertexPoints.push_back(point);
+				vertexFaces.push_back(face);
+				vertexNext.push_back(pointVertex[point]);
+				pointVertex[point] = vertex;
+			}
+			indices.push_back(vertex);
+		}
+	}
+
+	const Uint32 numVertices = Uint32(vertexPoints.size());
+	osg::Vec3Array* vertices = new osg::Vec3Array(numVertices);
+	osg::Vec3Array* normals = new osg::Vec3Array(numVertices);
+	osg::Vec2Array* coordinates = texCoords != NULL ? new osg::Vec2Array(
+			numVertices) : NULL;
+	for (Uint32 v = 0; v < numVertices; ++v) {
+		const Uint32 point = vertexPoints[v];
+		const Uint32 mask = getSmoothing(vertexFaces[v]);
+		(*vertices)[v] = positions[point];
+
+		osg::Vec3 normal = faceNormals[vertexFaces[v]];
+		if (mask != 0) {
+			normal.set(0.0f, 0.0f, 0.0f);
+			for (Uint32 a = adjacencyStart[point]; a < adjacencyStart[point
+					+ 1]; ++a) {
+				if (getSmoothing(adjacency[a]) & mask) {
+					normal += faceNormals[adjacency[a]];
+				}
+			}
+		}
+		normal.normalize();
+		(*normals)[v] = normal;
+
+		if (coordinates != NULL) {
+			const unsigned char* texCoord = texCoords + 8 * point;
+			(*coordinates)[v].set(getFloat(texCoord), getFloat(texCoord + 4));
+		}
+		// Ready for the next Geometry.
+		pointVertex[point] = NONE;
+	}
+
+	osg::Geometry* geometry = new osg::Geometry();
+	geometry->setVertexArray(vertices);
+	geometry->setNormalArray(normals);
+	geometry->setNormalBinding(osg::Geometry::BIND_PER_VERTEX);
+	if (coordinates != NULL) {
+		geometry->setTexCoordArray(0, coordinates);
+	}
+	if (numVertices <= 0x10000) {
+		osg::DrawElementsUShort* elements = new osg::DrawElementsUShort(
+				osg::PrimitiveSet::TRIANGLES, indices.size());
+		for (size_t i = 0; i < indices.size(); ++i) {
+			(*elements)[i] = GLushort(indices[i]);
+		}
+		geometry->addPrimitiveSet(elements);
+	} else {
+		geometry->addPrimitiveSet(new osg::DrawElementsUInt(
+				osg::PrimitiveSet::TRIANGLES, indices.size(), &indices[0]));
+	}
+	return geometry;
+} // end buildGeometry()
+
+/*
+ * readFirstKey - Reads the value of the first key of a track, the one for
+ * frame 0.
+ *
+ * @return \c false is returned if the track has no keys.
+ */
+bool readFirstKey(const Chunk& track, int numValues, float* values) {
+	ChunkCursor fields(track);
+	fields.readUint16();
+	fields.readBytes(8);
+	if (fields.readUint32() == 0) {
+		return false;
+	}
+	fields.readUint32();
+	// Tension, continuity, bias, ease to and ease from, if flagged.
+	const Uint16 flags = fields.readUint16();
+	for (int bit = 0; bit < 5; ++bit) {
+		if (flags & (1 << bit)) {
+			fields.readFloat();
+		}
+	}
+	for (int i = 0; i < numValues; ++i) {
+		values[i] = fields.readFloat();
+	}
+	return true;
+}
+
+/*
+ * decodeKeyframer - Decodes the object nodes of the keyframer.  Nodes
+ * without a NODE_ID chunk are numbered in file order, lights and cameras
+ * included, as old files refer to their parents that way.
+ */
+void decodeKeyframer(const Chunk& keyframer, std::vector<KeyframeNode>& nodes) {
+	PROFILE_ZONE("Reader3DS::decodeKeyframer");
+	ChunkCursor cursor(keyframer);
+	Chunk tag;
+	for (Uint32 index = 0; cursor.nextChunk(tag);) {
+		if (tag.id < FIRST_NODE_TAG || tag.id > LAST_NODE_TAG) {
+			continue;
+		}
+		if (tag.id != OBJECT_NODE_TAG) {
+			++index;
+			continue;
+		}
+
+		KeyframeNode node;
+		node.id = index++;
+		node.parent = NONE;
+		node.pivot.set(0.0f, 0.0f, 0.0f);
+		node.position.set(0.0f, 0.0f, 0.0f);
+		node.angle = 0.0f;
+		node.axis.set(0.0f, 0.0f, 1.0f);
+		node.scale.set(1.0f, 1.0f, 1.0f);
+
+		ChunkCursor nodeCursor(tag);
+		Chunk chunk;
+		float values[4];
+		while (nodeCursor.nextChunk(chunk)) {
+			ChunkCursor fields(chunk);
+			switch (chunk.id) {
+			case NODE_ID:
+				node.id = fields.readUint16();
+				break;
+			case NODE_HEADER: {
+				node.name = fields.readString();
+				fields.readUint16();
+				fields.readUint16();
+				const Uint16 parent = fields.readUint16();
+				node.parent = parent == 0xffff ? NONE : parent;
+				break;
+			}
+			case INSTANCE_NAME:
+				node.instanceName = fields.readString();
+				break;
+			case PIVOT:
+				node.pivot = getVec3(fields.readBytes(12));
+				break;
+			case POSITION_TRACK:
+				if (readFirstKey(chunk, 3, values)) {
+					node.position.set(values[0], values[1], values[2]);
+				}
+				break;
+			case ROTATION_TRACK:
+				if (readFirstKey(chunk, 4, values)) {
+					node.angle = values[0];
+					node.axis.set(values[1], values[2], values[3]);
+				}
+				break;
+			case SCALE_TRACK:
+				if (readFirstKey(chunk, 3, values)) {
+					node.scale.set(values[0], values[1], values[2]);
+				}
+				break;
+			}
+		}
+		nodes.push_back(node);
+	}
+} // end decodeKeyframer()
+
+/*
+ * findChunks - Walks the chunk tree down to the materials, meshes and
+ * keyframer, which the jobs decode.
+ */
+void findChunks(const Chunk& file, Model& model) {
+	ChunkCursor fileCursor(file);
+	Chunk main;
+	if (!fileCursor.nextChunk(main) || main.id != MAIN) {
+		throw Exception("Not a 3DS file", LOCATION);
+	}
+
+	ChunkCursor mainCursor(main);
+	Chunk chunk;
+	while (mainCursor.nextChunk(chunk)) {
+		if (chunk.id == KEYFRAMER) {
+			model.hasKeyframer = true;
+			model.keyframer = chunk;
+		} else if (chunk.id == EDITOR) {
+			ChunkCursor editorCursor(chunk);
+			Chunk object;
+			while (editorCursor.nextChunk(object)) {
+				if (object.id == MATERIAL) {
+					MaterialJob material;
+					material.chunk = object;
+					model.materials.push_back(material);
+				} else if (object.id == NAMED_OBJECT) {
+					ChunkCursor objectCursor(object);
+					const std::string name = objectCursor.readString();
+					Chunk sub;
+					while (objectCursor.nextChunk(sub)) {
+						if (sub.id == TRIANGLE_OBJECT) {
+							MeshJob mesh;
+							mesh.name = name;
+							mesh.chunk = sub;
+							model.meshes.push_back(mesh);
+						}
+					}
+				}
+			}
+		}
+	}
+} // end findChunks()
+
+/*
+ * Job - Decoding of one material, mesh or the keyframer.
+ */
+struct Job {
+	enum Type {
+		MATERIAL_JOB, MESH_JOB, KEYFRAMER_JOB
+	};
+
+	Type type;
+	size_t index;
+	size_t size; /**< Bytes of chunk data, to start the largest first */
+
+	bool operator<(const Job& other) const {
+		return size > other.size;
+	}
+};
+
+/*
+ * JobBody - parallelFor body that runs a range of jobs.
+ */
+class JobBody {
+public:
+	JobBody(const std::vector<Job>& _jobs, Model& _model) :
+		jobs(_jobs), model(_model) {
+	}
+
+	void operator()(size_t first, size_t last) const {
+		for (size_t j = first; j < last; ++j) {
+			const Job& job = jobs[j];
+			switch (job.type) {
+			case Job::MATERIAL_JOB:
+				decodeMaterial(model.materials[job.index], model.directory);
+				break;
+			case Job::MESH_JOB: {
+				MeshBuilder builder;
+				builder.build(model.meshes[job.index], model.hasKeyframer);
+				break;
+			}
+			case Job::KEYFRAMER_JOB:
+				decodeKeyframer(model.keyframer, model.nodes);
+				break;
+			}
+		}
+	}
+
+private:
+	const std::vector<Job>& jobs;
+	Model& model;
+};
+
+/*
+ * assemble - Puts the decoded parts together: binds the materials and
+ * places the meshes in the keyframer hierarchy.
+ */
+osg::ref_ptr<osg::Group> assemble(Model& model) {
+	PROFILE_ZONE("Reader3DS::assemble");
+	osg::ref_ptr<osg::Group> root = new osg::Group();
+
+	std::map<std::string, osg::StateSet*> stateSets;
+	for (size_t m = 0; m < model.materials.size(); ++m) {
+		stateSets.insert(std::make_pair(model.materials[m].name,
+				model.materials[m].stateSet.get()));
+	}
+	std::map<std::string, size_t> meshIndices;
+	for (size_t m = 0; m < model.meshes.size(); ++m) {
+		osg::Geode& geode = *model.meshes[m].geode;
+		for (unsigned int d = 0; d < geode.getNumDrawables(); ++d) {
+			const std::map<std::string, osg::StateSet*>::const_iterator
+					stateSet = stateSets.find(geode.getDrawable(d)->getName());
+			if (stateSet != stateSets.end()) {
+				geode.getDrawable(d)->setStateSet(stateSet->second);
+			}
+		}
+		meshIndices.insert(std::make_pair(model.meshes[m].name, m));
+	}
+
+	if (!model.hasKeyframer) {
+		for (size_t m = 0; m < model.meshes.size(); ++m) {
+			root->addChild(model.meshes[m].geode.get());
+		}
+		return root;
+	}
+
+	// Node matrix at frame 0 as lib3ds computes it, T * R * S, in the
+	// row-vector order of OSG.  3DS angles turn the other way round.
+	const std::vector<KeyframeNode>& nodes = model.nodes;
+	std::vector<bool> meshUsed(model.meshes.size(), false);
+	std::vector<osg::ref_ptr<osg::MatrixTransform> > transforms(nodes.size());
+	std::map<Uint32, size_t> nodeIndices;
+	for (size_t n = 0; n < nodes.size(); ++n) {
+		const KeyframeNode& node = nodes[n];
+		osg::Matrix rotation;
+		if (node.axis.length2() > 0.0f) {
+			rotation.makeRotate(-node.angle, node.axis);
+		}
+		transforms[n] = new osg::MatrixTransform(osg::Matrix::scale(node.scale)
+				* rotation * osg::Matrix::translate(node.position));
+		transforms[n]->setName(node.instanceName.empty() ? node.name
+				: node.instanceName);
+		nodeIndices.insert(std::make_pair(node.id, n));
+
+		const std::map<std::string, size_t>::const_iterator mesh =
+				meshIndices.find(node.name);
+		if (mesh != meshIndices.end()) {
+			osg::Geode* geode = model.meshes[mesh->second].geode.get();
+			if (node.pivot.length2() > 0.0f) {
+				osg::MatrixTransform* pivot = new osg::MatrixTransform(
+						osg::Matrix::translate(-node.pivot));
+				pivot->addChild(geode);
+				transforms[n]->addChild(pivot);
+			} else {
+				transforms[n]->addChild(geode);
+			}
+			meshUsed[mesh->second] = true;
+		}
+	}
+
+	// Link the nodes to their parents, leaving out links that would close
+	// a cycle.
+	std::vector<size_t> parents(nodes.size(), size_t(NONE));
+	for (size_t n = 0; n < nodes.size(); ++n) {
+		const std::map<Uint32, size_t>::const_iterator parent =
+				nodeIndices.find(nodes[n].parent);
+		if (parent == nodeIndices.end()) {
+			continue;
+		}
+		size_t ancestor = parent->second;
+		for (size_t steps = 0; ancestor != size_t(NONE) && ancestor != n
+				&& steps < nodes.size(); ++steps) {
+			ancestor = parents[ancestor];
+		}
+		if (ancestor == size_t(NONE)) {
+			parents[n] = parent->second;
+		}
+	}
+	for (size_t n = 0; n < nodes.size(); ++n) {
+		osg::Group* parent = parents[n] != size_t(NONE) ? transforms[parents[n]].get()
+				: root.get();
+		parent->addChild(transforms[n].get());
+	}
+
+	// Meshes no node places keep the position their mesh matrix gives.
+	for (size_t m = 0; m < model.meshes.size(); ++m) {
+		if (!meshUsed[m]) {
+			osg::MatrixTransform* transform = new osg::MatrixTransform(
+					model.meshes[m].matrix);
+			transform->addChild(model.meshes[m].geode.get());
+			root->addChild(transform);
+		}
+	}
+	return root;
+} // end assemble()
+
+/*****************************************
+ Comparison of scene graphs:
+ *****************************************/
+
+/*
+ * SurfaceStatistics - Order-independent measures of the triangles of a
+ * scene graph, in world coordinates.
+ */
+struct SurfaceStatistics {
+	SurfaceStatistics(void) :
+		triangles(0), area(0.0), moment(0.0, 0.0, 0.0),
+				secondMoment(0.0, 0.0, 0.0) {
+	}
+
+	Uint64 triangles;
+	double area;
+	osg::Vec3d moment; /**< Area-weighted sum of the centroids */
+	osg::Vec3d secondMoment; /**< Same of their squares, per axis */
+	osg::BoundingBox bounds;
+	std::map<Uint32, Uint64> trianglesByColor; /**< By diffuse RGB */
+};
+
+Uint32 getColorKey(const osg::StateSet* stateSet, Uint32 inherited) {
+	const osg::Material* material = stateSet != NULL ? dynamic_cast<
+			const osg::Material*> (stateSet->getAttribute(
+			osg::StateAttribute::MATERIAL)) : NULL;
+	if (material == NULL) {
+		return inherited;
+	}
+	const osg::Vec4& diffuse = material->getDiffuse(osg::Material::FRONT);
+	Uint32 key = 0;
+	for (int c = 0; c < 3; ++c) {
+		const float value = std::min(std::max(diffuse[c], 0.0f), 1.0f);
+		key = key << 8 | Uint32(value * 255.0f + 0.5f);
+	}
+	return key;
+}
+
+void addTriangle(SurfaceStatistics& statistics, const osg::Vec3& a,
+		const osg::Vec3& b, const osg::Vec3& c, Uint32 color) {
+	const double area = 0.5 * ((b - a) ^ (c - a)).length();
+	const osg::Vec3d centroid = osg::Vec3d(a + b + c) / 3.0;
+	++statistics.triangles;
+	statistics.area += area;
+	statistics.moment += centroid * area;
+	for (int i = 0; i < 3; ++i) {
+		statistics.secondMoment[i] += centroid[i] * centroid[i] * area;
+	}
+	statistics.bounds.expandBy(a);
+	statistics.bounds.expandBy(b);
+	statistics.bounds.expandBy(c);
+	++statistics.trianglesByColor[color];
+}
+
+/*
+ * addRun - Adds the triangles of one run of vertices drawn with \p mode.
+ */
+void addRun(SurfaceStatistics& statistics, GLenum mode,
+		const std::vector<osg::Vec3>& run, Uint32 color) {
+	const size_t size = run.size();
+	switch (mode) {
+	case osg::PrimitiveSet::TRIANGLES:
+		for (size_t i = 0; i + 2 < size; i += 3) {
+			addTriangle(statistics, run[i], run[i + 1], run[i + 2], color);
+		}
+		break;
+	case osg::PrimitiveSet::TRIANGLE_STRIP:
+	case osg::PrimitiveSet::QUAD_STRIP:
+		for (size_t i = 0; i + 2 < size; ++i) {
+			addTriangle(statistics, run[i], run[i + 1], run[i + 2], color);
+		}
+		break;
+	case osg::PrimitiveSet::TRIANGLE_FAN:
+	case osg::PrimitiveSet::POLYGON:
+		for (size_t i = 1; i + 1 < size; ++i) {
+			addTriangle(statistics, run[0], run[i], run[i + 1], color);
+		}
+		break;
+	case osg::PrimitiveSet::QUADS:
+		for (size_t i = 0; i + 3 < size; i += 4) {
+			addTriangle(statistics, run[i], run[i + 1], run[i + 2], color);
+			addTriangle(statistics, run[i], run[i + 2], run[i + 3], color);
+		}
+		break;
+	}
+}
+
+void addGeometry(SurfaceStatistics& statistics, const osg::Geometry& geometry,
+		const osg::Matrix& matrix, Uint32 color) {
+	const osg::Vec3Array* vertices =
+			dynamic_cast<const osg::Vec3Array*> (geometry.getVertexArray());
+	if (vertices == NULL) {
+		return;
+	}
+	color = getColorKey(geometry.getStateSet(), color);
+	std::vector<osg::Vec3> run;
+	for (unsigned int p = 0; p < geometry.getNumPrimitiveSets(); ++p) {
+		const osg::PrimitiveSet& set = *geometry.getPrimitiveSet(p);
+		const osg::DrawArrayLengths* lengths =
+				dynamic_cast<const osg::DrawArrayLengths*> (&set);
+		// DrawArrayLengths draws a run per length; the others one run.
+		size_t index = 0;
+		const size_t numRuns = lengths != NULL ? lengths->size() : 1;
+		for (size_t r = 0; r < numRuns; ++r) {
+			const size_t count = lengths != NULL ? size_t((*lengths)[r])
+					: set.getNumIndices();
+			run.clear();
+			for (size_t i = 0; i < count; ++i, ++index) {
+				const unsigned int vertex = lengths != NULL ? lengths->getFirst()
+						+ index : set.index(index);
+				if (vertex < vertices->size()) {
+					run.push_back((*vertices)[vertex] * matrix);
+				}
+			}
+			addRun(statistics, set.getMode(), run, color);
+		}
+	}
+}
+
+void addNode(SurfaceStatistics& statistics, const osg::Node& node,
+		osg::Matrix matrix, Uint32 color) {
+	color = getColorKey(node.getStateSet(), color);
+	const osg::Transform* transform = node.asTransform();
+	if (transform != NULL) {
+		transform->computeLocalToWorldMatrix(matrix, NULL);
+	}
+	const osg::Geode* geode = dynamic_cast<const osg::Geode*> (&node);
+	if (geode != NULL) {
+		for (unsigned int d = 0; d < geode->getNumDrawables(); ++d) {
+			const osg::Geometry* geometry =
+					dynamic_cast<const osg::Geometry*> (geode->getDrawable(d));
+			if (geometry != NULL) {
+				addGeometry(statistics, *geometry, matrix, color);
+			}
+		}
+	}
+	const osg::Group* group = node.asGroup();
+	if (group != NULL) {
+		for (unsigned int c = 0; c < group->getNumChildren(); ++c) {
+			addNode(statistics, *group->getChild(c), matrix, color);
+		}
+	}
+}
+
+bool differs(double value, double reference, double tolerance) {
+	return std::fabs(value - reference) > tolerance;
+}
+
+}
+
+/*****************************************
+ Methods of class Reader3DS:
+ *****************************************/
+
+/*
+ * Reader3DS - Constructor for Reader3DS class.
+ *
+ * @param _pool The pool whose workers decode the chunks.
+ */
+Reader3DS::Reader3DS(ThreadPool& _pool) :
+	pool(_pool) {
+} // end Reader3DS()
+
+/*
+ * canRead - Tells whether \p path names a 3DS file.
+ */
+bool Reader3DS::canRead(const std::string& path) {
+	const size_t dot = path.rfind('.');
+	if (dot == std::string::npos || path.size() - dot != 4) {
+		return false;
+	}
+	std::string extension = path.substr(dot + 1);
+	for (size_t i = 0; i < extension.size(); ++i) {
+		extension[i] = char(std::tolower(extension[i]));
+	}
+	return extension == "3ds";
+} // end canRead()
+
+/*
+ * read - Reads the model in \p path.
+ *
+ * @return The root of the model, named after the file.
+ * @throw Exception is thrown if the file cannot be read or is corrupt.
+ */
+osg::ref_ptr<osg::Node> Reader3DS::read(const std::string& path) {
+	PROFILE_ZONE("Reader3DS::read");
+	const MappedFile file(path);
+	Model model;
+	const size_t slash = path.rfind('/');
+	model.directory = slash == std::string::npos ? std::string() : path.substr(
+			0, slash + 1);
+	findChunks(file.getChunk(), model);
+
+	std::vector<Job> jobs;
+	for (size_t m = 0; m < model.materials.size(); ++m) {
+		const Job job = { Job::MATERIAL_JOB, m,
+				model.materials[m].chunk.getSize() };
+		jobs.push_back(job);
+	}
+	for (size_t m = 0; m < model.meshes.size(); ++m) {
+		const Job job = { Job::MESH_JOB, m, model.meshes[m].chunk.getSize() };
+		jobs.push_back(job);
+	}
+	if (model.hasKeyframer) {
+		const Job job = { Job::KEYFRAMER_JOB, 0, model.keyframer.getSize() };
+		jobs.push_back(job);
+	}
+	// Largest first, so a big mesh does not start last and finish alone.
+	std::stable_sort(jobs.begin(), jobs.end());
+	pool.parallelFor(0, jobs.size(), 1, JobBody(jobs, model));
+
+	osg::ref_ptr<osg::Group> root = assemble(model);
+	root->setName(path.substr(slash == std::string::npos ? 0 : slash + 1));
+	return root;
+} // end read()
+
+/*
+ * compare - Checks that \p node has the same surface and materials as
+ * \p reference: the same number of triangles per diffuse color, and the
+ * same area, bounds and distribution of the area in space.  The vertices,
+ * normals and graph structure may differ.
+ *
+ * @param differences Set to a description of the differences found, one
+ *                    per line.
+ * @return \c true is returned if there are none.
+ */
+bool Reader3DS::compare(const osg::Node& node, const osg::Node& reference,
+		std::string& differences) {
+	SurfaceStatistics actual;
+	SurfaceStatistics expected;
+	addNode(actual, node, osg::Matrix(), 0);
+	addNode(expected, reference, osg::Matrix(), 0);
+
+	std::ostringstream out;
+	if (actual.triangles != expected.triangles) {
+		out << actual.triangles << " triangles instead of "
+				<< expected.triangles << "\n";
+	}
+	if (differs(actual.area, expected.area, 1e-4 * expected.area)) {
+		out << "Area " << actual.area << " instead of " << expected.area
+				<< "\n";
+	}
+
+	const double size = expected.bounds.valid() ? double(
+			(expected.bounds._max - expected.bounds._min).length()) : 1.0;
+	const double tolerance = 1e-4 * size;
+	for (int i = 0; i < 3; ++i) {
+		if (actual.bounds.valid() != expected.bounds.valid() || differs(
+				actual.bounds._min[i], expected.bounds._min[i], tolerance)
+				|| differs(actual.bounds._max[i], expected.bounds._max[i],
+						tolerance)) {
+			out << "Bounds differ along axis " << i << "\n";
+		}
+		if (actual.area > 0.0 && expected.area > 0.0 && (differs(
+				actual.moment[i] / actual.area, expected.moment[i]
+						/ expected.area, tolerance) || differs(
+				actual.secondMoment[i] / actual.area, expected.secondMoment[i]
+						/ expected.area, 1e-3 * size * size))) {
+			out << "Area distributed differently along axis " << i << "\n";
+		}
+	}
+
+	std::map<Uint32, Uint64>::const_iterator a =
+			actual.trianglesByColor.begin();
+	std::map<Uint32, Uint64>::const_iterator e =
+			expected.trianglesByColor.begin();
+	while (a != actual.trianglesByColor.end() || e
+			!= expected.trianglesByColor.end()) {
+		const bool takeActual = e == expected.trianglesByColor.end() || (a
+				!= actual.trianglesByColor.end() && a->first < e->first);
+		const bool takeExpected = a == actual.trianglesByColor.end()
+				|| (e != expected.trianglesByColor.end() && e->first
+						< a->first);
+		const Uint32 color = takeActual ? a->first : e->first;
+		const Uint64 actualCount = takeExpected ? 0 : a->second;
+		const Uint64 expectedCount = takeActual ? 0 : e->second;
+		if (actualCount != expectedCount) {
+			char name[8];
+			snprintf(name, sizeof(name), "%06x", color);
+			out << actualCount << " triangles of diffuse color #" << name
+					<< " instead of " << expectedCount << "\n";
+		}
+		if (!takeExpected) {
+			++a;
+		}
+		if (!takeActual) {
+			++e;
+		}
+	}
+
+	differences = out.str();
+	return differences.empty();
+} // end compare()
@@ -0,0 +1,50 @@
+/*
+ * Reader3DS.h - Native reader of 3D Studio (.3ds) model files.
+ */
+
+#ifndef READER3DS_H_
+#define READER3DS_H_
+
+#include <string>
+
+/* Boost includes */
+#include <boost/noncopyable.hpp>
+
+/* osg includes */
+#include <osg/Node>
+#include <osg/ref_ptr>
+
+#include <SYNC/ThreadPool.h>
+
+/*
+ * Reader3DS - Builds a scene graph from a 3DS file without the OSG plugin.
+ * The file is mapped and its chunk tree walked in place; the chunks of the
+ * materials, of each mesh and of the keyframer are then decoded in parallel
+ * on the pool, each mesh straight into osg::Geometry arrays of their final
+ * size.  Only the results are put together on the calling thread.
+ *
+ * The graph has the structure the plugin builds: one Geode per mesh with a
+ * Geometry per material, under the keyframer's node hierarchy (at frame 0)
+ * when the file has one.  Normals follow the smoothing groups; vertices on
+ * a crease are split rather than given one averaged normal, so vertex
+ * counts differ from the plugin's while the surface is the same.  compare()
+ * checks that two graphs describe the same surface and materials.
+ *
+ * read() may be called from several threads at once, pool workers
+ * included.
+ */
+class Reader3DS: boost::noncopyable {
+public:
+	explicit Reader3DS(ThreadPool& _pool = ThreadPool::instance());
+
+	static bool canRead(const std::string& path);
+	osg::ref_ptr<osg::Node> read(const std::string& path);
+
+	static bool compare(const osg::Node& node, const osg::Node& reference,
+			std::string& differences);
+
+private:
+	ThreadPool& pool;
+};
+
+#endif /* READER3DS_H_ */
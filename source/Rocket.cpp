@@ -6,6 +6,7 @@
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <unistd.h>
 #include <stdexcept>
 #include <iostream>
 #include <iomanip>
@@ -49,9 +50,57 @@
 #include <ANALYSIS/ClippingPlane.h>
 #include <ANALYSIS/ClippingPlaneLocator.h>
 #include <MODEL/Hopper.h>
+#ifdef ROCKET_LOCK_PROFILING
+#include <SYNC/LockRegistry.h>
+#endif
+#include <UTIL/AllocationTracker.h>
+#include <UTIL/Exception.h>
+#include <UTIL/Logger.h>
+#include <UTIL/Metrics.h>
+#include <UTIL/Profiler.h>
+#include <UTIL/System.h>
 
 #include "Rocket.h"
 
+namespace {
+
+/*
+ * getResidentBytes - Samples the resident set size of the process.
+ */
+double getResidentBytes(void*) {
+	FILE* statm = fopen("/proc/self/statm", "r");
+	if (statm == NULL) {
+		return 0.0;
+	}
+	unsigned long size = 0;
+	unsigned long resident = 0;
+	const int fields = fscanf(statm, "%lu %lu", &size, &resident);
+	fclose(statm);
+	return fields == 2 ? double(resident) * double(sysconf(_SC_PAGESIZE))
+			: 0.0;
+}
+
+double getDroppedLogMessages(void*) {
+	return double(Logger::getDroppedMessages());
+}
+
+/*
+ * postToggle - Posts the scene command for a changed menu toggle, and
+ * returns the state the toggle should show: the new one, or the old one if
+ * the command queue was full and the command got dropped.
+ */
+bool postToggle(Hopper& hopper, Hopper::SceneCommand::Type type,
+		const GLMotif::ToggleButton::ValueChangedCallbackData& callbackData) {
+	if (hopper.postCommand(type, callbackData.set)) {
+		return callbackData.set;
+	}
+	LOG_WARNING("Scene command queue is full, ignoring %s",
+			callbackData.toggle->getName());
+	return !callbackData.set;
+}
+
+}
+
 /*****************************************
  Methods of class Rocket::DataItem:
  *****************************************/
@@ -84,36 +133,104 @@ Rocket::DataItem::~DataItem(void) {
  */
 Rocket::Rocket(int& argc, char**& argv, char**& appDefaults) :
 	Vrui::Application(argc, argv, appDefaults), analysisTool(0),
-			clippingPlanes(0), mainMenu(0), renderDialog(0) {
+			clippingPlanes(0), lastFrameStart(0), startupTimer("Startup"),
+			startupReported(false), mainMenu(0), renderDialog(0) {
+
+	/* Pin the main (simulation) thread as ROCKET_AFFINITY_MAIN asks; the
+	 threads it starts apply their own roles, not this one: */
+	SystemPosix::applyThreadRole("MAIN");
+	PROFILE_THREAD_NAME("Main");
 
-	/* Create the ATR Scene */
+	/* Create the ATR Scene; the model loads while the rest is set up: */
 	hopper = new Hopper();
 	hopper->config();
+	startupTimer.mark("Hopper::config");
 
 	/* Initialize Clippling Planes */
-	numberOfClippingPlanes = 6;
+	numberOfClippingPlanes = FrameState::MAX_CLIPPING_PLANES;
 	clippingPlanes = new ClippingPlane[numberOfClippingPlanes];
 	for (int i = 0; i < numberOfClippingPlanes; ++i) {
 		clippingPlanes[i].setAllocated(false);
 		clippingPlanes[i].setActive(false);
 	}
+	startupTimer.mark("Clipping planes");
 
 	/* Create the user interface: */
 	mainMenu = createMainMenu();
 	Vrui::setMainMenu(mainMenu);
+	startupTimer.mark("Main menu");
 	renderDialog = createRenderDialog();
+	startupTimer.mark("Render dialog");
 
 	/* Initialize Vrui navigation transformation: */
 	centerDisplayCallback(0);
+
+	/* Give display() a valid state before the first frame: */
+	publishFrameState();
+	startupTimer.mark("Navigation and frame state");
+
+#ifdef ROCKET_LOCK_PROFILING
+	/* Dump the lock statistics whenever SIGUSR1 arrives: */
+	LockRegistry::installSignalHandler(SIGUSR1);
+#endif
+
+	/* Register the runtime metrics; ROCKET_METRICS_SOCKET serves them: */
+	framesMetric = Metrics::counter("rocket_frames_total", "Frames simulated");
+	displayPassesMetric = Metrics::counter("rocket_display_passes_total",
+			"Calls of display(), over all contexts and eyes");
+	frameTimeMetric = Metrics::histogram("rocket_frame_seconds",
+			"Time between the starts of consecutive frames",
+			Metrics::exponentialBounds(0.001, 1.5, 16));
+	Metrics::addSampler("rocket_resident_memory_bytes",
+			"Resident set size of the process", &getResidentBytes, NULL);
+	Metrics::addSampler("rocket_log_dropped_messages",
+			"Log messages lost to full log buffers", &getDroppedLogMessages,
+			NULL);
+#ifdef ROCKET_LOCK_PROFILING
+	Metrics::addCollector(&LockRegistry::collectMetrics, NULL);
+#endif
+	Metrics::startServerFromEnvironment();
+	startupTimer.mark("Metrics");
 } // end Rocket()
 
 /*
  * ~Rocket - Destructor for Rocket class.
  */
 Rocket::~Rocket(void) {
+	Metrics::stopServer();
+
+	/* Report how the model catalog kept up with the session: */
+	const ModelCatalog::Statistics& models =
+			hopper->getModelCatalog().getStatistics();
+	LOG_INFO("Model catalog: %lu hits, %lu misses, %lu loads, %lu failures, "
+			"%lu prefetches (%lu used)", models.hits, models.misses,
+			models.loads, models.failures, models.prefetches,
+			models.prefetchHits);
+	LOG_INFO("Model catalog: %lu GPU and %lu CPU evictions",
+			models.gpuEvictions, models.cpuEvictions);
+	LOG_INFO("Model hot reload: %lu reloads (%lu meshes kept, %lu rebuilt)",
+			models.reloads, models.keptMeshes, models.rebuiltMeshes);
+
 	/* Delete the user interface: */
 	delete mainMenu;
 	delete renderDialog;
+
+#ifdef ROCKET_LOCK_PROFILING
+	/* Report the lock statistics of the session: */
+	LockRegistry::instance().dump(stderr);
+	std::string lockProfile;
+	if (SystemPosix::getenv("ROCKET_LOCK_PROFILE", lockProfile)) {
+		LockRegistry::instance().exportJSON(lockProfile);
+	}
+#endif
+
+#ifdef ROCKET_PROFILING
+	/* Report the frame profile of the session: */
+	Profiler::report();
+#elif defined(ROCKET_ALLOC_TRACKING)
+	/* The profile includes these; without it, report them on their own: */
+	AllocationTracker::writeSummary(stderr);
+#endif
 } // end ~Rocket()
 
 /*******************************
@@ -126,6 +243,8 @@ Rocket::~Rocket(void) {
  * parameter callbackData - Misc::CallbackData *
  */
 void Rocket::centerDisplayCallback(Misc::CallbackData * callbackData) {
+	ALLOCATION_PHASE(PHASE_CALLBACK);
+
 	/* Center the Sphere in the available display space, but do not scale it: */
 	Vrui::NavTransform nav = Vrui::NavTransform::identity;
 	nav *= Vrui::NavTransform::translateFromOriginTo(Vrui::getDisplayCenter());
@@ -141,11 +260,33 @@ void Rocket::centerDisplayCallback(Misc::CallbackData * callbackData) {
  */
 void Rocket::changeAnalysisToolsCallback(
 		GLMotif::RadioBox::ValueChangedCallbackData * callbackData) {
+	ALLOCATION_PHASE(PHASE_CALLBACK);
+
 	/* Set the new analysis tool: */
 	analysisTool = callbackData->radioBox->getToggleIndex(
 			callbackData->newSelectedToggle);
 } // end changeAnalysisToolsCallback()
 
+/*
+ * changeModelCallback
+ *
+ * parameter callbackData - GLMotif::RadioBox::ValueChangedCallbackData *
+ */
+void Rocket::changeModelCallback(
+		GLMotif::RadioBox::ValueChangedCallbackData * callbackData) {
+	ALLOCATION_PHASE(PHASE_CALLBACK);
+
+	/* Show the selected model from the next frame on; if the command queue
+	 is full, select the model shown again: */
+	const int index = callbackData->radioBox->getToggleIndex(
+			callbackData->newSelectedToggle);
+	if (index >= 0 && !hopper->postSelectModel(size_t(index))) {
+		LOG_WARNING("Scene command queue is full, ignoring model %s",
+				hopper->getModelCatalog().getName(size_t(index)).c_str());
+		callbackData->radioBox->setSelectedToggle(int(hopper->getModel()));
+	}
+} // end changeModelCallback()
+
 /*
  * createAnalysisToolsSubMenu
  *
@@ -192,6 +333,11 @@ GLMotif::PopupMenu* Rocket::createMainMenu(void) {
 			"RenderTogglesCascade", mainMenu, "Rendering Modes");
 	renderTogglesCascade->setPopup(createRenderTogglesMenu());
 
+	/* Create a cascade button to show the "Models" submenu: */
+	GLMotif::CascadeButton * modelsCascade = new GLMotif::CascadeButton(
+			"ModelsCascade", mainMenu, "Models");
+	modelsCascade->setPopup(createModelsSubMenu());
+
 	/* Create a cascade button to show the "Analysis Tools" submenu: */
 	GLMotif::CascadeButton * analysisToolsCascade = new GLMotif::CascadeButton(
 			"AnalysisToolsCascade", mainMenu, "Analysis Tools");
@@ -217,6 +363,31 @@ GLMotif::PopupMenu* Rocket::createMainMenu(void) {
 	return mainMenuPopup;
 } // end createMainMenu()
 
+/*
+ * createModelsSubMenu - One entry per model of the catalog.
+ *
+ * return - GLMotif::Popup *
+ */
+GLMotif::Popup * Rocket::createModelsSubMenu(void) {
+	GLMotif::Popup * modelsMenuPopup = new GLMotif::Popup("modelsMenuPopup",
+			Vrui::getWidgetManager());
+	GLMotif::RadioBox * models = new GLMotif::RadioBox("models",
+			modelsMenuPopup, false);
+	models->setSelectionMode(GLMotif::RadioBox::ALWAYS_ONE);
+
+	const ModelCatalog& catalog = hopper->getModelCatalog();
+	for (size_t i = 0; i < catalog.getNumModels(); ++i) {
+		models->addToggle(catalog.getName(i).c_str());
+	}
+
+	models->setSelectedToggle(int(hopper->getModel()));
+	models->getValueChangedCallbacks().add(this, &Rocket::changeModelCallback);
+
+	models->manageChild();
+
+	return modelsMenuPopup;
+} // end createModelsSubMenu()
+
 /*
  * createRenderDialog
  *
@@ -335,6 +506,8 @@ GLMotif::Popup * Rocket::createRenderTogglesMenu(void) {
  * parameter glContextData - GLContextData &
  */
 void Rocket::display(GLContextData & glContextData) const {
+	ALLOCATION_PHASE(PHASE_DISPLAY);
+	displayPassesMetric.add();
 
 	/* Get context data item: */
 	DataItem* dataItem = glContextData.retrieveDataItem<DataItem> (this);
@@ -350,38 +523,26 @@ void Rocket::display(GLContextData & glContextData) const {
 	glMatrixMode(GL_TEXTURE);
 	glPushMatrix();
 
-	/* Enable all clipping planes: */
+	/* Get this frame's snapshot; the live clipping planes may be changing: */
+	FrameState state;
+	frameState.read(state);
+
+	/* Enable all active clipping planes: */
 	int numberOfSupportedClippingPlanes;
 	glGetIntegerv(GL_MAX_CLIP_PLANES, &numberOfSupportedClippingPlanes);
-	int clippingPlaneIndex = 0;
-	for (int i = 0; i < numberOfClippingPlanes && clippingPlaneIndex
-			< numberOfSupportedClippingPlanes; ++i) {
-		if (clippingPlanes[i].isActive()) {
-			/* Enable the clipping plane: */
-			glEnable(GL_CLIP_PLANE0 + clippingPlaneIndex);
-			GLdouble clippingPlane[4];
-			for (int j = 0; j < 3; ++j)
-				clippingPlane[j] = clippingPlanes[i].getPlane().getNormal()[j];
-			clippingPlane[3] = -clippingPlanes[i].getPlane().getOffset();
-			glClipPlane(GL_CLIP_PLANE0 + clippingPlaneIndex, clippingPlane);
-			/* Go to the next clipping plane: */
-			++clippingPlaneIndex;
-		}
+	int numberOfEnabledClippingPlanes = state.numberOfActiveClippingPlanes;
+	if (numberOfEnabledClippingPlanes > numberOfSupportedClippingPlanes)
+		numberOfEnabledClippingPlanes = numberOfSupportedClippingPlanes;
+	for (int i = 0; i < numberOfEnabledClippingPlanes; ++i) {
+		glEnable(GL_CLIP_PLANE0 + i);
+		glClipPlane(GL_CLIP_PLANE0 + i, state.clippingPlanes[i]);
 	}
 
 	hopper->display(glContextData);
 
 	/* Disable all clipping planes: */
-	clippingPlaneIndex = 0;
-	for (int i = 0; i < numberOfClippingPlanes && clippingPlaneIndex
-			< numberOfSupportedClippingPlanes; ++i) {
-		if (clippingPlanes[i].isActive()) {
-			/* Disable the clipping plane: */
-			glDisable(GL_CLIP_PLANE0 + clippingPlaneIndex);
-			/* Go to the next clipping plane: */
-			++clippingPlaneIndex;
-		}
-	}
+	for (int i = 0; i < numberOfEnabledClippingPlanes; ++i)
+		glDisable(GL_CLIP_PLANE0 + i);
 
 	glMatrixMode(GL_TEXTURE);
 	glPopMatrix();
@@ -399,7 +560,36 @@ void Rocket::display(GLContextData & glContextData) const {
  * frame
  */
 void Rocket::frame(void) {
+	PROFILE_NEW_FRAME();
+	PROFILE_ZONE("Rocket::frame");
+	ALLOCATION_NEW_FRAME();
+	ALLOCATION_PHASE(PHASE_FRAME);
+
+	const Uint64 frameStart = SystemPosix::getMonotonicNanoseconds();
+	if (lastFrameStart != 0) {
+		frameTimeMetric.observe(double(frameStart - lastFrameStart) * 1e-9);
+	}
+	lastFrameStart = frameStart;
+	framesMetric.add();
+
 	hopper->frame();
+
+	/* Report the startup once the model replaced its placeholder: */
+	if (!startupReported && !hopper->isModelPending()) {
+		const ModelCatalog& models = hopper->getModelCatalog();
+		startupTimer.record("Model load (background)",
+				models.getLoadStartTime(hopper->getModel()),
+				models.getLoadFinishTime(hopper->getModel()));
+		startupTimer.mark("Frames until the model was swapped in");
+		startupTimer.report();
+		startupReported = true;
+	}
+
+	publishFrameState();
+
+#ifdef ROCKET_LOCK_PROFILING
+	LockRegistry::instance().poll();
+#endif
 } // end frame()
 
 /*
@@ -439,19 +629,24 @@ void Rocket::initContext(GLContextData & glContextData) const {
  */
 void Rocket::menuToggleSelectCallback(
 		GLMotif::ToggleButton::ValueChangedCallbackData * callbackData) {
+	ALLOCATION_PHASE(PHASE_CALLBACK);
+
 	/* Adjust program state based on which toggle button changed state: */
 	if (strcmp(callbackData->toggle->getName(), "showPlantToggle") == 0) {
-		hopper->toggleHopper();
-		showPlantToggle->setToggle(callbackData->set);
-		showPlantToggleRD->setToggle(callbackData->set);
+		const bool set = postToggle(*hopper, Hopper::SceneCommand::SHOW_HOPPER,
+				*callbackData);
+		showPlantToggle->setToggle(set);
+		showPlantToggleRD->setToggle(set);
 	} else if (strcmp(callbackData->toggle->getName(), "wireframeToggle") == 0) {
-		hopper->toggleWireframe();
-		wireframeToggle->setToggle(callbackData->set);
-		wireframeToggleRD->setToggle(callbackData->set);
+		const bool set = postToggle(*hopper,
+				Hopper::SceneCommand::SHOW_WIREFRAME, *callbackData);
+		wireframeToggle->setToggle(set);
+		wireframeToggleRD->setToggle(set);
 	} else if (strcmp(callbackData->toggle->getName(), "lightToggle") == 0) {
-		hopper->toggleLight();
-		lightToggle->setToggle(callbackData->set);
-		lightToggleRD->setToggle(callbackData->set);
+		const bool set = postToggle(*hopper, Hopper::SceneCommand::SHOW_LIGHT,
+				*callbackData);
+		lightToggle->setToggle(set);
+		lightToggleRD->setToggle(set);
 	} else if (strcmp(callbackData->toggle->getName(), "showRenderDialogToggle")
 			== 0) {
 		if (callbackData->set) {
@@ -466,6 +661,31 @@ void Rocket::menuToggleSelectCallback(
 	}
 } // end menuToggleSelectCallback()
 
+/*
+ * publishFrameState - Takes the snapshot of this frame that all display()
+ * calls will read.
+ */
+void Rocket::publishFrameState(void) {
+	NO_ALLOCATION_REGION("Rocket::publishFrameState");
+
+	FrameState state;
+
+	/* Pack the active clipping planes: */
+	for (int i = 0; i < numberOfClippingPlanes; ++i) {
+		if (clippingPlanes[i].isActive()) {
+			const Vrui::Plane plane = clippingPlanes[i].getPlane();
+			double* equation =
+					state.clippingPlanes[state.numberOfActiveClippingPlanes];
+			for (int j = 0; j < 3; ++j)
+				equation[j] = plane.getNormal()[j];
+			equation[3] = -plane.getOffset();
+			++state.numberOfActiveClippingPlanes;
+		}
+	}
+
+	frameState.publish(state);
+} // end publishFrameState()
+
 /*
  * sliderCallback
  *
@@ -473,6 +693,8 @@ void Rocket::menuToggleSelectCallback(
  */
 void Rocket::sliderCallback(
 		GLMotif::Slider::ValueChangedCallbackData * callbackData) {
+	ALLOCATION_PHASE(PHASE_CALLBACK);
+
 	if (strcmp(callbackData->slider->getName(), "SurfaceTransparencySlider")
 			== 0) {
 		;
@@ -489,6 +711,8 @@ void Rocket::sliderCallback(
  */
 void Rocket::toolCreationCallback(
 		Vrui::ToolManager::ToolCreationCallbackData * callbackData) {
+	ALLOCATION_PHASE(PHASE_CALLBACK);
+
 	/* Check if the new tool is a locator tool: */
 	Vrui::LocatorTool* locatorTool =
 			dynamic_cast<Vrui::LocatorTool*> (callbackData->tool);
@@ -510,6 +734,8 @@ void Rocket::toolCreationCallback(
  */
 void Rocket::toolDestructionCallback(
 		Vrui::ToolManager::ToolDestructionCallbackData * callbackData) {
+	ALLOCATION_PHASE(PHASE_CALLBACK);
+
 	/* Check if the to-be-destroyed tool is a locator tool: */
 	Vrui::LocatorTool* locatorTool =
 			dynamic_cast<Vrui::LocatorTool*> (callbackData->tool);
@@ -545,9 +771,15 @@ int main(int argc, char* argv[]) {
 
 		/* Return to the OS: */
 		return 0;
-	} catch (std::runtime_error err) {
-		/* Print an error message and return to the OS: */
-		std::cerr << "Caught exception " << err.what() << std::endl;
+	} catch (const Exception& err) {
+		/* Log the error with its call stack and return to the OS: */
+		LOG_EXCEPTION(LEVEL_ERROR, err);
+		Logger::shutdown();
+		return 1;
+	} catch (const std::runtime_error& err) {
+		/* Log an error message and return to the OS: */
+		LOG_ERROR("Caught exception %s", err.what());
+		Logger::shutdown();
 		return 1;
 	}
 } // end main()
@@ -19,6 +19,11 @@
 #include <Vrui/ToolManager.h>
 #include <Vrui/Application.h>
 
+#include <FrameState.h>
+#include <SYNC/SeqLock.h>
+#include <UTIL/Metrics.h>
+#include <UTIL/Timer.h>
+
 /* Begin Forward declarations: */
 class Hopper;
 class ClippingPlane;
@@ -66,6 +71,13 @@ private:
 	Hopper * hopper;
 	BaseLocatorList baseLocators;
 	ClippingPlane * clippingPlanes;
+	SeqLock<FrameState> frameState;
+	Counter framesMetric;
+	Counter displayPassesMetric;
+	Histogram frameTimeMetric; /**< Time between the starts of frames */
+	Uint64 lastFrameStart;
+	PhaseTimer startupTimer; /**< Reported once the model is swapped in */
+	bool startupReported;
 	GLMotif::PopupMenu* mainMenu;
 	int numberOfClippingPlanes;
 	GLMotif::PopupWindow* renderDialog;
@@ -79,10 +91,14 @@ private:
 	/* Private methods: */
 	void changeAnalysisToolsCallback(
 			GLMotif::RadioBox::ValueChangedCallbackData * callbackData);
+	void changeModelCallback(
+			GLMotif::RadioBox::ValueChangedCallbackData * callbackData);
 	GLMotif::Popup * createAnalysisToolsSubMenu(void);
 	GLMotif::PopupMenu * createMainMenu(void);
+	GLMotif::Popup * createModelsSubMenu(void);
 	GLMotif::PopupWindow * createRenderDialog(void);
 	GLMotif::Popup * createRenderTogglesMenu(void);
+	void publishFrameState(void);
 	virtual void toolCreationCallback(
 			Vrui::ToolManager::ToolCreationCallbackData * callbackData);
 	virtual void toolDestructionCallback(
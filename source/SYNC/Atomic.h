@@ -0,0 +1,117 @@
+#ifndef ATOMIC_H_
+#define ATOMIC_H_
+
+/*
+ * Atomic - Thin wrappers around the GCC atomic builtins used by the lock-free
+ * parts of SYNC.  Loads are acquire, stores are release and read-modify-write
+ * operations are sequentially consistent unless the name says otherwise.
+ */
+class Atomic {
+public:
+	/*
+	 * load - Atomically reads \p *ptr with acquire semantics.
+	 */
+	template<class T>
+	static T load(const volatile T* ptr) {
+		return __atomic_load_n(ptr, __ATOMIC_ACQUIRE);
+	} // end load()
+
+	/*
+	 * loadRelaxed - Atomically reads \p *ptr without ordering guarantees.
+	 */
+	template<class T>
+	static T loadRelaxed(const volatile T* ptr) {
+		return __atomic_load_n(ptr, __ATOMIC_RELAXED);
+	} // end loadRelaxed()
+
+	/*
+	 * store - Atomically writes \p value to \p *ptr with release semantics.
+	 */
+	template<class T>
+	static void store(volatile T* ptr, T value) {
+		__atomic_store_n(ptr, value, __ATOMIC_RELEASE);
+	} // end store()
+
+	/*
+	 * storeRelaxed - Atomically writes \p value to \p *ptr without ordering
+	 * guarantees.
+	 */
+	template<class T>
+	static void storeRelaxed(volatile T* ptr, T value) {
+		__atomic_store_n(ptr, value, __ATOMIC_RELAXED);
+	} // end storeRelaxed()
+
+	/*
+	 * exchange - Atomically replaces \p *ptr with \p value.
+	 *
+	 * @return The previous value of \p *ptr.
+	 */
+	template<class T>
+	static T exchange(volatile T* ptr, T value) {
+		return __atomic_exchange_n(ptr, value, __ATOMIC_SEQ_CST);
+	} // end exchange()
+
+	/*
+	 * compareAndSwap - Replaces \p *ptr with \p desired if it still equals
+	 * \p expected.
+	 *
+	 * @return \c true is returned if the swap took place.
+	 */
+	template<class T>
+	static bool compareAndSwap(volatile T* ptr, T expected, T desired) {
+		return __atomic_compare_exchange_n(ptr, &expected, desired, false,
+				__ATOMIC_SEQ_CST, __ATOMIC_RELAXED);
+	} // end compareAndSwap()
+
+	/*
+	 * fetchAdd - Atomically adds \p delta to \p *ptr.
+	 *
+	 * @return The value of \p *ptr before the addition.
+	 */
+	template<class T>
+	static T fetchAdd(volatile T* ptr, T delta) {
+		return __atomic_fetch_add(ptr, delta, __ATOMIC_SEQ_CST);
+	} // end fetchAdd()
+
+	/*
+	 * fetchAddRelaxed - Atomically adds \p delta to \p *ptr without ordering
+	 * guarantees.  Meant for statistics counters.
+	 */
+	template<class T>
+	static T fetchAddRelaxed(volatile T* ptr, T delta) {
+		return __atomic_fetch_add(ptr, delta, __ATOMIC_RELAXED);
+	} // end fetchAddRelaxed()
+
+	/*
+	 * fetchSub - Atomically subtracts \p delta from \p *ptr.
+	 *
+	 * @return The value of \p *ptr before the subtraction.
+	 */
+	template<class T>
+	static T fetchSub(volatile T* ptr, T delta) {
+		return __atomic_fetch_sub(ptr, delta, __ATOMIC_SEQ_CST);
+	} // end fetchSub()
+
+	/*
+	 * fence - Full memory barrier.
+	 */
+	static void fence(void) {
+		__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	} // end fence()
+
+	/*
+	 * cpuRelax - Tells the CPU that the caller is busy-waiting.  This frees
+	 * pipeline resources for the sibling hyperthread and saves power.
+	 */
+	static void cpuRelax(void) {
+#if defined(__i386__) || defined(__x86_64__)
+		__builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+		__asm__ __volatile__("yield" ::: "memory");
+#else
+		__asm__ __volatile__("" ::: "memory");
+#endif
+	} // end cpuRelax()
+};
+
+#endif /* ATOMIC_H_ */
@@ -0,0 +1,59 @@
+#include <SYNC/Atomic.h>
+#include <SYNC/Barrier.h>
+#include <SYNC/Futex.h>
+
+namespace {
+
+/* Number of times a waiter checks for the end of the round before sleeping: */
+const int SPIN_ROUNDS = 1000;
+
+}
+
+/*
+ * Barrier - Constructor for Barrier class.
+ *
+ * @param _count The number of threads that have to call wait() to complete a
+ *               round.
+ *
+ * @throw LockException is thrown if \p _count is not positive.
+ */
+Barrier::Barrier(int _count) :
+	count(_count), arrived(0), generation(0) {
+	if (count <= 0) {
+		throw LockException("A barrier needs at least one thread", LOCATION);
+	}
+} // end Barrier()
+
+/*
+ * wait - Waits until all threads of the barrier have arrived.
+ *
+ * @return \c true is returned to exactly one thread per round (the last one
+ *         to arrive), so that it can do the work that follows the barrier
+ *         once.  \c false is returned to the others.
+ */
+bool Barrier::wait(void) {
+	const Int32 round = Atomic::load(&generation);
+
+	if (Atomic::fetchAdd(&arrived, Int32(1)) == count - 1) {
+		// Last one in: start the next round before releasing the others, so
+		// that a thread which hurries on to the next wait() counts for it.
+		Atomic::storeRelaxed(&arrived, Int32(0));
+		Atomic::fetchAdd(&generation, Int32(1));
+		Futex::wakeAll(&generation);
+		return true;
+	}
+
+	if (Futex::isSpinningUseful()) {
+		for (int i = 0; i < SPIN_ROUNDS; ++i) {
+			if (Atomic::load(&generation) != round) {
+				return false;
+			}
+			Atomic::cpuRelax();
+		}
+	}
+
+	while (Atomic::load(&generation) == round) {
+		Futex::wait(&generation, round);
+	}
+	return false;
+} // end wait()
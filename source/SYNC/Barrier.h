@@ -0,0 +1,47 @@
+#ifndef BARRIER_H_
+#define BARRIER_H_
+
+/* Boost includes */
+#include <boost/noncopyable.hpp>
+
+#include <SYNC/LockException.h>
+#include <UTIL/Types.h>
+
+/*
+ * Barrier - Makes a fixed number of threads wait for each other, for example
+ * the render threads of all windows of a node before they swap buffers.
+ * Every thread calls wait(); the call returns once all of them arrived.  The
+ * barrier can be reused right away for the next round.
+ *
+ * Waiters spin briefly, since the last threads usually arrive within
+ * microseconds, and then sleep on a futex.
+ */
+class Barrier: boost::noncopyable {
+public:
+	explicit Barrier(int count);
+
+	/*
+	 * ~Barrier - destructor for Barrier class.
+	 *
+	 * @pre No thread should be waiting at the barrier.
+	 */
+	~Barrier(void) {
+		;
+	} // end ~Barrier()
+
+	bool wait(void);
+
+	/*
+	 * getCount - Returns the number of threads that meet at this barrier.
+	 */
+	int getCount(void) const {
+		return count;
+	} // end getCount()
+
+private:
+	const Int32 count;
+	volatile Int32 arrived; /**< Threads that reached the current round */
+	volatile Int32 generation; /**< Round number, the futex word */
+};
+
+#endif /* BARRIER_H_ */
@@ -0,0 +1,285 @@
+#ifndef BLOCKING_QUEUE_H_
+#define BLOCKING_QUEUE_H_
+
+#include <cstddef>
+#include <vector>
+
+/* Boost includes */
+#include <boost/noncopyable.hpp>
+
+#include <SYNC/CondVarPosix.h>
+#include <SYNC/Guard.h>
+#include <SYNC/MutexPosix.h>
+#include <UTIL/Types.h>
+
+/*
+ * BlockingQueue - Bounded first-in first-out queue for handing work between
+ * threads, for any number of producers and consumers.  Producers block while
+ * the queue is full and consumers block while it is empty, so neither side
+ * has to poll.  The batch operations move several items per lock round trip.
+ *
+ * Once close() has been called, pushes fail and pops drain the remaining
+ * items and then fail instead of blocking, which lets consumer threads shut
+ * down cleanly.
+ *
+ * @param ITEM_TYPE Copyable type of the queued items.
+ */
+template<class ITEM_TYPE>
+class BlockingQueue: boost::noncopyable {
+public:
+	/*
+	 * BlockingQueue - Creates an empty queue.
+	 *
+	 * @param _capacity The maximum number of queued items.  Must be > 0.
+	 */
+	explicit BlockingQueue(size_t _capacity) :
+		items(_capacity), head(0), count(0), closed(false) {
+	} // end BlockingQueue()
+
+	/*
+	 * push - Appends an item, blocking while the queue is full.
+	 *
+	 * @return \c false is returned if the queue was closed.
+	 */
+	bool push(const ITEM_TYPE& item) {
+		Guard<MutexPosix> guard(mutex);
+		while (count == items.size() && !closed) {
+			notFull.wait(mutex);
+		}
+		return append(item);
+	} // end push()
+
+	/*
+	 * tryPush - Appends an item if there is room (does not block).
+	 *
+	 * @return \c false is returned if the queue is full or closed.
+	 */
+	bool tryPush(const ITEM_TYPE& item) {
+		Guard<MutexPosix> guard(mutex);
+		return count < items.size() && append(item);
+	} // end tryPush()
+
+	/*
+	 * timedPush - Appends an item, blocking for at most \p milliseconds while
+	 * the queue is full.
+	 *
+	 * @return \c false is returned if the wait timed out or the queue was
+	 *         closed.
+	 */
+	bool timedPush(const ITEM_TYPE& item, Uint32 milliseconds) {
+		const struct timespec deadline = CondVarPosix::getDeadline(
+				milliseconds);
+		Guard<MutexPosix> guard(mutex);
+		while (count == items.size() && !closed) {
+			if (!notFull.waitUntil(mutex, deadline)) {
+				break;
+			}
+		}
+		return count < items.size() && append(item);
+	} // end timedPush()
+
+	/*
+	 * pushBatch - Appends the items in [\p first, \p last), blocking
+	 * whenever the queue is full.  Items are appended in as few lock round
+	 * trips as the free space allows.
+	 *
+	 * @return The number of items appended, which is less than the length
+	 *         of the range only if the queue was closed.
+	 */
+	template<class INPUT_ITERATOR>
+	size_t pushBatch(INPUT_ITERATOR first, INPUT_ITERATOR last) {
+		size_t pushed(0);
+		Guard<MutexPosix> guard(mutex);
+
+		while (first != last) {
+			while (count == items.size() && !closed) {
+				notFull.wait(mutex);
+			}
+			if (closed) {
+				break;
+			}
+
+			const size_t before = count;
+			for (; first != last && count < items.size(); ++first) {
+				items[(head + count) % items.size()] = *first;
+				++count;
+			}
+			pushed += count - before;
+			if (count - before == 1) {
+				notEmpty.signal();
+			} else {
+				notEmpty.broadcast();
+			}
+		}
+
+		return pushed;
+	} // end pushBatch()
+
+	/*
+	 * pop - Removes the oldest item, blocking while the queue is empty.
+	 *
+	 * @param item Storage for the removed item.
+	 *
+	 * @return \c false is returned if the queue is closed and empty.
+	 */
+	bool pop(ITEM_TYPE& item) {
+		Guard<MutexPosix> guard(mutex);
+		while (count == 0 && !closed) {
+			notEmpty.wait(mutex);
+		}
+		return take(item);
+	} // end pop()
+
+	/*
+	 * tryPop - Removes the oldest item if there is one (does not block).
+	 *
+	 * @return \c false is returned if the queue is empty.
+	 */
+	bool tryPop(ITEM_TYPE& item) {
+		Guard<MutexPosix> guard(mutex);
+		return take(item);
+	} // end tryPop()
+
+	/*
+	 * timedPop - Removes the oldest item, blocking for at most
+	 * \p milliseconds while the queue is empty.
+	 *
+	 * @return \c false is returned if the wait timed out or the queue is
+	 *         closed and empty.
+	 */
+	bool timedPop(ITEM_TYPE& item, Uint32 milliseconds) {
+		const struct timespec deadline = CondVarPosix::getDeadline(
+				milliseconds);
+		Guard<MutexPosix> guard(mutex);
+		while (count == 0 && !closed) {
+			if (!notEmpty.waitUntil(mutex, deadline)) {
+				break;
+			}
+		}
+		return take(item);
+	} // end timedPop()
+
+	/*
+	 * popBatch - Removes up to \p maxItems of the oldest items and appends
+	 * them to \p result.  Blocks until at least one item is available.
+	 *
+	 * @return The number of items removed, which is 0 only if the queue is
+	 *         closed and empty.
+	 */
+	size_t popBatch(std::vector<ITEM_TYPE>& result, size_t maxItems) {
+		Guard<MutexPosix> guard(mutex);
+		while (count == 0 && !closed) {
+			notEmpty.wait(mutex);
+		}
+		return takeBatch(result, maxItems);
+	} // end popBatch()
+
+	/*
+	 * tryPopBatch - Removes up to \p maxItems of the oldest items without
+	 * blocking and appends them to \p result.
+	 *
+	 * @return The number of items removed.
+	 */
+	size_t tryPopBatch(std::vector<ITEM_TYPE>& result, size_t maxItems) {
+		Guard<MutexPosix> guard(mutex);
+		return takeBatch(result, maxItems);
+	} // end tryPopBatch()
+
+	/*
+	 * close - Closes the queue.  Blocked producers and consumers are woken
+	 * up; consumers can still pop the items that are left.
+	 */
+	void close(void) {
+		Guard<MutexPosix> guard(mutex);
+		closed = true;
+		notEmpty.broadcast();
+		notFull.broadcast();
+	} // end close()
+
+	/*
+	 * isClosed - Tells if close() has been called.
+	 */
+	bool isClosed(void) const {
+		Guard<MutexPosix> guard(mutex);
+		return closed;
+	} // end isClosed()
+
+	/*
+	 * size - Returns the number of queued items.
+	 */
+	size_t size(void) const {
+		Guard<MutexPosix> guard(mutex);
+		return count;
+	} // end size()
+
+	/*
+	 * capacity - Returns the maximum number of queued items.
+	 */
+	size_t capacity(void) const {
+		return items.size();
+	} // end capacity()
+
+private:
+	/*
+	 * append - Stores an item at the tail and wakes one consumer.
+	 *
+	 * @pre mutex is held and the queue is not full.
+	 */
+	bool append(const ITEM_TYPE& item) {
+		if (closed) {
+			return false;
+		}
+		items[(head + count) % items.size()] = item;
+		++count;
+		notEmpty.signal();
+		return true;
+	} // end append()
+
+	/*
+	 * take - Removes the item at the head and wakes one producer.
+	 *
+	 * @pre mutex is held.
+	 */
+	bool take(ITEM_TYPE& item) {
+		if (count == 0) {
+			return false;
+		}
+		item = items[head];
+		items[head] = ITEM_TYPE();
+		head = (head + 1) % items.size();
+		--count;
+		notFull.signal();
+		return true;
+	} // end take()
+
+	/*
+	 * takeBatch - Removes up to \p maxItems items and wakes the producers.
+	 *
+	 * @pre mutex is held.
+	 */
+	size_t takeBatch(std::vector<ITEM_TYPE>& result, size_t maxItems) {
+		const size_t taken = count < maxItems ? count : maxItems;
+		for (size_t i = 0; i < taken; ++i) {
+			result.push_back(items[head]);
+			items[head] = ITEM_TYPE();
+			head = (head + 1) % items.size();
+		}
+		count -= taken;
+		if (taken == 1) {
+			notFull.signal();
+		} else if (taken > 1) {
+			notFull.broadcast();
+		}
+		return taken;
+	} // end takeBatch()
+
+	mutable MutexPosix mutex;
+	CondVarPosix notEmpty;
+	CondVarPosix notFull;
+	std::vector<ITEM_TYPE> items; /**< Ring buffer storage */
+	size_t head; /**< Index of the oldest item */
+	size_t count; /**< Number of queued items */
+	bool closed;
+};
+
+#endif /* BLOCKING_QUEUE_H_ */
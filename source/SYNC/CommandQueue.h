@@ -0,0 +1,155 @@
+#ifndef COMMAND_QUEUE_H_
+#define COMMAND_QUEUE_H_
+
+#include <cstddef>
+
+/* Boost includes */
+#include <boost/noncopyable.hpp>
+
+#include <SYNC/Atomic.h>
+#include <UTIL/Types.h>
+
+/*
+ * CommandQueue - Bounded lock-free queue for many producers and a single
+ * consumer.  Producers (UI callbacks, locators, worker threads) post
+ * commands with tryPush() from any thread; the owning thread applies them in
+ * one batch with drain(), typically at the frame boundary.  Neither side
+ * ever takes a lock or makes a system call.
+ *
+ * Each slot carries a sequence number that tells producers and the consumer
+ * whose turn it is (D. Vyukov's bounded queue), so a producer only contends
+ * with other producers on a single fetch-and-add of the tail.
+ *
+ * @param COMMAND_TYPE Copyable, default-constructible command type.
+ */
+template<class COMMAND_TYPE>
+class CommandQueue: boost::noncopyable {
+public:
+	/*
+	 * CommandQueue - Creates an empty queue.
+	 *
+	 * @param minimumCapacity The capacity is rounded up to a power of two.
+	 */
+	explicit CommandQueue(size_t minimumCapacity) :
+		head(0), tail(0) {
+		capacity = 2;
+		while (capacity < minimumCapacity) {
+			capacity <<= 1;
+		}
+		mask = capacity - 1;
+
+		cells = new Cell[capacity];
+		for (size_t i = 0; i < capacity; ++i) {
+			cells[i].sequence = i;
+		}
+	} // end CommandQueue()
+
+	~CommandQueue(void) {
+		delete[] cells;
+	} // end ~CommandQueue()
+
+	/*
+	 * tryPush - Appends a command.  Safe to call from any thread.
+	 *
+	 * @return \c false is returned if the queue is full.
+	 */
+	bool tryPush(const COMMAND_TYPE& command) {
+		size_t position = Atomic::loadRelaxed(&tail);
+
+		for (;;) {
+			Cell& cell = cells[position & mask];
+			const size_t sequence = Atomic::load(&cell.sequence);
+
+			if (sequence == position) {
+				// The slot is free for this position; claim the position.
+				if (Atomic::compareAndSwap(&tail, position, position + 1)) {
+					cell.command = command;
+					Atomic::store(&cell.sequence, position + 1);
+					return true;
+				}
+				position = Atomic::loadRelaxed(&tail);
+			} else if (sequence < position) {
+				// The consumer has not freed this slot yet: the queue is full.
+				return false;
+			} else {
+				// Another producer claimed the position first.
+				position = Atomic::loadRelaxed(&tail);
+			}
+		}
+	} // end tryPush()
+
+	/*
+	 * tryPop - Removes the oldest command.  Must only be called by the
+	 * consumer thread.
+	 *
+	 * @return \c false is returned if the queue is empty, or if the oldest
+	 *         command is still being written by its producer.
+	 */
+	bool tryPop(COMMAND_TYPE& command) {
+		Cell& cell = cells[head & mask];
+
+		if (Atomic::load(&cell.sequence) != head + 1) {
+			return false;
+		}
+		command = cell.command;
+		cell.command = COMMAND_TYPE();
+		Atomic::store(&cell.sequence, head + capacity);
+		++head;
+
+		return true;
+	} // end tryPop()
+
+	/*
+	 * drain - Removes all currently queued commands and passes each one to
+	 * \p handler, oldest first.  Must only be called by the consumer thread.
+	 * Commands pushed while draining are left for the next call, so a
+	 * producer cannot keep the consumer busy forever.
+	 *
+	 * @param handler Function object called as handler(const COMMAND_TYPE&).
+	 *
+	 * @return The number of commands handled.
+	 */
+	template<class HANDLER_TYPE>
+	size_t drain(HANDLER_TYPE& handler) {
+		const size_t end = Atomic::load(&tail);
+		size_t handled(0);
+		COMMAND_TYPE command;
+
+		while (head != end && tryPop(command)) {
+			handler(command);
+			++handled;
+		}
+
+		return handled;
+	} // end drain()
+
+	/*
+	 * getCapacity - Returns the maximum number of queued commands.
+	 */
+	size_t getCapacity(void) const {
+		return capacity;
+	} // end getCapacity()
+
+private:
+	struct Cell {
+		volatile size_t sequence;
+		COMMAND_TYPE command;
+	};
+
+	enum {
+		CACHE_LINE_SIZE = 64
+	};
+
+	Cell* cells;
+	size_t capacity;
+	size_t mask;
+
+	/* Keep the consumer and producer ends on separate cache lines: */
+	char padding0[CACHE_LINE_SIZE];
+	size_t head; /**< Only touched by the consumer */
+	char padding1[CACHE_LINE_SIZE];
+	volatile size_t tail;
+	char padding2[CACHE_LINE_SIZE];
+};
+
+#endif /* COMMAND_QUEUE_H_ */
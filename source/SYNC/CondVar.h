@@ -0,0 +1,11 @@
+#ifndef COND_VAR_H_
+#define COND_VAR_H_
+
+/**
+ * CondVar - Include this file to get the full declaration of the type that is
+ * typedef'd to CondVar.
+ */
+
+#include <SYNC/CondVarPosix.h>
+
+#endif	/* COND_VAR_H_ */
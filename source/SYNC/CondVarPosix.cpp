@@ -0,0 +1,95 @@
+#include <cstring>
+#include <sstream>
+
+#include <SYNC/CondVarPosix.h>
+#include <UTIL/ResourceException.h>
+
+/**
+ * CondVarPosix - Constructor for CondVarPosix class.
+ *
+ * @post The condition variable is initialized to use the monotonic clock for
+ *       timed waits.
+ *
+ * @throw ResourceException is thrown if the condition variable cannot be
+ *        allocated.
+ */
+CondVarPosix::CondVarPosix(void) {
+	pthread_condattr_t cond_attr;
+	pthread_condattr_init(&cond_attr);
+	pthread_condattr_setclock(&cond_attr, CLOCK_MONOTONIC);
+	const int result = pthread_cond_init(&cond, &cond_attr);
+	pthread_condattr_destroy(&cond_attr);
+
+	if (result != 0) {
+		std::ostringstream msg_stream;
+		msg_stream << "Condition variable allocation failed: "
+				<< std::strerror(result);
+		throw ResourceException(msg_stream.str(), LOCATION);
+	}
+} // end CondVarPosix()
+
+/*
+ * timedWait - Atomically releases \p mutex and waits for a signal, for at most
+ * the given number of milliseconds.
+ *
+ * @pre The current thread holds \p mutex.
+ * @post \p mutex is held again.
+ *
+ * @param mutex        The mutex protecting the condition.
+ * @param milliseconds The longest time to wait.
+ *
+ * @return \c false is returned if the wait timed out, \c true otherwise.
+ *
+ * @throw LockException is thrown if the current thread does not hold
+ *        \p mutex (debug builds only).
+ */
+bool CondVarPosix::timedWait(MutexPosix& mutex, Uint32 milliseconds) {
+	return waitUntil(mutex, getDeadline(milliseconds));
+} // end timedWait()
+
+/*
+ * waitUntil - Atomically releases \p mutex and waits for a signal until the
+ * given point in time of the monotonic clock.  Use this rather than
+ * timedWait() in a loop, so spurious wake-ups do not extend the total wait.
+ *
+ * @pre The current thread holds \p mutex.
+ * @post \p mutex is held again.
+ *
+ * @param mutex    The mutex protecting the condition.
+ * @param deadline Absolute CLOCK_MONOTONIC time, see getDeadline().
+ *
+ * @return \c false is returned if the deadline passed, \c true otherwise.
+ *
+ * @throw LockException is thrown if the current thread does not hold
+ *        \p mutex (debug builds only).
+ */
+bool CondVarPosix::waitUntil(MutexPosix& mutex,
+		const struct timespec& deadline) {
+	const int result = pthread_cond_timedwait(&cond, &mutex.mutex, &deadline);
+
+	if (EPERM == result) {
+		throw LockException(
+				"Tried to wait on a condition variable without holding its mutex",
+				LOCATION);
+	}
+	assert(result == 0 || result == ETIMEDOUT);
+
+	return result != ETIMEDOUT;
+} // end waitUntil()
+
+/*
+ * getDeadline - Returns the monotonic clock time \p milliseconds from now.
+ */
+struct timespec CondVarPosix::getDeadline(Uint32 milliseconds) {
+	struct timespec deadline;
+	clock_gettime(CLOCK_MONOTONIC, &deadline);
+
+	deadline.tv_sec += milliseconds / 1000;
+	deadline.tv_nsec += long(milliseconds % 1000) * 1000000L;
+	if (deadline.tv_nsec >= 1000000000L) {
+		deadline.tv_nsec -= 1000000000L;
+		++deadline.tv_sec;
+	}
+
+	return deadline;
+} // end getDeadline()
@@ -0,0 +1,90 @@
+/*
+ * CondVarPosix
+ *
+ * @note This file must be included by SYNC/CondVar.h, not the other way
+ *       around.
+ */
+
+#ifndef COND_VAR_POSIX_H_
+#define COND_VAR_POSIX_H_
+
+#include <ctime>
+#include <pthread.h>
+#include <errno.h>
+#include <assert.h>
+
+/* Boost includes */
+#include <boost/noncopyable.hpp>
+#include <boost/concept_check.hpp>
+
+#include <SYNC/LockException.h>
+#include <SYNC/MutexPosix.h>
+#include <UTIL/Types.h>
+
+/*
+ * CondVarPosix - Condition variable wrapper for POSIX-compliant systems using
+ * pthreads condition variables.  Timed waits are measured against the
+ * monotonic clock, so they are not affected by changes of the system time.
+ * This is typedef'd to CondVar.
+ */
+class CondVarPosix: boost::noncopyable {
+public:
+	CondVarPosix(void);
+
+	/**
+	 * ~CondVarPosix - destructor for CondVarPosix class.
+	 *
+	 * @pre No thread should be waiting on the condition variable.
+	 */
+	~CondVarPosix(void) {
+		const int result = pthread_cond_destroy(&cond);
+		assert(result == 0);
+		boost::ignore_unused_variable_warning(result);
+	} // end ~CondVarPosix()
+
+	/*
+	 * wait - Atomically releases \p mutex and waits for a signal.
+	 *
+	 * @pre The current thread holds \p mutex.
+	 * @post \p mutex is held again.  The wait may end spuriously, so callers
+	 *       must re-check their condition in a loop.
+	 *
+	 * @throw LockException is thrown if the current thread does not hold
+	 *        \p mutex (debug builds only).
+	 */
+	void wait(MutexPosix& mutex) {
+		const int result = pthread_cond_wait(&cond, &mutex.mutex);
+
+		if (EPERM == result) {
+			throw LockException(
+					"Tried to wait on a condition variable without holding its mutex",
+					LOCATION);
+		}
+		assert(result == 0);
+		boost::ignore_unused_variable_warning(result);
+	} // end wait()
+
+	bool timedWait(MutexPosix& mutex, Uint32 milliseconds);
+	bool waitUntil(MutexPosix& mutex, const struct timespec& deadline);
+
+	/*
+	 * signal - Wakes up one thread waiting on this condition variable.
+	 */
+	void signal(void) {
+		pthread_cond_signal(&cond);
+	} // end signal()
+
+	/*
+	 * broadcast - Wakes up all threads waiting on this condition variable.
+	 */
+	void broadcast(void) {
+		pthread_cond_broadcast(&cond);
+	} // end broadcast()
+
+	static struct timespec getDeadline(Uint32 milliseconds);
+
+protected:
+	pthread_cond_t cond;
+};
+
+#endif /* COND_VAR_POSIX_H_ */
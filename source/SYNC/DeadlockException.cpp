@@ -1,7 +1,7 @@
 #include <SYNC/DeadlockException.h>
 
 DeadlockException::DeadlockException(const std::string& msg,
-		const std::string& location) throw () :
+		const SourceLocation& location) throw () :
 	LockException(msg, location) {
 	/* Do nothing. */;
 }
@@ -11,7 +11,8 @@
 class DeadlockException : public LockException
 {
 public:
-   DeadlockException(const std::string& msg, const std::string& location = "")
+   DeadlockException(const std::string& msg,
+                     const SourceLocation& location = SourceLocation())
       throw ();
 
    virtual ~DeadlockException() throw ();
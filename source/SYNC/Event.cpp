@@ -0,0 +1,66 @@
+#include <ctime>
+
+#include <SYNC/Event.h>
+#include <UTIL/System.h>
+
+namespace {
+
+/* Number of times a waiter checks the flag before sleeping: */
+const int SPIN_ROUNDS = 1000;
+
+}
+
+/*
+ * waitSlow - Slow path of wait() and timedWait(): spins for a while, then
+ * marks the event as having sleepers and parks on the futex.
+ *
+ * @param timeout Nanoseconds to wait at most, or a negative value to wait
+ *                forever.
+ *
+ * @return \c true is returned if the event was passed, \c false on timeout.
+ */
+bool Event::waitSlow(Int64 timeout) {
+	if (Futex::isSpinningUseful()) {
+		for (int i = 0; i < SPIN_ROUNDS; ++i) {
+			Atomic::cpuRelax();
+			if (tryConsume()) {
+				return true;
+			}
+		}
+	}
+
+	const Uint64 deadline = SystemPosix::getMonotonicNanoseconds() + Uint64(
+			timeout);
+
+	for (;;) {
+		// An auto-reset waiter that was parked leaves WAITING behind when it
+		// takes the event, since other sleepers may still need a wake-up.
+		Int32 current = Atomic::load(&state);
+		if (current == SET) {
+			if (mode == MANUAL_RESET) {
+				return true;
+			}
+			if (Atomic::compareAndSwap(&state, Int32(SET), Int32(WAITING))) {
+				return true;
+			}
+			continue;
+		}
+		if (current == UNSET && !Atomic::compareAndSwap(&state, Int32(UNSET),
+				Int32(WAITING))) {
+			continue;
+		}
+
+		if (timeout < 0) {
+			Futex::wait(&state, WAITING);
+		} else {
+			const Uint64 now = SystemPosix::getMonotonicNanoseconds();
+			if (now >= deadline) {
+				return false;
+			}
+			struct timespec remaining;
+			remaining.tv_sec = time_t((deadline - now) / 1000000000UL);
+			remaining.tv_nsec = long((deadline - now) % 1000000000UL);
+			Futex::wait(&state, WAITING, &remaining);
+		}
+	}
+} // end waitSlow()
@@ -0,0 +1,106 @@
+#ifndef EVENT_H_
+#define EVENT_H_
+
+/* Boost includes */
+#include <boost/noncopyable.hpp>
+
+#include <SYNC/Atomic.h>
+#include <SYNC/Futex.h>
+#include <UTIL/Types.h>
+
+/*
+ * Event - A flag that threads can wait for, e.g. "the shared textures are
+ * uploaded".  set() raises the flag and wakes the waiters, reset() lowers it.
+ *
+ * A manual-reset event stays set, and lets every waiter through, until
+ * reset() is called.  An auto-reset event lets exactly one waiter through
+ * per set() and lowers itself again.  set() and an uncontended wait() do not
+ * enter the kernel; waiters spin briefly and then sleep on a futex.
+ */
+class Event: boost::noncopyable {
+public:
+	enum ResetMode {
+		MANUAL_RESET, AUTO_RESET
+	};
+
+	explicit Event(ResetMode _mode = MANUAL_RESET, bool initiallySet = false) :
+		mode(_mode), state(initiallySet ? SET : UNSET) {
+	} // end Event()
+
+	/*
+	 * ~Event - destructor for Event class.
+	 *
+	 * @pre No thread should be waiting for the event.
+	 */
+	~Event(void) {
+		;
+	} // end ~Event()
+
+	/*
+	 * set - Raises the flag and wakes the waiters (all of them for a
+	 * manual-reset event, one for an auto-reset event).
+	 */
+	void set(void) {
+		if (Atomic::exchange(&state, Int32(SET)) == WAITING) {
+			Futex::wake(&state, mode == MANUAL_RESET ? 0x7fffffff : 1);
+		}
+	} // end set()
+
+	/*
+	 * reset - Lowers the flag.  Has no effect if the flag is not set.
+	 */
+	void reset(void) {
+		Atomic::compareAndSwap(&state, Int32(SET), Int32(UNSET));
+	} // end reset()
+
+	/*
+	 * test - Tests whether the flag is raised, without waiting or consuming
+	 * it.
+	 */
+	bool test(void) const {
+		return Atomic::load(&state) == SET;
+	} // end test()
+
+	/*
+	 * wait - Waits until the flag is raised.  An auto-reset event lowers it
+	 * again before returning.
+	 */
+	void wait(void) {
+		if (!tryConsume()) {
+			waitSlow(-1);
+		}
+	} // end wait()
+
+	/*
+	 * timedWait - Waits until the flag is raised, for at most the given
+	 * number of milliseconds.
+	 *
+	 * @return \c true is returned if the flag was raised (and, for an
+	 *         auto-reset event, consumed).  \c false is returned on timeout.
+	 */
+	bool timedWait(Uint32 milliseconds) {
+		return tryConsume() || waitSlow(Int64(milliseconds) * 1000000);
+	} // end timedWait()
+
+private:
+	enum State {
+		UNSET = 0, SET = 1, WAITING = 2 /**< Unset, waiters may sleep */
+	};
+
+	/*
+	 * tryConsume - Passes the event if it is set, without waiting.
+	 */
+	bool tryConsume(void) {
+		if (mode == MANUAL_RESET) {
+			return Atomic::load(&state) == SET;
+		}
+		return Atomic::compareAndSwap(&state, Int32(SET), Int32(UNSET));
+	} // end tryConsume()
+
+	bool waitSlow(Int64 timeout);
+
+	const ResetMode mode;
+	volatile Int32 state;
+};
+
+#endif /* EVENT_H_ */
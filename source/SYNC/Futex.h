@@ -0,0 +1,65 @@
+#ifndef FUTEX_H_
+#define FUTEX_H_
+
+#include <ctime>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#include <UTIL/Types.h>
+
+/*
+ * Futex - Wrapper for the Linux futex(2) system call, used by the SYNC
+ * primitives to park threads once spinning no longer pays off.  All
+ * operations are process-private.
+ */
+class Futex {
+public:
+	/*
+	 * wait - Sleeps as long as \p *addr equals \p expected.
+	 *
+	 * @param addr     The futex word.
+	 * @param expected The value the caller last saw in \p *addr.
+	 * @param timeout  Relative timeout.  This parameter is optional and
+	 *                 defaults to NULL (wait forever).
+	 *
+	 * @return 0 is returned if the caller was woken up.  Otherwise, the errno
+	 *         value is returned: EAGAIN if \p *addr did not equal \p expected,
+	 *         ETIMEDOUT if the timeout expired and EINTR on a signal.
+	 */
+	static int wait(volatile Int32* addr, Int32 expected,
+			const struct timespec* timeout = NULL) {
+		const long result = syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE,
+				expected, timeout, NULL, 0);
+		return result == 0 ? 0 : errno;
+	} // end wait()
+
+	/*
+	 * wake - Wakes up to \p count threads sleeping on \p addr.
+	 *
+	 * @return The number of threads woken up.
+	 */
+	static int wake(volatile Int32* addr, Int32 count) {
+		return static_cast<int> (syscall(SYS_futex, addr, FUTEX_WAKE_PRIVATE,
+				count, NULL, NULL, 0));
+	} // end wake()
+
+	/*
+	 * wakeAll - Wakes every thread sleeping on \p addr.
+	 */
+	static int wakeAll(volatile Int32* addr) {
+		return wake(addr, 0x7fffffff);
+	} // end wakeAll()
+
+	/*
+	 * isSpinningUseful - Spinning before a futex wait only makes sense if the
+	 * thread being waited for can run at the same time as the waiter.
+	 */
+	static bool isSpinningUseful(void) {
+		static const bool useful = sysconf(_SC_NPROCESSORS_ONLN) > 1;
+		return useful;
+	} // end isSpinningUseful()
+};
+
+#endif /* FUTEX_H_ */
@@ -1,6 +1,10 @@
 #ifndef GUARD_H_
 #define GUARD_H_
 
+#ifdef DEBUG
+#include <SYNC/LockOrder.h>
+#endif
+
 /*
  * Guard - Scoped wrapper for a lock.
  *
@@ -31,6 +35,9 @@ public:
 	 */
 	~Guard(void) {
 		if (lockStatus) {
+#ifdef DEBUG
+			LockOrder::released(theLock);
+#endif
 			theLock->release();
 		}
 	} // end ~Guard()
@@ -49,7 +56,13 @@ public:
 	 * acquire - Acquires the lock.
 	 */
 	bool acquire(void) {
+#ifdef DEBUG
+		LockOrder::acquiring(theLock);
+#endif
 		theLock->acquire();
+#ifdef DEBUG
+		LockOrder::acquired(theLock);
+#endif
 		lockStatus = true;
 		return lockStatus;
 	} // end acquire()
@@ -59,6 +72,11 @@ public:
 	 */
 	bool tryAcquire(void) {
 		lockStatus = theLock->tryAcquire();
+#ifdef DEBUG
+		if (lockStatus) {
+			LockOrder::acquired(theLock);
+		}
+#endif
 		return lockStatus;
 	} // end tryAcquire()
 
@@ -67,6 +85,9 @@ public:
 	 */
 	void release(void) {
 		lockStatus = false;
+#ifdef DEBUG
+		LockOrder::released(theLock);
+#endif
 		theLock->release();
 	} // end release()
 
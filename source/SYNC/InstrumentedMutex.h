@@ -0,0 +1,213 @@
+#ifndef INSTRUMENTED_MUTEX_H_
+#define INSTRUMENTED_MUTEX_H_
+
+#include <cstdio>
+
+/* Boost includes */
+#include <boost/noncopyable.hpp>
+
+#ifdef ROCKET_LOCK_PROFILING
+#include <SYNC/LockRegistry.h>
+#include <SYNC/LockStatistics.h>
+#include <UTIL/System.h>
+#endif
+
+/**
+ * @example "Example of profiling a lock"
+ *
+ * Wrap any lock type that works with Guard<> and give it a name:
+ *
+ * \code
+ * InstrumentedMutex<MutexPosix> viewerLock("Hopper::viewerLock");
+ * Guard<InstrumentedMutex<MutexPosix> > guard(viewerLock);
+ * \endcode
+ *
+ * Build with ROCKET_LOCK_PROFILING defined to collect statistics, and dump
+ * them with LockRegistry::instance().dump().
+ */
+
+#ifdef ROCKET_LOCK_PROFILING
+
+class RWMutexPosix;
+
+/*
+ * SharedReads - Whether readers of LOCK_TYPE hold it together.  Only
+ * RWMutexPosix shares them; the other locks take a read lock exclusively.
+ */
+template<class LOCK_TYPE>
+struct SharedReads {
+	enum {
+		VALUE = false
+	};
+};
+
+template<>
+struct SharedReads<RWMutexPosix> {
+	enum {
+		VALUE = true
+	};
+};
+
+/*
+ * InstrumentedMutex - Wrapper that records contention statistics for any
+ * lock type usable with Guard<>.  Every acquisition is counted; acquisitions
+ * that cannot get the lock right away are counted as contended and their
+ * wait time is recorded.  The time the lock is held is recorded for
+ * exclusive acquisitions, which include read locks of lock types that do
+ * not share them (see SharedReads).  The statistics are registered with the
+ * LockRegistry under the name of the lock.
+ *
+ * Without ROCKET_LOCK_PROFILING, InstrumentedMutex<LOCK_TYPE> is just
+ * LOCK_TYPE with a constructor that ignores the name.
+ */
+template<class LOCK_TYPE>
+class InstrumentedMutex: boost::noncopyable {
+public:
+	explicit InstrumentedMutex(const char* name = "<unnamed lock>") :
+		statistics(name), holdStart(0) {
+		LockRegistry::instance().add(&statistics);
+	} // end InstrumentedMutex()
+
+	~InstrumentedMutex(void) {
+		LockRegistry::instance().remove(&statistics);
+	} // end ~InstrumentedMutex()
+
+	/*
+	 * acquire - Locks the wrapped lock exclusively.
+	 */
+	void acquire(void) {
+		if (!lock.tryAcquire()) {
+			const Uint64 start = SystemPosix::getMonotonicNanoseconds();
+			lock.acquire();
+			acquired(SystemPosix::getMonotonicNanoseconds() - start, true);
+		} else {
+			acquired(0, true);
+		}
+	} // end acquire()
+
+	/*
+	 * acquireRead - Acquires a read lock on the wrapped lock.
+	 */
+	void acquireRead(void) {
+		if (!lock.tryAcquireRead()) {
+			const Uint64 start = SystemPosix::getMonotonicNanoseconds();
+			lock.acquireRead();
+			acquired(SystemPosix::getMonotonicNanoseconds() - start,
+					!SharedReads<LOCK_TYPE>::VALUE);
+		} else {
+			acquired(0, !SharedReads<LOCK_TYPE>::VALUE);
+		}
+	} // end acquireRead()
+
+	/*
+	 * acquireWrite - Acquires a write lock on the wrapped lock.
+	 */
+	void acquireWrite(void) {
+		if (!lock.tryAcquireWrite()) {
+			const Uint64 start = SystemPosix::getMonotonicNanoseconds();
+			lock.acquireWrite();
+			acquired(SystemPosix::getMonotonicNanoseconds() - start, true);
+		} else {
+			acquired(0, true);
+		}
+	} // end acquireWrite()
+
+	/*
+	 * tryAcquire - Tries to lock the wrapped lock exclusively.
+	 */
+	bool tryAcquire(void) {
+		const bool result = lock.tryAcquire();
+		if (result) {
+			acquired(0, true);
+		}
+		return result;
+	} // end tryAcquire()
+
+	/*
+	 * tryAcquireRead - Tries to acquire a read lock on the wrapped lock.
+	 */
+	bool tryAcquireRead(void) {
+		const bool result = lock.tryAcquireRead();
+		if (result) {
+			acquired(0, !SharedReads<LOCK_TYPE>::VALUE);
+		}
+		return result;
+	} // end tryAcquireRead()
+
+	/*
+	 * tryAcquireWrite - Tries to acquire a write lock on the wrapped lock.
+	 */
+	bool tryAcquireWrite(void) {
+		const bool result = lock.tryAcquireWrite();
+		if (result) {
+			acquired(0, true);
+		}
+		return result;
+	} // end tryAcquireWrite()
+
+	/*
+	 * release - Releases the wrapped lock.
+	 */
+	void release(void) {
+		// holdStart is only non-zero while the lock is held exclusively, so
+		// no other thread touches it here.
+		if (holdStart != 0) {
+			statistics.recordHold(SystemPosix::getMonotonicNanoseconds()
+					- holdStart);
+			holdStart = 0;
+		}
+		lock.release();
+	} // end release()
+
+	/*
+	 * test - Tests the current lock status of the wrapped lock.
+	 */
+	bool test(void) const {
+		return lock.test();
+	} // end test()
+
+	/*
+	 * dump - Dumps the statistics of this lock.
+	 */
+	void dump(FILE* dest = stderr, const char* message =
+			"\n------ Mutex Dump -----\n") const {
+		fprintf(dest, "%s", message);
+		statistics.dump(dest);
+	} // end dump()
+
+	/*
+	 * getStatistics - Returns the statistics recorded for this lock.
+	 */
+	const LockStatistics& getStatistics(void) const {
+		return statistics;
+	} // end getStatistics()
+
+private:
+	/*
+	 * acquired - Books an acquisition that waited \p waitNanoseconds.
+	 */
+	void acquired(Uint64 waitNanoseconds, bool exclusive) {
+		statistics.recordAcquisition(waitNanoseconds);
+		if (exclusive) {
+			holdStart = SystemPosix::getMonotonicNanoseconds();
+		}
+	} // end acquired()
+
+	LOCK_TYPE lock;
+	LockStatistics statistics;
+	Uint64 holdStart; /**< When the current exclusive holder got the lock */
+};
+
+#else /* ROCKET_LOCK_PROFILING */
+
+template<class LOCK_TYPE>
+class InstrumentedMutex: public LOCK_TYPE {
+public:
+	explicit InstrumentedMutex(const char* = "<unnamed lock>") {
+		;
+	} // end InstrumentedMutex()
+};
+
+#endif /* ROCKET_LOCK_PROFILING */
+
+#endif /* INSTRUMENTED_MUTEX_H_ */
@@ -1,7 +1,7 @@
 #include <SYNC/LockException.h>
 
 LockException::LockException(const std::string& msg,
-		const std::string& location) throw () :
+		const SourceLocation& location) throw () :
 	Exception(msg, location) {
 	/* Do nothing. */;
 }
@@ -9,8 +9,8 @@
  */
 class LockException: public Exception {
 public:
-			LockException(const std::string& msg, const std::string& location =
-					"") throw ();
+			LockException(const std::string& msg, const SourceLocation& location =
+					SourceLocation()) throw ();
 
 	virtual ~LockException() throw ();
 
@@ -0,0 +1,166 @@
+#include <algorithm>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <pthread.h>
+
+#include <SYNC/LockOrder.h>
+#include <UTIL/System.h>
+
+namespace {
+
+typedef std::vector<const void*> LockList;
+
+/* Edges "from" -> "to", with the call stack that first established each: */
+typedef std::map<const void*, std::string> EdgeMap;
+typedef std::map<const void*, EdgeMap> LockGraph;
+
+/*
+ * The graph is protected by a plain pthreads mutex: Guard<MutexPosix> would
+ * call back into LockOrder.
+ */
+pthread_mutex_t graphMutex = PTHREAD_MUTEX_INITIALIZER;
+LockGraph graph;
+
+pthread_key_t heldLocksKey;
+pthread_once_t heldLocksOnce = PTHREAD_ONCE_INIT;
+
+void deleteHeldLocks(void* heldLocks) {
+	delete static_cast<LockList*> (heldLocks);
+}
+
+void createHeldLocksKey(void) {
+	pthread_key_create(&heldLocksKey, &deleteHeldLocks);
+}
+
+/*
+ * getHeldLocks - Returns the locks held by the current thread, in the order
+ * they were acquired.
+ */
+LockList& getHeldLocks(void) {
+	pthread_once(&heldLocksOnce, &createHeldLocksKey);
+	LockList* heldLocks = static_cast<LockList*> (pthread_getspecific(
+			heldLocksKey));
+	if (heldLocks == NULL) {
+		heldLocks = new LockList();
+		pthread_setspecific(heldLocksKey, heldLocks);
+	}
+	return *heldLocks;
+}
+
+/*
+ * findPath - Looks for a path of edges from \p from to \p to.
+ *
+ * @param path Storage for the locks along the path, starting with \p from.
+ *
+ * @pre graphMutex is held.
+ */
+bool findPath(const void* from, const void* to, std::vector<const void*>& path) {
+	path.push_back(from);
+	if (from == to) {
+		return true;
+	}
+
+	const LockGraph::const_iterator node = graph.find(from);
+	if (node != graph.end()) {
+		for (EdgeMap::const_iterator edge = node->second.begin(); edge
+				!= node->second.end(); ++edge) {
+			if (std::find(path.begin(), path.end(), edge->first) == path.end()
+					&& findPath(edge->first, to, path)) {
+				return true;
+			}
+		}
+	}
+
+	path.pop_back();
+	return false;
+}
+
+}
+
+/*
+ * acquiring - Checks a lock request against the lock order seen so far and
+ * records the new ordering edges.  Called before blocking on \p lock.
+ *
+ * @throw DeadlockException is thrown if taking \p lock while holding the
+ *        current thread's locks reverses an order that was used before.
+ */
+void LockOrder::acquiring(const void* lock) {
+	const LockList& heldLocks = getHeldLocks();
+	if (heldLocks.empty()) {
+		return;
+	}
+
+	std::string currentStack;
+	std::ostringstream conflict;
+
+	pthread_mutex_lock(&graphMutex);
+	for (LockList::const_iterator held = heldLocks.begin(); held
+			!= heldLocks.end(); ++held) {
+		if (*held == lock) {
+			continue;
+		}
+
+		EdgeMap& edges = graph[*held];
+		if (edges.find(lock) != edges.end()) {
+			continue;
+		}
+
+		// A new edge held -> lock closes a cycle if lock already leads back
+		// to held.
+		std::vector<const void*> path;
+		if (findPath(lock, *held, path)) {
+			conflict << "Lock order inversion: acquiring lock " << lock
+					<< " while holding lock " << *held
+					<< ", but the opposite order was established by:\n"
+					<< graph[path[0]][path[1]];
+			break;
+		}
+
+		if (currentStack.empty()) {
+			currentStack = SystemPosix::getCallStack();
+		}
+		edges[lock] = currentStack;
+	}
+	pthread_mutex_unlock(&graphMutex);
+
+	if (!conflict.str().empty()) {
+		throw DeadlockException(conflict.str() + "\nCurrent acquisition:\n"
+				+ SystemPosix::getCallStack(), LOCATION);
+	}
+} // end acquiring()
+
+/*
+ * acquired - Marks \p lock as held by the current thread.
+ */
+void LockOrder::acquired(const void* lock) {
+	getHeldLocks().push_back(lock);
+} // end acquired()
+
+/*
+ * released - Marks \p lock as no longer held by the current thread.
+ */
+void LockOrder::released(const void* lock) {
+	LockList& heldLocks = getHeldLocks();
+	for (LockList::iterator held = heldLocks.end(); held != heldLocks.begin();) {
+		--held;
+		if (*held == lock) {
+			heldLocks.erase(held);
+			break;
+		}
+	}
+} // end released()
+
+/*
+ * forget - Removes a lock that is being destroyed from the graph, so a new
+ * lock at the same address starts without history.
+ */
+void LockOrder::forget(const void* lock) {
+	pthread_mutex_lock(&graphMutex);
+	graph.erase(lock);
+	for (LockGraph::iterator node = graph.begin(); node != graph.end(); ++node) {
+		node->second.erase(lock);
+	}
+	pthread_mutex_unlock(&graphMutex);
+} // end forget()
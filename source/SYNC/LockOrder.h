@@ -0,0 +1,42 @@
+#ifndef LOCK_ORDER_H_
+#define LOCK_ORDER_H_
+
+#include <SYNC/DeadlockException.h>
+#include <SYNC/NullMutex.h>
+
+/*
+ * LockOrder - Lock-order checker for debug builds.  Guard, ReadGuard and
+ * WriteGuard report every acquisition and release made through them.  For
+ * each thread, LockOrder remembers which locks it holds, and whenever a lock
+ * is requested while others are held, it records "held before requested"
+ * edges in a process-wide graph, together with the call stack that
+ * established each edge.
+ *
+ * If a new edge would close a cycle, two threads can deadlock by taking the
+ * locks in opposite orders, even if they have not done so yet.  The request
+ * is refused with a DeadlockException carrying the call stacks of both
+ * orders, before the lock is touched.
+ *
+ * The hooks are only compiled in when DEBUG is defined, so release builds
+ * keep the plain acquire fast path.
+ */
+class LockOrder {
+public:
+	static void acquiring(const void* lock);
+	static void acquired(const void* lock);
+	static void released(const void* lock);
+	static void forget(const void* lock);
+
+	/* NullMutex never blocks, so it cannot take part in a deadlock: */
+	static void acquiring(const NullMutex*) {
+		;
+	}
+	static void acquired(const NullMutex*) {
+		;
+	}
+	static void released(const NullMutex*) {
+		;
+	}
+};
+
+#endif /* LOCK_ORDER_H_ */
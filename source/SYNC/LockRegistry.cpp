@@ -0,0 +1,260 @@
+#include <algorithm>
+#include <vector>
+
+#include <SYNC/Guard.h>
+#include <SYNC/LockRegistry.h>
+#include <UTIL/Metrics.h>
+#include <UTIL/System.h>
+
+volatile sig_atomic_t LockRegistry::dumpRequested = 0;
+
+namespace {
+
+/*
+ * findByName - Returns the entry of \p list with the given name, or NULL.
+ */
+LockStatistics* findByName(const std::list<LockStatistics*>& list,
+		const std::string& name) {
+	for (std::list<LockStatistics*>::const_iterator it = list.begin(); it
+			!= list.end(); ++it) {
+		if ((*it)->getName() == name) {
+			return *it;
+		}
+	}
+	return NULL;
+}
+
+/*
+ * deleteAll - Deletes the entries of a list returned by collect().
+ */
+void deleteAll(std::list<LockStatistics*>& list) {
+	for (std::list<LockStatistics*>::iterator it = list.begin(); it
+			!= list.end(); ++it) {
+		delete *it;
+	}
+	list.clear();
+}
+
+}
+
+/*
+ * LockRegistry - Constructor for LockRegistry class.
+ */
+LockRegistry::LockRegistry(void) {
+} // end LockRegistry()
+
+/*
+ * ~LockRegistry - Destructor for LockRegistry class.
+ */
+LockRegistry::~LockRegistry(void) {
+	deleteAll(retired);
+} // end ~LockRegistry()
+
+/*
+ * instance - Returns the process-wide registry.
+ *
+ * @note The registry is never destroyed, so locks with static storage
+ *       duration can still unregister themselves during exit.
+ */
+LockRegistry& LockRegistry::instance(void) {
+	static LockRegistry* registry = new LockRegistry();
+	return *registry;
+} // end instance()
+
+/*
+ * add - Registers the statistics of a lock.
+ *
+ * @param statistics Statistics owned by the lock.  They must be removed
+ *                   before they are destroyed.
+ */
+void LockRegistry::add(LockStatistics* statistics) {
+	Guard<MutexPosix> guard(registryLock);
+	live.push_back(statistics);
+} // end add()
+
+/*
+ * remove - Unregisters the statistics of a lock and keeps their totals in the
+ * retired entry of the same name.
+ */
+void LockRegistry::remove(LockStatistics* statistics) {
+	Guard<MutexPosix> guard(registryLock);
+	live.remove(statistics);
+
+	LockStatistics* entry = findByName(retired, statistics->getName());
+	if (entry == NULL) {
+		entry = new LockStatistics(statistics->getName());
+		retired.push_back(entry);
+	}
+	entry->merge(*statistics);
+} // end remove()
+
+/*
+ * collect - Returns one merged copy of the statistics per lock name.  The
+ * caller owns the returned objects.
+ *
+ * @pre registryLock is held.
+ */
+LockRegistry::StatisticsList LockRegistry::collect(void) const {
+	StatisticsList merged;
+	const StatisticsList* sources[] = { &retired, &live };
+
+	for (int i = 0; i < 2; ++i) {
+		for (StatisticsList::const_iterator it = sources[i]->begin(); it
+				!= sources[i]->end(); ++it) {
+			LockStatistics* entry = findByName(merged, (*it)->getName());
+			if (entry == NULL) {
+				entry = new LockStatistics((*it)->getName());
+				merged.push_back(entry);
+			}
+			entry->merge(**it);
+		}
+	}
+
+	return merged;
+} // end collect()
+
+/*
+ * dump - Prints the statistics of all locks, most contended first.
+ */
+void LockRegistry::dump(FILE* dest) const {
+	StatisticsList merged;
+	{
+		Guard<MutexPosix> guard(registryLock);
+		merged = collect();
+	}
+
+	std::vector<std::pair<Uint64, LockStatistics*> > order;
+	for (StatisticsList::iterator it = merged.begin(); it != merged.end(); ++it) {
+		order.push_back(std::make_pair((*it)->getWaitTime().getTotal(), *it));
+	}
+	std::sort(order.rbegin(), order.rend());
+
+	fprintf(dest, "\n------ Lock Statistics (%s) -----\n",
+			SystemPosix::getHostname().c_str());
+	for (size_t i = 0; i < order.size(); ++i) {
+		order[i].second->dump(dest);
+	}
+
+	deleteAll(merged);
+} // end dump()
+
+/*
+ * exportJSON - Writes the statistics of all locks to a JSON file.
+ *
+ * @param fileName The file to (over)write.
+ *
+ * @return \c true is returned if the file was written.
+ */
+bool LockRegistry::exportJSON(const std::string& fileName) const {
+	FILE* file = fopen(fileName.c_str(), "w");
+	if (file == NULL) {
+		return false;
+	}
+
+	StatisticsList merged;
+	{
+		Guard<MutexPosix> guard(registryLock);
+		merged = collect();
+	}
+
+	fprintf(file, "{ \"host\": \"%s\", \"locks\": [\n",
+			SystemPosix::getHostname().c_str());
+	for (StatisticsList::iterator it = merged.begin(); it != merged.end(); ++it) {
+		fprintf(file, "%s  ", it == merged.begin() ? "" : ",\n");
+		(*it)->writeJSON(file);
+	}
+	fprintf(file, "\n] }\n");
+
+	deleteAll(merged);
+	return fclose(file) == 0;
+} // end exportJSON()
+
+/*
+ * exportMetrics - Adds the statistics of all locks to a metrics snapshot,
+ * labelled with the lock name.  The wait and hold times become histograms
+ * in seconds with the power-of-two buckets of LockHistogram.
+ */
+void LockRegistry::exportMetrics(MetricsSnapshot& snapshot) const {
+	StatisticsList merged;
+	{
+		Guard<MutexPosix> guard(registryLock);
+		merged = collect();
+	}
+
+	std::vector<double> bounds;
+	for (int b = 1; b < LockHistogram::NUM_BUCKETS; ++b) {
+		bounds.push_back(double(Uint64(1) << b) * 1e-9);
+	}
+	std::vector<Uint64> buckets(LockHistogram::NUM_BUCKETS);
+
+	for (StatisticsList::iterator it = merged.begin(); it != merged.end(); ++it) {
+		const std::string lock = MetricsSnapshot::label("lock",
+				(*it)->getName());
+		snapshot.addCounter("rocket_lock_acquisitions_total",
+				"Acquisitions of the lock", lock, (*it)->getAcquisitions());
+		snapshot.addCounter("rocket_lock_contended_total",
+				"Acquisitions of the lock that had to wait", lock,
+				(*it)->getContended());
+
+		const LockHistogram* histograms[] = { &(*it)->getWaitTime(),
+				&(*it)->getHoldTime() };
+		const char* names[] = { "rocket_lock_wait_seconds",
+				"rocket_lock_hold_seconds" };
+		const char* help[] = { "Time spent waiting for the lock when contended",
+				"Time the lock was held exclusively" };
+		for (int h = 0; h < 2; ++h) {
+			for (int b = 0; b < LockHistogram::NUM_BUCKETS; ++b) {
+				buckets[b] = histograms[h]->getBucket(b);
+			}
+			snapshot.addHistogram(names[h], help[h], lock, bounds, buckets,
+					double(histograms[h]->getTotal()) * 1e-9);
+		}
+	}
+
+	deleteAll(merged);
+} // end exportMetrics()
+
+/*
+ * collectMetrics - Exports the registry's statistics as a MetricsCollector,
+ * for Metrics::addCollector().
+ */
+void LockRegistry::collectMetrics(MetricsSnapshot& snapshot, void*) {
+	instance().exportMetrics(snapshot);
+} // end collectMetrics()
+
+/*
+ * installSignalHandler - Makes the given signal request a dump.  The dump
+ * itself happens in the next call to poll(), since printing is not safe
+ * inside a signal handler.
+ */
+void LockRegistry::installSignalHandler(int signalNumber) {
+	struct sigaction action;
+	action.sa_handler = &LockRegistry::signalHandler;
+	sigemptyset(&action.sa_mask);
+	action.sa_flags = SA_RESTART;
+	sigaction(signalNumber, &action, NULL);
+} // end installSignalHandler()
+
+/*
+ * poll - Performs a dump requested through the signal handler.  The
+ * statistics are printed to stderr and, if the ROCKET_LOCK_PROFILE
+ * environment variable names a file, exported to it as well.
+ */
+void LockRegistry::poll(void) {
+	if (dumpRequested) {
+		dumpRequested = 0;
+		dump(stderr);
+
+		std::string fileName;
+		if (SystemPosix::getenv("ROCKET_LOCK_PROFILE", fileName)) {
+			exportJSON(fileName);
+		}
+	}
+} // end poll()
+
+/*
+ * signalHandler - Flags a pending dump.
+ */
+void LockRegistry::signalHandler(int) {
+	dumpRequested = 1;
+} // end signalHandler()
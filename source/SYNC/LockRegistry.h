@@ -0,0 +1,56 @@
+#ifndef LOCK_REGISTRY_H_
+#define LOCK_REGISTRY_H_
+
+#include <csignal>
+#include <cstdio>
+#include <list>
+#include <string>
+
+/* Boost includes */
+#include <boost/noncopyable.hpp>
+
+#include <SYNC/LockStatistics.h>
+#include <SYNC/MutexPosix.h>
+
+class MetricsSnapshot;
+
+/*
+ * LockRegistry - Process-wide list of the statistics of all instrumented
+ * locks.  Locks register themselves on construction.  When a lock is
+ * destroyed, its statistics are folded into a retired entry of the same name,
+ * so per-context locks still show up in the end-of-session report.
+ *
+ * @see InstrumentedMutex
+ */
+class LockRegistry: boost::noncopyable {
+public:
+	static LockRegistry& instance(void);
+
+	void add(LockStatistics* statistics);
+	void remove(LockStatistics* statistics);
+
+	void dump(FILE* dest = stderr) const;
+	bool exportJSON(const std::string& fileName) const;
+	void exportMetrics(MetricsSnapshot& snapshot) const;
+	static void collectMetrics(MetricsSnapshot& snapshot, void* context);
+
+	static void installSignalHandler(int signalNumber = SIGUSR1);
+	void poll(void);
+
+private:
+	typedef std::list<LockStatistics*> StatisticsList;
+
+	LockRegistry(void);
+	~LockRegistry(void);
+
+	StatisticsList collect(void) const;
+
+	mutable MutexPosix registryLock;
+	StatisticsList live; /**< Statistics of locks that still exist */
+	StatisticsList retired; /**< Owned; one entry per name */
+
+	static volatile sig_atomic_t dumpRequested;
+	static void signalHandler(int signalNumber);
+};
+
+#endif /* LOCK_REGISTRY_H_ */
@@ -0,0 +1,190 @@
+#include <SYNC/LockStatistics.h>
+
+/*****************************************
+ Methods of class LockHistogram:
+ *****************************************/
+
+/*
+ * LockHistogram - Constructor for LockHistogram class.
+ */
+LockHistogram::LockHistogram(void) :
+	total(0) {
+	for (int i = 0; i < NUM_BUCKETS; ++i) {
+		buckets[i] = 0;
+	}
+} // end LockHistogram()
+
+/*
+ * getCount - Returns the number of recorded durations.
+ */
+Uint64 LockHistogram::getCount(void) const {
+	Uint64 count(0);
+	for (int i = 0; i < NUM_BUCKETS; ++i) {
+		count += Atomic::loadRelaxed(&buckets[i]);
+	}
+	return count;
+} // end getCount()
+
+/*
+ * getTotal - Returns the sum of all recorded durations in nanoseconds.
+ */
+Uint64 LockHistogram::getTotal(void) const {
+	return Atomic::loadRelaxed(&total);
+} // end getTotal()
+
+/*
+ * getBucket - Returns the number of durations recorded in the given bucket.
+ */
+Uint64 LockHistogram::getBucket(int bucket) const {
+	return Atomic::loadRelaxed(&buckets[bucket]);
+} // end getBucket()
+
+/*
+ * getPercentile - Estimates a percentile of the recorded durations.
+ *
+ * @param percentile The percentile to estimate, between 0 and 100.
+ *
+ * @return The upper bound in nanoseconds of the bucket that contains the
+ *         percentile, or 0 if nothing was recorded.
+ */
+Uint64 LockHistogram::getPercentile(double percentile) const {
+	const Uint64 count = getCount();
+	if (count == 0) {
+		return 0;
+	}
+
+	const Uint64 rank = Uint64(percentile / 100.0 * double(count - 1)) + 1;
+	Uint64 seen(0);
+	for (int i = 0; i < NUM_BUCKETS; ++i) {
+		seen += Atomic::loadRelaxed(&buckets[i]);
+		if (seen >= rank) {
+			return Uint64(2) << i;
+		}
+	}
+	return Uint64(2) << (NUM_BUCKETS - 1);
+} // end getPercentile()
+
+/*
+ * merge - Adds the durations recorded in \p other to this histogram.
+ */
+void LockHistogram::merge(const LockHistogram& other) {
+	for (int i = 0; i < NUM_BUCKETS; ++i) {
+		Atomic::fetchAddRelaxed(&buckets[i], other.getBucket(i));
+	}
+	Atomic::fetchAddRelaxed(&total, other.getTotal());
+} // end merge()
+
+/*****************************************
+ Methods of class LockStatistics:
+ *****************************************/
+
+/*
+ * LockStatistics - Constructor for LockStatistics class.
+ *
+ * @param _name The name under which the lock is reported.
+ */
+LockStatistics::LockStatistics(const std::string& _name) :
+	name(_name), acquisitions(0), contended(0) {
+} // end LockStatistics()
+
+/*
+ * getName - Returns the name of the lock.
+ */
+const std::string& LockStatistics::getName(void) const {
+	return name;
+} // end getName()
+
+/*
+ * getAcquisitions - Returns the number of times the lock was acquired.
+ */
+Uint64 LockStatistics::getAcquisitions(void) const {
+	return Atomic::loadRelaxed(&acquisitions);
+} // end getAcquisitions()
+
+/*
+ * getContended - Returns the number of acquisitions that had to wait.
+ */
+Uint64 LockStatistics::getContended(void) const {
+	return Atomic::loadRelaxed(&contended);
+} // end getContended()
+
+/*
+ * getWaitTime - Returns the histogram of times spent waiting for the lock.
+ */
+const LockHistogram& LockStatistics::getWaitTime(void) const {
+	return waitTime;
+} // end getWaitTime()
+
+/*
+ * getHoldTime - Returns the histogram of times the lock was held.
+ */
+const LockHistogram& LockStatistics::getHoldTime(void) const {
+	return holdTime;
+} // end getHoldTime()
+
+/*
+ * merge - Adds the statistics of \p other to this object.  Used to fold the
+ * statistics of several locks with the same name (one per GL context, for
+ * example) into one report entry.
+ */
+void LockStatistics::merge(const LockStatistics& other) {
+	Atomic::fetchAddRelaxed(&acquisitions, other.getAcquisitions());
+	Atomic::fetchAddRelaxed(&contended, other.getContended());
+	waitTime.merge(other.waitTime);
+	holdTime.merge(other.holdTime);
+} // end merge()
+
+/*
+ * dump - Prints a human-readable summary of the statistics.
+ */
+void LockStatistics::dump(FILE* dest) const {
+	const Uint64 acquired = getAcquisitions();
+	const Uint64 waited = getContended();
+
+	fprintf(dest, "%s: %lu acquisitions, %lu contended (%.2f%%)\n",
+			name.c_str(), acquired, waited, acquired == 0 ? 0.0 : 100.0
+					* double(waited) / double(acquired));
+	if (waited != 0) {
+		fprintf(dest, "   wait ns: mean %lu  p50 <%lu  p99 <%lu  total %lu\n",
+				waitTime.getTotal() / waited, waitTime.getPercentile(50.0),
+				waitTime.getPercentile(99.0), waitTime.getTotal());
+	}
+	const Uint64 held = holdTime.getCount();
+	if (held != 0) {
+		fprintf(dest, "   hold ns: mean %lu  p50 <%lu  p99 <%lu  total %lu\n",
+				holdTime.getTotal() / held, holdTime.getPercentile(50.0),
+				holdTime.getPercentile(99.0), holdTime.getTotal());
+	}
+} // end dump()
+
+/*
+ * writeHistogram - Writes the non-empty buckets of a histogram as a JSON
+ * object mapping bucket upper bounds (ns) to counts.
+ */
+static void writeHistogram(FILE* dest, const LockHistogram& histogram) {
+	fprintf(dest, "{ \"count\": %lu, \"total_ns\": %lu, \"buckets\": {",
+			histogram.getCount(), histogram.getTotal());
+	bool first(true);
+	for (int i = 0; i < LockHistogram::NUM_BUCKETS; ++i) {
+		const Uint64 count = histogram.getBucket(i);
+		if (count != 0) {
+			fprintf(dest, "%s \"%lu\": %lu", first ? "" : ",", Uint64(2) << i,
+					count);
+			first = false;
+		}
+	}
+	fprintf(dest, " } }");
+} // end writeHistogram()
+
+/*
+ * writeJSON - Writes the statistics as a JSON object.
+ */
+void LockStatistics::writeJSON(FILE* dest) const {
+	fprintf(dest, "{ \"name\": \"%s\", \"acquisitions\": %lu, "
+		"\"contended\": %lu,\n    \"wait\": ", name.c_str(), getAcquisitions(),
+			getContended());
+	writeHistogram(dest, waitTime);
+	fprintf(dest, ",\n    \"hold\": ");
+	writeHistogram(dest, holdTime);
+	fprintf(dest, " }");
+} // end writeJSON()
@@ -0,0 +1,96 @@
+#ifndef LOCK_STATISTICS_H_
+#define LOCK_STATISTICS_H_
+
+#include <cstdio>
+#include <string>
+
+#include <SYNC/Atomic.h>
+#include <UTIL/Types.h>
+
+/*
+ * LockHistogram - Histogram of durations in nanoseconds with one bucket per
+ * power of two.  Bucket \c i counts durations in [2^i, 2^(i+1)) ns; bucket 0
+ * also counts durations of 0 ns.  Recording is wait-free and safe to do from
+ * several threads at once.
+ */
+class LockHistogram {
+public:
+	enum {
+		NUM_BUCKETS = 40 /**< The last bucket catches everything >= 2^39 ns */
+	};
+
+	LockHistogram(void);
+
+	/*
+	 * record - Adds one duration to the histogram.
+	 *
+	 * @param nanoseconds The duration to add.
+	 */
+	void record(Uint64 nanoseconds) {
+		int bucket = nanoseconds == 0 ? 0 : 63 - __builtin_clzl(nanoseconds);
+		if (bucket >= NUM_BUCKETS) {
+			bucket = NUM_BUCKETS - 1;
+		}
+		Atomic::fetchAddRelaxed(&buckets[bucket], Uint64(1));
+		Atomic::fetchAddRelaxed(&total, nanoseconds);
+	} // end record()
+
+	Uint64 getCount(void) const;
+	Uint64 getTotal(void) const;
+	Uint64 getBucket(int bucket) const;
+	Uint64 getPercentile(double percentile) const;
+	void merge(const LockHistogram& other);
+
+private:
+	volatile Uint64 buckets[NUM_BUCKETS];
+	volatile Uint64 total; /**< Sum of all recorded durations */
+};
+
+/*
+ * LockStatistics - Contention statistics of one named lock: how often it was
+ * acquired, how often the caller had to wait, and how long it waited for and
+ * held the lock.
+ */
+class LockStatistics {
+public:
+	explicit LockStatistics(const std::string& _name);
+
+	const std::string& getName(void) const;
+
+	/*
+	 * recordAcquisition - Counts one acquisition and the time spent waiting
+	 * for it.  A zero \p waitNanoseconds marks an uncontended acquisition.
+	 */
+	void recordAcquisition(Uint64 waitNanoseconds) {
+		Atomic::fetchAddRelaxed(&acquisitions, Uint64(1));
+		if (waitNanoseconds != 0) {
+			Atomic::fetchAddRelaxed(&contended, Uint64(1));
+			waitTime.record(waitNanoseconds);
+		}
+	} // end recordAcquisition()
+
+	/*
+	 * recordHold - Records how long the lock was held exclusively.
+	 */
+	void recordHold(Uint64 holdNanoseconds) {
+		holdTime.record(holdNanoseconds);
+	} // end recordHold()
+
+	Uint64 getAcquisitions(void) const;
+	Uint64 getContended(void) const;
+	const LockHistogram& getWaitTime(void) const;
+	const LockHistogram& getHoldTime(void) const;
+
+	void merge(const LockStatistics& other);
+	void dump(FILE* dest) const;
+	void writeJSON(FILE* dest) const;
+
+private:
+	std::string name;
+	volatile Uint64 acquisitions;
+	volatile Uint64 contended;
+	LockHistogram waitTime; /**< Only contended acquisitions are recorded */
+	LockHistogram holdTime;
+};
+
+#endif /* LOCK_STATISTICS_H_ */
@@ -7,6 +7,8 @@
  */
 
 #include <SYNC/MutexPosix.h>
+#include <SYNC/RWMutexPosix.h>
+#include <SYNC/SpinMutex.h>
 #include <SYNC/NullMutex.h>
 
 #endif	/* MUTEX_H_ */
@@ -18,6 +18,9 @@
 
 #include <SYNC/LockException.h>
 #include <SYNC/DeadlockException.h>
+#ifdef DEBUG
+#include <SYNC/LockOrder.h>
+#endif
 
 /*
  * MutexPosix - Mutex wrapper for POSIX-compliant systems using pthreads mutex
@@ -33,6 +36,9 @@ public:
 	 * @post The mutex variable is destroyed.
 	 */
 	~MutexPosix(void) {
+#ifdef DEBUG
+		LockOrder::forget(this);
+#endif
 		const int result = pthread_mutex_destroy(&mutex);
 		assert(result == 0);
 		boost::ignore_unused_variable_warning(result);
@@ -81,7 +87,8 @@ public:
 	 *       lock has already been acquired by another thread, the caller
 	 *       blocks until the mutex has been freed.
 	 *
-	 * @note No special read lock has been defined for now.
+	 * @note This is an exclusive lock.  Use RWMutexPosix when readers should
+	 *       be able to share it.
 	 */
 	void acquireRead(void) {
 		this->acquire();
@@ -94,7 +101,8 @@ public:
 	 *       lock has already been acquired by another thread, the caller
 	 *       blocks until the mutex has been freed.
 	 *
-	 * @note No special write lock has been defined for now.
+	 * @note This is an exclusive lock.  Use RWMutexPosix when readers should
+	 *       be able to share it.
 	 */
 	void acquireWrite(void)
 	{
@@ -168,7 +176,7 @@ public:
 
 	bool test(void) const;
 
-	// Allow the CondPosix class to access the private and protected
+	// Allow the CondVarPosix class to access the private and protected
 	// members of this class.  Specifically, direct access is needed to the
 	// mutex variable.
 	friend class CondVarPosix;
@@ -0,0 +1,294 @@
+#include <cstring>
+#include <sstream>
+#include <assert.h>
+
+/* Boost includes */
+#include <boost/concept_check.hpp>
+
+#include <SYNC/RWMutexPosix.h>
+#ifdef DEBUG
+#include <SYNC/LockOrder.h>
+#endif
+#include <UTIL/ResourceException.h>
+
+/**
+ * RWMutexPosix - Constructor for RWMutexPosix class.
+ *
+ * @post The lock is initialized, unlocked and ready for use.
+ *
+ * @throw ResourceException is thrown if the underlying pthreads objects
+ *        cannot be allocated.
+ */
+RWMutexPosix::RWMutexPosix(void) :
+	readers(0), waitingWriters(0), writer(false), upgrader(false) {
+	int result = pthread_mutex_init(&mutex, NULL);
+
+	if (result == 0) {
+		result = pthread_cond_init(&readCond, NULL);
+		if (result == 0) {
+			result = pthread_cond_init(&writeCond, NULL);
+			if (result != 0) {
+				pthread_cond_destroy(&readCond);
+			}
+		}
+		if (result != 0) {
+			pthread_mutex_destroy(&mutex);
+		}
+	}
+
+	if (result != 0) {
+		std::ostringstream msg_stream;
+		msg_stream << "Read/write mutex allocation failed: " << std::strerror(
+				result);
+		throw ResourceException(msg_stream.str(), LOCATION);
+	}
+} // end RWMutexPosix()
+
+/**
+ * ~RWMutexPosix - Destructor for RWMutexPosix class.
+ *
+ * @pre No thread should hold or wait for the lock.
+ */
+RWMutexPosix::~RWMutexPosix(void) {
+#ifdef DEBUG
+	LockOrder::forget(this);
+#endif
+	int result = pthread_cond_destroy(&writeCond);
+	assert(result == 0);
+	result = pthread_cond_destroy(&readCond);
+	assert(result == 0);
+	result = pthread_mutex_destroy(&mutex);
+	assert(result == 0);
+	boost::ignore_unused_variable_warning(result);
+} // end ~RWMutexPosix()
+
+/*
+ * acquireRead - Acquires a shared (read) lock on this mutex.
+ *
+ * @post The caller shares the lock with any other readers.  If a writer holds
+ *       the lock or is waiting for it, the caller blocks until the writer has
+ *       released it.
+ */
+void RWMutexPosix::acquireRead(void) {
+	pthread_mutex_lock(&mutex);
+	while (writer || waitingWriters > 0) {
+		pthread_cond_wait(&readCond, &mutex);
+	}
+	++readers;
+	pthread_mutex_unlock(&mutex);
+} // end acquireRead()
+
+/*
+ * acquireWrite - Acquires an exclusive (write) lock on this mutex.
+ *
+ * @post The caller holds the lock exclusively.  New readers are held back
+ *       while the caller waits for the current readers to drain.
+ *
+ * @throw DeadlockException is thrown if the current thread holds the
+ *        upgradable lock; use upgrade() instead.
+ */
+void RWMutexPosix::acquireWrite(void) {
+	pthread_mutex_lock(&mutex);
+	if (ownsUpgrade()) {
+		pthread_mutex_unlock(&mutex);
+		throw DeadlockException(
+				"Tried to write lock a read/write mutex while holding its upgradable lock",
+				LOCATION);
+	}
+	++waitingWriters;
+	while (writer || readers > 0) {
+		pthread_cond_wait(&writeCond, &mutex);
+	}
+	--waitingWriters;
+	writer = true;
+	pthread_mutex_unlock(&mutex);
+} // end acquireWrite()
+
+/*
+ * acquireUpgrade - Acquires a shared lock on this mutex that can later be
+ * upgraded to an exclusive lock with upgrade().
+ *
+ * @post The caller shares the lock with any plain readers.  Only one thread
+ *       at a time may hold the upgradable lock.
+ */
+void RWMutexPosix::acquireUpgrade(void) {
+	pthread_mutex_lock(&mutex);
+	while (writer || waitingWriters > 0 || upgrader) {
+		pthread_cond_wait(&readCond, &mutex);
+	}
+	++readers;
+	upgrader = true;
+	upgraderThread = pthread_self();
+	pthread_mutex_unlock(&mutex);
+} // end acquireUpgrade()
+
+/*
+ * tryAcquireRead - Tries to acquire a shared (read) lock on this mutex (does
+ * not block).
+ *
+ * @return \c true is returned if the lock is acquired, and \c false is
+ *         returned if a writer holds or is waiting for the lock.
+ */
+bool RWMutexPosix::tryAcquireRead(void) {
+	bool acquired(false);
+
+	pthread_mutex_lock(&mutex);
+	if (!writer && waitingWriters == 0) {
+		++readers;
+		acquired = true;
+	}
+	pthread_mutex_unlock(&mutex);
+
+	return acquired;
+} // end tryAcquireRead()
+
+/*
+ * tryAcquireWrite - Tries to acquire an exclusive (write) lock on this mutex
+ * (does not block).
+ *
+ * @return \c true is returned if the lock is acquired, and \c false is
+ *         returned if any reader or writer holds the lock.
+ */
+bool RWMutexPosix::tryAcquireWrite(void) {
+	bool acquired(false);
+
+	pthread_mutex_lock(&mutex);
+	if (!writer && readers == 0) {
+		writer = true;
+		acquired = true;
+	}
+	pthread_mutex_unlock(&mutex);
+
+	return acquired;
+} // end tryAcquireWrite()
+
+/*
+ * upgrade - Converts the upgradable lock held by the current thread into an
+ * exclusive lock.
+ *
+ * @pre The current thread holds the upgradable lock.
+ * @post The caller holds the lock exclusively.  The lock was never released
+ *       in between, so state read under the upgradable lock is still valid.
+ *
+ * @throw LockException is thrown if the current thread does not hold the
+ *        upgradable lock.
+ */
+void RWMutexPosix::upgrade(void) {
+	pthread_mutex_lock(&mutex);
+	if (!ownsUpgrade() || writer) {
+		pthread_mutex_unlock(&mutex);
+		throw LockException(
+				"Tried to upgrade a read/write mutex without holding its upgradable lock",
+				LOCATION);
+	}
+
+	// Count as a waiting writer so that no new readers get in, then wait for
+	// everyone but ourselves to leave.
+	++waitingWriters;
+	while (readers > 1) {
+		pthread_cond_wait(&writeCond, &mutex);
+	}
+	--waitingWriters;
+	--readers;
+	writer = true;
+	pthread_mutex_unlock(&mutex);
+} // end upgrade()
+
+/*
+ * downgrade - Converts the exclusive lock held by the current thread into a
+ * shared lock.
+ *
+ * @pre The current thread holds the write lock.
+ * @post The caller holds a read lock (the upgradable one if the write lock
+ *       was obtained through upgrade()), and blocked readers are woken up.
+ */
+void RWMutexPosix::downgrade(void) {
+	pthread_mutex_lock(&mutex);
+	if (!writer) {
+		pthread_mutex_unlock(&mutex);
+		throw LockException(
+				"Tried to downgrade a read/write mutex that is not write locked",
+				LOCATION);
+	}
+	writer = false;
+	++readers;
+	if (waitingWriters == 0) {
+		pthread_cond_broadcast(&readCond);
+	}
+	pthread_mutex_unlock(&mutex);
+} // end downgrade()
+
+/*
+ * release - Releases the lock held by the current thread, whichever mode it
+ * was acquired in.
+ *
+ * @post Waiting writers are woken up first; readers are only woken up if no
+ *       writer is waiting.
+ *
+ * @throw LockException is thrown if the mutex is not locked.
+ */
+void RWMutexPosix::release(void) {
+	pthread_mutex_lock(&mutex);
+
+	if (writer) {
+		writer = false;
+		if (ownsUpgrade()) {
+			upgrader = false;
+		}
+	} else if (readers > 0) {
+		--readers;
+		if (ownsUpgrade()) {
+			upgrader = false;
+		}
+	} else {
+		pthread_mutex_unlock(&mutex);
+		throw LockException("Tried to release a read/write mutex that is not locked",
+				LOCATION);
+	}
+
+	if (waitingWriters > 0) {
+		// Both plain writers and an upgrading reader wait on writeCond, each
+		// for a different condition, so all of them have to re-check.
+		if (readers <= 1) {
+			pthread_cond_broadcast(&writeCond);
+		}
+	} else {
+		pthread_cond_broadcast(&readCond);
+	}
+
+	pthread_mutex_unlock(&mutex);
+} // end release()
+
+/*
+ * test - Tests the current lock status.
+ *
+ * @return \c true is returned if any reader or writer holds this mutex.
+ *         \c false is returned otherwise.
+ */
+bool RWMutexPosix::test(void) const {
+	pthread_mutex_lock(&mutex);
+	const bool locked = writer || readers > 0;
+	pthread_mutex_unlock(&mutex);
+
+	return locked;
+} // end test()
+
+/*
+ * dump - Dumps the mutex debug stuff and current state.
+ */
+void RWMutexPosix::dump(FILE* dest, const char* message) const {
+	pthread_mutex_lock(&mutex);
+	fprintf(dest, "%sRW Mutex: readers=%d writer=%d upgrader=%d "
+		"waitingWriters=%d\n", message, readers, writer ? 1 : 0,
+			upgrader ? 1 : 0, waitingWriters);
+	pthread_mutex_unlock(&mutex);
+} // end dump()
+
+/*
+ * ownsUpgrade - Tells if the current thread holds the upgradable lock.
+ *
+ * @pre The internal mutex is locked.
+ */
+bool RWMutexPosix::ownsUpgrade(void) const {
+	return upgrader && pthread_equal(upgraderThread, pthread_self());
+} // end ownsUpgrade()
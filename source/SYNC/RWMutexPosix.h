@@ -0,0 +1,90 @@
+/*
+ * RWMutexPosix
+ *
+ * @note This file must be included by SYNC/Mutex.h, not the other way around.
+ */
+
+#ifndef RW_MUTEX_POSIX_H_
+#define RW_MUTEX_POSIX_H_
+
+#include <cstdio>
+#include <pthread.h>
+
+/* Boost includes */
+#include <boost/noncopyable.hpp>
+
+#include <SYNC/LockException.h>
+#include <SYNC/DeadlockException.h>
+
+/*
+ * RWMutexPosix - Shared/exclusive (reader-writer) lock for POSIX-compliant
+ * systems.  Any number of readers may hold the lock at the same time, while a
+ * writer holds it exclusively.  The lock is writer-preferring: once a writer
+ * is waiting, new readers block until it has been served, so a steady stream
+ * of render threads cannot starve an update.
+ *
+ * One reader at a time may hold the lock in upgradable mode.  An upgradable
+ * reader shares the lock with plain readers and can later be converted into a
+ * writer with upgrade() without releasing it in between.
+ *
+ * acquire(), tryAcquire() and release() use exclusive mode, so the lock can be
+ * used with Guard<>.  Use ReadGuard<> and WriteGuard<> to select the mode
+ * explicitly.
+ *
+ * @note Read locks are not recursive.  A thread that already holds a read lock
+ *       and requests another one deadlocks as soon as a writer is waiting.
+ */
+class RWMutexPosix: boost::noncopyable {
+public:
+	RWMutexPosix(void);
+	~RWMutexPosix(void);
+
+	/*
+	 * acquire - Acquires an exclusive (write) lock on this mutex.
+	 */
+	void acquire(void) {
+		this->acquireWrite();
+	} // end acquire()
+
+	void acquireRead(void);
+	void acquireWrite(void);
+	void acquireUpgrade(void);
+
+	/*
+	 * tryAcquire - Tries to acquire an exclusive (write) lock on this mutex
+	 * (does not block).
+	 *
+	 * @return \c true is returned if the lock is acquired, and \c false is
+	 *         returned otherwise.
+	 */
+	bool tryAcquire(void) {
+		return this->tryAcquireWrite();
+	} // end tryAcquire()
+
+	bool tryAcquireRead(void);
+	bool tryAcquireWrite(void);
+
+	void upgrade(void);
+	void downgrade(void);
+
+	void release(void);
+
+	bool test(void) const;
+
+	void dump(FILE* dest = stderr, const char* message =
+			"\n------ Mutex Dump -----\n") const;
+
+private:
+	bool ownsUpgrade(void) const;
+
+	mutable pthread_mutex_t mutex;
+	pthread_cond_t readCond; /**< Readers and upgraders wait here */
+	pthread_cond_t writeCond; /**< Writers and an upgrading reader wait here */
+	int readers; /**< Number of readers, including the upgradable one */
+	int waitingWriters; /**< Writers (and upgrades) waiting for the lock */
+	bool writer; /**< Is a writer holding the lock */
+	bool upgrader; /**< Is the upgradable slot taken */
+	pthread_t upgraderThread; /**< Owner of the upgradable slot */
+};
+
+#endif  /* RW_MUTEX_POSIX_H_ */
@@ -0,0 +1,101 @@
+#ifndef READ_GUARD_H_
+#define READ_GUARD_H_
+
+#ifdef DEBUG
+#include <SYNC/LockOrder.h>
+#endif
+
+/*
+ * ReadGuard - Scoped wrapper for the read side of a lock.  The lock type
+ * must provide acquireRead(), tryAcquireRead() and release(), as
+ * RWMutexPosix, MutexPosix and NullMutex do.
+ *
+ * @see Guard
+ */
+template<class LOCK_TYPE>
+class ReadGuard {
+public:
+	/**
+	 * ReadGuard - Acquires a read lock implicitly. If \p block is true, then
+	 * use a blocking mutex acquisition operation. Otherwise, use a
+	 * non-blocking acquisition call.
+	 *
+	 * @post \c lockStatus reflects whether the given lock was acquired.
+	 *
+	 * @param lock  The mutex to associate with this guard.
+	 * @param block A flag indicating whether a blocking acquisition operation
+	 *              should be used to acquire the lock. This parameter is
+	 *              optional and defaults to true if it is not specified.
+	 */
+	ReadGuard(LOCK_TYPE& lock, const bool block = true) :
+		theLock(&lock) {
+		lockStatus = block ? acquire() : tryAcquire();
+	} // end ReadGuard()
+
+	/*
+	 * ~ReadGuard - Releases the lock.
+	 */
+	~ReadGuard(void) {
+		if (lockStatus) {
+#ifdef DEBUG
+			LockOrder::released(theLock);
+#endif
+			theLock->release();
+		}
+	} // end ~ReadGuard()
+
+	/**
+	 * locked - Indicates whether this guard is currently locked.
+	 *
+	 * @return \c true is returned if this guard is locked; \c false is
+	 *         returned otherwise.
+	 */
+	bool locked(void) const {
+		return lockStatus;
+	} // end locked()
+
+	/*
+	 * acquire - Acquires a read lock.
+	 */
+	bool acquire(void) {
+#ifdef DEBUG
+		LockOrder::acquiring(theLock);
+#endif
+		theLock->acquireRead();
+#ifdef DEBUG
+		LockOrder::acquired(theLock);
+#endif
+		lockStatus = true;
+		return lockStatus;
+	} // end acquire()
+
+	/*
+	 * tryAcquire - Tries to acquire a read lock.
+	 */
+	bool tryAcquire(void) {
+		lockStatus = theLock->tryAcquireRead();
+#ifdef DEBUG
+		if (lockStatus) {
+			LockOrder::acquired(theLock);
+		}
+#endif
+		return lockStatus;
+	} // end tryAcquire()
+
+	/*
+	 * release - Explicity releases the lock.
+	 */
+	void release(void) {
+		lockStatus = false;
+#ifdef DEBUG
+		LockOrder::released(theLock);
+#endif
+		theLock->release();
+	} // end release()
+
+private:
+	LOCK_TYPE* theLock; /**< The lock that we are using */
+	bool lockStatus; /**< Are we locked or not */
+};
+
+#endif /* READ_GUARD_H_ */
@@ -0,0 +1,89 @@
+#ifndef SEQ_LOCK_H_
+#define SEQ_LOCK_H_
+
+/* Boost includes */
+#include <boost/noncopyable.hpp>
+
+#include <SYNC/Atomic.h>
+#include <UTIL/Types.h>
+
+/*
+ * SeqLock - Publishes snapshots of a value from one writer thread to any
+ * number of reader threads without locks.  The writer fills the oldest of
+ * three buffers and then makes it the current one; readers copy the current
+ * buffer and use its sequence number to check that the writer did not reuse
+ * the buffer while they were copying.
+ *
+ * Because the writer always writes a buffer other than the one it published
+ * last, a reader only has to retry if the writer publishes two more
+ * snapshots during a single copy.  With one publish per frame, readers in
+ * practice never retry and never wait.
+ *
+ * @param VALUE_TYPE Plain data type (copyable with assignment, no pointers
+ *                   to shared state) of the snapshots.
+ */
+template<class VALUE_TYPE>
+class SeqLock: boost::noncopyable {
+public:
+	SeqLock(void) :
+		current(0) {
+		for (int i = 0; i < NUM_BUFFERS; ++i) {
+			buffers[i].sequence = 0;
+		}
+	} // end SeqLock()
+
+	/*
+	 * publish - Makes \p value the current snapshot.  Must only be called by
+	 * one thread at a time.
+	 */
+	void publish(const VALUE_TYPE& value) {
+		const Uint32 next = (Atomic::loadRelaxed(&current) + 1) % NUM_BUFFERS;
+		Buffer& buffer = buffers[next];
+
+		// An odd sequence number marks the buffer as being written.
+		const Uint32 sequence = Atomic::loadRelaxed(&buffer.sequence);
+		Atomic::storeRelaxed(&buffer.sequence, sequence + 1);
+		Atomic::fence();
+		buffer.value = value;
+		Atomic::store(&buffer.sequence, sequence + 2);
+
+		Atomic::store(&current, next);
+	} // end publish()
+
+	/*
+	 * read - Copies the current snapshot.  Safe to call from any thread at
+	 * any time.
+	 *
+	 * @param value Storage for the snapshot.
+	 */
+	void read(VALUE_TYPE& value) const {
+		for (;;) {
+			const Buffer& buffer = buffers[Atomic::load(&current)];
+			const Uint32 before = Atomic::load(&buffer.sequence);
+
+			if ((before & 1) == 0) {
+				value = buffer.value;
+				Atomic::fence();
+				if (Atomic::loadRelaxed(&buffer.sequence) == before) {
+					return;
+				}
+			}
+			Atomic::cpuRelax();
+		}
+	} // end read()
+
+private:
+	enum {
+		NUM_BUFFERS = 3
+	};
+
+	struct Buffer {
+		volatile Uint32 sequence; /**< Odd while the writer fills value */
+		VALUE_TYPE value;
+	};
+
+	Buffer buffers[NUM_BUFFERS];
+	volatile Uint32 current; /**< Index of the last published buffer */
+};
+
+#endif /* SEQ_LOCK_H_ */
@@ -0,0 +1,66 @@
+#include <SYNC/SpinMutex.h>
+
+namespace {
+
+/* Upper bound on the number of spin rounds before parking. */
+const Int32 MAX_SPIN = 100;
+
+/* Upper bound on the number of pause instructions per spin round. */
+const Int32 MAX_BACKOFF = 64;
+
+}
+
+/*
+ * acquireContended - Slow path of acquire().  Spins with exponential backoff
+ * for up to twice the usual number of rounds this lock needed, then parks on
+ * the futex until the holder releases it.
+ *
+ * @post A lock on the mutex is acquired by the caller.
+ */
+void SpinMutex::acquireContended(void) {
+	if (Futex::isSpinningUseful()) {
+		const Int32 estimate = Atomic::loadRelaxed(&spinEstimate);
+		const Int32 limit = estimate * 2 + 10 < MAX_SPIN ? estimate * 2 + 10
+				: MAX_SPIN;
+		Int32 backoff = 1;
+
+		for (Int32 spins = 0; spins < limit; ++spins) {
+			for (Int32 i = 0; i < backoff; ++i) {
+				Atomic::cpuRelax();
+			}
+			if (backoff < MAX_BACKOFF) {
+				backoff <<= 1;
+			}
+
+			if (Atomic::loadRelaxed(&state) == UNLOCKED
+					&& Atomic::compareAndSwap(&state, Int32(UNLOCKED),
+							Int32(LOCKED))) {
+				// Move the estimate an eighth of the way towards what this
+				// acquisition needed.
+				Atomic::storeRelaxed(&spinEstimate, estimate + (spins
+						- estimate) / 8);
+				return;
+			}
+		}
+
+		Atomic::storeRelaxed(&spinEstimate, estimate + (limit - estimate) / 8);
+	}
+
+	// Mark the lock as contended so that the holder wakes us on release.  If
+	// the exchange returns UNLOCKED, we got the lock (in contended state,
+	// which only costs a spurious wake-up later).
+	while (Atomic::exchange(&state, Int32(CONTENDED)) != UNLOCKED) {
+		Futex::wait(&state, CONTENDED);
+	}
+} // end acquireContended()
+
+/*
+ * dump - Dumps the mutex debug stuff and current state.
+ */
+void SpinMutex::dump(FILE* dest, const char* message) const {
+	static const char* const stateNames[] = { "unlocked", "locked",
+			"locked (contended)" };
+	fprintf(dest, "%sSpin Mutex: %s, spin estimate %d\n", message,
+			stateNames[Atomic::load(&state)], Atomic::loadRelaxed(
+					&spinEstimate));
+} // end dump()
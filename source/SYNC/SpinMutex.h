@@ -0,0 +1,184 @@
+/*
+ * SpinMutex
+ *
+ * @note This file must be included by SYNC/Mutex.h, not the other way around.
+ */
+
+#ifndef SPIN_MUTEX_H_
+#define SPIN_MUTEX_H_
+
+#include <cstdio>
+#include <pthread.h>
+
+/* Boost includes */
+#include <boost/noncopyable.hpp>
+
+#include <SYNC/Atomic.h>
+#include <SYNC/Futex.h>
+#include <SYNC/LockException.h>
+#include <SYNC/DeadlockException.h>
+#ifdef DEBUG
+#include <SYNC/LockOrder.h>
+#endif
+#include <UTIL/Types.h>
+
+/*
+ * SpinMutex - Adaptive mutex for very short critical sections.  An
+ * uncontended acquire or release is a single atomic instruction.  Under
+ * contention the caller spins for a bounded number of rounds with
+ * exponential pause backoff, and only parks in the kernel (futex) if the
+ * lock is still held after that.  The spin limit adapts per lock to how long
+ * it usually takes to get the lock, like glibc's adaptive mutexes.
+ *
+ * SpinMutex has the same interface as MutexPosix and NullMutex and can be
+ * used with Guard<>.  It is not recursive.
+ */
+class SpinMutex: boost::noncopyable {
+public:
+	SpinMutex(void) :
+		state(UNLOCKED), spinEstimate(0) {
+#ifdef DEBUG
+		owned = false;
+#endif
+	} // end SpinMutex()
+
+	/*
+	 * ~SpinMutex - destructor for SpinMutex class.
+	 *
+	 * @pre No thread should be in a lock-specific function.
+	 */
+	~SpinMutex(void) {
+#ifdef DEBUG
+		LockOrder::forget(this);
+#endif
+	} // end ~SpinMutex()
+
+	/*
+	 * acquire - Locks this mutex.
+	 *
+	 * @post A lock on the mutex is acquired by the caller.  If it is held by
+	 *       another thread, the caller spins for a short while and then
+	 *       blocks until the mutex has been freed.
+	 *
+	 * @throw DeadlockException is thrown in debug builds if the current
+	 *        thread has already locked this mutex.
+	 */
+	void acquire(void) {
+#ifdef DEBUG
+		if (owned && pthread_equal(owner, pthread_self())) {
+			throw DeadlockException(
+					"Tried to lock mutex twice in the same thread", LOCATION);
+		}
+#endif
+		if (!Atomic::compareAndSwap(&state, Int32(UNLOCKED), Int32(LOCKED))) {
+			acquireContended();
+		}
+#ifdef DEBUG
+		owner = pthread_self();
+		owned = true;
+#endif
+	} // end acquire()
+
+	/*
+	 * acquireRead - Acquires a read lock on this mutex.
+	 *
+	 * @note This is an exclusive lock.
+	 */
+	void acquireRead(void) {
+		this->acquire();
+	} // end acquireRead()
+
+	/*
+	 * acquireWrite - Acquires a write lock on this mutex.
+	 *
+	 * @note This is an exclusive lock.
+	 */
+	void acquireWrite(void) {
+		this->acquire();
+	} // end acquireWrite()
+
+	/*
+	 * tryAcquire - Tries to acquire a lock on this mutex (does not block or
+	 * spin).
+	 *
+	 * @return \c true is returned if the lock is acquired, and \c false is
+	 *         returned if the mutex is already locked.
+	 */
+	bool tryAcquire(void) {
+		const bool acquired = Atomic::loadRelaxed(&state) == UNLOCKED
+				&& Atomic::compareAndSwap(&state, Int32(UNLOCKED),
+						Int32(LOCKED));
+#ifdef DEBUG
+		if (acquired) {
+			owner = pthread_self();
+			owned = true;
+		}
+#endif
+		return acquired;
+	} // end tryAcquire()
+
+	/*
+	 * tryAcquireRead - Tries to acquire a read lock on this mutex.
+	 */
+	bool tryAcquireRead(void) {
+		return this->tryAcquire();
+	} // end tryAcquireRead()
+
+	/*
+	 * tryAcquireWrite - Tries to acquire a write lock on this mutex.
+	 */
+	bool tryAcquireWrite(void) {
+		return this->tryAcquire();
+	} // end tryAcquireWrite()
+
+	/*
+	 * release - Releases this mutex.
+	 *
+	 * @pre The mutex must be locked by the current thread.
+	 * @post The mutex is unlocked and one parked waiter, if any, is woken up.
+	 *
+	 * @throw LockException is thrown in debug builds if the current thread
+	 *        was not the one that locked this mutex.
+	 */
+	void release(void) {
+#ifdef DEBUG
+		if (!owned || !pthread_equal(owner, pthread_self())) {
+			throw LockException(
+					"Tried to release a mutex that this thread does not own",
+					LOCATION);
+		}
+		owned = false;
+#endif
+		if (Atomic::exchange(&state, Int32(UNLOCKED)) == CONTENDED) {
+			Futex::wake(&state, 1);
+		}
+	} // end release()
+
+	/*
+	 * test - Tests the current lock status.
+	 *
+	 * @return \c true is returned if this mutex is currently locked.
+	 */
+	bool test(void) const {
+		return Atomic::load(&state) != UNLOCKED;
+	} // end test()
+
+	void dump(FILE* dest = stderr, const char* message =
+			"\n------ Mutex Dump -----\n") const;
+
+private:
+	enum State {
+		UNLOCKED = 0, LOCKED = 1, CONTENDED = 2 /**< Locked, waiters may sleep */
+	};
+
+	void acquireContended(void);
+
+	volatile Int32 state;
+	volatile Int32 spinEstimate; /**< Running average of spins needed */
+#ifdef DEBUG
+	pthread_t owner;
+	bool owned;
+#endif
+};
+
+#endif /* SPIN_MUTEX_H_ */
@@ -0,0 +1,431 @@
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <sstream>
+#include <unistd.h>
+
+#include <SYNC/Atomic.h>
+#include <SYNC/Futex.h>
+#include <SYNC/Guard.h>
+#include <SYNC/ThreadPool.h>
+#include <UTIL/Exception.h>
+#include <UTIL/Profiler.h>
+#include <UTIL/ResourceException.h>
+#include <UTIL/System.h>
+
+namespace {
+
+/* The pool and worker index of the current thread, if it is a worker: */
+__thread ThreadPool* currentPool = NULL;
+__thread int currentWorker = -1;
+
+/* Rounds an idle worker looks for work before going to sleep: */
+const int IDLE_ROUNDS = 64;
+
+}
+
+/*****************************************
+ Methods of class TaskGroup:
+ *****************************************/
+
+/*
+ * TaskGroup - Constructor for TaskGroup class.
+ *
+ * @param _pool The pool that runs the tasks of this group.
+ */
+TaskGroup::TaskGroup(ThreadPool& _pool) :
+	pool(_pool), pending(0), failed(false) {
+} // end TaskGroup()
+
+/*
+ * ~TaskGroup - Destructor for TaskGroup class.  Waits for the tasks that are
+ * still running, but does not report their errors.
+ */
+TaskGroup::~TaskGroup(void) {
+	while (Atomic::load(&pending) > 0) {
+		if (!pool.runOne(*this)) {
+			const Int32 left = Atomic::load(&pending);
+			if (left > 0) {
+				struct timespec timeout = { 0, 1000000 };
+				Futex::wait(&pending, left, &timeout);
+			}
+		}
+	}
+} // end ~TaskGroup()
+
+/*
+ * run - Submits a task as part of this group.
+ *
+ * @param task Task allocated with new.  The pool deletes it after it ran.
+ */
+void TaskGroup::run(Task* task) {
+	task->group = this;
+	Atomic::fetchAdd(&pending, Int32(1));
+	pool.submit(task);
+} // end run()
+
+/*
+ * wait - Waits until all tasks of this group have finished.  The calling
+ * thread runs the queued tasks of this group while it waits.
+ *
+ * @throw Exception is thrown if any task of the group threw.  The message
+ *        of the first failure is reported.
+ */
+void TaskGroup::wait(void) {
+	while (Atomic::load(&pending) > 0) {
+		if (!pool.runOne(*this)) {
+			// Nothing to help with: sleep until the last task finishes.  The
+			// timeout covers tasks that get queued after we looked.
+			const Int32 left = Atomic::load(&pending);
+			if (left > 0) {
+				struct timespec timeout = { 0, 1000000 };
+				Futex::wait(&pending, left, &timeout);
+			}
+		}
+	}
+
+	Guard<SpinMutex> guard(errorLock);
+	if (failed) {
+		failed = false;
+		throw Exception("Task failed: " + error, LOCATION);
+	}
+} // end wait()
+
+/*
+ * finished - Books the completion of one task of this group.
+ *
+ * @param taskError The message of the exception the task threw, or NULL.
+ */
+void TaskGroup::finished(const std::string* taskError) {
+	if (taskError != NULL) {
+		Guard<SpinMutex> guard(errorLock);
+		if (!failed) {
+			failed = true;
+			error = *taskError;
+		}
+	}
+
+	if (Atomic::fetchSub(&pending, Int32(1)) == 1) {
+		Futex::wakeAll(&pending);
+	}
+} // end finished()
+
+/*****************************************
+ Methods of class ThreadPool:
+ *****************************************/
+
+/*
+ * ThreadPool - Constructor for ThreadPool class.  Starts the worker threads.
+ *
+ * @param numWorkers The number of worker threads.  This parameter is
+ *                   optional; 0 (the default) selects
+ *                   getDefaultNumWorkers().
+ *
+ * @throw ResourceException is thrown if a worker thread cannot be started.
+ */
+ThreadPool::ThreadPool(int numWorkers) :
+	queuedTasks(0), sleepingWorkers(0), stopping(0) {
+	if (numWorkers <= 0) {
+		numWorkers = getDefaultNumWorkers();
+	}
+
+	for (int i = 0; i < numWorkers; ++i) {
+		Worker* worker = new Worker();
+		worker->pool = this;
+		worker->index = i;
+		workers.push_back(worker);
+	}
+
+	for (int i = 0; i < numWorkers; ++i) {
+		const int result = pthread_create(&workers[i]->thread, NULL,
+				&ThreadPool::workerMain, workers[i]);
+		if (result != 0) {
+			// Shut down the workers that did start.
+			for (int j = i; j < numWorkers; ++j) {
+				workers[j]->index = -1;
+			}
+			shutdown();
+
+			std::ostringstream msg_stream;
+			msg_stream << "Worker thread creation failed: " << std::strerror(
+					result);
+			throw ResourceException(msg_stream.str(), LOCATION);
+		}
+	}
+} // end ThreadPool()
+
+/*
+ * ~ThreadPool - Destructor for ThreadPool class.
+ */
+ThreadPool::~ThreadPool(void) {
+	shutdown();
+} // end ~ThreadPool()
+
+/*
+ * instance - Returns the thread pool shared by the application.  It is
+ * created on first use and never destroyed.
+ */
+ThreadPool& ThreadPool::instance(void) {
+	static ThreadPool* pool = new ThreadPool();
+	return *pool;
+} // end instance()
+
+/*
+ * shutdown - Stops and joins the worker threads.  Tasks that have not
+ * started yet are deleted without running, and fail their groups.
+ */
+void ThreadPool::shutdown(void) {
+	{
+		Guard<MutexPosix> guard(sleepLock);
+		Atomic::store(&stopping, Int32(1));
+		wakeUp.broadcast();
+	}
+
+	for (size_t i = 0; i < workers.size(); ++i) {
+		if (workers[i]->index >= 0) {
+			pthread_join(workers[i]->thread, NULL);
+		}
+	}
+
+	for (size_t i = 0; i < workers.size(); ++i) {
+		for (size_t j = 0; j < workers[i]->tasks.size(); ++j) {
+			cancelTask(workers[i]->tasks[j]);
+		}
+		delete workers[i];
+	}
+	workers.clear();
+
+	Guard<SpinMutex> guard(injectionLock);
+	for (size_t i = 0; i < injected.size(); ++i) {
+		cancelTask(injected[i]);
+	}
+	injected.clear();
+	Atomic::store(&queuedTasks, Int32(0));
+} // end shutdown()
+
+/*
+ * cancelTask - Deletes a task without running it, and reports it to its
+ * group as failed.
+ */
+void ThreadPool::cancelTask(Task* task) {
+	static const std::string error("pool shut down");
+
+	TaskGroup* group = task->group;
+	delete task;
+	if (group != NULL) {
+		group->finished(&error);
+	}
+} // end cancelTask()
+
+/*
+ * getDefaultNumWorkers - Returns the value of the ROCKET_WORKER_THREADS
+ * environment variable if it is set, and otherwise the number of online
+ * cores minus one (but at least one).
+ */
+int ThreadPool::getDefaultNumWorkers(void) {
+	std::string value;
+	if (SystemPosix::getenv("ROCKET_WORKER_THREADS", value)) {
+		const int numWorkers = std::atoi(value.c_str());
+		if (numWorkers > 0) {
+			return numWorkers;
+		}
+	}
+
+	const long cores = sysconf(_SC_NPROCESSORS_ONLN);
+	return cores > 2 ? int(cores - 1) : 1;
+} // end getDefaultNumWorkers()
+
+/*
+ * getNumWorkers - Returns the number of worker threads.
+ */
+int ThreadPool::getNumWorkers(void) const {
+	return int(workers.size());
+} // end getNumWorkers()
+
+/*
+ * submit - Queues a task.  Workers of this pool push onto their own deque;
+ * other threads use the shared queue.  Once the pool shuts down, tasks
+ * fail instead.
+ */
+void ThreadPool::submit(Task* task) {
+	if (currentPool == this) {
+		Worker& worker = *workers[currentWorker];
+		Guard<SpinMutex> guard(worker.lock);
+		worker.tasks.push_back(task);
+	} else {
+		Guard<SpinMutex> guard(injectionLock);
+		if (Atomic::load(&stopping)) {
+			guard.release();
+			cancelTask(task);
+			return;
+		}
+		injected.push_back(task);
+	}
+
+	Atomic::fetchAdd(&queuedTasks, Int32(1));
+	if (Atomic::load(&sleepingWorkers) > 0) {
+		Guard<MutexPosix> guard(sleepLock);
+		wakeUp.signal();
+	}
+} // end submit()
+
+/*
+ * takeTask - Removes and returns the newest, or else the oldest, task of
+ * \p tasks that belongs to \p group, or to any group if \p group is NULL.
+ *
+ * @return The task, or NULL if there is none.
+ */
+Task* ThreadPool::takeTask(std::deque<Task*>& tasks, bool newest,
+		const TaskGroup* group) {
+	if (tasks.empty()) {
+		return NULL;
+	}
+	if (group == NULL) {
+		Task* task(newest ? tasks.back() : tasks.front());
+		if (newest) {
+			tasks.pop_back();
+		} else {
+			tasks.pop_front();
+		}
+		return task;
+	}
+
+	const size_t size = tasks.size();
+	for (size_t i = 0; i < size; ++i) {
+		const size_t index = newest ? size - 1 - i : i;
+		if (tasks[index]->group == group) {
+			Task* task(tasks[index]);
+			tasks.erase(tasks.begin() + index);
+			return task;
+		}
+	}
+	return NULL;
+} // end takeTask()
+
+/*
+ * findTask - Takes a task to run: the newest one of the calling worker, else
+ * the oldest submitted from outside, else the oldest one of another worker.
+ *
+ * @param self  Index of the calling worker, or -1 for other threads.
+ * @param group Group the task has to belong to, or NULL for any task.
+ *
+ * @return The task, or NULL if there is no such queued task.
+ */
+Task* ThreadPool::findTask(int self, const TaskGroup* group) {
+	Task* task(NULL);
+
+	if (Atomic::load(&queuedTasks) == 0) {
+		return NULL;
+	}
+
+	if (self >= 0) {
+		Worker& worker = *workers[self];
+		Guard<SpinMutex> guard(worker.lock);
+		task = takeTask(worker.tasks, true, group);
+	}
+
+	if (task == NULL) {
+		Guard<SpinMutex> guard(injectionLock);
+		task = takeTask(injected, false, group);
+	}
+
+	const int numWorkers = int(workers.size());
+	for (int i = 1; task == NULL && i <= numWorkers; ++i) {
+		Worker& victim = *workers[(self + i + numWorkers) % numWorkers];
+		if (&victim != (self >= 0 ? workers[self] : NULL)) {
+			Guard<SpinMutex> guard(victim.lock);
+			task = takeTask(victim.tasks, false, group);
+		}
+	}
+
+	if (task != NULL) {
+		Atomic::fetchSub(&queuedTasks, Int32(1));
+	}
+	return task;
+} // end findTask()
+
+/*
+ * runOne - Runs one queued task of \p group on the calling thread, if there
+ * is one.
+ *
+ * @return \c true is returned if a task was run.
+ */
+bool ThreadPool::runOne(const TaskGroup& group) {
+	Task* task = findTask(currentPool == this ? currentWorker : -1, &group);
+	if (task == NULL) {
+		return false;
+	}
+	runTask(task);
+	return true;
+} // end runOne()
+
+/*
+ * runTask - Runs and deletes a task and reports its completion to its group.
+ */
+void ThreadPool::runTask(Task* task) {
+	std::string error;
+	bool failed(false);
+
+	try {
+		task->execute();
+	} catch (const std::exception& exception) {
+		error = exception.what();
+		failed = true;
+	} catch (...) {
+		error = "unknown exception";
+		failed = true;
+	}
+
+	// The group may be destroyed as soon as it hears of its last task, so
+	// the task has to be gone by then.
+	TaskGroup* group = task->group;
+	delete task;
+	if (group != NULL) {
+		group->finished(failed ? &error : NULL);
+	}
+} // end runTask()
+
+/*
+ * workerLoop - Main loop of a worker thread: run tasks while there are any,
+ * sleep while there are none.
+ */
+void ThreadPool::workerLoop(Worker& worker) {
+	int idleRounds(0);
+
+	while (!Atomic::load(&stopping)) {
+		Task* task = findTask(worker.index, NULL);
+		if (task != NULL) {
+			runTask(task);
+			idleRounds = 0;
+		} else if (++idleRounds < IDLE_ROUNDS) {
+			Atomic::cpuRelax();
+		} else {
+			Guard<MutexPosix> guard(sleepLock);
+			Atomic::fetchAdd(&sleepingWorkers, Int32(1));
+			while (Atomic::load(&queuedTasks) == 0 && !Atomic::load(&stopping)) {
+				wakeUp.wait(sleepLock);
+			}
+			Atomic::fetchSub(&sleepingWorkers, Int32(1));
+			idleRounds = 0;
+		}
+	}
+} // end workerLoop()
+
+/*
+ * workerMain - Entry point of the worker threads.
+ */
+void* ThreadPool::workerMain(void* argument) {
+	Worker& worker = *static_cast<Worker*> (argument);
+	currentPool = worker.pool;
+	currentWorker = worker.index;
+	SystemPosix::applyThreadRole("WORKER");
+#ifdef ROCKET_PROFILING
+	std::ostringstream name;
+	name << "Worker " << worker.index;
+	Profiler::setThreadName(name.str());
+#endif
+
+	worker.pool->workerLoop(worker);
+
+	return NULL;
+} // end workerMain()
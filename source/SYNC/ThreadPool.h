@@ -0,0 +1,188 @@
+#ifndef THREAD_POOL_H_
+#define THREAD_POOL_H_
+
+#include <cstddef>
+#include <deque>
+#include <string>
+#include <vector>
+#include <pthread.h>
+
+/* Boost includes */
+#include <boost/noncopyable.hpp>
+
+#include <SYNC/CondVarPosix.h>
+#include <SYNC/MutexPosix.h>
+#include <SYNC/SpinMutex.h>
+#include <UTIL/Types.h>
+
+class ThreadPool;
+class TaskGroup;
+
+/*
+ * Task - A unit of work for the ThreadPool.  Tasks are allocated with new and
+ * deleted by the pool once they have run.
+ */
+class Task {
+public:
+	Task(void) :
+		group(NULL) {
+	}
+
+	virtual ~Task(void) {
+	}
+
+	/*
+	 * execute - Does the work.  Exceptions are caught by the pool and
+	 * reported by TaskGroup::wait().
+	 */
+	virtual void execute(void) = 0;
+
+private:
+	friend class ThreadPool;
+	friend class TaskGroup;
+
+	TaskGroup* group; /**< The group this task counts towards */
+};
+
+/*
+ * TaskGroup - A set of tasks that can be waited for together.  A thread
+ * that waits for a group runs the queued tasks of that group itself in the
+ * meantime, so tasks may create and wait for nested groups without tying up
+ * workers.  It never runs tasks of other groups, which could take much
+ * longer than the wait.
+ */
+class TaskGroup: boost::noncopyable {
+public:
+	explicit TaskGroup(ThreadPool& _pool);
+	~TaskGroup(void);
+
+	void run(Task* task);
+	void wait(void);
+
+private:
+	friend class ThreadPool;
+
+	void finished(const std::string* error);
+
+	ThreadPool& pool;
+	volatile Int32 pending; /**< Tasks submitted but not yet finished */
+	SpinMutex errorLock;
+	std::string error; /**< Message of the first failed task */
+	bool failed;
+};
+
+/*
+ * ThreadPool - Work-stealing task scheduler.  Each worker thread owns a
+ * deque: it pushes and pops its own tasks at the back (most recent first,
+ * which keeps the working set in its cache) and, when it runs out, steals
+ * the oldest task from the front of another worker's deque.  Tasks
+ * submitted from outside the pool go to a shared queue.  Idle workers sleep
+ * on a condition variable.
+ *
+ * instance() returns the pool shared by the whole application.  Its size is
+ * taken from the ROCKET_WORKER_THREADS environment variable and defaults to
+ * one worker per core, minus one for the main thread.
+ */
+class ThreadPool: boost::noncopyable {
+public:
+	explicit ThreadPool(int numWorkers = 0);
+	~ThreadPool(void);
+
+	static ThreadPool& instance(void);
+	static int getDefaultNumWorkers(void);
+
+	int getNumWorkers(void) const;
+
+	/*
+	 * parallelFor - Calls body(first, last) for subranges of [begin, end)
+	 * that are at most \p grain long, in parallel, and waits for all of them.
+	 * The range is split recursively, so the subranges spread over the
+	 * workers by stealing.
+	 *
+	 * @param begin First index.
+	 * @param end   One past the last index.
+	 * @param grain Largest subrange handed to one call of \p body.
+	 * @param body  Function object callable as body(size_t, size_t) const.
+	 *
+	 * @throw Exception is thrown if any call of \p body threw.
+	 */
+	template<class BODY_TYPE>
+	void parallelFor(size_t begin, size_t end, size_t grain,
+			const BODY_TYPE& body) {
+		if (begin >= end) {
+			return;
+		}
+		if (grain == 0) {
+			grain = 1;
+		}
+
+		TaskGroup group(*this);
+		group.run(new RangeTask<BODY_TYPE> (begin, end, grain, body, group));
+		group.wait();
+	} // end parallelFor()
+
+private:
+	friend class TaskGroup;
+
+	/*
+	 * RangeTask - Task that keeps splitting off the upper half of its range
+	 * as a new task until it is no longer than the grain size.
+	 */
+	template<class BODY_TYPE>
+	class RangeTask: public Task {
+	public:
+		RangeTask(size_t _begin, size_t _end, size_t _grain,
+				const BODY_TYPE& _body, TaskGroup& _rangeGroup) :
+			begin(_begin), end(_end), grain(_grain), body(_body),
+					rangeGroup(_rangeGroup) {
+		}
+
+		virtual void execute(void) {
+			while (end - begin > grain) {
+				const size_t middle = begin + (end - begin) / 2;
+				rangeGroup.run(new RangeTask(middle, end, grain, body,
+						rangeGroup));
+				end = middle;
+			}
+			body(begin, end);
+		}
+
+	private:
+		size_t begin;
+		size_t end;
+		const size_t grain;
+		const BODY_TYPE& body;
+		TaskGroup& rangeGroup;
+	};
+
+	struct Worker {
+		ThreadPool* pool;
+		int index;
+		pthread_t thread;
+		SpinMutex lock; /**< Protects tasks */
+		std::deque<Task*> tasks;
+	};
+
+	void shutdown(void);
+	static void cancelTask(Task* task);
+	void submit(Task* task);
+	static Task* takeTask(std::deque<Task*>& tasks, bool newest,
+			const TaskGroup* group);
+	Task* findTask(int self, const TaskGroup* group);
+	bool runOne(const TaskGroup& group);
+	void runTask(Task* task);
+	void workerLoop(Worker& worker);
+	static void* workerMain(void* argument);
+
+	std::vector<Worker*> workers;
+	SpinMutex injectionLock; /**< Protects injected */
+	std::deque<Task*> injected; /**< Tasks submitted from other threads */
+
+	volatile Int32 queuedTasks; /**< Tasks in all deques */
+	volatile Int32 sleepingWorkers;
+	volatile Int32 stopping;
+	MutexPosix sleepLock;
+	CondVarPosix wakeUp;
+};
+
+#endif /* THREAD_POOL_H_ */
@@ -0,0 +1,560 @@
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include <malloc.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#include <SYNC/Atomic.h>
+#include <UTIL/AllocationTracker.h>
+#include <UTIL/System.h>
+
+#if defined(ROCKET_ALLOC_TRACKING) && !defined(__GLIBC__)
+#error "ROCKET_ALLOC_TRACKING needs the glibc allocator entry points"
+#endif
+
+#ifdef __GLIBC__
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* pointer, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+void* __libc_valloc(size_t size);
+void __libc_free(void* pointer);
+}
+#endif
+
+namespace {
+
+enum StrictMode {
+	STRICT_UNKNOWN, STRICT_COUNT, STRICT_LOG, STRICT_ABORT
+};
+
+/*
+ * PhaseCounters - The allocations of one thread in one phase.  The owning
+ * thread updates the first three without locked instructions; newFrame()
+ * owns the rest.
+ */
+struct PhaseCounters {
+	volatile Uint64 allocations;
+	volatile Uint64 frees;
+	volatile Uint64 bytes;
+
+	Uint64 frameStartAllocations;
+	Uint64 frameStartBytes;
+	Uint64 maxFrameAllocations;
+	Uint64 maxFrameBytes;
+};
+
+struct ThreadCounters {
+	volatile Int32 threadId;
+	PhaseCounters phases[AllocationTracker::NUM_PHASES];
+};
+
+/*
+ * Everything here is zero-initialized static storage: the hooks run before
+ * any constructor, and they must not allocate.  The last slot is shared by
+ * all threads past the others, and so is updated with locked instructions.
+ */
+ThreadCounters threads[AllocationTracker::MAX_THREADS];
+volatile Uint32 numThreads = 0;
+
+__thread AllocationTracker::Phase currentPhase = AllocationTracker::PHASE_OTHER;
+__thread const char* currentRegion = NULL;
+__thread bool regionReported = false;
+#ifdef ROCKET_ALLOC_TRACKING
+__thread ThreadCounters* currentThread = NULL;
+__thread bool inHook = false;
+#endif
+
+volatile Int64 liveBytes = 0;
+volatile Int64 peakLiveBytes = 0;
+volatile Uint64 violations = 0;
+volatile int strictMode = STRICT_UNKNOWN;
+volatile Uint32 frameNumber = 0;
+
+/* Per-frame totals, written by newFrame() under historyMutex: */
+pthread_mutex_t historyMutex = PTHREAD_MUTEX_INITIALIZER;
+AllocationTracker::FrameAllocations frameHistory[AllocationTracker::FRAME_HISTORY];
+Uint64 frameAllocations[AllocationTracker::NUM_PHASES];
+Uint64 frameBytes[AllocationTracker::NUM_PHASES];
+Uint64 maxFrameAllocations[AllocationTracker::NUM_PHASES];
+Uint64 maxFrameBytes[AllocationTracker::NUM_PHASES];
+
+const char* const PHASE_NAMES[AllocationTracker::NUM_PHASES] = { "other",
+		"frame", "display", "callback" };
+
+Uint32 getNumThreads(void) {
+	const Uint32 count = Atomic::load(&numThreads);
+	return count < Uint32(AllocationTracker::MAX_THREADS) ? count
+			: Uint32(AllocationTracker::MAX_THREADS);
+}
+
+int getStrictMode(void) {
+	if (Atomic::loadRelaxed(&strictMode) == STRICT_UNKNOWN) {
+		const char* value = ::getenv("ROCKET_ALLOC_STRICT");
+		int mode = STRICT_COUNT;
+		if (value != NULL && std::strcmp(value, "abort") == 0) {
+			mode = STRICT_ABORT;
+		} else if (value != NULL && std::strcmp(value, "log") == 0) {
+			mode = STRICT_LOG;
+		}
+		Atomic::storeRelaxed(&strictMode, mode);
+	}
+	return Atomic::loadRelaxed(&strictMode);
+}
+
+#ifdef ROCKET_ALLOC_TRACKING
+
+ThreadCounters& getThreadCounters(void) {
+	if (currentThread == NULL) {
+		Uint32 index = Atomic::fetchAdd(&numThreads, Uint32(1));
+		if (index >= AllocationTracker::MAX_THREADS) {
+			index = AllocationTracker::MAX_THREADS - 1;
+		}
+		currentThread = &threads[index];
+		Atomic::compareAndSwap(&currentThread->threadId, Int32(0),
+				Int32(syscall(SYS_gettid)));
+	}
+	return *currentThread;
+}
+
+/*
+ * add - Adds to a counter of \p thread, which only the calling thread
+ * writes unless it is the shared last slot.
+ */
+inline void add(const ThreadCounters& thread, volatile Uint64& counter,
+		Uint64 delta) {
+	if (&thread == &threads[AllocationTracker::MAX_THREADS - 1]) {
+		Atomic::fetchAddRelaxed(&counter, delta);
+	} else {
+		Atomic::storeRelaxed(&counter, Atomic::loadRelaxed(&counter) + delta);
+	}
+}
+
+/*
+ * reportViolation - Handles an allocation inside a zero-allocation region.
+ * The report itself allocates; inHook keeps those allocations out of the
+ * counts and from reporting again.
+ */
+void reportViolation(size_t size) {
+	Atomic::fetchAddRelaxed(&violations, Uint64(1));
+
+	const int mode = getStrictMode();
+	if (mode == STRICT_COUNT || (mode == STRICT_LOG && regionReported)) {
+		return;
+	}
+	regionReported = true;
+
+	inHook = true;
+	void* frames[32];
+	const int numFrames = SystemBase::captureCallStack(frames, 32, 2);
+	char message[256];
+	const int length = snprintf(message, sizeof(message),
+			"Allocation of %lu bytes in zero-allocation region \"%s\" "
+				"(frame %u)\n", static_cast<unsigned long> (size),
+			currentRegion, Atomic::loadRelaxed(&frameNumber));
+	if (length > 0 && write(STDERR_FILENO, message, length) < 0) {
+		;
+	}
+	{
+		// Freed before inHook is cleared, as it was allocated uncounted.
+		const std::string stack = SystemBase::symbolizeCallStack(frames,
+				numFrames);
+		if (write(STDERR_FILENO, stack.data(), stack.size()) < 0) {
+			;
+		}
+	}
+	inHook = false;
+
+	if (mode == STRICT_ABORT) {
+		abort();
+	}
+}
+
+void recordAllocation(void* pointer) {
+	if (pointer == NULL || inHook) {
+		return;
+	}
+	const size_t size = malloc_usable_size(pointer);
+
+	ThreadCounters& thread = getThreadCounters();
+	PhaseCounters& counters = thread.phases[currentPhase];
+	add(thread, counters.allocations, 1);
+	add(thread, counters.bytes, size);
+
+	const Int64 live = Atomic::fetchAddRelaxed(&liveBytes, Int64(size))
+			+ Int64(size);
+	Int64 peak = Atomic::loadRelaxed(&peakLiveBytes);
+	while (live > peak && !Atomic::compareAndSwap(&peakLiveBytes, peak, live)) {
+		peak = Atomic::loadRelaxed(&peakLiveBytes);
+	}
+
+	if (currentRegion != NULL) {
+		reportViolation(size);
+	}
+}
+
+void recordFree(size_t size) {
+	if (inHook) {
+		return;
+	}
+	ThreadCounters& thread = getThreadCounters();
+	add(thread, thread.phases[currentPhase].frees, 1);
+	Atomic::fetchAddRelaxed(&liveBytes, -Int64(size));
+}
+
+#endif /* ROCKET_ALLOC_TRACKING */
+
+}
+
+/*
+ * newFrame - Closes the current frame: the allocations since the previous
+ * call are added to the frame history and the per-frame maxima.  Call this
+ * from one thread only, at the top of the application's frame().
+ */
+void AllocationTracker::newFrame(void) {
+	const Uint64 now = SystemPosix::getMonotonicNanoseconds();
+	pthread_mutex_lock(&historyMutex);
+
+	const Uint32 frame = Atomic::loadRelaxed(&frameNumber);
+	FrameAllocations& record = frameHistory[frame % FRAME_HISTORY];
+	std::memset(&record, 0, sizeof(record));
+	record.time = now;
+	record.frame = frame;
+
+	const Uint32 threadCount = getNumThreads();
+	for (Uint32 t = 0; t < threadCount; ++t) {
+		for (int p = 0; p < NUM_PHASES; ++p) {
+			PhaseCounters& counters = threads[t].phases[p];
+			const Uint64 allocations = Atomic::loadRelaxed(
+					&counters.allocations);
+			const Uint64 bytes = Atomic::loadRelaxed(&counters.bytes);
+			const Uint64 deltaAllocations = allocations
+					- counters.frameStartAllocations;
+			const Uint64 deltaBytes = bytes - counters.frameStartBytes;
+			counters.frameStartAllocations = allocations;
+			counters.frameStartBytes = bytes;
+
+			// Before the first frame, everything since startup would count.
+			if (frame > 0) {
+				if (deltaAllocations > counters.maxFrameAllocations) {
+					counters.maxFrameAllocations = deltaAllocations;
+				}
+				if (deltaBytes > counters.maxFrameBytes) {
+					counters.maxFrameBytes = deltaBytes;
+				}
+				record.allocations[p] += deltaAllocations;
+				record.bytes[p] += deltaBytes;
+			}
+		}
+	}
+
+	if (frame > 0) {
+		for (int p = 0; p < NUM_PHASES; ++p) {
+			frameAllocations[p] += record.allocations[p];
+			frameBytes[p] += record.bytes[p];
+			if (record.allocations[p] > maxFrameAllocations[p]) {
+				maxFrameAllocations[p] = record.allocations[p];
+			}
+			if (record.bytes[p] > maxFrameBytes[p]) {
+				maxFrameBytes[p] = record.bytes[p];
+			}
+		}
+	}
+	Atomic::store(&frameNumber, frame + 1);
+
+	pthread_mutex_unlock(&historyMutex);
+} // end newFrame()
+
+/*
+ * getPhaseName - Returns the name of a phase as used in the reports.
+ */
+const char* AllocationTracker::getPhaseName(Phase phase) {
+	return phase >= 0 && phase < NUM_PHASES ? PHASE_NAMES[phase] : "?";
+} // end getPhaseName()
+
+/*
+ * getViolations - Returns the number of allocations made inside
+ * zero-allocation regions so far.
+ */
+Uint64 AllocationTracker::getViolations(void) {
+	return Atomic::loadRelaxed(&violations);
+} // end getViolations()
+
+/*
+ * getFrameHistory - Returns the totals of the last FRAME_HISTORY complete
+ * frames, oldest first.
+ */
+void AllocationTracker::getFrameHistory(std::vector<FrameAllocations>& history) {
+	pthread_mutex_lock(&historyMutex);
+	const Uint32 frames = Atomic::loadRelaxed(&frameNumber);
+	// Frame 0 only sets the baseline, and the newest slot is complete.
+	const Uint32 first = frames > FRAME_HISTORY ? frames - FRAME_HISTORY : 1;
+	history.clear();
+	for (Uint32 frame = first; frame < frames; ++frame) {
+		history.push_back(frameHistory[frame % FRAME_HISTORY]);
+	}
+	pthread_mutex_unlock(&historyMutex);
+} // end getFrameHistory()
+
+/*
+ * writeSummary - Prints the allocations per phase and per thread, the live
+ * heap and its peak, and the zero-allocation violations.
+ */
+void AllocationTracker::writeSummary(FILE* dest) {
+	Uint64 totalAllocations[NUM_PHASES] = { 0 };
+	Uint64 totalFrees[NUM_PHASES] = { 0 };
+	Uint64 totalBytes[NUM_PHASES] = { 0 };
+	const Uint32 threadCount = getNumThreads();
+	for (Uint32 t = 0; t < threadCount; ++t) {
+		for (int p = 0; p < NUM_PHASES; ++p) {
+			const PhaseCounters& counters = threads[t].phases[p];
+			totalAllocations[p] += Atomic::loadRelaxed(&counters.allocations);
+			totalFrees[p] += Atomic::loadRelaxed(&counters.frees);
+			totalBytes[p] += Atomic::loadRelaxed(&counters.bytes);
+		}
+	}
+
+	pthread_mutex_lock(&historyMutex);
+	const Uint32 frames = Atomic::loadRelaxed(&frameNumber);
+	const double completeFrames = frames > 1 ? double(frames - 1) : 1.0;
+
+	fprintf(dest, "\n------ Heap Allocations (%u frames) -----\n", frames);
+	fprintf(dest, "%-10s %12s %12s %10s %12s %10s %12s %10s\n", "Phase",
+			"Allocations", "Frees", "MB", "Allocs/frame", "Max", "KB/frame",
+			"Max KB");
+	for (int p = 0; p < NUM_PHASES; ++p) {
+		fprintf(dest, "%-10s %12lu %12lu %10.1f %12.1f %10lu %12.1f %10.1f\n",
+				PHASE_NAMES[p], totalAllocations[p], totalFrees[p],
+				double(totalBytes[p]) / 1048576.0, double(frameAllocations[p])
+						/ completeFrames, maxFrameAllocations[p],
+				double(frameBytes[p]) / completeFrames / 1024.0,
+				double(maxFrameBytes[p]) / 1024.0);
+	}
+
+	fprintf(dest, "%-10s %12s %12s %10s", "Thread", "Allocations", "Frees",
+			"MB");
+	for (int p = PHASE_FRAME; p < NUM_PHASES; ++p) {
+		fprintf(dest, " %10s", PHASE_NAMES[p]);
+	}
+	fprintf(dest, "   (max allocations in one frame)\n");
+	for (Uint32 t = 0; t < threadCount; ++t) {
+		Uint64 allocations(0), frees(0), bytes(0);
+		for (int p = 0; p < NUM_PHASES; ++p) {
+			const PhaseCounters& counters = threads[t].phases[p];
+			allocations += Atomic::loadRelaxed(&counters.allocations);
+			frees += Atomic::loadRelaxed(&counters.frees);
+			bytes += Atomic::loadRelaxed(&counters.bytes);
+		}
+		fprintf(dest, "%-10d %12lu %12lu %10.1f", Atomic::loadRelaxed(
+				&threads[t].threadId), allocations, frees, double(bytes)
+				/ 1048576.0);
+		for (int p = PHASE_FRAME; p < NUM_PHASES; ++p) {
+			fprintf(dest, " %10lu", threads[t].phases[p].maxFrameAllocations);
+		}
+		fprintf(dest, "\n");
+	}
+	pthread_mutex_unlock(&historyMutex);
+
+	fprintf(dest, "Live heap: %.1f MB, peak %.1f MB\n", double(
+			Atomic::loadRelaxed(&liveBytes)) / 1048576.0, double(
+			Atomic::loadRelaxed(&peakLiveBytes)) / 1048576.0);
+	fprintf(dest, "Allocations in zero-allocation regions: %lu\n",
+			getViolations());
+} // end writeSummary()
+
+/*
+ * setPhase - Sets the phase the calling thread's allocations count toward.
+ *
+ * @return The previous phase.
+ */
+AllocationTracker::Phase AllocationTracker::setPhase(Phase phase) {
+	const Phase previous = currentPhase;
+	currentPhase = phase;
+	return previous;
+} // end setPhase()
+
+/*
+ * enterRegion - Makes the calling thread's allocations violations until the
+ * matching leaveRegion().
+ *
+ * @return The enclosing region, or NULL.
+ */
+const char* AllocationTracker::enterRegion(const char* name) {
+	getStrictMode();
+	const char* previous = currentRegion;
+	currentRegion = name;
+	regionReported = false;
+	return previous;
+} // end enterRegion()
+
+/*
+ * leaveRegion - Goes back to the region enterRegion() returned.
+ */
+void AllocationTracker::leaveRegion(const char* previous) {
+	currentRegion = previous;
+} // end leaveRegion()
+
+#ifdef ROCKET_ALLOC_TRACKING
+
+/*
+ * The C allocator is replaced by forwarding to glibc's internal entry
+ * points, which also catches the allocations of libraries that never use
+ * operator new.  The definitions are linked into the executable, so they
+ * bind before libc's own from the first allocation on, and every block that
+ * reaches free() was counted when it was allocated.
+ */
+extern "C" {
+
+void* malloc(size_t size) __THROW {
+	void* pointer = __libc_malloc(size);
+	recordAllocation(pointer);
+	return pointer;
+}
+
+void* calloc(size_t count, size_t size) __THROW {
+	void* pointer = __libc_calloc(count, size);
+	recordAllocation(pointer);
+	return pointer;
+}
+
+void* realloc(void* pointer, size_t size) __THROW {
+	const size_t oldSize = pointer != NULL ? malloc_usable_size(pointer) : 0;
+	void* result = __libc_realloc(pointer, size);
+	if (pointer != NULL && (result != NULL || size == 0)) {
+		recordFree(oldSize);
+	}
+	recordAllocation(result);
+	return result;
+}
+
+void* memalign(size_t alignment, size_t size) __THROW {
+	void* pointer = __libc_memalign(alignment, size);
+	recordAllocation(pointer);
+	return pointer;
+}
+
+void* aligned_alloc(size_t alignment, size_t size) __THROW {
+	void* pointer = __libc_memalign(alignment, size);
+	recordAllocation(pointer);
+	return pointer;
+}
+
+int posix_memalign(void** result, size_t alignment, size_t size) __THROW {
+	if (alignment % sizeof(void*) != 0 || (alignment & (alignment - 1)) != 0
+			|| alignment == 0) {
+		return EINVAL;
+	}
+	void* pointer = __libc_memalign(alignment, size);
+	if (pointer == NULL) {
+		return ENOMEM;
+	}
+	recordAllocation(pointer);
+	*result = pointer;
+	return 0;
+}
+
+void* valloc(size_t size) __THROW {
+	void* pointer = __libc_valloc(size);
+	recordAllocation(pointer);
+	return pointer;
+}
+
+void free(void* pointer) __THROW {
+	if (pointer != NULL) {
+		recordFree(malloc_usable_size(pointer));
+		__libc_free(pointer);
+	}
+}
+
+}
+
+#if __cplusplus >= 201103L
+#define ALLOCATION_THROW
+#define ALLOCATION_NO_THROW noexcept
+#else
+#define ALLOCATION_THROW throw (std::bad_alloc)
+#define ALLOCATION_NO_THROW throw ()
+#endif
+
+namespace {
+
+/*
+ * allocate - operator new: retries through the new handler, as the
+ * standard requires, and throws std::bad_alloc when there is none.
+ */
+void* allocate(size_t size) {
+	if (size == 0) {
+		size = 1;
+	}
+	for (;;) {
+		void* pointer = malloc(size);
+		if (pointer != NULL) {
+			return pointer;
+		}
+		const std::new_handler handler = std::set_new_handler(NULL);
+		std::set_new_handler(handler);
+		if (handler == NULL) {
+			throw std::bad_alloc();
+		}
+		handler();
+	}
+}
+
+void* allocateNoThrow(size_t size) {
+	try {
+		return allocate(size);
+	} catch (const std::bad_alloc&) {
+		return NULL;
+	}
+}
+
+}
+
+void* operator new(size_t size) ALLOCATION_THROW {
+	return allocate(size);
+}
+
+void* operator new[](size_t size) ALLOCATION_THROW {
+	return allocate(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) ALLOCATION_NO_THROW {
+	return allocateNoThrow(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) ALLOCATION_NO_THROW {
+	return allocateNoThrow(size);
+}
+
+void operator delete(void* pointer) ALLOCATION_NO_THROW {
+	free(pointer);
+}
+
+void operator delete[](void* pointer) ALLOCATION_NO_THROW {
+	free(pointer);
+}
+
+void operator delete(void* pointer, const std::nothrow_t&) ALLOCATION_NO_THROW {
+	free(pointer);
+}
+
+void operator delete[](void* pointer, const std::nothrow_t&) ALLOCATION_NO_THROW {
+	free(pointer);
+}
+
+#ifdef __cpp_sized_deallocation
+void operator delete(void* pointer, size_t) ALLOCATION_NO_THROW {
+	free(pointer);
+}
+
+void operator delete[](void* pointer, size_t) ALLOCATION_NO_THROW {
+	free(pointer);
+}
+#endif
+
+#endif /* ROCKET_ALLOC_TRACKING */
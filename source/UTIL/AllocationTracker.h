@@ -0,0 +1,144 @@
+#ifndef ALLOCATION_TRACKER_H_
+#define ALLOCATION_TRACKER_H_
+
+#include <cstddef>
+#include <cstdio>
+#include <vector>
+
+/* Boost includes */
+#include <boost/noncopyable.hpp>
+#include <boost/preprocessor/cat.hpp>
+
+#include <UTIL/Types.h>
+
+/**
+ * @example "Example of tracking the allocations of a frame"
+ *
+ * Phases attribute heap allocations to the part of the frame that made
+ * them, and zero-allocation regions mark code that must not allocate at all:
+ *
+ * \code
+ * void Rocket::frame(void) {
+ *     ALLOCATION_NEW_FRAME();
+ *     ALLOCATION_PHASE(PHASE_FRAME);
+ *     ...
+ *     {
+ *         NO_ALLOCATION_REGION("Rocket::publishFrameState");
+ *         publishFrameState();
+ *     }
+ * }
+ * \endcode
+ *
+ * The macros compile to nothing unless ROCKET_ALLOC_TRACKING is defined.
+ * With it, operator new/delete and (on glibc) malloc, calloc, realloc, the
+ * aligned variants and free are replaced by counting versions, so the
+ * allocations made inside OSG, GLMotif and Vrui are counted too.
+ */
+#ifdef ROCKET_ALLOC_TRACKING
+#define ALLOCATION_PHASE(phase) \
+	AllocationPhase BOOST_PP_CAT(allocationPhase, __LINE__)( \
+		AllocationTracker::phase)
+#define NO_ALLOCATION_REGION(name) \
+	NoAllocationRegion BOOST_PP_CAT(noAllocationRegion, __LINE__)(name)
+#define ALLOCATION_NEW_FRAME() AllocationTracker::newFrame()
+#else
+#define ALLOCATION_PHASE(phase)
+#define NO_ALLOCATION_REGION(name)
+#define ALLOCATION_NEW_FRAME()
+#endif
+
+/*
+ * AllocationTracker - Counts heap allocations, frees and bytes per thread
+ * and per frame phase, the largest count seen in a single frame, and the
+ * number of bytes live on the heap and its peak.
+ *
+ * Allocations inside a NO_ALLOCATION_REGION are violations.  They are
+ * always counted; the ROCKET_ALLOC_STRICT environment variable decides what
+ * else happens:
+ *
+ *   log    Print the region and the call stack of the first violation of
+ *          each region entry to stderr.
+ *   abort  Print the same and abort(), so a debugger stops at the culprit.
+ *
+ * The counts are part of the profiler output: the summary is printed after
+ * the zone summary and the per-frame counts appear as counter tracks in the
+ * Chrome trace.
+ */
+class AllocationTracker {
+public:
+	enum Phase {
+		PHASE_OTHER, /**< Startup, shutdown and anything not marked */
+		PHASE_FRAME, /**< Application::frame() */
+		PHASE_DISPLAY, /**< Application::display(), per context and pass */
+		PHASE_CALLBACK, /**< GUI and tool callbacks */
+		NUM_PHASES
+	};
+
+	enum {
+		MAX_THREADS = 256, /**< Counter slots; the last one is shared */
+		FRAME_HISTORY = 4096 /**< Frames kept for the trace */
+	};
+
+	/*
+	 * FrameAllocations - What one frame allocated, over all threads.
+	 */
+	struct FrameAllocations {
+		Uint64 time; /**< Monotonic nanoseconds at the end of the frame */
+		Uint32 frame;
+		Uint64 allocations[NUM_PHASES];
+		Uint64 bytes[NUM_PHASES];
+	};
+
+	static void newFrame(void);
+	static const char* getPhaseName(Phase phase);
+	static Uint64 getViolations(void);
+	static void getFrameHistory(std::vector<FrameAllocations>& history);
+	static void writeSummary(FILE* dest);
+
+private:
+	friend class AllocationPhase;
+	friend class NoAllocationRegion;
+
+	static Phase setPhase(Phase phase);
+	static const char* enterRegion(const char* name);
+	static void leaveRegion(const char* previous);
+};
+
+/*
+ * AllocationPhase - Attributes the calling thread's allocations to a phase
+ * for the lifetime of a scope.  Use ALLOCATION_PHASE rather than this class
+ * directly.
+ */
+class AllocationPhase: boost::noncopyable {
+public:
+	explicit AllocationPhase(AllocationTracker::Phase phase) :
+		previous(AllocationTracker::setPhase(phase)) {
+	} // end AllocationPhase()
+
+	~AllocationPhase(void) {
+		AllocationTracker::setPhase(previous);
+	} // end ~AllocationPhase()
+
+private:
+	const AllocationTracker::Phase previous;
+};
+
+/*
+ * NoAllocationRegion - Marks a scope that must not allocate on the calling
+ * thread.  Use NO_ALLOCATION_REGION rather than this class directly.
+ */
+class NoAllocationRegion: boost::noncopyable {
+public:
+	explicit NoAllocationRegion(const char* name) :
+		previous(AllocationTracker::enterRegion(name)) {
+	} // end NoAllocationRegion()
+
+	~NoAllocationRegion(void) {
+		AllocationTracker::leaveRegion(previous);
+	} // end ~NoAllocationRegion()
+
+private:
+	const char* const previous;
+};
+
+#endif /* ALLOCATION_TRACKER_H_ */
@@ -0,0 +1,273 @@
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define BYTE_ORDER_X86
+#endif
+
+#include <UTIL/ByteOrder.h>
+
+namespace {
+
+/*
+ * swapScalar - Reverses the bytes of each element one at a time.  memcpy()
+ * keeps the access legal for any element type and compiles to plain loads
+ * and stores.
+ */
+template<class T, T SWAP(T)>
+void swapScalar(const Uint8* source, Uint8* destination, size_t count) {
+	for (size_t i = 0; i < count; ++i) {
+		T value;
+		std::memcpy(&value, source + i * sizeof(T), sizeof(T));
+		value = SWAP(value);
+		std::memcpy(destination + i * sizeof(T), &value, sizeof(T));
+	}
+}
+
+Uint16 bswap16(Uint16 value) {
+	return __builtin_bswap16(value);
+}
+
+Uint32 bswap32(Uint32 value) {
+	return __builtin_bswap32(value);
+}
+
+Uint64 bswap64(Uint64 value) {
+	return __builtin_bswap64(value);
+}
+
+void swapTail(const Uint8* source, Uint8* destination, size_t count,
+		size_t size) {
+	switch (size) {
+	case 2:
+		swapScalar<Uint16, bswap16> (source, destination, count);
+		break;
+	case 4:
+		swapScalar<Uint32, bswap32> (source, destination, count);
+		break;
+	case 8:
+		swapScalar<Uint64, bswap64> (source, destination, count);
+		break;
+	}
+}
+
+/*
+ * swapPlain - Portable implementation, for CPUs without SSSE3.
+ */
+void swapPlain(const void* source, void* destination, size_t count,
+		size_t size) {
+	swapTail(static_cast<const Uint8*> (source),
+			static_cast<Uint8*> (destination), count, size);
+}
+
+#ifdef BYTE_ORDER_X86
+
+/* Byte shuffle patterns that reverse 2, 4 and 8 byte elements of a lane: */
+const char SHUFFLE_16[16] = { 1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12,
+		15, 14 };
+const char SHUFFLE_32[16] = { 3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14,
+		13, 12 };
+const char SHUFFLE_64[16] = { 7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10,
+		9, 8 };
+
+/* Copies from this size on bypass the cache with streaming stores: */
+const size_t STREAMING_THRESHOLD = 4 << 20;
+
+const char* shuffleFor(size_t size) {
+	return size == 2 ? SHUFFLE_16 : size == 4 ? SHUFFLE_32 : SHUFFLE_64;
+}
+
+/*
+ * swapSSSE3 - Swaps 64 bytes per round with pshufb.
+ */
+__attribute__((target("ssse3")))
+void swapSSSE3(const void* source, void* destination, size_t count,
+		size_t size) {
+	const Uint8* in = static_cast<const Uint8*> (source);
+	Uint8* out = static_cast<Uint8*> (destination);
+	const size_t bytes = count * size;
+	const __m128i shuffle = _mm_loadu_si128(
+			reinterpret_cast<const __m128i*> (shuffleFor(size)));
+
+	size_t i = 0;
+	for (; i + 64 <= bytes; i += 64) {
+		const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*> (in
+				+ i));
+		const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*> (in
+				+ i + 16));
+		const __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*> (in
+				+ i + 32));
+		const __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*> (in
+				+ i + 48));
+		_mm_storeu_si128(reinterpret_cast<__m128i*> (out + i), _mm_shuffle_epi8(
+				a, shuffle));
+		_mm_storeu_si128(reinterpret_cast<__m128i*> (out + i + 16),
+				_mm_shuffle_epi8(b, shuffle));
+		_mm_storeu_si128(reinterpret_cast<__m128i*> (out + i + 32),
+				_mm_shuffle_epi8(c, shuffle));
+		_mm_storeu_si128(reinterpret_cast<__m128i*> (out + i + 48),
+				_mm_shuffle_epi8(d, shuffle));
+	}
+	for (; i + 16 <= bytes; i += 16) {
+		const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*> (in
+				+ i));
+		_mm_storeu_si128(reinterpret_cast<__m128i*> (out + i), _mm_shuffle_epi8(
+				a, shuffle));
+	}
+
+	swapTail(in + i, out + i, (bytes - i) / size, size);
+}
+
+/*
+ * swapAVX2 - Swaps 128 bytes per round with vpshufb.  The shuffle works
+ * within 16 byte lanes, which is all an element swap needs.
+ *
+ * Large copies that would not fit in the cache are written with streaming
+ * stores, which skip reading the destination into the cache first.
+ */
+__attribute__((target("avx2")))
+void swapAVX2(const void* source, void* destination, size_t count,
+		size_t size) {
+	const Uint8* in = static_cast<const Uint8*> (source);
+	Uint8* out = static_cast<Uint8*> (destination);
+	const size_t bytes = count * size;
+	const __m128i lane = _mm_loadu_si128(
+			reinterpret_cast<const __m128i*> (shuffleFor(size)));
+	const __m256i shuffle = _mm256_broadcastsi128_si256(lane);
+
+	size_t i = 0;
+	if (in != out && bytes >= STREAMING_THRESHOLD && reinterpret_cast<size_t> (
+			out) % size == 0) {
+		// Streaming stores need an aligned destination.
+		const size_t head = (32 - reinterpret_cast<size_t> (out) % 32) % 32;
+		swapTail(in, out, head / size, size);
+		for (i = head; i + 32 <= bytes; i += 32) {
+			const __m256i a = _mm256_loadu_si256(
+					reinterpret_cast<const __m256i*> (in + i));
+			_mm256_stream_si256(reinterpret_cast<__m256i*> (out + i),
+					_mm256_shuffle_epi8(a, shuffle));
+		}
+		_mm_sfence();
+	}
+
+	for (; i + 128 <= bytes; i += 128) {
+		const __m256i a = _mm256_loadu_si256(
+				reinterpret_cast<const __m256i*> (in + i));
+		const __m256i b = _mm256_loadu_si256(
+				reinterpret_cast<const __m256i*> (in + i + 32));
+		const __m256i c = _mm256_loadu_si256(
+				reinterpret_cast<const __m256i*> (in + i + 64));
+		const __m256i d = _mm256_loadu_si256(
+				reinterpret_cast<const __m256i*> (in + i + 96));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*> (out + i),
+				_mm256_shuffle_epi8(a, shuffle));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*> (out + i + 32),
+				_mm256_shuffle_epi8(b, shuffle));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*> (out + i + 64),
+				_mm256_shuffle_epi8(c, shuffle));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*> (out + i + 96),
+				_mm256_shuffle_epi8(d, shuffle));
+	}
+	for (; i + 32 <= bytes; i += 32) {
+		const __m256i a = _mm256_loadu_si256(
+				reinterpret_cast<const __m256i*> (in + i));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*> (out + i),
+				_mm256_shuffle_epi8(a, shuffle));
+	}
+
+	swapTail(in + i, out + i, (bytes - i) / size, size);
+}
+
+#endif /* BYTE_ORDER_X86 */
+
+typedef void (*SwapFunction)(const void*, void*, size_t, size_t);
+
+struct Implementation {
+	SwapFunction swap;
+	const char* name;
+};
+
+/*
+ * selectImplementation - Picks the widest kernel the CPU supports.
+ */
+Implementation selectImplementation(void) {
+	Implementation implementation = { &swapPlain, "scalar" };
+#ifdef BYTE_ORDER_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) {
+		implementation.swap = &swapAVX2;
+		implementation.name = "AVX2";
+	} else if (__builtin_cpu_supports("ssse3")) {
+		implementation.swap = &swapSSSE3;
+		implementation.name = "SSSE3";
+	}
+#endif
+	return implementation;
+}
+
+const Implementation& getKernel(void) {
+	static const Implementation implementation = selectImplementation();
+	return implementation;
+}
+
+}
+
+/*
+ * swap - Reverses the bytes of each element, in place.
+ */
+void ByteOrder::swap(Uint16* data, size_t count) {
+	swapBytes(data, data, count, sizeof(*data));
+} // end swap()
+
+void ByteOrder::swap(Uint32* data, size_t count) {
+	swapBytes(data, data, count, sizeof(*data));
+} // end swap()
+
+void ByteOrder::swap(Uint64* data, size_t count) {
+	swapBytes(data, data, count, sizeof(*data));
+} // end swap()
+
+/*
+ * swap - Copies \p count elements from \p source to \p destination,
+ * reversing the bytes of each.
+ */
+void ByteOrder::swap(const Uint16* source, Uint16* destination, size_t count) {
+	swapBytes(source, destination, count, sizeof(*source));
+} // end swap()
+
+void ByteOrder::swap(const Uint32* source, Uint32* destination, size_t count) {
+	swapBytes(source, destination, count, sizeof(*source));
+} // end swap()
+
+void ByteOrder::swap(const Uint64* source, Uint64* destination, size_t count) {
+	swapBytes(source, destination, count, sizeof(*source));
+} // end swap()
+
+/*
+ * getImplementation - Returns the name of the kernel in use: "AVX2",
+ * "SSSE3" or "scalar".
+ */
+const char* ByteOrder::getImplementation(void) {
+	return getKernel().name;
+} // end getImplementation()
+
+/*
+ * convert - Converts between big-endian and host order: a byte swap on
+ * little-endian hosts, a copy on big-endian ones.
+ */
+void ByteOrder::convert(const void* source, void* destination, size_t count,
+		size_t size) {
+	if (HOST_IS_LITTLE_ENDIAN) {
+		swapBytes(source, destination, count, size);
+	} else if (source != destination) {
+		std::memcpy(destination, source, count * size);
+	}
+} // end convert()
+
+/*
+ * swapBytes - Reverses the bytes of \p count elements of \p size bytes.
+ */
+void ByteOrder::swapBytes(const void* source, void* destination, size_t count,
+		size_t size) {
+	getKernel().swap(source, destination, count, size);
+} // end swapBytes()
@@ -0,0 +1,87 @@
+#ifndef BYTE_ORDER_H_
+#define BYTE_ORDER_H_
+
+#include <cstddef>
+
+/* Boost includes */
+#include <boost/static_assert.hpp>
+
+#include <UTIL/Types.h>
+
+#if !defined(__BYTE_ORDER__) || !defined(__ORDER_LITTLE_ENDIAN__)
+#error "The compiler does not tell the host byte order"
+#endif
+
+/*
+ * ByteOrder - Byte order conversion of whole arrays, for the big-endian
+ * blocks that telemetry and simulation data arrive in.  Each call swaps
+ * millions of values with SSSE3 or AVX2 shuffles (whichever the CPU
+ * supports, chosen once at startup) and finishes with a scalar tail.
+ *
+ * The networkToHost() and hostToNetwork() overloads convert between
+ * big-endian (network) order and the host order.  Since the host order is
+ * known at compile time, they compile to a copy or nothing on big-endian
+ * hosts.  swap() always reverses the bytes of every element.
+ *
+ * Every function comes in two forms: in place, and from \p source to
+ * \p destination.  The two arrays of the second form must either be the
+ * same or not overlap at all.  No alignment is required.
+ */
+class ByteOrder {
+public:
+	enum {
+		HOST_IS_LITTLE_ENDIAN = __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+	};
+
+	static void swap(Uint16* data, size_t count);
+	static void swap(Uint32* data, size_t count);
+	static void swap(Uint64* data, size_t count);
+	static void swap(const Uint16* source, Uint16* destination, size_t count);
+	static void swap(const Uint32* source, Uint32* destination, size_t count);
+	static void swap(const Uint64* source, Uint64* destination, size_t count);
+
+	/*
+	 * networkToHost - Converts big-endian values to host order, in place.
+	 */
+	template<class T>
+	static void networkToHost(T* data, size_t count) {
+		networkToHost(data, data, count);
+	} // end networkToHost()
+
+	/*
+	 * networkToHost - Converts big-endian values to host order.
+	 */
+	template<class T>
+	static void networkToHost(const T* source, T* destination, size_t count) {
+		BOOST_STATIC_ASSERT(sizeof(T) == 2 || sizeof(T) == 4 || sizeof(T) == 8);
+		convert(source, destination, count, sizeof(T));
+	} // end networkToHost()
+
+	/*
+	 * hostToNetwork - Converts values in host order to big-endian, in place.
+	 */
+	template<class T>
+	static void hostToNetwork(T* data, size_t count) {
+		hostToNetwork(data, data, count);
+	} // end hostToNetwork()
+
+	/*
+	 * hostToNetwork - Converts values in host order to big-endian.
+	 */
+	template<class T>
+	static void hostToNetwork(const T* source, T* destination, size_t count) {
+		BOOST_STATIC_ASSERT(sizeof(T) == 2 || sizeof(T) == 4 || sizeof(T) == 8);
+		// Byte swapping is its own inverse.
+		convert(source, destination, count, sizeof(T));
+	} // end hostToNetwork()
+
+	static const char* getImplementation(void);
+
+private:
+	static void convert(const void* source, void* destination, size_t count,
+			size_t size);
+	static void swapBytes(const void* source, void* destination, size_t count,
+			size_t size);
+};
+
+#endif /* BYTE_ORDER_H_ */
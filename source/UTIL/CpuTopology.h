@@ -0,0 +1,64 @@
+#ifndef CPU_TOPOLOGY_H_
+#define CPU_TOPOLOGY_H_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include <UTIL/Types.h>
+
+/*
+ * CpuCache - One CPU cache, as described in
+ * /sys/devices/system/cpu/cpu<N>/cache/index<M>.
+ */
+struct CpuCache {
+	int level; /**< 1 for L1 etc. */
+	std::string type; /**< "Data", "Instruction" or "Unified" */
+	Uint64 size; /**< In bytes */
+	Uint32 lineSize; /**< In bytes */
+	std::vector<int> cpus; /**< The logical CPUs that share this cache */
+};
+
+/*
+ * CpuInfo - One logical CPU (a hardware thread).
+ */
+struct CpuInfo {
+	int id; /**< The number the kernel uses for this CPU */
+	int package; /**< Physical socket */
+	int core; /**< Core id, unique within the package */
+	int numaNode; /**< NUMA node, 0 if the system has no NUMA information */
+	std::vector<int> siblings; /**< SMT siblings on the same core, incl. id */
+};
+
+/*
+ * CpuTopology - The online CPUs of the machine with their cores, sockets,
+ * caches and NUMA nodes.
+ *
+ * @see SystemPosix::getCpuTopology()
+ */
+struct CpuTopology {
+	std::vector<CpuInfo> cpus; /**< Sorted by id */
+	std::vector<CpuCache> caches; /**< Each shared cache is listed once */
+	std::vector<std::vector<int> > numaNodes; /**< CPUs of each node */
+	int numPackages;
+	int numCores; /**< Physical cores, over all packages */
+
+	CpuTopology(void) :
+		numPackages(0), numCores(0) {
+	} // end CpuTopology()
+
+	/*
+	 * findCpu - Returns the entry of the CPU with the given kernel id, or
+	 * NULL if it is not online.
+	 */
+	const CpuInfo* findCpu(int id) const {
+		for (size_t i = 0; i < cpus.size(); ++i) {
+			if (cpus[i].id == id) {
+				return &cpus[i];
+			}
+		}
+		return NULL;
+	} // end findCpu()
+};
+
+#endif /* CPU_TOPOLOGY_H_ */
@@ -1,16 +1,17 @@
-
-#include <iostream>
+#include <sstream>
 
 #include <UTIL/Exception.h>
 #include <UTIL/System.h>
 
-Exception::Exception(const std::string& _description, const std::string& _location)
-   throw()
+Exception::Exception(const std::string& _description,
+                     const SourceLocation& _location) throw()
    : std::runtime_error(_description)
    , description(_description)
    , location(_location)
 {
-   stackTrace = SystemPosix::getCallStack();
+   // Skip our own frame; the trace starts at the throw site.
+   numStackFrames = SystemPosix::captureCallStack(stackFrames,
+                                                  MAX_STACK_FRAMES, 1);
 }
 
 Exception::~Exception() throw()
@@ -39,16 +40,60 @@ void Exception::setDescription(const std::string& desc)
    description = desc;
 }
 
-const std::string& Exception::getLocation() const
+/*
+ * getLocation - Returns the location of the throw site as "file:line", or ""
+ * if the exception was created without one.
+ */
+std::string Exception::getLocation() const
+{
+   if (location.line == 0)
+   {
+      return std::string(location.file);
+   }
+
+   std::ostringstream stream;
+   stream << location.file << ":" << location.line;
+   return stream.str();
+}
+
+const char* Exception::getFile() const
+{
+   return location.file;
+}
+
+int Exception::getLine() const
 {
-   return location;
+   return location.line;
 }
 
+/*
+ * getStackTrace - Returns the call stack at the point the exception was
+ * created.  The function names are looked up on the first call.
+ */
 const std::string& Exception::getStackTrace() const
 {
+   if (stackTrace.empty())
+   {
+      stackTrace = SystemPosix::symbolizeCallStack(stackFrames,
+                                                   numStackFrames);
+   }
    return stackTrace;
 }
 
+/*
+ * getStackFrames - Returns the raw return addresses of the call stack, for
+ * symbolizing elsewhere (see Logger::logException()).
+ */
+void* const* Exception::getStackFrames() const
+{
+   return stackFrames;
+}
+
+int Exception::getNumStackFrames() const
+{
+   return numStackFrames;
+}
+
 std::string Exception::getExtendedDescription() const
 {
    return this->getExceptionName() + std::string(": ") + getDescription();
@@ -56,6 +101,6 @@ std::string Exception::getExtendedDescription() const
 
 std::string Exception::getFullDescription() const
 {
-   return getExtendedDescription() + std::string("  ") + location +
-             std::string("\n") + stackTrace;
+   return getExtendedDescription() + std::string("  ") + getLocation() +
+             std::string("\n") + getStackTrace();
 }
@@ -4,34 +4,56 @@
 #include <string>
 #include <stdexcept>
 
-/* Boost */
-#include <boost/preprocessor/stringize.hpp>
-
-#define LOCATION std::string(__FILE__) + std::string(":") + \
-           std::string(BOOST_PP_STRINGIZE(__LINE__))
+#define LOCATION SourceLocation(__FILE__, __LINE__)
 
 /**
  * @example "Example of using exceptions"
  *
  * All exceptions derive from Exception, and its constructor takes two
- * parameters: a description of the error and an optional string describing the
- * location in the code at which the error occurred. The easiest way to get the
- * location information is to use the preprocessor symbol \c LOCATION.
+ * parameters: a description of the error and an optional SourceLocation
+ * describing the location in the code at which the error occurred. The
+ * easiest way to get the location information is to use the preprocessor
+ * symbol \c LOCATION.
  *
  * \code
  * throw Exception("An error occurred", LOCATION);
  * \endcode
  */
 
+/*
+ * SourceLocation - A file name and line number, as produced by \c LOCATION.
+ * The file name is not copied, so it must be a string literal (which
+ * __FILE__ is).
+ */
+struct SourceLocation {
+	SourceLocation(const char* _file = "", int _line = 0) :
+		file(_file), line(_line) {
+	}
+
+	const char* file;
+	int line;
+};
+
 /*
  * Exception - Base exception for all exceptions. Exception areas:
  * - I/O loading/saving issues
  * - Property access errors
  * - Invalid data type errors
+ *
+ * The call stack is captured as raw return addresses when the exception is
+ * created, which is cheap.  It is only turned into function names when
+ * getStackTrace() or what() is first called.  LOG_EXCEPTION writes the same
+ * text as getFullDescription(), but leaves the name lookup to the logger's
+ * writer thread.
  */
 class Exception: public std::runtime_error {
 public:
-	Exception(const std::string& desc, const std::string& location) throw ();
+	enum {
+		MAX_STACK_FRAMES = 32
+	};
+
+	Exception(const std::string& desc, const SourceLocation& location =
+			SourceLocation()) throw ();
 	virtual ~Exception() throw ();
 
 	virtual const char* what() const throw ();
@@ -41,8 +63,12 @@ public:
 	const std::string& getDescription() const;
 	void setDescription(const std::string& desc);
 
-	const std::string& getLocation() const;
+	std::string getLocation() const;
+	const char* getFile() const;
+	int getLine() const;
 	const std::string& getStackTrace() const;
+	void* const* getStackFrames() const;
+	int getNumStackFrames() const;
 
 	virtual std::string getExtendedDescription() const;
 
@@ -50,8 +76,11 @@ public:
 
 protected:
 	std::string description;
-	std::string location;
-	std::string stackTrace;
+	SourceLocation location;
+
+	void* stackFrames[MAX_STACK_FRAMES];
+	int numStackFrames;
+	mutable std::string stackTrace; /**< Filled in on first use */
 
 	mutable std::string fullDescription;
 };
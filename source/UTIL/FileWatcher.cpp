@@ -0,0 +1,128 @@
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include <UTIL/FileWatcher.h>
+#include <UTIL/Logger.h>
+
+/*
+ * FileWatcher - Constructor for FileWatcher class.
+ */
+FileWatcher::FileWatcher(void) :
+	fd(inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) {
+	if (fd < 0) {
+		LOG_WARNING("Cannot watch files: inotify: %s", strerror(errno));
+	}
+} // end FileWatcher()
+
+/*
+ * ~FileWatcher - Destructor for FileWatcher class.
+ */
+FileWatcher::~FileWatcher(void) {
+	if (fd >= 0) {
+		close(fd);
+	}
+} // end ~FileWatcher()
+
+bool FileWatcher::isEnabled(void) const {
+	return fd >= 0;
+} // end isEnabled()
+
+/*
+ * watch - Reports changes of \p path from now on, as \p path.  Watching a
+ * file twice is harmless; a file watched under several paths is reported
+ * under each of them.
+ *
+ * @return \c false is returned if its directory cannot be watched.
+ */
+bool FileWatcher::watch(const std::string& path) {
+	if (fd < 0) {
+		return false;
+	}
+	const size_t slash = path.rfind('/');
+	const std::string directory = slash == std::string::npos ? "."
+			: slash == 0 ? "/" : path.substr(0, slash);
+	const std::string name = slash == std::string::npos ? path : path.substr(
+			slash + 1);
+
+	// inotify gives every spelling of a directory the same watch, so the
+	// files are kept under its real path.
+	char realDirectory[PATH_MAX];
+	if (realpath(directory.c_str(), realDirectory) == NULL) {
+		LOG_WARNING("Cannot watch %s: %s", directory.c_str(), strerror(errno));
+		return false;
+	}
+	const int wd = inotify_add_watch(fd, realDirectory, IN_CLOSE_WRITE
+			| IN_MOVED_TO);
+	if (wd < 0) {
+		LOG_WARNING("Cannot watch %s: %s", directory.c_str(), strerror(errno));
+		return false;
+	}
+	directories[wd] = realDirectory;
+
+	const std::string key = std::string(realDirectory) + "/" + name;
+	typedef std::multimap<std::string, std::string>::const_iterator Iterator;
+	const std::pair<Iterator, Iterator> range = files.equal_range(key);
+	for (Iterator f = range.first; f != range.second; ++f) {
+		if (f->second == path) {
+			return true;
+		}
+	}
+	files.insert(std::make_pair(key, path));
+	return true;
+} // end watch()
+
+/*
+ * poll - Appends the watched files that changed since the last call to
+ * \p changed, each once.
+ */
+void FileWatcher::poll(std::vector<std::string>& changed) {
+	if (fd < 0) {
+		return;
+	}
+	const size_t first = changed.size();
+	char buffer[4096] __attribute__ ((aligned(__alignof__(inotify_event))));
+	for (;;) {
+		const ssize_t length = read(fd, buffer, sizeof(buffer));
+		if (length <= 0) {
+			if (length < 0 && errno == EINTR) {
+				continue;
+			}
+			break;
+		}
+		for (ssize_t offset = 0; offset < length;) {
+			const inotify_event* event =
+					reinterpret_cast<const inotify_event*> (buffer + offset);
+			offset += sizeof(inotify_event) + event->len;
+
+			if (event->mask & IN_Q_OVERFLOW) {
+				// Events were lost; any file may have changed.
+				for (std::multimap<std::string, std::string>::const_iterator f =
+						files.begin(); f != files.end(); ++f) {
+					changed.push_back(f->second);
+				}
+				continue;
+			}
+			const std::map<int, std::string>::const_iterator directory =
+					directories.find(event->wd);
+			if (directory == directories.end() || event->len == 0) {
+				continue;
+			}
+			typedef std::multimap<std::string, std::string>::const_iterator
+					Iterator;
+			const std::pair<Iterator, Iterator> range = files.equal_range(
+					directory->second + "/" + event->name);
+			for (Iterator file = range.first; file != range.second; ++file) {
+				changed.push_back(file->second);
+			}
+		}
+	}
+
+	std::sort(changed.begin() + first, changed.end());
+	changed.erase(std::unique(changed.begin() + first, changed.end()),
+			changed.end());
+} // end poll()
@@ -0,0 +1,39 @@
+#ifndef FILEWATCHER_H_
+#define FILEWATCHER_H_
+
+#include <map>
+#include <string>
+#include <vector>
+
+/* Boost includes */
+#include <boost/noncopyable.hpp>
+
+/*
+ * FileWatcher - Reports files that were rewritten, through inotify.  The
+ * directories of the files are watched rather than the files themselves,
+ * so files replaced by a rename (as most editors and exporters save) are
+ * still reported, and so are files that did not exist yet.  A file counts
+ * as changed once a writer closed it or it was renamed into place, never
+ * halfway through a write.
+ *
+ * poll() never blocks; call it as often as changes should be noticed.
+ * Changes made on another host of a network file system are not reported.
+ * If inotify is unavailable, nothing is ever reported.
+ */
+class FileWatcher: boost::noncopyable {
+public:
+	FileWatcher(void);
+	~FileWatcher(void);
+
+	bool isEnabled(void) const;
+	bool watch(const std::string& path);
+	void poll(std::vector<std::string>& changed);
+
+private:
+	int fd;
+	std::map<int, std::string> directories; /**< Real paths, by watch descriptor */
+	/* The paths passed to watch(), by real directory + "/" + file name: */
+	std::multimap<std::string, std::string> files;
+};
+
+#endif /* FILEWATCHER_H_ */
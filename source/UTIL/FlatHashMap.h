@@ -0,0 +1,480 @@
+#ifndef FLAT_HASH_MAP_H_
+#define FLAT_HASH_MAP_H_
+
+#include <cstddef>
+#include <cstring>
+#include <functional>
+#include <iterator>
+#include <new>
+#include <utility>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include <UTIL/Types.h>
+
+/*
+ * FlatHashMap - Hash map that keeps its entries in one flat array (open
+ * addressing with linear probing), for hot lookups by id such as node,
+ * tracker or content hash ids.
+ *
+ * Next to the entries, the map keeps one control byte per slot: 7 bits of
+ * the hash for a full slot, or EMPTY.  Lookups compare 16 control bytes at a
+ * time with SSE2 and only touch the entries whose bits match, so a miss
+ * usually costs one 16 byte load.  Erasing shifts the following entries of
+ * the probe run back instead of leaving tombstones, so lookups do not slow
+ * down as entries come and go.
+ *
+ * The map grows by doubling once it is 3/4 full.  After reserve(n), the
+ * first n entries are inserted without rehashing, so a map that is reserved
+ * up front never rehashes in the middle of a frame.
+ *
+ * Insert and erase invalidate iterators and references, since entries move.
+ * The hash functor must mix well, like Uint64Hash: the low bits select the
+ * slot.
+ */
+template<class KEY, class VALUE, class HASH = Uint64Hash,
+		class EQUAL = std::equal_to<KEY> >
+class FlatHashMap {
+public:
+	typedef KEY key_type;
+	typedef VALUE mapped_type;
+	typedef std::pair<const KEY, VALUE> value_type;
+	typedef size_t size_type;
+
+private:
+	/*
+	 * IteratorBase - Forward iterator over the full slots, for both the
+	 * const and the mutable iterator.
+	 */
+	template<class MAP, class ENTRY>
+	class IteratorBase {
+	public:
+		typedef std::forward_iterator_tag iterator_category;
+		typedef typename FlatHashMap::value_type value_type;
+		typedef std::ptrdiff_t difference_type;
+		typedef ENTRY* pointer;
+		typedef ENTRY& reference;
+
+		IteratorBase(void) :
+			map(NULL), index(0) {
+		}
+
+		IteratorBase(MAP* _map, size_t _index) :
+			map(_map), index(_index) {
+			skipEmpty();
+		}
+
+		/* Converts an iterator into a const_iterator: */
+		template<class OTHER_MAP, class OTHER_ENTRY>
+		IteratorBase(const IteratorBase<OTHER_MAP, OTHER_ENTRY>& other) :
+			map(other.map), index(other.index) {
+		}
+
+		reference operator*(void) const {
+			return map->slots[index];
+		}
+
+		pointer operator->(void) const {
+			return &map->slots[index];
+		}
+
+		IteratorBase& operator++(void) {
+			++index;
+			skipEmpty();
+			return *this;
+		}
+
+		IteratorBase operator++(int) {
+			IteratorBase old(*this);
+			++*this;
+			return old;
+		}
+
+		template<class OTHER_MAP, class OTHER_ENTRY>
+		bool operator==(const IteratorBase<OTHER_MAP, OTHER_ENTRY>& other) const {
+			return index == other.index;
+		}
+
+		template<class OTHER_MAP, class OTHER_ENTRY>
+		bool operator!=(const IteratorBase<OTHER_MAP, OTHER_ENTRY>& other) const {
+			return index != other.index;
+		}
+
+	private:
+		template<class, class > friend class IteratorBase;
+		friend class FlatHashMap;
+
+		void skipEmpty(void) {
+			while (index < map->capacity && map->control[index] == EMPTY) {
+				++index;
+			}
+		}
+
+		MAP* map;
+		size_t index;
+	};
+
+public:
+	typedef IteratorBase<FlatHashMap, value_type> iterator;
+	typedef IteratorBase<const FlatHashMap, const value_type> const_iterator;
+
+	FlatHashMap(void) :
+		control(NULL), slots(NULL), capacity(0), numEntries(0) {
+	} // end FlatHashMap()
+
+	explicit FlatHashMap(size_t expectedSize) :
+		control(NULL), slots(NULL), capacity(0), numEntries(0) {
+		reserve(expectedSize);
+	} // end FlatHashMap()
+
+	FlatHashMap(const FlatHashMap& other) :
+		control(NULL), slots(NULL), capacity(0), numEntries(0), hasher(
+				other.hasher), equal(other.equal) {
+		reserve(other.numEntries);
+		for (const_iterator i = other.begin(); i != other.end(); ++i) {
+			insertNew(*i, hashOf(i->first));
+		}
+	} // end FlatHashMap()
+
+	~FlatHashMap(void) {
+		destroyAll();
+		release(control, slots);
+	} // end ~FlatHashMap()
+
+	FlatHashMap& operator=(const FlatHashMap& other) {
+		if (this != &other) {
+			FlatHashMap copy(other);
+			swap(copy);
+		}
+		return *this;
+	} // end operator=()
+
+	iterator begin(void) {
+		return iterator(this, 0);
+	} // end begin()
+
+	const_iterator begin(void) const {
+		return const_iterator(this, 0);
+	} // end begin()
+
+	iterator end(void) {
+		return iterator(this, capacity);
+	} // end end()
+
+	const_iterator end(void) const {
+		return const_iterator(this, capacity);
+	} // end end()
+
+	size_t size(void) const {
+		return numEntries;
+	} // end size()
+
+	bool empty(void) const {
+		return numEntries == 0;
+	} // end empty()
+
+	/*
+	 * getCapacity - Returns the number of slots.  At most 3/4 of them are
+	 * used before the map grows.
+	 */
+	size_t getCapacity(void) const {
+		return capacity;
+	} // end getCapacity()
+
+	iterator find(const KEY& key) {
+		const size_t index = findIndex(key, hashOf(key));
+		return index == NOT_FOUND ? end() : iterator(this, index);
+	} // end find()
+
+	const_iterator find(const KEY& key) const {
+		const size_t index = findIndex(key, hashOf(key));
+		return index == NOT_FOUND ? end() : const_iterator(this, index);
+	} // end find()
+
+	/*
+	 * count - Returns 1 if \p key is in the map, and 0 otherwise.
+	 */
+	size_t count(const KEY& key) const {
+		return findIndex(key, hashOf(key)) == NOT_FOUND ? 0 : 1;
+	} // end count()
+
+	/*
+	 * insert - Inserts \p entry unless its key is in the map already.
+	 *
+	 * @return The entry with the key, and \c true if it was inserted.
+	 */
+	std::pair<iterator, bool> insert(const value_type& entry) {
+		const Uint64 hash = hashOf(entry.first);
+		size_t index = findIndex(entry.first, hash);
+		if (index != NOT_FOUND) {
+			return std::make_pair(iterator(this, index), false);
+		}
+
+		if (needsGrowth()) {
+			rehash(capacity == 0 ? size_t(MIN_CAPACITY) : capacity * 2);
+		}
+		index = insertNew(entry, hash);
+		return std::make_pair(iterator(this, index), true);
+	} // end insert()
+
+	/*
+	 * operator[] - Returns the value of \p key, inserting a default value if
+	 * the key is not in the map yet.
+	 */
+	VALUE& operator[](const KEY& key) {
+		return insert(value_type(key, VALUE())).first->second;
+	} // end operator[]()
+
+	/*
+	 * erase - Removes the entry with the given key, if there is one.
+	 *
+	 * @return The number of entries removed (0 or 1).
+	 */
+	size_t erase(const KEY& key) {
+		const size_t index = findIndex(key, hashOf(key));
+		if (index == NOT_FOUND) {
+			return 0;
+		}
+		eraseIndex(index);
+		return 1;
+	} // end erase()
+
+	/*
+	 * erase - Removes the entry an iterator points to.
+	 */
+	void erase(const_iterator position) {
+		eraseIndex(position.index);
+	} // end erase()
+
+	/*
+	 * clear - Removes all entries but keeps the slots, so refilling the map
+	 * does not allocate.
+	 */
+	void clear(void) {
+		destroyAll();
+		if (capacity > 0) {
+			std::memset(control, EMPTY, capacity + GROUP_SIZE - 1);
+		}
+		numEntries = 0;
+	} // end clear()
+
+	/*
+	 * reserve - Makes room for \p expectedSize entries, so that inserting up
+	 * to that many does not rehash.
+	 */
+	void reserve(size_t expectedSize) {
+		size_t needed = MIN_CAPACITY;
+		while (needed - needed / 4 < expectedSize) {
+			needed *= 2;
+		}
+		if (needed > capacity) {
+			rehash(needed);
+		}
+	} // end reserve()
+
+	void swap(FlatHashMap& other) {
+		std::swap(control, other.control);
+		std::swap(slots, other.slots);
+		std::swap(capacity, other.capacity);
+		std::swap(numEntries, other.numEntries);
+		std::swap(hasher, other.hasher);
+		std::swap(equal, other.equal);
+	} // end swap()
+
+private:
+	enum {
+		GROUP_SIZE = 16, /**< Control bytes compared at once */
+		MIN_CAPACITY = 16
+	};
+
+	static const Uint8 EMPTY = 0x80;
+	static const size_t NOT_FOUND = ~size_t(0);
+
+	/*
+	 * matchGroup - Returns a bit mask of the bytes in \p group[0..15] that
+	 * equal \p value.
+	 */
+	static Uint32 matchGroup(const Uint8* group, Uint8 value) {
+#ifdef __SSE2__
+		const __m128i bytes = _mm_loadu_si128(
+				reinterpret_cast<const __m128i*> (group));
+		return Uint32(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8(
+				char(value)))));
+#else
+		Uint32 mask(0);
+		for (int i = 0; i < GROUP_SIZE; ++i) {
+			mask |= Uint32(group[i] == value) << i;
+		}
+		return mask;
+#endif
+	} // end matchGroup()
+
+	Uint64 hashOf(const KEY& key) const {
+		return Uint64(hasher(key));
+	} // end hashOf()
+
+	size_t homeOf(Uint64 hash) const {
+		return size_t(hash >> 7) & (capacity - 1);
+	} // end homeOf()
+
+	static Uint8 tagOf(Uint64 hash) {
+		return Uint8(hash & 0x7f);
+	} // end tagOf()
+
+	/*
+	 * setControl - Sets the control byte of a slot.  The first GROUP_SIZE - 1
+	 * bytes are mirrored behind the end, so a group can be loaded from any
+	 * slot without wrapping around.
+	 */
+	void setControl(size_t index, Uint8 value) {
+		control[index] = value;
+		if (index < GROUP_SIZE - 1) {
+			control[capacity + index] = value;
+		}
+	} // end setControl()
+
+	/*
+	 * findIndex - Returns the slot of \p key, or NOT_FOUND.  A key sits in
+	 * the run of full slots that starts at its home slot, so the search ends
+	 * at the first empty slot.
+	 */
+	size_t findIndex(const KEY& key, Uint64 hash) const {
+		if (numEntries == 0) {
+			return NOT_FOUND;
+		}
+
+		const Uint8 tag = tagOf(hash);
+		size_t position = homeOf(hash);
+		for (size_t probed = 0; probed < capacity; probed += GROUP_SIZE) {
+			const Uint8* group = control + position;
+			const Uint32 empties = matchGroup(group, EMPTY);
+			Uint32 matches = matchGroup(group, tag);
+			if (empties != 0) {
+				// Only slots before the first empty one belong to the run.
+				matches &= (empties & (0 - empties)) - 1;
+			}
+
+			while (matches != 0) {
+				const size_t index = (position + __builtin_ctz(matches))
+						& (capacity - 1);
+				if (equal(slots[index].first, key)) {
+					return index;
+				}
+				matches &= matches - 1;
+			}
+
+			if (empties != 0) {
+				return NOT_FOUND;
+			}
+			position = (position + GROUP_SIZE) & (capacity - 1);
+		}
+		return NOT_FOUND;
+	} // end findIndex()
+
+	/*
+	 * insertNew - Puts an entry whose key is not in the map into the first
+	 * empty slot of its run.
+	 *
+	 * @pre There is room for one more entry.
+	 */
+	size_t insertNew(const value_type& entry, Uint64 hash) {
+		size_t position = homeOf(hash);
+		Uint32 empties;
+		while ((empties = matchGroup(control + position, EMPTY)) == 0) {
+			position = (position + GROUP_SIZE) & (capacity - 1);
+		}
+
+		const size_t index = (position + __builtin_ctz(empties)) & (capacity
+				- 1);
+		new (&slots[index]) value_type(entry);
+		setControl(index, tagOf(hash));
+		++numEntries;
+		return index;
+	} // end insertNew()
+
+	/*
+	 * eraseIndex - Removes the entry in slot \p index.  Entries further down
+	 * the run move back into the gap, unless that would put them before
+	 * their home slot, so no run is ever cut short.
+	 */
+	void eraseIndex(size_t index) {
+		const size_t mask = capacity - 1;
+		slots[index].~value_type();
+
+		size_t gap = index;
+		for (size_t next = (index + 1) & mask; control[next] != EMPTY; next
+				= (next + 1) & mask) {
+			const size_t home = homeOf(hashOf(slots[next].first));
+			// The entry has to stay if its home lies in (gap, next].
+			const bool stays = gap <= next ? gap < home && home <= next : gap
+					< home || home <= next;
+			if (!stays) {
+				new (&slots[gap]) value_type(slots[next]);
+				slots[next].~value_type();
+				setControl(gap, control[next]);
+				gap = next;
+			}
+		}
+
+		setControl(gap, EMPTY);
+		--numEntries;
+	} // end eraseIndex()
+
+	/*
+	 * rehash - Moves all entries into \p newCapacity slots.
+	 */
+	void rehash(size_t newCapacity) {
+		Uint8* oldControl = control;
+		value_type* oldSlots = slots;
+		const size_t oldCapacity = capacity;
+
+		control = new Uint8[newCapacity + GROUP_SIZE - 1];
+		try {
+			slots = static_cast<value_type*> (::operator new(newCapacity
+					* sizeof(value_type)));
+		} catch (...) {
+			delete[] control;
+			control = oldControl;
+			throw;
+		}
+		std::memset(control, EMPTY, newCapacity + GROUP_SIZE - 1);
+		capacity = newCapacity;
+		numEntries = 0;
+
+		for (size_t i = 0; i < oldCapacity; ++i) {
+			if (oldControl[i] != EMPTY) {
+				insertNew(oldSlots[i], hashOf(oldSlots[i].first));
+				oldSlots[i].~value_type();
+			}
+		}
+		release(oldControl, oldSlots);
+	} // end rehash()
+
+	bool needsGrowth(void) const {
+		return numEntries + 1 > capacity - capacity / 4;
+	} // end needsGrowth()
+
+	void destroyAll(void) {
+		for (size_t i = 0; i < capacity; ++i) {
+			if (control[i] != EMPTY) {
+				slots[i].~value_type();
+			}
+		}
+	} // end destroyAll()
+
+	static void release(Uint8* oldControl, value_type* oldSlots) {
+		delete[] oldControl;
+		::operator delete(oldSlots);
+	} // end release()
+
+	Uint8* control; /**< capacity + GROUP_SIZE - 1 control bytes */
+	value_type* slots;
+	size_t capacity; /**< A power of two, or 0 */
+	size_t numEntries;
+	HASH hasher;
+	EQUAL equal;
+};
+
+#endif /* FLAT_HASH_MAP_H_ */
@@ -0,0 +1,183 @@
+#include <cstdlib>
+#include <cstring>
+
+#include <UTIL/FrameArena.h>
+
+namespace {
+
+/* The arena of the innermost FrameArenaScope on this thread: */
+__thread FrameArena* currentArena = NULL;
+
+}
+
+/*****************************************
+ Methods of class FrameArena:
+ *****************************************/
+
+/*
+ * FrameArena - Constructor for FrameArena class.  No memory is allocated
+ * until the first allocate().
+ *
+ * @param _blockSize The size of the first block.  This parameter is optional
+ *                   and defaults to 64 KB.
+ */
+FrameArena::FrameArena(size_t _blockSize) :
+	blockSize(_blockSize), blocks(NULL), current(NULL), end(NULL),
+			usedInOldBlocks(0), capacity(0), peakUsage(0),
+			numBlockAllocations(0) {
+#ifdef DEBUG
+	poisoning = true;
+#else
+	poisoning = false;
+#endif
+} // end FrameArena()
+
+/*
+ * ~FrameArena - Destructor for FrameArena class.
+ */
+FrameArena::~FrameArena(void) {
+	releaseBlocks();
+} // end ~FrameArena()
+
+/*
+ * reset - Releases everything allocated since the last reset.  If that took
+ * more than one block, the blocks are merged into one, so the next frame of
+ * the same size does not allocate.
+ */
+void FrameArena::reset(void) {
+	const size_t used = getBytesUsed();
+	if (used > peakUsage) {
+		peakUsage = used;
+	}
+
+	if (blocks != NULL && blocks->next != NULL) {
+		const size_t total = capacity;
+		releaseBlocks();
+		addBlock(total);
+	} else if (blocks != NULL) {
+		char* start = reinterpret_cast<char*> (blocks + 1);
+		if (poisoning) {
+			std::memset(start, POISON, current - start);
+		}
+		current = start;
+	}
+	usedInOldBlocks = 0;
+} // end reset()
+
+/*
+ * getBytesUsed - Returns the number of bytes handed out since the last
+ * reset, including alignment padding.
+ */
+size_t FrameArena::getBytesUsed(void) const {
+	return blocks == NULL ? 0 : usedInOldBlocks + (current
+			- reinterpret_cast<char*> (blocks + 1));
+} // end getBytesUsed()
+
+/*
+ * getCapacity - Returns the total size of the blocks the arena holds.
+ */
+size_t FrameArena::getCapacity(void) const {
+	return capacity;
+} // end getCapacity()
+
+/*
+ * getPeakUsage - Returns the highest getBytesUsed() seen at a reset.
+ */
+size_t FrameArena::getPeakUsage(void) const {
+	return peakUsage;
+} // end getPeakUsage()
+
+/*
+ * getNumBlockAllocations - Returns how often the arena went to the heap.  It
+ * stops growing once the frames reach their usual size.
+ */
+Uint64 FrameArena::getNumBlockAllocations(void) const {
+	return numBlockAllocations;
+} // end getNumBlockAllocations()
+
+/*
+ * setPoisoning - Turns overwriting released memory with POISON on or off.
+ */
+void FrameArena::setPoisoning(bool enabled) {
+	poisoning = enabled;
+} // end setPoisoning()
+
+/*
+ * getCurrent - Returns the arena of the innermost FrameArenaScope on the
+ * calling thread, or NULL outside of any scope.
+ */
+FrameArena* FrameArena::getCurrent(void) {
+	return currentArena;
+} // end getCurrent()
+
+/*
+ * allocateSlow - Starts a new block when the current one is full.  Blocks
+ * double in size, and are always big enough for the request.
+ */
+void* FrameArena::allocateSlow(size_t size, size_t alignment) {
+	if (blocks != NULL) {
+		usedInOldBlocks += current - reinterpret_cast<char*> (blocks + 1);
+		blockSize = blocks->size * 2;
+	}
+
+	size_t needed = blockSize;
+	while (needed < size + alignment) {
+		needed *= 2;
+	}
+	addBlock(needed);
+
+	return allocate(size, alignment);
+} // end allocateSlow()
+
+/*
+ * addBlock - Makes a new block of \p size usable bytes the current one.
+ *
+ * @throw std::bad_alloc is thrown if the heap is exhausted.
+ */
+void FrameArena::addBlock(size_t size) {
+	Block* block = static_cast<Block*> (std::malloc(sizeof(Block) + size));
+	if (block == NULL) {
+		throw std::bad_alloc();
+	}
+
+	block->next = blocks;
+	block->size = size;
+	blocks = block;
+	current = reinterpret_cast<char*> (block + 1);
+	end = current + size;
+	capacity += size;
+	++numBlockAllocations;
+} // end addBlock()
+
+/*
+ * releaseBlocks - Returns all blocks to the heap.
+ */
+void FrameArena::releaseBlocks(void) {
+	while (blocks != NULL) {
+		Block* next = blocks->next;
+		std::free(blocks);
+		blocks = next;
+	}
+	current = NULL;
+	end = NULL;
+	capacity = 0;
+} // end releaseBlocks()
+
+/*****************************************
+ Methods of class FrameArenaScope:
+ *****************************************/
+
+/*
+ * FrameArenaScope - Constructor for FrameArenaScope class.
+ */
+FrameArenaScope::FrameArenaScope(FrameArena& arena) :
+	previous(currentArena) {
+	currentArena = &arena;
+} // end FrameArenaScope()
+
+/*
+ * ~FrameArenaScope - Destructor for FrameArenaScope class.
+ */
+FrameArenaScope::~FrameArenaScope(void) {
+	currentArena = previous;
+} // end ~FrameArenaScope()
@@ -0,0 +1,206 @@
+#ifndef FRAME_ARENA_H_
+#define FRAME_ARENA_H_
+
+#include <cstddef>
+#include <limits>
+#include <new>
+
+/* Boost includes */
+#include <boost/noncopyable.hpp>
+
+#include <UTIL/Types.h>
+
+/*
+ * FrameArena - Bump allocator for memory that only lives until the end of a
+ * frame: event data, temporary matrices and plane arrays, analysis results.
+ * Allocating is a pointer increment, freeing is a no-op, and reset() at the
+ * frame boundary releases everything at once.
+ *
+ * The arena takes memory from the heap in blocks.  When a frame needed more
+ * than one block, reset() replaces them by a single block of the combined
+ * size, so once the frames reach their usual size the arena stops touching
+ * the heap.
+ *
+ * The arena does not run destructors.  Only put objects in it that do not
+ * need one, or destroy them by hand.  An arena is meant to be used by one
+ * thread at a time, such as one for frame() and one per render context for
+ * display().  Code deep down the call chain can reach the arena of the
+ * current scope through getCurrent().
+ *
+ * With poisoning on (the default in DEBUG builds), reset() overwrites the
+ * released memory with 0xDD so that stale pointers into the last frame show
+ * up quickly.
+ */
+class FrameArena: boost::noncopyable {
+public:
+	enum {
+		DEFAULT_ALIGNMENT = 16, /**< Enough for any scalar and SSE type */
+		POISON = 0xDD
+	};
+
+	explicit FrameArena(size_t blockSize = 64 * 1024);
+	~FrameArena(void);
+
+	/*
+	 * allocate - Returns \p size bytes of uninitialized memory that stays
+	 * valid until the next reset().
+	 *
+	 * @param alignment A power of two.  This parameter is optional and
+	 *                  defaults to DEFAULT_ALIGNMENT.
+	 *
+	 * @throw std::bad_alloc is thrown if a new block cannot be allocated.
+	 */
+	void* allocate(size_t size, size_t alignment = DEFAULT_ALIGNMENT) {
+		char* start = reinterpret_cast<char*> ((reinterpret_cast<size_t> (current)
+				+ alignment - 1) & ~(alignment - 1));
+		if (start + size > end || start < current) {
+			return allocateSlow(size, alignment);
+		}
+		current = start + size;
+		return start;
+	} // end allocate()
+
+	/*
+	 * allocateArray - Returns uninitialized memory for \p count objects of
+	 * type T.
+	 */
+	template<class T>
+	T* allocateArray(size_t count) {
+		if (count > std::numeric_limits<size_t>::max() / sizeof(T)) {
+			throw std::bad_alloc();
+		}
+		return static_cast<T*> (allocate(count * sizeof(T),
+				__alignof__(T) > DEFAULT_ALIGNMENT ? __alignof__(T)
+						: size_t(DEFAULT_ALIGNMENT)));
+	} // end allocateArray()
+
+	void reset(void);
+
+	size_t getBytesUsed(void) const;
+	size_t getCapacity(void) const;
+	size_t getPeakUsage(void) const;
+	Uint64 getNumBlockAllocations(void) const;
+
+	void setPoisoning(bool enabled);
+
+	static FrameArena* getCurrent(void);
+
+private:
+	/* Header in front of every block: */
+	struct Block {
+		Block* next;
+		size_t size; /**< Usable bytes after the header */
+	};
+
+	void* allocateSlow(size_t size, size_t alignment);
+	void addBlock(size_t size);
+	void releaseBlocks(void);
+
+	size_t blockSize; /**< Size of the next block to allocate */
+	Block* blocks; /**< Newest first; allocations come from the first one */
+	char* current;
+	char* end;
+	size_t usedInOldBlocks; /**< Bytes used in the blocks after the first */
+	size_t capacity;
+	size_t peakUsage;
+	Uint64 numBlockAllocations;
+	bool poisoning;
+};
+
+/*
+ * FrameArenaScope - Makes an arena the one FrameArena::getCurrent() returns
+ * on this thread, for the lifetime of the scope.
+ */
+class FrameArenaScope: boost::noncopyable {
+public:
+	explicit FrameArenaScope(FrameArena& arena);
+	~FrameArenaScope(void);
+
+private:
+	FrameArena* previous;
+};
+
+/*
+ * ArenaAllocator - STL allocator that takes its memory from a FrameArena,
+ * for containers that are filled and dropped within a frame:
+ *
+ * \code
+ * std::vector<Point, ArenaAllocator<Point> > points(
+ *         ArenaAllocator<Point>(arena));
+ * \endcode
+ *
+ * deallocate() does nothing; the memory comes back with the arena's reset().
+ * The container must be gone (or at least never used again) by then.
+ */
+template<class T>
+class ArenaAllocator {
+public:
+	typedef T value_type;
+	typedef T* pointer;
+	typedef const T* const_pointer;
+	typedef T& reference;
+	typedef const T& const_reference;
+	typedef size_t size_type;
+	typedef std::ptrdiff_t difference_type;
+
+	template<class U>
+	struct rebind {
+		typedef ArenaAllocator<U> other;
+	};
+
+	explicit ArenaAllocator(FrameArena& _arena) :
+		arena(&_arena) {
+	} // end ArenaAllocator()
+
+	template<class U>
+	ArenaAllocator(const ArenaAllocator<U>& other) :
+		arena(other.getArena()) {
+	} // end ArenaAllocator()
+
+	pointer allocate(size_type count, const void* = 0) {
+		return arena->allocateArray<T> (count);
+	} // end allocate()
+
+	void deallocate(pointer, size_type) {
+		;
+	} // end deallocate()
+
+	void construct(pointer p, const T& value) {
+		new (p) T(value);
+	} // end construct()
+
+	void destroy(pointer p) {
+		p->~T();
+	} // end destroy()
+
+	pointer address(reference value) const {
+		return &value;
+	} // end address()
+
+	const_pointer address(const_reference value) const {
+		return &value;
+	} // end address()
+
+	size_type max_size(void) const {
+		return std::numeric_limits<size_type>::max() / sizeof(T);
+	} // end max_size()
+
+	FrameArena* getArena(void) const {
+		return arena;
+	} // end getArena()
+
+private:
+	FrameArena* arena;
+};
+
+template<class T, class U>
+bool operator==(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) {
+	return a.getArena() == b.getArena();
+}
+
+template<class T, class U>
+bool operator!=(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) {
+	return a.getArena() != b.getArena();
+}
+
+#endif /* FRAME_ARENA_H_ */
@@ -0,0 +1,616 @@
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <vector>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+/* Boost includes */
+#include <boost/static_assert.hpp>
+
+#include <SYNC/Atomic.h>
+#include <SYNC/Event.h>
+#include <UTIL/Exception.h>
+#include <UTIL/Logger.h>
+#include <UTIL/System.h>
+
+BOOST_STATIC_ASSERT(sizeof(LogRecord) == LogRecord::SIZE);
+
+namespace {
+
+/*
+ * Ring - The records of one thread.  The thread appends at tail, the writer
+ * consumes at head; each side only writes its own index.  When the thread
+ * exits, the ring is released, and handed to a new thread once the writer
+ * has emptied it.
+ */
+struct Ring {
+	LogRecord* records;
+	volatile Int32 threadId;
+	volatile Int32 released; /**< Set when the owning thread has exited */
+	volatile Uint64 dropped; /**< Written by the owning thread */
+	Uint64 reportedDropped; /**< Written by the writer */
+	char padding1[64];
+	volatile Int32 filling; /**< Set between beginRecord() and commitRecord() */
+	volatile Uint32 head;
+	char padding2[64];
+	volatile Uint32 tail;
+	char padding3[64];
+};
+
+/*
+ * ExceptionPayload - What LOG_EXCEPTION hands to the writer.  The call
+ * stack stays raw until the writer symbolizes it.
+ */
+struct ExceptionPayload {
+	std::string description;
+	void* frames[Exception::MAX_STACK_FRAMES];
+	int numFrames;
+};
+
+const Uint32 RING_MASK = Logger::RECORDS_PER_THREAD - 1;
+
+const char* const LEVEL_NAMES[] = { "TRACE", "DEBUG", "INFO ", "WARN ",
+		"ERROR" };
+
+pthread_mutex_t registryMutex = PTHREAD_MUTEX_INITIALIZER;
+Ring* rings[Logger::MAX_THREADS];
+volatile Uint32 numRings = 0;
+volatile Uint64 unregisteredDrops = 0;
+__thread Ring* currentRing = NULL;
+pthread_once_t ringKeyOnce = PTHREAD_ONCE_INIT;
+pthread_key_t ringKey;
+
+/* The writer thread and its state: */
+pthread_once_t writerOnce = PTHREAD_ONCE_INIT;
+pthread_t writer;
+volatile bool writerRunning = false;
+volatile bool stopRequested = false;
+volatile Uint64 completedPasses = 0;
+Event wakeup(Event::AUTO_RESET);
+
+/* The output, and the record used once the writer has stopped: */
+pthread_mutex_t outputMutex = PTHREAD_MUTEX_INITIALIZER;
+FILE* output = stderr;
+LogRecord synchronousRecord;
+
+/* For turning monotonic record times into wall clock times: */
+Int64 realtimeOffset = 0;
+
+int parseLevel(const char* name) {
+	static const char* const names[] = { "trace", "debug", "info", "warning",
+			"error", "off" };
+	for (int level = 0; level <= Logger::LEVEL_OFF; ++level) {
+		if (std::strcmp(name, names[level]) == 0) {
+			return level;
+		}
+	}
+	return -1;
+}
+
+int getInitialLevel(void) {
+	const char* value = ::getenv("ROCKET_LOG_LEVEL");
+	const int level = value != NULL ? parseLevel(value) : -1;
+	return level >= 0 ? level : Logger::LEVEL_TRACE;
+}
+
+/*
+ * appendFormatted - Appends one printf() conversion of a single value.
+ */
+template<class T>
+void appendFormatted(std::string& line, const std::string& specification,
+		T value) {
+	char buffer[256];
+	const int length = snprintf(buffer, sizeof(buffer), specification.c_str(),
+			value);
+	if (length < 0) {
+		return;
+	}
+	if (size_t(length) < sizeof(buffer)) {
+		line.append(buffer, length);
+	} else {
+		std::vector<char> large(length + 1);
+		snprintf(&large[0], large.size(), specification.c_str(), value);
+		line.append(&large[0], length);
+	}
+}
+
+bool isOneOf(char character, const char* characters) {
+	return character != '\0' && std::strchr(characters, character) != NULL;
+}
+
+/*
+ * appendMessage - Formats the record's format string with its arguments.
+ * Each conversion is redone with the length modifier that matches the type
+ * the argument was stored with, and with a conversion that fits it if the
+ * format asked for something else.
+ */
+void appendMessage(std::string& line, const LogRecord& record) {
+	const char* position = record.format;
+	int argument = 0;
+	while (*position != '\0') {
+		const char* literalEnd = std::strchr(position, '%');
+		if (literalEnd == NULL) {
+			line.append(position);
+			break;
+		}
+		line.append(position, literalEnd - position);
+		position = literalEnd + 1;
+		if (*position == '%') {
+			line += '%';
+			++position;
+			continue;
+		}
+
+		/* Split the conversion into flags/width/precision and the type: */
+		std::string specification("%");
+		while (isOneOf(*position, "-+ #0") || std::isdigit(
+				static_cast<unsigned char> (*position)) || *position == '.') {
+			specification += *position++;
+		}
+		while (isOneOf(*position, "hlLqjzt")) {
+			++position;
+		}
+		const char conversion = *position;
+		if (conversion == '\0') {
+			break;
+		}
+		++position;
+
+		if (argument >= record.numArguments) {
+			line += "<missing>";
+			continue;
+		}
+		const LogRecord::Argument& value = record.arguments[argument];
+		switch (record.types[argument++]) {
+		case LogRecord::SIGNED:
+			if (isOneOf(conversion, "eEfFgGaA")) {
+				appendFormatted(line, specification + conversion,
+						double(value.signedValue));
+			} else {
+				appendFormatted(line, specification + "ll" + (isOneOf(
+						conversion, "diouxXc") ? conversion : 'd'),
+						static_cast<long long> (value.signedValue));
+			}
+			break;
+		case LogRecord::UNSIGNED:
+			if (isOneOf(conversion, "eEfFgGaA")) {
+				appendFormatted(line, specification + conversion,
+						double(value.unsignedValue));
+			} else {
+				appendFormatted(line, specification + "ll" + (isOneOf(
+						conversion, "ouxXc") ? conversion : 'u'),
+						static_cast<unsigned long long> (value.unsignedValue));
+			}
+			break;
+		case LogRecord::FLOATING:
+			appendFormatted(line, specification + (isOneOf(conversion,
+					"eEfFgGaA") ? conversion : 'g'), value.floatingValue);
+			break;
+		case LogRecord::STRING: {
+			const std::string text(record.text + value.string.offset,
+					value.string.length);
+			appendFormatted(line, specification + 's', text.c_str());
+			break;
+		}
+		case LogRecord::POINTER:
+			appendFormatted(line, specification + 'p', value.pointerValue);
+			break;
+		}
+	}
+}
+
+/*
+ * appendRecord - Formats a record as one line (more for exceptions):
+ * "2010-06-03 14:03:12.345678 INFO  [tid] file.cpp:42: message".
+ */
+void appendRecord(std::string& line, const LogRecord& record, Int32 threadId) {
+	const Int64 wallTime = Int64(record.time) + realtimeOffset;
+	const time_t seconds = time_t(wallTime / 1000000000);
+	struct tm local;
+	localtime_r(&seconds, &local);
+	char timestamp[64];
+	const size_t length = strftime(timestamp, sizeof(timestamp),
+			"%Y-%m-%d %H:%M:%S", &local);
+	snprintf(timestamp + length, sizeof(timestamp) - length, ".%06d",
+			int(wallTime % 1000000000 / 1000));
+
+	const char* file = std::strrchr(record.file, '/');
+	file = file != NULL ? file + 1 : record.file;
+
+	const int level = record.level < Logger::LEVEL_OFF ? int(record.level)
+			: int(Logger::LEVEL_ERROR);
+	char header[192];
+	snprintf(header, sizeof(header), "%s %s [%d] %s:%d: ", timestamp,
+			LEVEL_NAMES[level], threadId, file, record.line);
+	line += header;
+
+	if (record.payload != NULL) {
+		const ExceptionPayload* payload =
+				static_cast<const ExceptionPayload*> (record.payload);
+		line += payload->description;
+		line += '\n';
+		line += SystemBase::symbolizeCallStack(payload->frames,
+				payload->numFrames);
+		delete payload;
+	} else {
+		appendMessage(line, record);
+	}
+	if (line.empty() || line[line.size() - 1] != '\n') {
+		line += '\n';
+	}
+}
+
+/*
+ * writePending - One writer pass: writes the records of all rings, oldest
+ * first, and reports new drops.
+ */
+void writePending(void) {
+	const Uint32 count = Atomic::load(&numRings);
+	std::vector<Uint32> heads(count);
+	std::vector<Uint32> tails(count);
+	for (Uint32 r = 0; r < count; ++r) {
+		heads[r] = Atomic::loadRelaxed(&rings[r]->head);
+		tails[r] = Atomic::load(&rings[r]->tail);
+	}
+
+	std::string line;
+	pthread_mutex_lock(&outputMutex);
+	for (;;) {
+		Uint32 oldest = count;
+		for (Uint32 r = 0; r < count; ++r) {
+			if (heads[r] != tails[r] && (oldest == count
+					|| rings[r]->records[heads[r] & RING_MASK].time
+							< rings[oldest]->records[heads[oldest] & RING_MASK].time)) {
+				oldest = r;
+			}
+		}
+		if (oldest == count) {
+			break;
+		}
+
+		Ring& ring = *rings[oldest];
+		line.clear();
+		appendRecord(line, ring.records[heads[oldest] & RING_MASK],
+				Atomic::loadRelaxed(&ring.threadId));
+		fwrite(line.data(), 1, line.size(), output);
+		Atomic::store(&ring.head, ++heads[oldest]);
+	}
+
+	for (Uint32 r = 0; r < count; ++r) {
+		Ring& ring = *rings[r];
+		const Uint64 dropped = Atomic::loadRelaxed(&ring.dropped);
+		if (dropped != ring.reportedDropped) {
+			fprintf(output, "%lu messages of thread %d were dropped because "
+				"its log buffer was full\n", dropped - ring.reportedDropped,
+					Atomic::loadRelaxed(&ring.threadId));
+			ring.reportedDropped = dropped;
+		}
+	}
+	fflush(output);
+	pthread_mutex_unlock(&outputMutex);
+}
+
+void* writerMain(void*) {
+	SystemPosix::applyThreadRole("LOGGER");
+	for (;;) {
+		const bool stopping = Atomic::load(&stopRequested);
+		writePending();
+		Atomic::fetchAdd(&completedPasses, Uint64(1));
+		if (stopping) {
+			break;
+		}
+		wakeup.timedWait(Logger::FLUSH_INTERVAL);
+	}
+	return NULL;
+}
+
+void startWriter(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_REALTIME, &now);
+	realtimeOffset = Int64(now.tv_sec) * 1000000000 + Int64(now.tv_nsec)
+			- Int64(SystemPosix::getMonotonicNanoseconds());
+
+	std::string path;
+	if (SystemPosix::getenv("ROCKET_LOG_FILE", path)) {
+		Logger::setOutput(path);
+	}
+
+	if (pthread_create(&writer, NULL, &writerMain, NULL) == 0) {
+		Atomic::store(&writerRunning, true);
+		atexit(&Logger::shutdown);
+	}
+}
+
+/*
+ * releaseRing - Runs when a thread that has a ring exits.  A message the
+ * thread logs from a later destructor takes a ring anew.
+ */
+void releaseRing(void* ring) {
+	currentRing = NULL;
+	Atomic::store(&static_cast<Ring*> (ring)->released, Int32(1));
+}
+
+void createRingKey(void) {
+	pthread_key_create(&ringKey, &releaseRing);
+}
+
+/*
+ * getRing - Returns the calling thread's ring.  On first use it takes over
+ * the ring of a thread that has exited, once its records are written, or
+ * creates a new one.
+ *
+ * @return The ring, or NULL if MAX_THREADS live threads have one already.
+ */
+Ring* getRing(void) {
+	if (currentRing == NULL) {
+		pthread_once(&ringKeyOnce, &createRingKey);
+		pthread_mutex_lock(&registryMutex);
+		const Uint32 count = Atomic::loadRelaxed(&numRings);
+		Ring* ring = NULL;
+		for (Uint32 r = 0; r < count && ring == NULL; ++r) {
+			if (Atomic::load(&rings[r]->released) && Atomic::load(
+					&rings[r]->head) == rings[r]->tail) {
+				ring = rings[r];
+			}
+		}
+		if (ring == NULL && count < Logger::MAX_THREADS) {
+			ring = new Ring();
+			ring->records = new LogRecord[Logger::RECORDS_PER_THREAD];
+			ring->dropped = 0;
+			ring->reportedDropped = 0;
+			ring->filling = 0;
+			ring->head = 0;
+			ring->tail = 0;
+			rings[count] = ring;
+			Atomic::store(&numRings, count + 1);
+		}
+		if (ring != NULL) {
+			Atomic::store(&ring->threadId, Int32(syscall(SYS_gettid)));
+			Atomic::store(&ring->released, Int32(0));
+			pthread_setspecific(ringKey, ring);
+			currentRing = ring;
+		}
+		pthread_mutex_unlock(&registryMutex);
+	}
+	return currentRing;
+}
+
+}
+
+volatile int Logger::minimumLevel = getInitialLevel();
+
+/*
+ * addString - Copies a string argument into the record's text area,
+ * truncating it to the space that is left.
+ */
+void LogRecord::addString(const char* value, size_t length) {
+	if (numArguments >= MAX_ARGUMENTS) {
+		return;
+	}
+	const size_t available = sizeof(text) - textUsed;
+	if (length > available) {
+		length = available;
+	}
+	std::memcpy(text + textUsed, value, length);
+	types[numArguments] = STRING;
+	arguments[numArguments].string.offset = textUsed;
+	arguments[numArguments].string.length = Uint16(length);
+	++numArguments;
+	textUsed = Uint16(textUsed + length);
+}
+
+/*
+ * setLevel - Drops messages below \p level from now on.  Messages below
+ * ROCKET_LOG_LEVEL are never compiled in, whatever the level.
+ */
+void Logger::setLevel(Level level) {
+	Atomic::store(&minimumLevel, int(level));
+} // end setLevel()
+
+/*
+ * getLevel - Returns the level set by setLevel() or ROCKET_LOG_LEVEL.
+ */
+Logger::Level Logger::getLevel(void) {
+	return Level(Atomic::load(&minimumLevel));
+} // end getLevel()
+
+/*
+ * setOutput - Appends the log to the given file instead of the current
+ * output.  "-" means stderr.
+ *
+ * @return \c false is returned if the file could not be opened; the output
+ *         does not change then.
+ */
+bool Logger::setOutput(const std::string& path) {
+	FILE* file = path == "-" ? stderr : fopen(path.c_str(), "a");
+	if (file == NULL) {
+		return false;
+	}
+	pthread_mutex_lock(&outputMutex);
+	if (output != stderr) {
+		fclose(output);
+	}
+	output = file;
+	pthread_mutex_unlock(&outputMutex);
+	return true;
+} // end setOutput()
+
+/*
+ * getDroppedMessages - Returns the number of messages lost to full rings,
+ * to a lack of rings, or to a shutdown that could not wait for them.
+ */
+Uint64 Logger::getDroppedMessages(void) {
+	Uint64 dropped = Atomic::loadRelaxed(&unregisteredDrops);
+	const Uint32 count = Atomic::load(&numRings);
+	for (Uint32 r = 0; r < count; ++r) {
+		dropped += Atomic::loadRelaxed(&rings[r]->dropped);
+	}
+	return dropped;
+} // end getDroppedMessages()
+
+/*
+ * flush - Waits (up to about a second) until everything logged so far has
+ * been written.
+ */
+void Logger::flush(void) {
+	if (!Atomic::load(&writerRunning)) {
+		return;
+	}
+
+	const Uint32 count = Atomic::load(&numRings);
+	std::vector<Uint32> tails(count);
+	for (Uint32 r = 0; r < count; ++r) {
+		tails[r] = Atomic::load(&rings[r]->tail);
+	}
+
+	int attempts = 1000;
+	for (Uint32 r = 0; r < count && attempts > 0; ++r) {
+		while (Uint32(Atomic::load(&rings[r]->head) - tails[r]) > RING_MASK
+				&& --attempts > 0) {
+			wakeup.set();
+			usleep(1000);
+		}
+	}
+
+	// The pass that took the last record has yet to flush the output.
+	const Uint64 passes = Atomic::load(&completedPasses);
+	while (Atomic::load(&completedPasses) == passes && --attempts > 0) {
+		wakeup.set();
+		usleep(1000);
+	}
+} // end flush()
+
+/*
+ * shutdown - Writes what is left and stops the writer thread.  Messages
+ * logged afterwards are written directly by the logging thread.  It is
+ * registered with atexit(), and safe to call more than once.
+ *
+ * A thread may have reserved a record just before the stop, and commit it
+ * after the writer's last pass; shutdown() waits (up to about a second) for
+ * such records and writes them itself.  Those that still are not committed
+ * are counted as dropped.
+ */
+void Logger::shutdown(void) {
+	pthread_mutex_lock(&registryMutex);
+	if (Atomic::load(&writerRunning)) {
+		Atomic::store(&stopRequested, true);
+		Atomic::fence();
+		wakeup.set();
+		pthread_join(writer, NULL);
+
+		const Uint32 count = Atomic::load(&numRings);
+		int attempts = 1000;
+		Uint64 lost = 0;
+		for (Uint32 r = 0; r < count; ++r) {
+			while (Atomic::load(&rings[r]->filling) && --attempts > 0) {
+				usleep(1000);
+			}
+			if (Atomic::load(&rings[r]->filling)) {
+				++lost;
+			}
+		}
+		writePending();
+		Atomic::fetchAddRelaxed(&unregisteredDrops, lost);
+		Atomic::store(&writerRunning, false);
+	}
+	pthread_mutex_unlock(&registryMutex);
+} // end shutdown()
+
+/*
+ * logException - Logs the exception's description, location and call
+ * stack, the same text as Exception::getFullDescription().  Looking up the
+ * function names of the stack is left to the writer thread.
+ */
+void Logger::logException(Level level, const char* file, int line,
+		const Exception& exception) {
+	LogRecord* record = beginRecord(level, file, line, "");
+	if (record == NULL) {
+		return;
+	}
+	ExceptionPayload* payload = new ExceptionPayload();
+	payload->description = exception.getExtendedDescription() + "  "
+			+ exception.getLocation();
+	payload->numFrames = exception.getNumStackFrames();
+	std::memcpy(payload->frames, exception.getStackFrames(),
+			payload->numFrames * sizeof(void*));
+	record->payload = payload;
+	commitRecord(record);
+} // end logException()
+
+/*
+ * beginRecord - Reserves the next record of the calling thread's ring and
+ * fills in the header.
+ *
+ * @return The record, or NULL if the message is dropped.
+ */
+LogRecord* Logger::beginRecord(Level level, const char* file, int line,
+		const char* format) {
+	pthread_once(&writerOnce, &startWriter);
+
+	LogRecord* record = NULL;
+	if (!Atomic::load(&stopRequested) && Atomic::load(&writerRunning)) {
+		Ring* ring = getRing();
+		if (ring == NULL) {
+			Atomic::fetchAddRelaxed(&unregisteredDrops, Uint64(1));
+			return NULL;
+		}
+
+		// Marked before stopRequested is checked again, so that shutdown()
+		// either sees the record being filled, or this thread sees the stop.
+		Atomic::exchange(&ring->filling, Int32(1));
+		const Uint32 tail = ring->tail;
+		if (Atomic::load(&stopRequested)) {
+			Atomic::store(&ring->filling, Int32(0));
+		} else if (tail - Atomic::load(&ring->head) > RING_MASK) {
+			Atomic::storeRelaxed(&ring->dropped, ring->dropped + 1);
+			Atomic::store(&ring->filling, Int32(0));
+			wakeup.set();
+			return NULL;
+		} else {
+			record = &ring->records[tail & RING_MASK];
+		}
+	}
+	if (record == NULL) {
+		// Without a writer, the message is written on this thread.
+		pthread_mutex_lock(&outputMutex);
+		record = &synchronousRecord;
+	}
+
+	record->time = SystemPosix::getMonotonicNanoseconds();
+	record->format = format;
+	record->file = file;
+	record->payload = NULL;
+	record->line = line;
+	record->level = Uint8(level);
+	record->numArguments = 0;
+	record->textUsed = 0;
+	return record;
+} // end beginRecord()
+
+/*
+ * commitRecord - Hands a record from beginRecord() to the writer.  The
+ * writer is only woken early for warnings and errors, or when the ring is
+ * half full; otherwise it picks the record up within FLUSH_INTERVAL.
+ */
+void Logger::commitRecord(LogRecord* record) {
+	if (record == &synchronousRecord) {
+		std::string line;
+		appendRecord(line, *record, Int32(syscall(SYS_gettid)));
+		fwrite(line.data(), 1, line.size(), output);
+		fflush(output);
+		pthread_mutex_unlock(&outputMutex);
+		return;
+	}
+
+	Ring* ring = currentRing;
+	const Uint32 tail = ring->tail + 1;
+	Atomic::store(&ring->tail, tail);
+	Atomic::store(&ring->filling, Int32(0));
+	if (record->level >= LEVEL_WARNING || tail - Atomic::loadRelaxed(
+			&ring->head) > RECORDS_PER_THREAD / 2) {
+		wakeup.set();
+	}
+} // end commitRecord()
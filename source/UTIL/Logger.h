@@ -0,0 +1,294 @@
+#ifndef LOGGER_H_
+#define LOGGER_H_
+
+#include <cstring>
+#include <string>
+
+#include <UTIL/Types.h>
+
+class Exception;
+
+/**
+ * @example "Example of logging"
+ *
+ * The macros take a printf() style format and up to six arguments:
+ *
+ * \code
+ * LOG_INFO("Loaded %s: %d nodes in %.1f ms", path, numNodes, milliseconds);
+ * LOG_WARNING("Ignoring %s=%s", name.c_str(), value.c_str());
+ *
+ * try {
+ *     ...
+ * } catch (const Exception& e) {
+ *     LOG_EXCEPTION(LEVEL_ERROR, e);
+ * }
+ * \endcode
+ *
+ * The format must be a string literal: only its address is stored, and the
+ * text is formatted later on the logging thread.  String arguments are
+ * copied (and truncated if the record runs out of room), so they may be
+ * temporaries.  Length modifiers in the format do not matter, since every
+ * argument is stored with its own type: "%d" prints a long just fine.
+ *
+ * Messages below ROCKET_LOG_LEVEL (a number, 0 = trace ... 4 = error; by
+ * default 1 in DEBUG builds and 2 otherwise) compile to nothing.
+ */
+#ifndef ROCKET_LOG_LEVEL
+#ifdef DEBUG
+#define ROCKET_LOG_LEVEL 1
+#else
+#define ROCKET_LOG_LEVEL 2
+#endif
+#endif
+
+#define LOG_AT(level, ...) \
+	do { \
+		if (Logger::level >= ROCKET_LOG_LEVEL && \
+				Logger::isEnabled(Logger::level)) { \
+			Logger::log(Logger::level, __FILE__, __LINE__, __VA_ARGS__); \
+		} \
+	} while (0)
+#define LOG_TRACE(...) LOG_AT(LEVEL_TRACE, __VA_ARGS__)
+#define LOG_DEBUG(...) LOG_AT(LEVEL_DEBUG, __VA_ARGS__)
+#define LOG_INFO(...) LOG_AT(LEVEL_INFO, __VA_ARGS__)
+#define LOG_WARNING(...) LOG_AT(LEVEL_WARNING, __VA_ARGS__)
+#define LOG_ERROR(...) LOG_AT(LEVEL_ERROR, __VA_ARGS__)
+#define LOG_EXCEPTION(level, exception) \
+	do { \
+		if (Logger::level >= ROCKET_LOG_LEVEL && \
+				Logger::isEnabled(Logger::level)) { \
+			Logger::logException(Logger::level, __FILE__, __LINE__, \
+					exception); \
+		} \
+	} while (0)
+
+/*
+ * LogRecord - One message as it travels from the logging thread to the
+ * writer: the format address and the arguments in binary form.  Records
+ * have a fixed size so that they can live in a ring buffer.
+ */
+struct LogRecord {
+	enum {
+		SIZE = 256,
+		MAX_ARGUMENTS = 8
+	};
+
+	enum ArgumentType {
+		SIGNED, UNSIGNED, FLOATING, STRING, POINTER
+	};
+
+	union Argument {
+		Int64 signedValue;
+		Uint64 unsignedValue;
+		double floatingValue;
+		const void* pointerValue;
+		struct {
+			Uint16 offset; /**< Into text[] */
+			Uint16 length;
+		} string;
+	};
+
+	Uint64 time;
+	const char* format;
+	const char* file;
+	void* payload; /**< Heap data owned by the record, e.g. an exception */
+	Int32 line;
+	Uint8 level;
+	Uint8 numArguments;
+	Uint16 textUsed;
+	Uint8 types[MAX_ARGUMENTS];
+	Argument arguments[MAX_ARGUMENTS];
+	char text[SIZE - 40 - MAX_ARGUMENTS * (1 + sizeof(Argument))];
+
+	void add(int value) {
+		addSigned(value);
+	}
+	void add(long value) {
+		addSigned(value);
+	}
+	void add(long long value) {
+		addSigned(value);
+	}
+	void add(unsigned int value) {
+		addUnsigned(value);
+	}
+	void add(unsigned long value) {
+		addUnsigned(value);
+	}
+	void add(unsigned long long value) {
+		addUnsigned(value);
+	}
+	void add(double value) {
+		if (numArguments < MAX_ARGUMENTS) {
+			types[numArguments] = FLOATING;
+			arguments[numArguments++].floatingValue = value;
+		}
+	}
+	void add(const void* value) {
+		if (numArguments < MAX_ARGUMENTS) {
+			types[numArguments] = POINTER;
+			arguments[numArguments++].pointerValue = value;
+		}
+	}
+	void add(const char* value) {
+		addString(value != NULL ? value : "(null)", value != NULL ? std::strlen(
+				value) : 6);
+	}
+	void add(const std::string& value) {
+		addString(value.data(), value.size());
+	}
+
+	void addSigned(Int64 value) {
+		if (numArguments < MAX_ARGUMENTS) {
+			types[numArguments] = SIGNED;
+			arguments[numArguments++].signedValue = value;
+		}
+	}
+	void addUnsigned(Uint64 value) {
+		if (numArguments < MAX_ARGUMENTS) {
+			types[numArguments] = UNSIGNED;
+			arguments[numArguments++].unsignedValue = value;
+		}
+	}
+	void addString(const char* value, size_t length);
+};
+
+/*
+ * Logger - Asynchronous logger.  A thread that logs only writes a binary
+ * record into its own ring buffer, without locks or system calls; a
+ * background thread formats the records of all threads in time order and
+ * writes them to stderr or the file named by ROCKET_LOG_FILE.  Rendering
+ * therefore never waits for a terminal or a disk.
+ *
+ * When a thread's ring is full, its new messages are dropped rather than
+ * blocking the thread.  The writer reports how many were lost, and
+ * getDroppedMessages() returns the total.  The ring of a thread that exits
+ * goes to the next thread that logs.
+ *
+ * The level can also be raised at run time with setLevel() or the
+ * ROCKET_LOG_LEVEL environment variable ("trace", "debug", "info",
+ * "warning" or "error").  The writer thread starts with the first message;
+ * shutdown(), which also runs at exit, writes whatever is left.
+ */
+class Logger {
+public:
+	enum Level {
+		LEVEL_TRACE, LEVEL_DEBUG, LEVEL_INFO, LEVEL_WARNING, LEVEL_ERROR,
+		LEVEL_OFF
+	};
+
+	enum {
+		RECORDS_PER_THREAD = 1024, /**< Ring size, a power of two */
+		MAX_THREADS = 256, /**< Live threads with a ring of their own */
+		FLUSH_INTERVAL = 20 /**< Milliseconds between writer passes */
+	};
+
+	static bool isEnabled(Level level) {
+		return level >= minimumLevel;
+	} // end isEnabled()
+
+	static void setLevel(Level level);
+	static Level getLevel(void);
+	static bool setOutput(const std::string& path);
+	static Uint64 getDroppedMessages(void);
+	static void flush(void);
+	static void shutdown(void);
+
+	static void logException(Level level, const char* file, int line,
+			const Exception& exception);
+
+	static void log(Level level, const char* file, int line,
+			const char* format) {
+		LogRecord* record = beginRecord(level, file, line, format);
+		if (record != NULL) {
+			commitRecord(record);
+		}
+	} // end log()
+
+	template<class A1>
+	static void log(Level level, const char* file, int line,
+			const char* format, const A1& a1) {
+		LogRecord* record = beginRecord(level, file, line, format);
+		if (record != NULL) {
+			record->add(a1);
+			commitRecord(record);
+		}
+	} // end log()
+
+	template<class A1, class A2>
+	static void log(Level level, const char* file, int line,
+			const char* format, const A1& a1, const A2& a2) {
+		LogRecord* record = beginRecord(level, file, line, format);
+		if (record != NULL) {
+			record->add(a1);
+			record->add(a2);
+			commitRecord(record);
+		}
+	} // end log()
+
+	template<class A1, class A2, class A3>
+	static void log(Level level, const char* file, int line,
+			const char* format, const A1& a1, const A2& a2, const A3& a3) {
+		LogRecord* record = beginRecord(level, file, line, format);
+		if (record != NULL) {
+			record->add(a1);
+			record->add(a2);
+			record->add(a3);
+			commitRecord(record);
+		}
+	} // end log()
+
+	template<class A1, class A2, class A3, class A4>
+	static void log(Level level, const char* file, int line,
+			const char* format, const A1& a1, const A2& a2, const A3& a3,
+			const A4& a4) {
+		LogRecord* record = beginRecord(level, file, line, format);
+		if (record != NULL) {
+			record->add(a1);
+			record->add(a2);
+			record->add(a3);
+			record->add(a4);
+			commitRecord(record);
+		}
+	} // end log()
+
+	template<class A1, class A2, class A3, class A4, class A5>
+	static void log(Level level, const char* file, int line,
+			const char* format, const A1& a1, const A2& a2, const A3& a3,
+			const A4& a4, const A5& a5) {
+		LogRecord* record = beginRecord(level, file, line, format);
+		if (record != NULL) {
+			record->add(a1);
+			record->add(a2);
+			record->add(a3);
+			record->add(a4);
+			record->add(a5);
+			commitRecord(record);
+		}
+	} // end log()
+
+	template<class A1, class A2, class A3, class A4, class A5, class A6>
+	static void log(Level level, const char* file, int line,
+			const char* format, const A1& a1, const A2& a2, const A3& a3,
+			const A4& a4, const A5& a5, const A6& a6) {
+		LogRecord* record = beginRecord(level, file, line, format);
+		if (record != NULL) {
+			record->add(a1);
+			record->add(a2);
+			record->add(a3);
+			record->add(a4);
+			record->add(a5);
+			record->add(a6);
+			commitRecord(record);
+		}
+	} // end log()
+
+private:
+	static LogRecord* beginRecord(Level level, const char* file, int line,
+			const char* format);
+	static void commitRecord(LogRecord* record);
+
+	static volatile int minimumLevel;
+};
+
+#endif /* LOGGER_H_ */
@@ -0,0 +1,873 @@
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <pthread.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include <SYNC/Atomic.h>
+#include <UTIL/Logger.h>
+#include <UTIL/Metrics.h>
+#include <UTIL/System.h>
+
+namespace {
+
+/*
+ * Definition - A registered metric.
+ */
+struct Definition {
+	MetricsSnapshot::Type type;
+	std::string name;
+	std::string help;
+	std::string labels;
+	Uint32 slot; /**< Into the shards, or into gauges[] */
+	const double* bounds;
+	Uint32 numBounds;
+	MetricsSampler sampler;
+	void* context;
+};
+
+struct Collector {
+	MetricsCollector collector;
+	void* context;
+};
+
+/*
+ * Slots 0 and 1 of the shards and gauge 0 take the updates of handles that
+ * were never registered.
+ */
+const Uint32 FIRST_SLOT = 2;
+const Uint32 FIRST_GAUGE = 1;
+
+const int POLL_INTERVAL = 200; /**< Milliseconds between stop checks */
+const int CLIENT_TIMEOUT = 1; /**< Seconds a client may take to ask */
+const Uint32 BINARY_VERSION = 1;
+
+pthread_mutex_t registryMutex = PTHREAD_MUTEX_INITIALIZER;
+std::vector<Definition>* definitions = NULL;
+std::vector<Collector>* collectors = NULL;
+Uint32 numSlots = FIRST_SLOT;
+Uint32 numGauges = FIRST_GAUGE;
+
+volatile Uint64* shards[Metrics::MAX_THREADS];
+bool releasedShards[Metrics::MAX_THREADS]; /**< Their threads have exited */
+volatile Uint32 numShards = 0;
+volatile Uint64* volatile overflowShard = NULL; /**< Shared past MAX_THREADS */
+pthread_once_t shardKeyOnce = PTHREAD_ONCE_INIT;
+pthread_key_t shardKey;
+
+/* The server thread and its state: */
+pthread_mutex_t serverMutex = PTHREAD_MUTEX_INITIALIZER;
+pthread_t server;
+bool serverRunning = false;
+volatile bool stopRequested = false;
+int listenSocket = -1;
+std::string socketPath;
+std::string hostname;
+
+double toDouble(Uint64 bits) {
+	double value;
+	std::memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+Uint64 toBits(double value) {
+	Uint64 bits;
+	std::memcpy(&bits, &value, sizeof(bits));
+	return bits;
+}
+
+/*
+ * sumSlot - Returns a slot summed over all shards.
+ */
+Uint64 sumSlot(Uint32 slot, Uint32 count) {
+	volatile Uint64* overflow = Atomic::load(&overflowShard);
+	Uint64 sum = overflow != NULL ? Atomic::loadRelaxed(&overflow[slot]) : 0;
+	for (Uint32 s = 0; s < count; ++s) {
+		sum += Atomic::loadRelaxed(&shards[s][slot]);
+	}
+	return sum;
+}
+
+double sumDoubleSlot(Uint32 slot, Uint32 count) {
+	volatile Uint64* overflow = Atomic::load(&overflowShard);
+	double sum = overflow != NULL ? toDouble(Atomic::loadRelaxed(
+			&overflow[slot])) : 0.0;
+	for (Uint32 s = 0; s < count; ++s) {
+		sum += toDouble(Atomic::loadRelaxed(&shards[s][slot]));
+	}
+	return sum;
+}
+
+/*
+ * createRegistry - Creates the lists on first use.  They are never
+ * destroyed, so threads may update metrics during static destruction.
+ *
+ * @pre registryMutex is held.
+ */
+void createRegistry(void) {
+	if (definitions == NULL) {
+		definitions = new std::vector<Definition>();
+		collectors = new std::vector<Collector>();
+	}
+}
+
+/*
+ * findDefinition - Returns the registered metric of that name and labels.
+ * A metric registered with another type is returned as well, after a
+ * warning; the caller must then hand out a dead handle, as its slots are
+ * laid out for the other type.
+ *
+ * @pre registryMutex is held.
+ */
+Definition* findDefinition(MetricsSnapshot::Type type,
+		const std::string& name, const std::string& labels) {
+	createRegistry();
+	for (size_t d = 0; d < definitions->size(); ++d) {
+		Definition& definition = (*definitions)[d];
+		if (definition.name == name && definition.labels == labels) {
+			if (definition.type != type) {
+				LOG_WARNING("Metric %s{%s} is not recorded: it is registered "
+					"with another type", name.c_str(), labels.c_str());
+			}
+			return &definition;
+		}
+	}
+	return NULL;
+}
+
+/*
+ * addDefinition - Registers a metric that needs \p slots shard slots.
+ *
+ * @pre registryMutex is held.
+ *
+ * @return The new definition, or NULL if the shards are full.
+ */
+Definition* addDefinition(MetricsSnapshot::Type type,
+		const std::string& name, const std::string& help,
+		const std::string& labels, Uint32 slots) {
+	if (numSlots + slots > Metrics::MAX_SLOTS) {
+		LOG_WARNING("Metric %s is not recorded: out of metric slots",
+				name.c_str());
+		return NULL;
+	}
+	Definition definition;
+	definition.type = type;
+	definition.name = name;
+	definition.help = help;
+	definition.labels = labels;
+	definition.slot = numSlots;
+	definition.bounds = NULL;
+	definition.numBounds = 0;
+	definition.sampler = NULL;
+	definition.context = NULL;
+	numSlots += slots;
+	definitions->push_back(definition);
+	return &definitions->back();
+}
+
+/*
+ * formatDouble - Formats a number the way the text format spells it.
+ */
+std::string formatDouble(double value) {
+	if (std::isnan(value)) {
+		return "NaN";
+	}
+	if (std::isinf(value)) {
+		return value > 0.0 ? "+Inf" : "-Inf";
+	}
+	// The shortest of the usual precisions that reads back the same value:
+	char buffer[32];
+	snprintf(buffer, sizeof(buffer), "%.15g", value);
+	if (std::strtod(buffer, NULL) != value) {
+		snprintf(buffer, sizeof(buffer), "%.17g", value);
+	}
+	return buffer;
+}
+
+std::string formatUnsigned(Uint64 value) {
+	char buffer[32];
+	snprintf(buffer, sizeof(buffer), "%llu",
+			static_cast<unsigned long long> (value));
+	return buffer;
+}
+
+void appendEscaped(std::string& output, const std::string& text,
+		bool quotes) {
+	for (size_t c = 0; c < text.size(); ++c) {
+		if (text[c] == '\\') {
+			output += "\\\\";
+		} else if (text[c] == '\n') {
+			output += "\\n";
+		} else if (text[c] == '"' && quotes) {
+			output += "\\\"";
+		} else {
+			output += text[c];
+		}
+	}
+}
+
+/*
+ * appendSampleLine - Appends "name{labels} value" with the host label first
+ * and an optional extra label last.
+ */
+void appendSampleLine(std::string& output, const std::string& name,
+		const std::string& host, const std::string& labels,
+		const std::string& extra, const std::string& value) {
+	output += name;
+	output += "{host=\"";
+	appendEscaped(output, host, true);
+	output += '"';
+	if (!labels.empty()) {
+		output += ',';
+		output += labels;
+	}
+	if (!extra.empty()) {
+		output += ',';
+		output += extra;
+	}
+	output += "} ";
+	output += value;
+	output += '\n';
+}
+
+void appendUint16(std::string& output, Uint16 value) {
+	const Uint16 big = SystemPosix::Htons(value);
+	output.append(reinterpret_cast<const char*> (&big), sizeof(big));
+}
+
+void appendUint32(std::string& output, Uint32 value) {
+	const Uint32 big = SystemPosix::Htonl(value);
+	output.append(reinterpret_cast<const char*> (&big), sizeof(big));
+}
+
+void appendUint64(std::string& output, Uint64 value) {
+	const Uint64 big = SystemPosix::Htonll(value);
+	output.append(reinterpret_cast<const char*> (&big), sizeof(big));
+}
+
+void appendString(std::string& output, const std::string& text) {
+	const Uint16 length = Uint16(std::min(text.size(), size_t(0xFFFF)));
+	appendUint16(output, length);
+	output.append(text.data(), length);
+}
+
+/*
+ * sendAll - Writes the whole buffer to the client, unless it goes away.
+ */
+void sendAll(int client, const std::string& data) {
+	size_t sent = 0;
+	while (sent < data.size()) {
+		const ssize_t result = send(client, data.data() + sent, data.size()
+				- sent, MSG_NOSIGNAL);
+		if (result < 0 && errno == EINTR) {
+			continue;
+		}
+		if (result <= 0) {
+			return;
+		}
+		sent += size_t(result);
+	}
+}
+
+/*
+ * serveClient - Answers one request: a line naming the format, or an HTTP
+ * GET of /metrics or /metrics.bin.
+ */
+void serveClient(int client) {
+	struct timeval timeout;
+	timeout.tv_sec = CLIENT_TIMEOUT;
+	timeout.tv_usec = 0;
+	setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+	setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+	std::string request;
+	char buffer[512];
+	while (request.find('\n') == std::string::npos && request.size() < 4096) {
+		const ssize_t received = recv(client, buffer, sizeof(buffer), 0);
+		if (received < 0 && errno == EINTR) {
+			continue;
+		}
+		if (received <= 0) {
+			break;
+		}
+		request.append(buffer, received);
+	}
+	std::string line = request.substr(0, request.find('\n'));
+	if (!line.empty() && line[line.size() - 1] == '\r') {
+		line.erase(line.size() - 1);
+	}
+
+	bool http = false;
+	bool binary = false;
+	bool known = true;
+	if (line.compare(0, 4, "GET ") == 0) {
+		http = true;
+		const std::string path = line.substr(4, line.find(' ', 4) - 4);
+		binary = path == "/metrics.bin";
+		known = binary || path == "/metrics" || path == "/";
+	} else {
+		binary = line == "binary";
+		known = binary || line == "text" || line.empty();
+	}
+
+	std::string body;
+	if (known) {
+		MetricsSnapshot snapshot;
+		snapshot.setHostname(hostname);
+		Metrics::collect(snapshot);
+		if (binary) {
+			snapshot.writeBinary(body);
+		} else {
+			snapshot.writeText(body);
+		}
+	} else {
+		body = "unknown request; send \"text\" or \"binary\"\n";
+	}
+
+	if (http) {
+		std::string header = known ? "HTTP/1.0 200 OK\r\n"
+				: "HTTP/1.0 404 Not Found\r\n";
+		header += binary ? "Content-Type: application/octet-stream\r\n"
+				: "Content-Type: text/plain; version=0.0.4\r\n";
+		header += "Content-Length: " + formatUnsigned(body.size()) + "\r\n";
+		header += "Connection: close\r\n\r\n";
+		sendAll(client, header);
+	}
+	sendAll(client, body);
+}
+
+void* serverMain(void*) {
+	SystemPosix::applyThreadRole("METRICS");
+	static const Counter scrapes = Metrics::counter(
+			"rocket_metrics_scrapes_total",
+			"Requests served by the metrics socket");
+
+	while (!Atomic::load(&stopRequested)) {
+		struct pollfd waiting;
+		waiting.fd = listenSocket;
+		waiting.events = POLLIN;
+		waiting.revents = 0;
+		if (poll(&waiting, 1, POLL_INTERVAL) <= 0) {
+			continue;
+		}
+		const int client = accept(listenSocket, NULL, NULL);
+		if (client < 0) {
+			continue;
+		}
+		serveClient(client);
+		close(client);
+		scrapes.add();
+	}
+	return NULL;
+}
+
+}
+
+__thread volatile Uint64* Metrics::currentShard = NULL;
+volatile Uint64 Metrics::gauges[MAX_GAUGES];
+
+/*
+ * counter - Registers a counter, or returns the one registered under the
+ * same name and labels.
+ *
+ * @param name The metric name, e.g. "rocket_frames_total".
+ * @param help One line describing it.
+ * @param labels Extra labels in the text format, e.g. "lock=\"frame\"";
+ *        see MetricsSnapshot::label().
+ */
+Counter Metrics::counter(const std::string& name, const std::string& help,
+		const std::string& labels) {
+	pthread_mutex_lock(&registryMutex);
+	Definition* definition = findDefinition(MetricsSnapshot::COUNTER, name,
+			labels);
+	if (definition == NULL) {
+		definition = addDefinition(MetricsSnapshot::COUNTER, name, help,
+				labels, 1);
+	} else if (definition->type != MetricsSnapshot::COUNTER) {
+		definition = NULL;
+	}
+	const Uint32 slot = definition != NULL ? definition->slot : 0;
+	pthread_mutex_unlock(&registryMutex);
+	return Counter(slot);
+} // end counter()
+
+/*
+ * gauge - Registers a gauge, or returns the one registered under the same
+ * name and labels.
+ */
+Gauge Metrics::gauge(const std::string& name, const std::string& help,
+		const std::string& labels) {
+	pthread_mutex_lock(&registryMutex);
+	Definition* definition = findDefinition(MetricsSnapshot::GAUGE, name,
+			labels);
+	if (definition == NULL) {
+		if (numGauges < MAX_GAUGES) {
+			definition = addDefinition(MetricsSnapshot::GAUGE, name, help,
+					labels, 0);
+			definition->slot = numGauges++;
+		} else {
+			LOG_WARNING("Metric %s is not recorded: out of gauges",
+					name.c_str());
+		}
+	} else if (definition->type != MetricsSnapshot::GAUGE) {
+		definition = NULL;
+	} else if (definition->sampler != NULL) {
+		LOG_WARNING("Metric %s{%s} is not recorded: it is computed by a "
+			"sampler", name.c_str(), labels.c_str());
+		definition = NULL;
+	}
+	const Uint32 slot = definition != NULL ? definition->slot : 0;
+	pthread_mutex_unlock(&registryMutex);
+	return Gauge(slot);
+} // end gauge()
+
+/*
+ * histogram - Registers a histogram, or returns the one registered under
+ * the same name and labels.
+ *
+ * @param bounds The upper bounds of the buckets, in ascending order.
+ */
+Histogram Metrics::histogram(const std::string& name,
+		const std::string& help, const std::vector<double>& bounds,
+		const std::string& labels) {
+	pthread_mutex_lock(&registryMutex);
+	Definition* definition = findDefinition(MetricsSnapshot::HISTOGRAM, name,
+			labels);
+	if (definition == NULL) {
+		definition = addDefinition(MetricsSnapshot::HISTOGRAM, name, help,
+				labels, Uint32(bounds.size()) + 2);
+		if (definition != NULL) {
+			// Handles point at the bounds, so they are never freed.
+			double* copy = new double[bounds.size() + 1];
+			std::copy(bounds.begin(), bounds.end(), copy);
+			definition->bounds = copy;
+			definition->numBounds = Uint32(bounds.size());
+		}
+	} else if (definition->type != MetricsSnapshot::HISTOGRAM) {
+		definition = NULL;
+	}
+	const Histogram histogram = definition != NULL ? Histogram(
+			definition->slot, definition->bounds, definition->numBounds)
+			: Histogram();
+	pthread_mutex_unlock(&registryMutex);
+	return histogram;
+} // end histogram()
+
+/*
+ * addSampler - Registers a gauge whose value \p sampler computes each time
+ * the metrics are read.
+ */
+void Metrics::addSampler(const std::string& name, const std::string& help,
+		MetricsSampler sampler, void* context, const std::string& labels) {
+	pthread_mutex_lock(&registryMutex);
+	Definition* definition = findDefinition(MetricsSnapshot::GAUGE, name,
+			labels);
+	if (definition == NULL) {
+		definition = addDefinition(MetricsSnapshot::GAUGE, name, help,
+				labels, 0);
+		if (definition != NULL) {
+			// It has no gauge; gauge() hands out dead handles for it.
+			definition->slot = 0;
+		}
+	} else if (definition->type != MetricsSnapshot::GAUGE) {
+		definition = NULL;
+	}
+	if (definition != NULL) {
+		definition->sampler = sampler;
+		definition->context = context;
+	}
+	pthread_mutex_unlock(&registryMutex);
+} // end addSampler()
+
+/*
+ * addCollector - Registers a function that adds its own samples each time
+ * the metrics are read.
+ */
+void Metrics::addCollector(MetricsCollector collector, void* context) {
+	pthread_mutex_lock(&registryMutex);
+	createRegistry();
+	Collector entry;
+	entry.collector = collector;
+	entry.context = context;
+	collectors->push_back(entry);
+	pthread_mutex_unlock(&registryMutex);
+} // end addCollector()
+
+/*
+ * exponentialBounds - Returns \p count bucket bounds, the first \p start
+ * and each \p factor times the previous.
+ */
+std::vector<double> Metrics::exponentialBounds(double start, double factor,
+		int count) {
+	std::vector<double> bounds;
+	for (int b = 0; b < count; ++b) {
+		bounds.push_back(start);
+		start *= factor;
+	}
+	return bounds;
+} // end exponentialBounds()
+
+/*
+ * collect - Adds the current value of every metric to the snapshot.  The
+ * per-thread shards are read without stopping their writers, so a
+ * histogram's count and sum may be one observation apart.
+ */
+void Metrics::collect(MetricsSnapshot& snapshot) {
+	std::vector<Definition> current;
+	std::vector<Collector> currentCollectors;
+	pthread_mutex_lock(&registryMutex);
+	if (definitions != NULL) {
+		current = *definitions;
+		currentCollectors = *collectors;
+	}
+	pthread_mutex_unlock(&registryMutex);
+
+	const Uint32 count = Atomic::load(&numShards);
+	for (size_t d = 0; d < current.size(); ++d) {
+		const Definition& definition = current[d];
+		switch (definition.type) {
+		case MetricsSnapshot::COUNTER:
+			snapshot.addCounter(definition.name, definition.help,
+					definition.labels, sumSlot(definition.slot, count));
+			break;
+		case MetricsSnapshot::GAUGE:
+			snapshot.addGauge(definition.name, definition.help,
+					definition.labels, definition.sampler != NULL
+							? definition.sampler(definition.context)
+							: toDouble(Atomic::loadRelaxed(
+									&gauges[definition.slot])));
+			break;
+		case MetricsSnapshot::HISTOGRAM: {
+			std::vector<Uint64> buckets(definition.numBounds + 1);
+			for (Uint32 b = 0; b <= definition.numBounds; ++b) {
+				buckets[b] = sumSlot(definition.slot + b, count);
+			}
+			snapshot.addHistogram(definition.name, definition.help,
+					definition.labels, std::vector<double>(definition.bounds,
+							definition.bounds + definition.numBounds),
+					buckets, sumDoubleSlot(definition.slot
+							+ definition.numBounds + 1, count));
+			break;
+		}
+		}
+	}
+
+	for (size_t c = 0; c < currentCollectors.size(); ++c) {
+		currentCollectors[c].collector(snapshot, currentCollectors[c].context);
+	}
+} // end collect()
+
+/*
+ * startServer - Serves the metrics on a Unix domain socket at \p path.  A
+ * stale socket left there by an earlier run is replaced; the new one is only
+ * accessible to the current user.
+ *
+ * @return \c false is returned if the server is already running or the
+ *         socket could not be created.
+ */
+bool Metrics::startServer(const std::string& path) {
+	pthread_mutex_lock(&serverMutex);
+	if (serverRunning) {
+		pthread_mutex_unlock(&serverMutex);
+		return false;
+	}
+
+	struct sockaddr_un address;
+	std::memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	if (path.empty() || path.size() >= sizeof(address.sun_path)) {
+		pthread_mutex_unlock(&serverMutex);
+		LOG_WARNING("Metrics socket path %s is empty or too long", path);
+		return false;
+	}
+	std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+	struct stat status;
+	if (lstat(path.c_str(), &status) == 0 && S_ISSOCK(status.st_mode)) {
+		unlink(path.c_str());
+	}
+
+	listenSocket = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (listenSocket < 0 || bind(listenSocket,
+			reinterpret_cast<struct sockaddr*> (&address), sizeof(address))
+			!= 0 || chmod(path.c_str(), S_IRUSR | S_IWUSR) != 0 || listen(
+			listenSocket, 8) != 0) {
+		const int error = errno;
+		if (listenSocket >= 0) {
+			close(listenSocket);
+			listenSocket = -1;
+		}
+		pthread_mutex_unlock(&serverMutex);
+		LOG_WARNING("Cannot serve metrics on %s: %s", path, strerror(error));
+		return false;
+	}
+
+	hostname = SystemPosix::getHostname();
+	socketPath = path;
+	Atomic::store(&stopRequested, false);
+	if (pthread_create(&server, NULL, &serverMain, NULL) != 0) {
+		close(listenSocket);
+		listenSocket = -1;
+		unlink(path.c_str());
+		pthread_mutex_unlock(&serverMutex);
+		return false;
+	}
+	serverRunning = true;
+	pthread_mutex_unlock(&serverMutex);
+	LOG_INFO("Serving metrics on %s", path);
+	return true;
+} // end startServer()
+
+/*
+ * startServerFromEnvironment - Starts the server if ROCKET_METRICS_SOCKET
+ * names a socket path.
+ */
+bool Metrics::startServerFromEnvironment(void) {
+	std::string path;
+	return SystemPosix::getenv("ROCKET_METRICS_SOCKET", path) && startServer(
+			path);
+} // end startServerFromEnvironment()
+
+/*
+ * stopServer - Stops the server and removes its socket.
+ */
+void Metrics::stopServer(void) {
+	pthread_mutex_lock(&serverMutex);
+	if (serverRunning) {
+		Atomic::store(&stopRequested, true);
+		pthread_join(server, NULL);
+		close(listenSocket);
+		listenSocket = -1;
+		unlink(socketPath.c_str());
+		serverRunning = false;
+	}
+	pthread_mutex_unlock(&serverMutex);
+} // end stopServer()
+
+/*
+ * createShard - Gives the calling thread a shard: the one of a thread that
+ * has exited, whose counts it carries on, or a new one.  Threads past
+ * MAX_THREADS live ones share a shard, and may lose an update now and then
+ * when two of them race on it.
+ */
+volatile Uint64* Metrics::createShard(void) {
+	pthread_once(&shardKeyOnce, &Metrics::createShardKey);
+	pthread_mutex_lock(&registryMutex);
+	const Uint32 count = Atomic::loadRelaxed(&numShards);
+	volatile Uint64* shard = NULL;
+	for (Uint32 s = 0; s < count && shard == NULL; ++s) {
+		if (releasedShards[s]) {
+			releasedShards[s] = false;
+			shard = shards[s];
+		}
+	}
+	if (shard == NULL && count < MAX_THREADS) {
+		shard = new Uint64[MAX_SLOTS]();
+		shards[count] = shard;
+		releasedShards[count] = false;
+		Atomic::store(&numShards, count + 1);
+	}
+	if (shard != NULL) {
+		pthread_setspecific(shardKey, const_cast<Uint64*> (shard));
+	} else {
+		if (overflowShard == NULL) {
+			Atomic::store(&overflowShard, static_cast<volatile Uint64*> (
+					new Uint64[MAX_SLOTS]()));
+		}
+		shard = Atomic::loadRelaxed(&overflowShard);
+	}
+	pthread_mutex_unlock(&registryMutex);
+	currentShard = shard;
+	return shard;
+} // end createShard()
+
+void Metrics::createShardKey(void) {
+	pthread_key_create(&shardKey, &Metrics::releaseShard);
+} // end createShardKey()
+
+/*
+ * releaseShard - Runs when a thread that has a shard of its own exits, and
+ * hands the shard to the next new thread.
+ */
+void Metrics::releaseShard(void* shard) {
+	currentShard = NULL;
+	pthread_mutex_lock(&registryMutex);
+	const Uint32 count = Atomic::loadRelaxed(&numShards);
+	for (Uint32 s = 0; s < count; ++s) {
+		if (shards[s] == shard) {
+			releasedShards[s] = true;
+		}
+	}
+	pthread_mutex_unlock(&registryMutex);
+} // end releaseShard()
+
+/*
+ * label - Returns name="value" with the value escaped, for the labels of a
+ * metric.
+ */
+std::string MetricsSnapshot::label(const std::string& name,
+		const std::string& value) {
+	std::string result = name + "=\"";
+	appendEscaped(result, value, true);
+	return result + '"';
+} // end label()
+
+void MetricsSnapshot::addCounter(const std::string& name,
+		const std::string& help, const std::string& labels, Uint64 value) {
+	Sample sample;
+	sample.type = COUNTER;
+	sample.name = name;
+	sample.help = help;
+	sample.labels = labels;
+	sample.value = 0.0;
+	sample.count = value;
+	samples.push_back(sample);
+} // end addCounter()
+
+void MetricsSnapshot::addGauge(const std::string& name,
+		const std::string& help, const std::string& labels, double value) {
+	Sample sample;
+	sample.type = GAUGE;
+	sample.name = name;
+	sample.help = help;
+	sample.labels = labels;
+	sample.value = value;
+	sample.count = 0;
+	samples.push_back(sample);
+} // end addGauge()
+
+/*
+ * addHistogram - Adds a histogram.  \p buckets holds one count per bound
+ * plus one for the values above the last, each counting only its own range.
+ */
+void MetricsSnapshot::addHistogram(const std::string& name,
+		const std::string& help, const std::string& labels,
+		const std::vector<double>& bounds, const std::vector<Uint64>& buckets,
+		double sum) {
+	Sample sample;
+	sample.type = HISTOGRAM;
+	sample.name = name;
+	sample.help = help;
+	sample.labels = labels;
+	sample.value = sum;
+	sample.count = 0;
+	sample.bounds = bounds;
+	sample.buckets = buckets;
+	sample.buckets.resize(bounds.size() + 1);
+	for (size_t b = 0; b < sample.buckets.size(); ++b) {
+		sample.count += sample.buckets[b];
+	}
+	samples.push_back(sample);
+} // end addHistogram()
+
+bool MetricsSnapshot::orderByName(const Sample& a, const Sample& b) {
+	return a.name < b.name;
+} // end orderByName()
+
+/*
+ * setHostname - Sets the value of the "host" label.
+ */
+void MetricsSnapshot::setHostname(const std::string& _hostname) {
+	hostname = _hostname;
+} // end setHostname()
+
+/*
+ * writeText - Appends the samples in the Prometheus text exposition format.
+ */
+void MetricsSnapshot::writeText(std::string& output) const {
+	static const char* const typeNames[] = { "counter", "gauge", "histogram" };
+
+	std::vector<Sample> ordered(samples);
+	std::stable_sort(ordered.begin(), ordered.end(), &orderByName);
+	for (size_t s = 0; s < ordered.size(); ++s) {
+		const Sample& sample = ordered[s];
+		if (s == 0 || ordered[s - 1].name != sample.name) {
+			output += "# HELP " + sample.name + ' ';
+			appendEscaped(output, sample.help, false);
+			output += "\n# TYPE " + sample.name + ' ' + typeNames[sample.type]
+					+ '\n';
+		}
+
+		switch (sample.type) {
+		case COUNTER:
+			appendSampleLine(output, sample.name, hostname, sample.labels, "",
+					formatUnsigned(sample.count));
+			break;
+		case GAUGE:
+			appendSampleLine(output, sample.name, hostname, sample.labels, "",
+					formatDouble(sample.value));
+			break;
+		case HISTOGRAM: {
+			Uint64 cumulative = 0;
+			for (size_t b = 0; b < sample.buckets.size(); ++b) {
+				cumulative += sample.buckets[b];
+				appendSampleLine(output, sample.name + "_bucket", hostname,
+						sample.labels, "le=\"" + (b < sample.bounds.size()
+								? formatDouble(sample.bounds[b]) : "+Inf")
+								+ '"', formatUnsigned(cumulative));
+			}
+			appendSampleLine(output, sample.name + "_sum", hostname,
+					sample.labels, "", formatDouble(sample.value));
+			appendSampleLine(output, sample.name + "_count", hostname,
+					sample.labels, "", formatUnsigned(sample.count));
+			break;
+		}
+		}
+	}
+} // end writeText()
+
+/*
+ * writeBinary - Appends the samples as a compact snapshot.  All integers
+ * are big-endian, doubles are sent as their IEEE 754 bits, and strings as a
+ * 16-bit length followed by the bytes:
+ *
+ *   "RKMS"  Uint32 version (1)  Uint64 wall clock time in ns
+ *   string  host name
+ *   Uint32  number of samples, then for each:
+ *     Uint8 type (0 counter, 1 gauge, 2 histogram)  string name
+ *     string labels (text format, without the host)
+ *     counter:   Uint64 value
+ *     gauge:     double value
+ *     histogram: Uint32 bounds  double bound[bounds]
+ *                Uint64 bucket[bounds + 1] (not cumulative)  double sum
+ */
+void MetricsSnapshot::writeBinary(std::string& output) const {
+	struct timespec now;
+	clock_gettime(CLOCK_REALTIME, &now);
+
+	output += "RKMS";
+	appendUint32(output, BINARY_VERSION);
+	appendUint64(output, Uint64(now.tv_sec) * 1000000000 + Uint64(now.tv_nsec));
+	appendString(output, hostname);
+	appendUint32(output, Uint32(samples.size()));
+	for (size_t s = 0; s < samples.size(); ++s) {
+		const Sample& sample = samples[s];
+		output += char(sample.type);
+		appendString(output, sample.name);
+		appendString(output, sample.labels);
+		switch (sample.type) {
+		case COUNTER:
+			appendUint64(output, sample.count);
+			break;
+		case GAUGE:
+			appendUint64(output, toBits(sample.value));
+			break;
+		case HISTOGRAM:
+			appendUint32(output, Uint32(sample.bounds.size()));
+			for (size_t b = 0; b < sample.bounds.size(); ++b) {
+				appendUint64(output, toBits(sample.bounds[b]));
+			}
+			for (size_t b = 0; b < sample.buckets.size(); ++b) {
+				appendUint64(output, sample.buckets[b]);
+			}
+			appendUint64(output, toBits(sample.value));
+			break;
+		}
+	}
+} // end writeBinary()
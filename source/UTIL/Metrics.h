@@ -0,0 +1,249 @@
+#ifndef METRICS_H_
+#define METRICS_H_
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <SYNC/Atomic.h>
+#include <UTIL/Types.h>
+
+class Counter;
+class Gauge;
+class Histogram;
+class MetricsSnapshot;
+
+/*
+ * MetricsCollector - Adds samples to a snapshot when the metrics are read,
+ * for values that live elsewhere (e.g. the lock statistics).
+ */
+typedef void (*MetricsCollector)(MetricsSnapshot& snapshot, void* context);
+
+/*
+ * MetricsSampler - Returns the current value of a gauge that is only
+ * computed when the metrics are read.
+ */
+typedef double (*MetricsSampler)(void* context);
+
+/**
+ * @example "Example of recording metrics"
+ *
+ * Metrics are registered once and then updated through small handles.
+ * Updates go to a per-thread shard with plain stores, so they are as cheap
+ * as incrementing a local variable:
+ *
+ * \code
+ * static const Counter uploads = Metrics::counter("rocket_uploads_total",
+ *         "Textures uploaded to the GPU");
+ * static const Histogram uploadTime = Metrics::histogram(
+ *         "rocket_upload_seconds", "Texture upload time",
+ *         Metrics::exponentialBounds(0.0001, 2.0, 16));
+ *
+ * uploads.add();
+ * uploadTime.observe(seconds);
+ * \endcode
+ */
+
+/*
+ * Metrics - Registry of counters, gauges and histograms, served over a
+ * Unix domain socket for watching a running session.
+ *
+ * Counter and histogram updates go to the calling thread's shard, which
+ * only that thread writes, without locked instructions.  Reading the
+ * metrics sums the shards.  Sampled gauges and collectors run only when
+ * the metrics are read.  So while nobody is polling, the metrics cost a few
+ * stores on the hot path and a server thread asleep in poll().
+ *
+ * The server starts if ROCKET_METRICS_SOCKET names a socket path, or with
+ * startServer().  A client sends one request line and gets one response:
+ *
+ *   "text" or an HTTP "GET /metrics"    Prometheus text format
+ *   "binary" or "GET /metrics.bin"      the binary snapshot described at
+ *                                       MetricsSnapshot::writeBinary()
+ *
+ * for instance with curl --unix-socket <path> http://localhost/metrics.
+ * Every sample carries the host name as a "host" label.
+ */
+class Metrics {
+public:
+	enum {
+		MAX_SLOTS = 4096, /**< Counter and histogram slots per shard */
+		MAX_GAUGES = 256,
+		MAX_THREADS = 256 /**< Live threads with a shard of their own */
+	};
+
+	static Counter counter(const std::string& name, const std::string& help,
+			const std::string& labels = "");
+	static Gauge gauge(const std::string& name, const std::string& help,
+			const std::string& labels = "");
+	static Histogram histogram(const std::string& name,
+			const std::string& help, const std::vector<double>& bounds,
+			const std::string& labels = "");
+	static void addSampler(const std::string& name, const std::string& help,
+			MetricsSampler sampler, void* context,
+			const std::string& labels = "");
+	static void addCollector(MetricsCollector collector, void* context);
+
+	static std::vector<double> exponentialBounds(double start, double factor,
+			int count);
+
+	static void collect(MetricsSnapshot& snapshot);
+
+	static bool startServer(const std::string& path);
+	static bool startServerFromEnvironment(void);
+	static void stopServer(void);
+
+	/*
+	 * getShard - Returns the calling thread's slots.
+	 */
+	static volatile Uint64* getShard(void) {
+		volatile Uint64* shard = currentShard;
+		return shard != NULL ? shard : createShard();
+	} // end getShard()
+
+private:
+	friend class Gauge;
+
+	static volatile Uint64* createShard(void);
+	static void createShardKey(void);
+	static void releaseShard(void* shard);
+
+	static __thread volatile Uint64* currentShard;
+	static volatile Uint64 gauges[MAX_GAUGES]; /**< The doubles' bits */
+};
+
+/*
+ * Counter - A count that only goes up.
+ */
+class Counter {
+public:
+	Counter(void) :
+		slot(0) {
+	} // end Counter()
+
+	inline void add(Uint64 delta = 1) const;
+
+private:
+	friend class Metrics;
+
+	explicit Counter(Uint32 _slot) :
+		slot(_slot) {
+	} // end Counter()
+
+	Uint32 slot;
+};
+
+/*
+ * Gauge - A value that goes up and down.  Gauges are not sharded: set()
+ * stores the latest value of all threads.
+ */
+class Gauge {
+public:
+	Gauge(void) :
+		slot(0) {
+	} // end Gauge()
+
+	void set(double value) const {
+		Uint64 bits;
+		std::memcpy(&bits, &value, sizeof(bits));
+		Atomic::storeRelaxed(&Metrics::gauges[slot], bits);
+	} // end set()
+
+private:
+	friend class Metrics;
+
+	explicit Gauge(Uint32 _slot) :
+		slot(_slot) {
+	} // end Gauge()
+
+	Uint32 slot;
+};
+
+/*
+ * Histogram - Counts observations per bucket; bucket i holds the values up
+ * to bounds[i], and one more bucket the values above the last bound.
+ */
+class Histogram {
+public:
+	Histogram(void) :
+		slot(0), bounds(NULL), numBounds(0) {
+	} // end Histogram()
+
+	inline void observe(double value) const;
+
+private:
+	friend class Metrics;
+
+	Histogram(Uint32 _slot, const double* _bounds, Uint32 _numBounds) :
+		slot(_slot), bounds(_bounds), numBounds(_numBounds) {
+	} // end Histogram()
+
+	Uint32 slot; /**< numBounds + 1 buckets, then the sum */
+	const double* bounds;
+	Uint32 numBounds;
+};
+
+void Counter::add(Uint64 delta) const {
+	volatile Uint64* shard = Metrics::getShard();
+	Atomic::storeRelaxed(&shard[slot], shard[slot] + delta);
+} // end add()
+
+void Histogram::observe(double value) const {
+	volatile Uint64* shard = Metrics::getShard();
+	const Uint32 bucket = Uint32(std::lower_bound(bounds, bounds + numBounds,
+			value) - bounds);
+	Atomic::storeRelaxed(&shard[slot + bucket], shard[slot + bucket] + 1);
+
+	double sum;
+	Uint64 bits = shard[slot + numBounds + 1];
+	std::memcpy(&sum, &bits, sizeof(sum));
+	sum += value;
+	std::memcpy(&bits, &sum, sizeof(bits));
+	Atomic::storeRelaxed(&shard[slot + numBounds + 1], bits);
+} // end observe()
+
+/*
+ * MetricsSnapshot - The values of all metrics at one point in time, as
+ * produced by Metrics::collect() and by collectors.
+ */
+class MetricsSnapshot {
+public:
+	enum Type {
+		COUNTER, GAUGE, HISTOGRAM
+	};
+
+	void addCounter(const std::string& name, const std::string& help,
+			const std::string& labels, Uint64 value);
+	void addGauge(const std::string& name, const std::string& help,
+			const std::string& labels, double value);
+	void addHistogram(const std::string& name, const std::string& help,
+			const std::string& labels, const std::vector<double>& bounds,
+			const std::vector<Uint64>& buckets, double sum);
+
+	static std::string label(const std::string& name,
+			const std::string& value);
+
+	void setHostname(const std::string& hostname);
+	void writeText(std::string& output) const;
+	void writeBinary(std::string& output) const;
+
+private:
+	struct Sample {
+		Type type;
+		std::string name;
+		std::string help;
+		std::string labels;
+		double value;
+		Uint64 count;
+		std::vector<double> bounds;
+		std::vector<Uint64> buckets; /**< Not cumulative */
+	};
+
+	static bool orderByName(const Sample& a, const Sample& b);
+
+	std::string hostname;
+	std::vector<Sample> samples;
+};
+
+#endif /* METRICS_H_ */
@@ -0,0 +1,192 @@
+#ifndef OBJECT_POOL_H_
+#define OBJECT_POOL_H_
+
+#include <cassert>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+/* Boost includes */
+#include <boost/noncopyable.hpp>
+
+/*
+ * ObjectPool - Recycles the memory of objects of one type that are created
+ * and destroyed over and over, such as per-frame events or queue nodes.
+ * Objects live in chunks of OBJECTS_PER_CHUNK slots; destroy() puts the slot
+ * on a free list and create() takes it back from there, so after the first
+ * few frames the pool stops touching the heap.  Chunks are only returned to
+ * the heap when the pool goes away.
+ *
+ * Unlike FrameArena, objects are destroyed one at a time and their
+ * destructors run.  The pool is not thread safe.  In DEBUG builds, destroyed
+ * objects are overwritten with 0xDD and destroying an object twice is caught
+ * by an assertion.
+ */
+template<class T, size_t OBJECTS_PER_CHUNK = 64>
+class ObjectPool: boost::noncopyable {
+public:
+	ObjectPool(void) :
+		chunks(NULL), freeSlots(NULL), numLive(0), numSlots(0) {
+	} // end ObjectPool()
+
+	/*
+	 * ~ObjectPool - Destructor for ObjectPool class.  All objects must have
+	 * been destroyed by then; those that were not are leaked, without their
+	 * destructors running.
+	 */
+	~ObjectPool(void) {
+		while (chunks != NULL) {
+			Chunk* next = chunks->next;
+			std::free(chunks);
+			chunks = next;
+		}
+	} // end ~ObjectPool()
+
+	/*
+	 * create - Default constructs a new object in the pool.
+	 *
+	 * @throw std::bad_alloc is thrown if a new chunk cannot be allocated.
+	 */
+	T* create(void) {
+		Slot* slot = takeSlot();
+		try {
+			T* object = new (slot->storage) T();
+			++numLive;
+			return object;
+		} catch (...) {
+			putSlot(slot);
+			throw;
+		}
+	} // end create()
+
+	/*
+	 * create - Copy constructs a new object in the pool.
+	 */
+	T* create(const T& value) {
+		Slot* slot = takeSlot();
+		try {
+			T* object = new (slot->storage) T(value);
+			++numLive;
+			return object;
+		} catch (...) {
+			putSlot(slot);
+			throw;
+		}
+	} // end create()
+
+	/*
+	 * destroy - Runs the destructor of an object created by this pool and
+	 * makes its slot available again.  Passing NULL is allowed.
+	 */
+	void destroy(T* object) {
+		if (object == NULL) {
+			return;
+		}
+#ifdef DEBUG
+		assert(!hasFreeMark(reinterpret_cast<Slot*> (object))
+				&& "object destroyed twice");
+#endif
+		object->~T();
+		--numLive;
+		putSlot(reinterpret_cast<Slot*> (object));
+	} // end destroy()
+
+	/*
+	 * reserve - Makes sure \p count objects fit without allocating.
+	 */
+	void reserve(size_t count) {
+		while (numSlots < count) {
+			addChunk();
+		}
+	} // end reserve()
+
+	size_t getNumLive(void) const {
+		return numLive;
+	} // end getNumLive()
+
+	size_t getCapacity(void) const {
+		return numSlots;
+	} // end getCapacity()
+
+private:
+	/* A slot holds an object while in use and a link while free: */
+	union Slot {
+		Slot* nextFree;
+		char storage[sizeof(T)];
+		long double alignLongDouble;
+		void* alignPointer;
+		long long alignLongLong;
+	};
+
+	struct Chunk {
+		Chunk* next;
+		Slot slots[OBJECTS_PER_CHUNK];
+	};
+
+#ifdef DEBUG
+	/* Marks a free slot; written right after the free-list link: */
+	static const unsigned int FREE_MARK = 0xF7EE5107u;
+
+	static bool hasFreeMark(const Slot* slot) {
+		const unsigned int mark = FREE_MARK;
+		return sizeof(Slot) >= sizeof(Slot*) + sizeof(mark)
+				&& std::memcmp(reinterpret_cast<const char*> (slot)
+						+ sizeof(Slot*), &mark, sizeof(mark)) == 0;
+	}
+
+	static void poison(Slot* slot) {
+		const unsigned int mark = FREE_MARK;
+		std::memset(static_cast<void*> (slot), 0xDD, sizeof(Slot));
+		if (sizeof(Slot) >= sizeof(Slot*) + sizeof(mark)) {
+			std::memcpy(reinterpret_cast<char*> (slot) + sizeof(Slot*), &mark,
+					sizeof(mark));
+		}
+	}
+#endif
+
+	Slot* takeSlot(void) {
+		if (freeSlots == NULL) {
+			addChunk();
+		}
+		Slot* slot = freeSlots;
+		freeSlots = slot->nextFree;
+#ifdef DEBUG
+		std::memset(static_cast<void*> (slot), 0, sizeof(Slot));
+#endif
+		return slot;
+	}
+
+	void putSlot(Slot* slot) {
+#ifdef DEBUG
+		poison(slot);
+#endif
+		slot->nextFree = freeSlots;
+		freeSlots = slot;
+	}
+
+	void addChunk(void) {
+		Chunk* chunk = static_cast<Chunk*> (std::malloc(sizeof(Chunk)));
+		if (chunk == NULL) {
+			throw std::bad_alloc();
+		}
+		chunk->next = chunks;
+		chunks = chunk;
+		for (size_t i = OBJECTS_PER_CHUNK; i > 0; --i) {
+			Slot* slot = &chunk->slots[i - 1];
+#ifdef DEBUG
+			poison(slot);
+#endif
+			slot->nextFree = freeSlots;
+			freeSlots = slot;
+		}
+		numSlots += OBJECTS_PER_CHUNK;
+	}
+
+	Chunk* chunks;
+	Slot* freeSlots;
+	size_t numLive;
+	size_t numSlots;
+};
+
+#endif /* OBJECT_POOL_H_ */
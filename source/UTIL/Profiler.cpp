@@ -0,0 +1,504 @@
+#include <algorithm>
+#include <cstring>
+#include <vector>
+#include <pthread.h>
+#include <unistd.h>
+
+#include <SYNC/Atomic.h>
+#include <UTIL/AllocationTracker.h>
+#include <UTIL/Profiler.h>
+
+namespace {
+
+/*
+ * ZoneEvent - One finished zone, as written to the trace.
+ */
+struct ZoneEvent {
+	Uint64 start;
+	Uint64 end;
+	Uint32 frame;
+	Int32 context;
+	Uint16 zone;
+	Uint8 depth;
+	Int8 pass;
+};
+
+enum {
+	EVENTS_PER_CHUNK = 4096,
+	MAX_CHUNKS = 64, /**< So a thread traces at most 256k zones */
+
+	/* Durations are bucketed per power of two, split into 16 linear steps: */
+	SUB_BUCKET_BITS = 4,
+	SUB_BUCKETS = 1 << SUB_BUCKET_BITS,
+	NUM_BUCKETS = 40 * SUB_BUCKETS
+};
+
+/*
+ * ZoneStatistics - Durations of one zone on one thread.  Only the owning
+ * thread writes; the report reads concurrently, which can at worst miss the
+ * latest few samples.
+ */
+struct ZoneStatistics {
+	Uint64 count;
+	Uint64 total;
+	Uint64 max;
+	Uint32 buckets[NUM_BUCKETS];
+
+	ZoneStatistics(void) :
+		count(0), total(0), max(0) {
+		std::memset(buckets, 0, sizeof(buckets));
+	}
+};
+
+/*
+ * bucketOf - Returns the histogram bucket of a duration.  Values below 16 ns
+ * get a bucket each; above that, the bucket is at most 1/16 wide.
+ */
+int bucketOf(Uint64 nanoseconds) {
+	if (nanoseconds < SUB_BUCKETS) {
+		return int(nanoseconds);
+	}
+	const int magnitude = 63 - __builtin_clzl(nanoseconds);
+	const int bucket = (magnitude - SUB_BUCKET_BITS + 1) * SUB_BUCKETS
+			+ int((nanoseconds >> (magnitude - SUB_BUCKET_BITS))
+					& (SUB_BUCKETS - 1));
+	return bucket < NUM_BUCKETS ? bucket : NUM_BUCKETS - 1;
+}
+
+/*
+ * bucketValue - Returns the middle of the range covered by a bucket.
+ */
+Uint64 bucketValue(int bucket) {
+	if (bucket < SUB_BUCKETS) {
+		return Uint64(bucket);
+	}
+	const int magnitude = bucket / SUB_BUCKETS + SUB_BUCKET_BITS - 1;
+	const Uint64 low = (Uint64(1) << magnitude) + (Uint64(bucket
+			% SUB_BUCKETS) << (magnitude - SUB_BUCKET_BITS));
+	return low + (Uint64(1) << (magnitude - SUB_BUCKET_BITS)) / 2;
+}
+
+/*
+ * ThreadBuffer - Everything one thread records.  Buffers are never freed,
+ * so the report can read those of threads that have already exited.
+ */
+struct ThreadBuffer {
+	std::string name;
+	Uint32 index;
+	int depth;
+	Int32 context;
+	Int32 pass;
+
+	ZoneEvent* chunks[MAX_CHUNKS];
+	volatile Uint32 numEvents; /**< Published after each event is written */
+	volatile Uint64 droppedEvents;
+
+	ZoneStatistics* volatile statistics[Profiler::MAX_ZONES];
+};
+
+pthread_mutex_t registryMutex = PTHREAD_MUTEX_INITIALIZER;
+
+const char* zoneNames[Profiler::MAX_ZONES];
+volatile Uint32 numZones = 0;
+
+ThreadBuffer* threads[Profiler::MAX_THREADS];
+volatile Uint32 numThreads = 0;
+
+/* Where the trace time line starts: */
+const Uint64 startTime = SystemPosix::getMonotonicNanoseconds();
+
+volatile Uint32 frameNumber = 0;
+
+/* The zone recorded by newFrame() and the time the current frame began: */
+Uint32 frameZone = Profiler::MAX_ZONES;
+Uint64 frameStart = 0;
+
+__thread ThreadBuffer* currentThread = NULL;
+
+/*
+ * getThreadBuffer - Returns the buffer of the calling thread, creating it on
+ * the first call.
+ *
+ * @return The buffer, or NULL if MAX_THREADS threads are already recording.
+ */
+ThreadBuffer* getThreadBuffer(void) {
+	if (currentThread == NULL) {
+		pthread_mutex_lock(&registryMutex);
+		const Uint32 index = Atomic::loadRelaxed(&numThreads);
+		if (index < Profiler::MAX_THREADS) {
+			ThreadBuffer* buffer = new ThreadBuffer();
+			buffer->index = index;
+			buffer->depth = 0;
+			buffer->context = -1;
+			buffer->pass = -1;
+			buffer->numEvents = 0;
+			buffer->droppedEvents = 0;
+			std::memset(buffer->chunks, 0, sizeof(buffer->chunks));
+			std::memset((void*) buffer->statistics, 0,
+					sizeof(buffer->statistics));
+
+			char name[32];
+			snprintf(name, sizeof(name), "Thread %u", index);
+			buffer->name = name;
+
+			threads[index] = buffer;
+			Atomic::store(&numThreads, index + 1);
+			currentThread = buffer;
+		}
+		pthread_mutex_unlock(&registryMutex);
+	}
+	return currentThread;
+}
+
+/*
+ * record - Adds a finished zone to the buffer and statistics of the calling
+ * thread.
+ */
+void record(ThreadBuffer& buffer, Uint32 zone, Uint64 start, Uint64 end) {
+	const Uint64 duration = end - start;
+
+	ZoneStatistics* statistics = buffer.statistics[zone];
+	if (statistics == NULL) {
+		statistics = new ZoneStatistics();
+		Atomic::store(&buffer.statistics[zone], statistics);
+	}
+	Atomic::storeRelaxed(&statistics->count, statistics->count + 1);
+	Atomic::storeRelaxed(&statistics->total, statistics->total + duration);
+	if (duration > statistics->max) {
+		Atomic::storeRelaxed(&statistics->max, duration);
+	}
+	Uint32& bucket = statistics->buckets[bucketOf(duration)];
+	Atomic::storeRelaxed(&bucket, bucket + 1);
+
+	const Uint32 index = buffer.numEvents;
+	const Uint32 chunk = index / EVENTS_PER_CHUNK;
+	if (chunk >= MAX_CHUNKS) {
+		Atomic::storeRelaxed(&buffer.droppedEvents, buffer.droppedEvents + 1);
+		return;
+	}
+	if (buffer.chunks[chunk] == NULL) {
+		buffer.chunks[chunk] = new ZoneEvent[EVENTS_PER_CHUNK];
+	}
+
+	ZoneEvent& event = buffer.chunks[chunk][index % EVENTS_PER_CHUNK];
+	event.start = start;
+	event.end = end;
+	event.frame = Atomic::loadRelaxed(&frameNumber);
+	event.context = buffer.context;
+	event.pass = Int8(buffer.pass);
+	event.zone = Uint16(zone);
+	event.depth = Uint8(buffer.depth);
+	Atomic::store(&buffer.numEvents, index + 1);
+}
+
+/*
+ * writeJSONString - Writes \p text as a JSON string literal.
+ */
+void writeJSONString(FILE* dest, const char* text) {
+	fputc('"', dest);
+	for (; *text != '\0'; ++text) {
+		if (*text == '"' || *text == '\\') {
+			fputc('\\', dest);
+		}
+		if (static_cast<unsigned char> (*text) >= 0x20) {
+			fputc(*text, dest);
+		}
+	}
+	fputc('"', dest);
+}
+
+/*
+ * ZoneSummary - The statistics of one zone, merged over all threads.
+ */
+struct ZoneSummary {
+	const char* name;
+	ZoneStatistics statistics;
+
+	Uint64 getPercentile(double percentile) const {
+		const Uint64 rank = Uint64(percentile / 100.0
+				* double(statistics.count - 1)) + 1;
+		Uint64 seen(0);
+		for (int i = 0; i < NUM_BUCKETS; ++i) {
+			seen += statistics.buckets[i];
+			if (seen >= rank) {
+				return std::min(bucketValue(i), statistics.max);
+			}
+		}
+		return statistics.max;
+	}
+
+	bool operator<(const ZoneSummary& other) const {
+		return statistics.total > other.statistics.total;
+	}
+};
+
+}
+
+/*
+ * registerZone - Returns the id of the zone with the given name, registering
+ * the name on first use.  PROFILE_ZONE calls this once per call site.
+ *
+ * @param name The zone name.  It must stay valid for the lifetime of the
+ *             program, e.g. a string literal.
+ *
+ * @return The zone id.  The last id is kept for "<other zones>": once the
+ *         other MAX_ZONES - 1 ids are in use, further names share it.
+ */
+Uint32 Profiler::registerZone(const char* name) {
+	pthread_mutex_lock(&registryMutex);
+	Uint32 zone(0);
+	const Uint32 count = Atomic::loadRelaxed(&numZones);
+	while (zone < count && std::strcmp(zoneNames[zone], name) != 0) {
+		++zone;
+	}
+	if (zone == count) {
+		if (count < MAX_ZONES - 1) {
+			zoneNames[zone] = name;
+			Atomic::store(&numZones, count + 1);
+		} else {
+			zone = MAX_ZONES - 1;
+			if (count < MAX_ZONES) {
+				zoneNames[zone] = "<other zones>";
+				Atomic::store(&numZones, Uint32(MAX_ZONES));
+			}
+		}
+	}
+	pthread_mutex_unlock(&registryMutex);
+	return zone;
+} // end registerZone()
+
+/*
+ * enter - Books the start of a zone on the calling thread.
+ */
+void Profiler::enter(void) {
+	ThreadBuffer* buffer = getThreadBuffer();
+	if (buffer != NULL) {
+		++buffer->depth;
+	}
+} // end enter()
+
+/*
+ * leave - Records a zone that ends now on the calling thread.
+ *
+ * @param zone  The id from registerZone().
+ * @param start The start time from SystemPosix::getMonotonicNanoseconds().
+ */
+void Profiler::leave(Uint32 zone, Uint64 start) {
+	const Uint64 end = SystemPosix::getMonotonicNanoseconds();
+	ThreadBuffer* buffer = currentThread;
+	if (buffer != NULL) {
+		--buffer->depth;
+		record(*buffer, zone, start, end);
+	}
+} // end leave()
+
+/*
+ * newFrame - Marks the start of a new frame.  The time since the previous
+ * call is recorded as the "Frame" zone, and zones recorded from now on carry
+ * the new frame number.  Call this from one thread only, at the top of the
+ * application's frame().
+ */
+void Profiler::newFrame(void) {
+	const Uint64 now = SystemPosix::getMonotonicNanoseconds();
+	if (frameZone == MAX_ZONES) {
+		frameZone = registerZone("Frame");
+	}
+
+	ThreadBuffer* buffer = getThreadBuffer();
+	if (buffer != NULL && frameStart != 0) {
+		record(*buffer, frameZone, frameStart, now);
+	}
+	frameStart = now;
+	Atomic::fetchAdd(&frameNumber, Uint32(1));
+} // end newFrame()
+
+/*
+ * getFrameNumber - Returns the number of frames started so far.
+ */
+Uint32 Profiler::getFrameNumber(void) {
+	return Atomic::load(&frameNumber);
+} // end getFrameNumber()
+
+/*
+ * setContext - Sets the render context and pass that the calling thread's
+ * zones are tagged with.  -1 means none.
+ */
+void Profiler::setContext(Int32 context, Int32 pass) {
+	ThreadBuffer* buffer = getThreadBuffer();
+	if (buffer != NULL) {
+		buffer->context = context;
+		buffer->pass = pass;
+	}
+} // end setContext()
+
+/*
+ * getContext - Returns the tags set by setContext() on the calling thread.
+ */
+void Profiler::getContext(Int32& context, Int32& pass) {
+	ThreadBuffer* buffer = getThreadBuffer();
+	context = buffer != NULL ? buffer->context : -1;
+	pass = buffer != NULL ? buffer->pass : -1;
+} // end getContext()
+
+/*
+ * setThreadName - Names the calling thread in the trace.
+ */
+void Profiler::setThreadName(const std::string& name) {
+	ThreadBuffer* buffer = getThreadBuffer();
+	if (buffer != NULL) {
+		pthread_mutex_lock(&registryMutex);
+		buffer->name = name;
+		pthread_mutex_unlock(&registryMutex);
+	}
+} // end setThreadName()
+
+/*
+ * exportTrace - Writes all recorded zones in the Chrome trace event format.
+ * Each zone carries its frame number, and its render context and pass if it
+ * has them, as arguments.
+ *
+ * @param path The file to write.
+ *
+ * @return \c false is returned if the file could not be written.
+ */
+bool Profiler::exportTrace(const std::string& path) {
+	FILE* dest = fopen(path.c_str(), "w");
+	if (dest == NULL) {
+		return false;
+	}
+
+	const int pid = int(getpid());
+	const Uint32 threadCount = Atomic::load(&numThreads);
+	bool first(true);
+
+	fprintf(dest, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+	pthread_mutex_lock(&registryMutex);
+	for (Uint32 t = 0; t < threadCount; ++t) {
+		fprintf(dest, "%s{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":%d,"
+			"\"tid\":%u,\"args\":{\"name\":", first ? "" : ",\n", pid, t);
+		writeJSONString(dest, threads[t]->name.c_str());
+		fprintf(dest, "}}");
+		first = false;
+	}
+
+	for (Uint32 t = 0; t < threadCount; ++t) {
+		const ThreadBuffer& buffer = *threads[t];
+		const Uint32 numEvents = Atomic::load(&buffer.numEvents);
+		for (Uint32 i = 0; i < numEvents; ++i) {
+			const ZoneEvent& event = buffer.chunks[i / EVENTS_PER_CHUNK][i
+					% EVENTS_PER_CHUNK];
+			fprintf(dest, ",\n{\"ph\":\"X\",\"cat\":\"rocket\",\"name\":");
+			writeJSONString(dest, zoneNames[event.zone]);
+			fprintf(dest, ",\"pid\":%d,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f,"
+				"\"args\":{\"frame\":%u", pid, t, double(event.start
+					- startTime) / 1000.0, double(event.end - event.start)
+					/ 1000.0, event.frame);
+			if (event.context >= 0) {
+				fprintf(dest, ",\"context\":%d", event.context);
+			}
+			if (event.pass >= 0) {
+				fprintf(dest, ",\"pass\":%d", int(event.pass));
+			}
+			fprintf(dest, "}}");
+		}
+	}
+	pthread_mutex_unlock(&registryMutex);
+
+#ifdef ROCKET_ALLOC_TRACKING
+	/* Heap allocations per frame, as counter tracks: */
+	std::vector<AllocationTracker::FrameAllocations> history;
+	AllocationTracker::getFrameHistory(history);
+	for (size_t i = 0; i < history.size(); ++i) {
+		const double time = double(history[i].time - startTime) / 1000.0;
+		for (int p = 0; p < AllocationTracker::NUM_PHASES; ++p) {
+			fprintf(dest, ",\n{\"ph\":\"C\",\"name\":\"Allocations (%s)\","
+				"\"pid\":%d,\"ts\":%.3f,\"args\":{\"count\":%lu,\"KB\":%.1f}}",
+					AllocationTracker::getPhaseName(
+							AllocationTracker::Phase(p)), pid, time,
+					history[i].allocations[p], double(history[i].bytes[p])
+							/ 1024.0);
+		}
+	}
+#endif
+
+	fprintf(dest, "\n]}\n");
+
+	return fclose(dest) == 0;
+} // end exportTrace()
+
+/*
+ * writeSummary - Prints count, mean, p50/p95/p99 and maximum of each zone
+ * over all threads, the most expensive zones first.
+ */
+void Profiler::writeSummary(FILE* dest) {
+	std::vector<ZoneSummary> summaries(Atomic::load(&numZones));
+	for (size_t z = 0; z < summaries.size(); ++z) {
+		summaries[z].name = zoneNames[z];
+	}
+
+	Uint64 dropped(0);
+	const Uint32 threadCount = Atomic::load(&numThreads);
+	for (Uint32 t = 0; t < threadCount; ++t) {
+		dropped += Atomic::loadRelaxed(&threads[t]->droppedEvents);
+		for (size_t z = 0; z < summaries.size(); ++z) {
+			const ZoneStatistics* source = Atomic::load(
+					&threads[t]->statistics[z]);
+			if (source == NULL) {
+				continue;
+			}
+			ZoneStatistics& target = summaries[z].statistics;
+			target.count += Atomic::loadRelaxed(&source->count);
+			target.total += Atomic::loadRelaxed(&source->total);
+			target.max = std::max(target.max, Atomic::loadRelaxed(
+					&source->max));
+			for (int i = 0; i < NUM_BUCKETS; ++i) {
+				target.buckets[i] += Atomic::loadRelaxed(&source->buckets[i]);
+			}
+		}
+	}
+	std::sort(summaries.begin(), summaries.end());
+
+	fprintf(dest, "\n------ Frame Profile (%u frames) -----\n", Atomic::load(
+			&frameNumber));
+	fprintf(dest, "%-32s %10s %10s %10s %10s %10s %10s\n", "Zone (ms)",
+			"Count", "Mean", "p50", "p95", "p99", "Max");
+	for (size_t z = 0; z < summaries.size(); ++z) {
+		const ZoneSummary& summary = summaries[z];
+		if (summary.statistics.count == 0) {
+			continue;
+		}
+		fprintf(dest, "%-32s %10lu %10.3f %10.3f %10.3f %10.3f %10.3f\n",
+				summary.name, summary.statistics.count,
+				double(summary.statistics.total)
+						/ double(summary.statistics.count) / 1e6,
+				double(summary.getPercentile(50.0)) / 1e6,
+				double(summary.getPercentile(95.0)) / 1e6,
+				double(summary.getPercentile(99.0)) / 1e6,
+				double(summary.statistics.max) / 1e6);
+	}
+	if (dropped > 0) {
+		fprintf(dest, "(%lu zones were not traced because the trace buffers "
+			"were full; they are included above)\n", dropped);
+	}
+
+#ifdef ROCKET_ALLOC_TRACKING
+	AllocationTracker::writeSummary(dest);
+#endif
+} // end writeSummary()
+
+/*
+ * report - Prints the summary to stderr and writes the trace to the file
+ * named by ROCKET_PROFILE_TRACE (default: rocket-trace.json).
+ */
+void Profiler::report(void) {
+	writeSummary(stderr);
+
+	std::string path("rocket-trace.json");
+	SystemPosix::getenv("ROCKET_PROFILE_TRACE", path);
+	if (exportTrace(path)) {
+		fprintf(stderr, "Frame trace written to %s\n", path.c_str());
+	} else {
+		fprintf(stderr, "Could not write the frame trace to %s\n",
+				path.c_str());
+	}
+} // end report()
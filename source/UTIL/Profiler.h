@@ -0,0 +1,121 @@
+#ifndef PROFILER_H_
+#define PROFILER_H_
+
+#include <cstdio>
+#include <string>
+
+/* Boost includes */
+#include <boost/noncopyable.hpp>
+#include <boost/preprocessor/cat.hpp>
+
+#include <UTIL/System.h>
+#include <UTIL/Types.h>
+
+/**
+ * @example "Example of profiling a function"
+ *
+ * A zone measures the enclosing scope.  Zones nest, and each thread records
+ * into its own buffer, so zones are cheap enough for every frame:
+ *
+ * \code
+ * void Hopper::frame(void) {
+ *     PROFILE_ZONE("Hopper::frame");
+ *     ...
+ * }
+ * \endcode
+ *
+ * The macros compile to nothing unless ROCKET_PROFILING is defined.
+ */
+#ifdef ROCKET_PROFILING
+#define PROFILE_ZONE(name) \
+	static const Uint32 BOOST_PP_CAT(profileZoneId, __LINE__) = \
+		Profiler::registerZone(name); \
+	ProfileZone BOOST_PP_CAT(profileZone, __LINE__)( \
+		BOOST_PP_CAT(profileZoneId, __LINE__))
+#define PROFILE_CONTEXT(context, pass) \
+	ProfileContext BOOST_PP_CAT(profileContext, __LINE__)(context, pass)
+#define PROFILE_NEW_FRAME() Profiler::newFrame()
+#define PROFILE_THREAD_NAME(name) Profiler::setThreadName(name)
+#else
+#define PROFILE_ZONE(name)
+#define PROFILE_CONTEXT(context, pass)
+#define PROFILE_NEW_FRAME()
+#define PROFILE_THREAD_NAME(name)
+#endif
+
+/*
+ * Profiler - Hierarchical frame profiler.  Zones record their start and end
+ * time on the monotonic clock into a buffer owned by the recording thread,
+ * so recording takes no locks.  Each zone is tagged with the frame number
+ * and, inside a PROFILE_CONTEXT, with the render context and pass (eye) it
+ * belongs to.
+ *
+ * At exit, report() writes the recorded zones as Chrome trace events (for
+ * chrome://tracing or Perfetto) and prints a p50/p95/p99 summary per zone.
+ * With ROCKET_ALLOC_TRACKING, both also include the heap allocation counts
+ * of AllocationTracker.
+ */
+class Profiler {
+public:
+	enum {
+		MAX_ZONES = 256, /**< Distinct zone names */
+		MAX_THREADS = 256 /**< Threads that record zones */
+	};
+
+	static Uint32 registerZone(const char* name);
+	static void enter(void);
+	static void leave(Uint32 zone, Uint64 start);
+	static void newFrame(void);
+	static Uint32 getFrameNumber(void);
+	static void setContext(Int32 context, Int32 pass);
+	static void getContext(Int32& context, Int32& pass);
+	static void setThreadName(const std::string& name);
+
+	static bool exportTrace(const std::string& path);
+	static void writeSummary(FILE* dest);
+	static void report(void);
+};
+
+/*
+ * ProfileZone - Measures the lifetime of a scope.  Use PROFILE_ZONE rather
+ * than this class directly.
+ */
+class ProfileZone: boost::noncopyable {
+public:
+	explicit ProfileZone(Uint32 _zone) :
+		zone(_zone) {
+		Profiler::enter();
+		start = SystemPosix::getMonotonicNanoseconds();
+	} // end ProfileZone()
+
+	~ProfileZone(void) {
+		Profiler::leave(zone, start);
+	} // end ~ProfileZone()
+
+private:
+	const Uint32 zone;
+	Uint64 start;
+};
+
+/*
+ * ProfileContext - Tags the zones recorded by the current thread in a scope
+ * with a render context and pass.  Use PROFILE_CONTEXT rather than this class
+ * directly.
+ */
+class ProfileContext: boost::noncopyable {
+public:
+	ProfileContext(Int32 context, Int32 pass) {
+		Profiler::getContext(savedContext, savedPass);
+		Profiler::setContext(context, pass);
+	} // end ProfileContext()
+
+	~ProfileContext(void) {
+		Profiler::setContext(savedContext, savedPass);
+	} // end ~ProfileContext()
+
+private:
+	Int32 savedContext;
+	Int32 savedPass;
+};
+
+#endif /* PROFILER_H_ */
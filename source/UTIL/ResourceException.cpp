@@ -7,7 +7,7 @@
  * ResourceException constructor
  */
 ResourceException::ResourceException(const std::string& msg,
-		const std::string& location) throw () :
+		const SourceLocation& location) throw () :
 	Exception(msg, location) {
 	/* Do nothing. */;
 } // end ResourceException()
@@ -9,7 +9,7 @@
 class ResourceException: public Exception {
 public:
 			ResourceException(const std::string& msg,
-					const std::string& location = "") throw ();
+					const SourceLocation& location = SourceLocation()) throw ();
 
 	virtual ~ResourceException(void) throw ();
 
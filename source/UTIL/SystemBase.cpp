@@ -1,17 +1,87 @@
 #include <cstdlib>
+#include <cstring>
 #include <sstream>
 #include <string>
+#include <cxxabi.h>
+#include <execinfo.h>
 
 #include <UTIL/SystemBase.h>
 
+/*
+ * captureCallStack - Records the return addresses of the current call stack
+ * without resolving them, which is cheap enough to do on every throw.
+ *
+ * @param frames    Storage for the addresses, innermost call first.
+ * @param maxFrames The size of \p frames.
+ * @param skip      The number of innermost frames to leave out, not counting
+ *                  captureCallStack() itself.
+ *
+ * @return The number of addresses stored.
+ */
+int SystemBase::captureCallStack(void** frames, int maxFrames, int skip) {
+	++skip;
+
+	void* buffer[128];
+	int count = backtrace(buffer, maxFrames + skip < 128 ? maxFrames + skip
+			: 128);
+	count = count > skip ? count - skip : 0;
+	std::memcpy(frames, buffer + skip, count * sizeof(void*));
+
+	return count;
+} // end captureCallStack()
+
+/*
+ * symbolizeCallStack - Turns addresses from captureCallStack() into a
+ * readable stack trace with demangled function names.  Functions of the
+ * executable are only named if it is linked with -rdynamic.
+ */
+std::string SystemBase::symbolizeCallStack(void* const * frames,
+		int numFrames) {
+	std::ostringstream stream;
+	stream << "Stack trace:\n";
+
+	char** symbols = numFrames > 0 ? backtrace_symbols(frames, numFrames)
+			: NULL;
+	if (symbols == NULL) {
+		stream << "   <Call stack printing not supported>\n";
+		return stream.str();
+	}
+
+	for (int i = 0; i < numFrames; ++i) {
+		// glibc formats a frame as "binary(mangled+0x1f) [0x4005d4]".
+		std::string line(symbols[i]);
+		const std::string::size_type open = line.find('(');
+		const std::string::size_type plus = line.find('+', open);
+		const std::string::size_type close = line.find(')', open);
+
+		stream << "   #" << i << " ";
+		if (open != std::string::npos && plus != std::string::npos && close
+				!= std::string::npos && plus > open + 1) {
+			const std::string mangled = line.substr(open + 1, plus - open - 1);
+			int status;
+			char* demangled = abi::__cxa_demangle(mangled.c_str(), NULL, NULL,
+					&status);
+			stream << (status == 0 ? demangled : mangled.c_str())
+					<< line.substr(plus, close - plus) << " in "
+					<< line.substr(0, open) << "\n";
+			std::free(demangled);
+		} else {
+			stream << line << "\n";
+		}
+	}
+	std::free(symbols);
+
+	return stream.str();
+} // end symbolizeCallStack()
+
 /*
  * getCallStack - Returns a stack trace.
  *
  * @post If supported, returns a string describing the current call stack.
  */
 std::string SystemBase::getCallStack() {
-	std::string ret_stack(
-			"Stack trace:\n   <Call stack printing not supported>\n");
+	void* frames[64];
+	const int numFrames = captureCallStack(frames, 64, 1);
 
-	return ret_stack;
+	return symbolizeCallStack(frames, numFrames);
 }
@@ -41,7 +41,7 @@ public:
 	 * @return \c false is returned on a big-endian host.
 	 */
 	static bool isLittleEndian() {
-		return (getEndian() == 0);
+		return __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__;
 	} // end isLittleEndian()
 
 	/*
@@ -51,9 +51,11 @@ public:
 	 * @return \c false is returned on a little-endian host.
 	 */
 	static bool isBigEndian() {
-		return (getEndian() == 1);
+		return __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__;
 	} // end isBigEndian()
 
+	static int captureCallStack(void** frames, int maxFrames, int skip = 0);
+	static std::string symbolizeCallStack(void* const * frames, int numFrames);
 	static std::string getCallStack();
 };
 
@@ -1,79 +1,311 @@
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
 #include <cstdlib>
 #include <cstring>
+#include <ctime>
+#include <fstream>
+#include <set>
+#include <sstream>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
 #include <sys/utsname.h>
+#include <linux/mempolicy.h>
 
+#include <UTIL/Logger.h>
 #include <UTIL/SystemPosix.h>
 
+namespace {
+
+const char* const SYSFS_CPU = "/sys/devices/system/cpu/";
+const char* const SYSFS_NODE = "/sys/devices/system/node/";
+
 /*
- * usleep - Sleeps for the given number of microseconds.
- *
- * @param micro The number of microseconds to sleep.
+ * InitialScheduling - The affinity and scheduling the process started with,
+ * taken before main() so that no role has changed them yet.
  */
-int SystemPosix::usleep(Uint32 micro) {
-	return ::usleep(micro);
-} // end usleep()
+struct InitialScheduling {
+	bool valid;
+	cpu_set_t affinity;
+	int policy;
+	struct sched_param param;
+	int nice;
+
+	InitialScheduling(void) {
+		valid = pthread_getaffinity_np(pthread_self(), sizeof(affinity),
+				&affinity) == 0 && pthread_getschedparam(pthread_self(),
+				&policy, &param) == 0;
+		nice = getpriority(PRIO_PROCESS, 0);
+	}
+} initialScheduling;
+
+/* Whether applyThreadRole() ran on the calling thread before: */
+__thread bool roleApplied = false;
 
 /*
- * msleep - Sleeps for the given number of milliseconds.
+ * readSysFile - Reads the first line of a sysfs file.
  *
- * @param milli The number of milliseconds to sleep.
+ * @return \c false is returned if the file does not exist or is empty.
  */
-int SystemPosix::msleep(Uint32 milli) {
-	// usleep() cannot sleep for more than 1 second, so we have to work
-	// around that here.  First, we sleep for N seconds.
-	if (milli >= 1000) {
-		SystemPosix::sleep(milli / 1000);
+bool readSysFile(const std::string& path, std::string& value) {
+	std::ifstream file(path.c_str());
+	return std::getline(file, value) && !value.empty();
+}
+
+/*
+ * readSysInt - Reads a sysfs file holding a single integer.
+ */
+int readSysInt(const std::string& path, int defaultValue) {
+	std::string value;
+	return readSysFile(path, value) ? std::atoi(value.c_str()) : defaultValue;
+}
+
+std::string toString(int value) {
+	std::ostringstream stream;
+	stream << value;
+	return stream.str();
+}
+
+/*
+ * readCaches - Adds the caches of \p cpu that are not listed yet.
+ */
+void readCaches(int cpu, std::vector<CpuCache>& caches) {
+	for (int index = 0;; ++index) {
+		const std::string dir = SYSFS_CPU + ("cpu" + toString(cpu))
+				+ "/cache/index" + toString(index) + "/";
+
+		CpuCache cache;
+		std::string shared;
+		if (!readSysFile(dir + "type", cache.type) || !readSysFile(dir
+				+ "shared_cpu_list", shared) || !SystemPosix::parseCpuList(
+				shared, cache.cpus)) {
+			break;
+		}
+		cache.level = readSysInt(dir + "level", 0);
+		cache.lineSize = Uint32(readSysInt(dir + "coherency_line_size", 0));
+
+		// Sizes are given as e.g. "32K" or "8192K".
+		std::string size;
+		cache.size = 0;
+		if (readSysFile(dir + "size", size)) {
+			cache.size = Uint64(std::strtoul(size.c_str(), NULL, 10));
+			switch (size[size.size() - 1]) {
+			case 'K':
+				cache.size <<= 10;
+				break;
+			case 'M':
+				cache.size <<= 20;
+				break;
+			case 'G':
+				cache.size <<= 30;
+				break;
+			}
+		}
+
+		bool known(false);
+		for (size_t i = 0; i < caches.size() && !known; ++i) {
+			known = caches[i].level == cache.level && caches[i].type
+					== cache.type && caches[i].cpus == cache.cpus;
+		}
+		if (!known) {
+			caches.push_back(cache);
+		}
 	}
+}
 
-	// Then we finish off by sleeping for (N mod 1000) milliseconds.
-	return SystemPosix::usleep((milli % 1000) * 1000);
-} // end msleep()
+/*
+ * readCpuTopology - Builds the topology from sysfs.  If sysfs is not
+ * available, every online CPU is reported as a core of its own.
+ */
+CpuTopology readCpuTopology(void) {
+	CpuTopology topology;
 
-/**
- * Ntohll - Converts the given 64-bit value (a long long) from native byte
- * ordering to network byte ordering.  This is safe to use with signed and
- * unsigned values.
+	std::string online;
+	std::vector<int> ids;
+	if (!readSysFile(std::string(SYSFS_CPU) + "online", online)
+			|| !SystemPosix::parseCpuList(online, ids)) {
+		ids.clear();
+		const long count = sysconf(_SC_NPROCESSORS_ONLN);
+		for (long i = 0; i < count; ++i) {
+			ids.push_back(int(i));
+		}
+	}
+
+	// NUMA nodes, and which node each CPU belongs to:
+	std::vector<int> nodeIds;
+	std::string nodes;
+	if (readSysFile(std::string(SYSFS_NODE) + "online", nodes)) {
+		SystemPosix::parseCpuList(nodes, nodeIds);
+	}
+	std::vector<int> cpuNode;
+	for (size_t n = 0; n < nodeIds.size(); ++n) {
+		std::string list;
+		std::vector<int> cpus;
+		if (readSysFile(SYSFS_NODE + ("node" + toString(nodeIds[n]))
+				+ "/cpulist", list)) {
+			SystemPosix::parseCpuList(list, cpus);
+		}
+		if (int(topology.numaNodes.size()) <= nodeIds[n]) {
+			topology.numaNodes.resize(nodeIds[n] + 1);
+		}
+		topology.numaNodes[nodeIds[n]] = cpus;
+		for (size_t i = 0; i < cpus.size(); ++i) {
+			if (int(cpuNode.size()) <= cpus[i]) {
+				cpuNode.resize(cpus[i] + 1, 0);
+			}
+			cpuNode[cpus[i]] = nodeIds[n];
+		}
+	}
+	if (topology.numaNodes.empty()) {
+		topology.numaNodes.push_back(ids);
+	}
+
+	std::set<int> packages;
+	std::set<std::pair<int, int> > cores;
+	for (size_t i = 0; i < ids.size(); ++i) {
+		const std::string dir = SYSFS_CPU + ("cpu" + toString(ids[i]))
+				+ "/topology/";
+
+		CpuInfo cpu;
+		cpu.id = ids[i];
+		cpu.package = readSysInt(dir + "physical_package_id", 0);
+		cpu.core = readSysInt(dir + "core_id", cpu.id);
+		cpu.numaNode = cpu.id < int(cpuNode.size()) ? cpuNode[cpu.id] : 0;
+
+		std::string siblings;
+		if (!readSysFile(dir + "thread_siblings_list", siblings)
+				|| !SystemPosix::parseCpuList(siblings, cpu.siblings)) {
+			cpu.siblings.assign(1, cpu.id);
+		}
+
+		packages.insert(cpu.package);
+		cores.insert(std::make_pair(cpu.package, cpu.core));
+		topology.cpus.push_back(cpu);
+
+		readCaches(cpu.id, topology.caches);
+	}
+
+	topology.numPackages = int(packages.size());
+	topology.numCores = int(cores.size());
+	return topology;
+}
+
+/*
+ * toUpper - Returns \p text in upper case, for building variable names.
+ */
+std::string toUpper(std::string text) {
+	for (size_t i = 0; i < text.size(); ++i) {
+		text[i] = char(std::toupper(static_cast<unsigned char> (text[i])));
+	}
+	return text;
+}
+
+/*
+ * parseAffinity - Turns the value of a ROCKET_AFFINITY_<ROLE> variable into
+ * a CPU list: "node:N" for the CPUs of NUMA node N, "package:N" for those
+ * of socket N, and otherwise a list such as "0-3,8".
  */
-Uint64 SystemPosix::Ntohll(Uint64 conversion) {
-	Uint64 ret_val;
+bool parseAffinity(const std::string& spec, std::vector<int>& cpus) {
+	const CpuTopology& topology = SystemPosix::getCpuTopology();
+	cpus.clear();
 
-	if (isLittleEndian()) {
-		*(reinterpret_cast<Uint32*> (&ret_val) + 1) = Ntohl(
-				*reinterpret_cast<Uint32*> (&conversion));
-		*reinterpret_cast<Uint32*> (&ret_val) = Ntohl(
-				*(reinterpret_cast<Uint32*> (&conversion) + 1));
+	if (spec.compare(0, 5, "node:") == 0) {
+		const int node = std::atoi(spec.c_str() + 5);
+		if (node >= 0 && node < int(topology.numaNodes.size())) {
+			cpus = topology.numaNodes[node];
+		}
+	} else if (spec.compare(0, 8, "package:") == 0) {
+		const int package = std::atoi(spec.c_str() + 8);
+		for (size_t i = 0; i < topology.cpus.size(); ++i) {
+			if (topology.cpus[i].package == package) {
+				cpus.push_back(topology.cpus[i].id);
+			}
+		}
 	} else {
-		*reinterpret_cast<Uint32*> (&ret_val) = Ntohl(
-				*reinterpret_cast<Uint32*> (&conversion));
-		*(reinterpret_cast<Uint32*> (&ret_val) + 1) = Ntohl(
-				*(reinterpret_cast<Uint32*> (&conversion) + 1));
+		SystemPosix::parseCpuList(spec, cpus);
 	}
 
-	return ret_val;
-} // end Ntohll()
+	return !cpus.empty();
+}
 
 /*
- * Htonll - Converts the given 64-bit value (a long long) from network byte
- * ordering to native byte ordering.  This is safe to use with signed and
- * unsigned values.
+ * parseScheduling - Parses the value of a ROCKET_SCHED_<ROLE> variable:
+ * "normal", "batch" or "idle", optionally followed by ":<nice value>", or
+ * "fifo:<priority>" or "rr:<priority>".
  */
-Uint64 SystemPosix::Htonll(Uint64 conversion) {
-	Uint64 ret_val;
+bool parseScheduling(const std::string& spec,
+		SystemPosix::SchedulingPolicy& policy, int& priority) {
+	const std::string::size_type colon = spec.find(':');
+	const std::string name = spec.substr(0, colon);
+	priority = colon == std::string::npos ? 0 : std::atoi(spec.c_str()
+			+ colon + 1);
 
-	if (isLittleEndian()) {
-		*(reinterpret_cast<Uint32*> (&ret_val) + 1) = Htonl(
-				*reinterpret_cast<Uint32*> (&conversion));
-		*reinterpret_cast<Uint32*> (&ret_val) = Htonl(
-				*(reinterpret_cast<Uint32*> (&conversion) + 1));
+	if (name == "normal") {
+		policy = SystemPosix::SCHEDULE_NORMAL;
+	} else if (name == "batch") {
+		policy = SystemPosix::SCHEDULE_BATCH;
+	} else if (name == "idle") {
+		policy = SystemPosix::SCHEDULE_IDLE;
+	} else if (name == "fifo") {
+		policy = SystemPosix::SCHEDULE_FIFO;
+	} else if (name == "rr") {
+		policy = SystemPosix::SCHEDULE_ROUND_ROBIN;
 	} else {
-		*reinterpret_cast<Uint32*> (&ret_val) = Htonl(
-				*reinterpret_cast<Uint32*> (&conversion));
-		*(reinterpret_cast<Uint32*> (&ret_val) + 1) = Htonl(
-				*(reinterpret_cast<Uint32*> (&conversion) + 1));
+		return false;
 	}
+	return true;
+}
+
+}
+
+/*
+ * usleep - Sleeps for the given number of microseconds; see sleepUntil().
+ * Unlike ::usleep(), it is not cut short by signals, and any length works.
+ *
+ * @param micro The number of microseconds to sleep.
+ *
+ * @return 0 is returned on success, an errno value otherwise.  Unlike
+ *         ::usleep(), it does not return -1 and set errno.
+ */
+int SystemPosix::usleep(Uint32 micro) {
+	return sleepUntil(getMonotonicNanoseconds() + Uint64(micro) * 1000);
+} // end usleep()
+
+/*
+ * msleep - Sleeps for the given number of milliseconds; see sleepUntil().
+ *
+ * @param milli The number of milliseconds to sleep.
+ *
+ * @return 0 is returned on success, an errno value otherwise.
+ */
+int SystemPosix::msleep(Uint32 milli) {
+	return sleepUntil(getMonotonicNanoseconds() + Uint64(milli) * 1000000);
+} // end msleep()
+
+/*
+ * sleepUntil - Sleeps until the monotonic clock (see
+ * getMonotonicNanoseconds()) reaches the given time.  Because the deadline
+ * is absolute, signals that interrupt the sleep do not stretch it, and a
+ * loop that adds a fixed period to its deadline does not drift.
+ *
+ * @param deadline The monotonic time to wake up at, in nanoseconds.
+ *
+ * @return 0 is returned on success, an errno value otherwise.
+ */
+int SystemPosix::sleepUntil(Uint64 deadline) {
+	struct timespec until;
+	until.tv_sec = time_t(deadline / 1000000000);
+	until.tv_nsec = long(deadline % 1000000000);
 
-	return ret_val;
-} // end Htonll()
+	int result;
+	do {
+		result = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &until, NULL);
+	} while (result == EINTR);
+	return result;
+} // end sleepUntil()
 
 /*
  * getenv - Queries the run-time environment for the value of the named
@@ -152,3 +384,261 @@ std::string SystemPosix::getHostname() {
 		return std::string("<hostname-lookup failed>");
 	}
 } // end getHostname()
+
+/*
+ * getCpuTopology - Returns the CPU topology of this machine: the online
+ * logical CPUs with their cores, sockets and SMT siblings, the caches and
+ * the NUMA nodes.  It is read from /sys on the first call.
+ */
+const CpuTopology& SystemPosix::getCpuTopology(void) {
+	static const CpuTopology topology = readCpuTopology();
+	return topology;
+} // end getCpuTopology()
+
+/*
+ * getCurrentCpu - Returns the CPU the calling thread is running on, or -1 if
+ * that cannot be determined.  Without affinity set, the answer may be stale
+ * by the time the caller looks at it.
+ */
+int SystemPosix::getCurrentCpu(void) {
+	return sched_getcpu();
+} // end getCurrentCpu()
+
+/*
+ * parseCpuList - Parses a CPU list in the kernel's format, e.g. "0-3,8,10-11".
+ *
+ * @param list The text to parse.
+ * @param cpus Storage for the CPU numbers, in ascending order.
+ *
+ * @return \c false is returned if \p list is malformed or empty.
+ */
+bool SystemPosix::parseCpuList(const std::string& list, std::vector<int>& cpus) {
+	cpus.clear();
+
+	const char* p = list.c_str();
+	while (*p != '\0' && *p != '\n') {
+		char* end;
+		const long first = std::strtol(p, &end, 10);
+		long last = first;
+		if (end == p || first < 0) {
+			return false;
+		}
+		p = end;
+		if (*p == '-') {
+			++p;
+			last = std::strtol(p, &end, 10);
+			if (end == p || last < first) {
+				return false;
+			}
+			p = end;
+		}
+		for (long cpu = first; cpu <= last; ++cpu) {
+			cpus.push_back(int(cpu));
+		}
+		if (*p == ',') {
+			++p;
+		} else if (*p != '\0' && *p != '\n') {
+			return false;
+		}
+	}
+
+	std::sort(cpus.begin(), cpus.end());
+	cpus.erase(std::unique(cpus.begin(), cpus.end()), cpus.end());
+	return !cpus.empty();
+} // end parseCpuList()
+
+/*
+ * setThreadAffinity - Restricts the calling thread to the given CPUs.
+ *
+ * @return \c true is returned on success.  \c false is returned if \p cpus
+ *         is empty or names no online CPU.
+ */
+bool SystemPosix::setThreadAffinity(const std::vector<int>& cpus) {
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	for (size_t i = 0; i < cpus.size(); ++i) {
+		if (cpus[i] >= 0 && cpus[i] < CPU_SETSIZE) {
+			CPU_SET(cpus[i], &set);
+		}
+	}
+
+	return CPU_COUNT(&set) > 0 && pthread_setaffinity_np(pthread_self(),
+			sizeof(set), &set) == 0;
+} // end setThreadAffinity()
+
+/*
+ * getThreadAffinity - Returns the CPUs the calling thread may run on.
+ */
+bool SystemPosix::getThreadAffinity(std::vector<int>& cpus) {
+	cpu_set_t set;
+	cpus.clear();
+	if (pthread_getaffinity_np(pthread_self(), sizeof(set), &set) != 0) {
+		return false;
+	}
+
+	for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+		if (CPU_ISSET(cpu, &set)) {
+			cpus.push_back(cpu);
+		}
+	}
+	return true;
+} // end getThreadAffinity()
+
+/*
+ * setThreadScheduling - Changes the scheduling policy of the calling thread.
+ *
+ * @param policy   The new policy.
+ * @param priority For SCHEDULE_FIFO and SCHEDULE_ROUND_ROBIN, the real-time
+ *                 priority (1-99).  For the other policies, the nice value
+ *                 (-20 to 19) of the thread.  This parameter is optional and
+ *                 defaults to 0.
+ *
+ * @return \c true is returned on success.  \c false is returned, with errno
+ *         set, if the caller lacks the privileges or the priority is out of
+ *         range.
+ */
+bool SystemPosix::setThreadScheduling(SchedulingPolicy policy, int priority) {
+	int native;
+	switch (policy) {
+	case SCHEDULE_BATCH:
+		native = SCHED_BATCH;
+		break;
+	case SCHEDULE_IDLE:
+		native = SCHED_IDLE;
+		break;
+	case SCHEDULE_FIFO:
+		native = SCHED_FIFO;
+		break;
+	case SCHEDULE_ROUND_ROBIN:
+		native = SCHED_RR;
+		break;
+	default:
+		native = SCHED_OTHER;
+		break;
+	}
+
+	const bool realTime = native == SCHED_FIFO || native == SCHED_RR;
+	struct sched_param param;
+	std::memset(&param, 0, sizeof(param));
+	param.sched_priority = realTime ? priority : 0;
+	const int result = pthread_setschedparam(pthread_self(), native, &param);
+	if (result != 0) {
+		errno = result;
+		return false;
+	}
+
+	// On Linux the nice value is per thread when given a thread id.
+	return realTime || setpriority(PRIO_PROCESS, id_t(syscall(SYS_gettid)),
+			priority) == 0;
+} // end setThreadScheduling()
+
+/*
+ * applyThreadRole - Applies the affinity and scheduling configured for a
+ * role ("RENDER", "WORKER", ...) to the calling thread.  The settings come
+ * from two environment variables, both optional:
+ *
+ *   ROCKET_AFFINITY_<ROLE>  "0-3,8" (CPU list), "node:N" or "package:N"
+ *   ROCKET_SCHED_<ROLE>     "normal[:nice]", "batch[:nice]", "idle",
+ *                           "fifo:<priority>" or "rr:<priority>"
+ *
+ * A new thread inherits the settings of the thread that started it, e.g.
+ * the CPUs the main thread was pinned to.  The first role applied to a
+ * thread therefore puts what it does not configure back to how the process
+ * started; later roles on the same thread leave it alone.
+ *
+ * Invalid or failing settings are logged as warnings and otherwise ignored.
+ *
+ * @return \c false is returned if a configured setting was not applied.
+ */
+bool SystemPosix::applyThreadRole(const std::string& role) {
+	bool applied(true);
+	std::string value;
+	const bool inherited = !roleApplied && initialScheduling.valid;
+	roleApplied = true;
+
+	const std::string affinityName = "ROCKET_AFFINITY_" + toUpper(role);
+	if (getenv(affinityName, value)) {
+		std::vector<int> cpus;
+		if (!parseAffinity(value, cpus) || !setThreadAffinity(cpus)) {
+			LOG_WARNING("Ignoring %s=%s: no usable CPUs",
+					affinityName.c_str(), value.c_str());
+			applied = false;
+		}
+	} else if (inherited) {
+		pthread_setaffinity_np(pthread_self(),
+				sizeof(initialScheduling.affinity),
+				&initialScheduling.affinity);
+	}
+
+	const std::string schedulingName = "ROCKET_SCHED_" + toUpper(role);
+	if (getenv(schedulingName, value)) {
+		SchedulingPolicy policy;
+		int priority;
+		if (!parseScheduling(value, policy, priority)) {
+			LOG_WARNING("Ignoring %s=%s: unknown policy",
+					schedulingName.c_str(), value.c_str());
+			applied = false;
+		} else if (!setThreadScheduling(policy, priority)) {
+			LOG_WARNING("Ignoring %s=%s: %s", schedulingName.c_str(),
+					value.c_str(), std::strerror(errno));
+			applied = false;
+		}
+	} else if (inherited) {
+		pthread_setschedparam(pthread_self(), initialScheduling.policy,
+				&initialScheduling.param);
+		setpriority(PRIO_PROCESS, id_t(syscall(SYS_gettid)),
+				initialScheduling.nice);
+	}
+
+	return applied;
+} // end applyThreadRole()
+
+/*
+ * allocateNumaLocal - Allocates a large buffer whose pages prefer a given
+ * NUMA node.  The memory is page-aligned and zero-filled, and pages are only
+ * placed when first touched.
+ *
+ * @param size The size of the buffer in bytes.
+ * @param node The NUMA node.  This parameter is optional and defaults to -1,
+ *             the node of the CPU the caller runs on.
+ *
+ * @return The buffer, to be released with freeNumaLocal(), or NULL if the
+ *         allocation failed.  On machines with a single node this is an
+ *         ordinary anonymous mapping.
+ */
+void* SystemPosix::allocateNumaLocal(size_t size, int node) {
+	void* memory = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE
+			| MAP_ANONYMOUS, -1, 0);
+	if (memory == MAP_FAILED) {
+		return NULL;
+	}
+
+	const CpuTopology& topology = getCpuTopology();
+	if (node < 0) {
+		const CpuInfo* cpu = topology.findCpu(getCurrentCpu());
+		node = cpu != NULL ? cpu->numaNode : 0;
+	}
+
+	if (topology.numaNodes.size() > 1 && node < int(sizeof(unsigned long)
+			* 8)) {
+		// The binding is only a preference, so a full node falls back to
+		// the others instead of failing.  The kernel reads maxnode - 1
+		// bits of the mask.
+		const unsigned long nodeMask = 1UL << node;
+		syscall(SYS_mbind, memory, size, MPOL_PREFERRED, &nodeMask,
+				sizeof(nodeMask) * 8 + 1, 0);
+	}
+
+	return memory;
+} // end allocateNumaLocal()
+
+/*
+ * freeNumaLocal - Releases a buffer from allocateNumaLocal().
+ *
+ * @param size The size that was passed to allocateNumaLocal().
+ */
+void SystemPosix::freeNumaLocal(void* memory, size_t size) {
+	if (memory != NULL) {
+		munmap(memory, size);
+	}
+} // end freeNumaLocal()
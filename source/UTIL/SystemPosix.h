@@ -8,12 +8,14 @@
 #define SYSTEM_POSIX_H_
 
 #include <string>
+#include <ctime>
 #include <unistd.h>
 #include <sys/time.h>
 #include <sys/types.h>
 #include <netinet/in.h>
 #include <sys/param.h>
 
+#include <UTIL/CpuTopology.h>
 #include <UTIL/SystemBase.h>
 #include <UTIL/Types.h>
 
@@ -28,6 +30,7 @@ class SystemPosix: public SystemBase {
 public:
 	static int usleep(Uint32 micro);
 	static int msleep(Uint32 milli);
+	static int sleepUntil(Uint64 deadline);
 
 	/*
 	 * sleep - Sleeps for the given number of seconds.
@@ -49,6 +52,19 @@ public:
 		return ::gettimeofday(tp, tzp);
 	} // end gettimeofday()
 
+	/*
+	 * getMonotonicNanoseconds - Reads the monotonic clock.  Unlike
+	 * gettimeofday(), the monotonic clock never jumps when the system time is
+	 * adjusted, so it is the one to use for measuring intervals.
+	 *
+	 * @return Nanoseconds since an unspecified starting point.
+	 */
+	static Uint64 getMonotonicNanoseconds(void) {
+		struct timespec now;
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		return Uint64(now.tv_sec) * 1000000000UL + Uint64(now.tv_nsec);
+	} // end getMonotonicNanoseconds()
+
 	/*
 	 * Ntohs - Converts the given 16-bit value (a short) from native byte
 	 * ordering to network byte ordering.  This is safe to use with signed and
@@ -67,7 +83,20 @@ public:
 		return ntohl(conversion);
 	} // end Ntohl()
 
-	static Uint64 Ntohll(Uint64 conversion);
+	/*
+	 * Ntohll - Converts the given 64-bit value (a long long) from network
+	 * byte ordering to native byte ordering.  This is safe to use with signed
+	 * and unsigned values.
+	 *
+	 * @see ByteOrder for converting whole arrays.
+	 */
+	static Uint64 Ntohll(Uint64 conversion) {
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+		return __builtin_bswap64(conversion);
+#else
+		return conversion;
+#endif
+	} // end Ntohll()
 
 	/*
 	 * Htons - Converts the given 16-bit value (a short) from network byte
@@ -87,10 +116,38 @@ public:
 		return htonl(conversion);
 	} // end Htonl()
 
-	static Uint64 Htonll(Uint64 conversion);
+	/*
+	 * Htonll - Converts the given 64-bit value (a long long) from native byte
+	 * ordering to network byte ordering.  This is safe to use with signed and
+	 * unsigned values.
+	 */
+	static Uint64 Htonll(Uint64 conversion) {
+		return Ntohll(conversion);
+	} // end Htonll()
+
 	static bool getenv(const std::string& name, std::string& result);
 	static bool setenv(const std::string& name, const std::string& value);
 	static std::string getHostname();
+
+	/*
+	 * SchedulingPolicy - Scheduling classes for setThreadScheduling().  The
+	 * real-time policies (FIFO, ROUND_ROBIN) need CAP_SYS_NICE or a suitable
+	 * RLIMIT_RTPRIO.
+	 */
+	enum SchedulingPolicy {
+		SCHEDULE_NORMAL, SCHEDULE_BATCH, SCHEDULE_IDLE, SCHEDULE_FIFO,
+		SCHEDULE_ROUND_ROBIN
+	};
+
+	static const CpuTopology& getCpuTopology(void);
+	static int getCurrentCpu(void);
+	static bool parseCpuList(const std::string& list, std::vector<int>& cpus);
+	static bool setThreadAffinity(const std::vector<int>& cpus);
+	static bool getThreadAffinity(std::vector<int>& cpus);
+	static bool setThreadScheduling(SchedulingPolicy policy, int priority = 0);
+	static bool applyThreadRole(const std::string& role);
+	static void* allocateNumaLocal(size_t size, int node = -1);
+	static void freeNumaLocal(void* memory, size_t size);
 };
 
 #endif /* SYSTEM_POSIX_H_ */
@@ -0,0 +1,565 @@
+#include <algorithm>
+#include <cmath>
+#include <sys/prctl.h>
+
+#include <SYNC/Atomic.h>
+#include <UTIL/Logger.h>
+#include <UTIL/System.h>
+#include <UTIL/Timer.h>
+
+/*****************************************
+ Methods of class Timer:
+ *****************************************/
+
+/*
+ * sleepUntil - Waits until the monotonic clock reaches \p deadline.  The
+ * thread sleeps until \p spin nanoseconds before the deadline and spins for
+ * the rest, which trades a little CPU time for waking within a microsecond
+ * or so instead of at the whim of the scheduler.
+ *
+ * @param deadline The monotonic time to return at, in nanoseconds.
+ * @param spin     How long before the deadline to stop sleeping; 0 sleeps
+ *                 all the way.
+ */
+void Timer::sleepUntil(Uint64 deadline, Uint64 spin) {
+	Uint64 now = SystemPosix::getMonotonicNanoseconds();
+	if (deadline > now + spin) {
+		// If the sleep fails (it returns an errno value then), the spin
+		// below waits out the rest.
+		SystemPosix::sleepUntil(deadline - spin);
+		now = SystemPosix::getMonotonicNanoseconds();
+	}
+	while (now < deadline) {
+		Atomic::cpuRelax();
+		now = SystemPosix::getMonotonicNanoseconds();
+	}
+} // end sleepUntil()
+
+/*
+ * sleepFor - Waits for \p duration nanoseconds; see sleepUntil().
+ */
+void Timer::sleepFor(Uint64 duration, Uint64 spin) {
+	sleepUntil(SystemPosix::getMonotonicNanoseconds() + duration, spin);
+} // end sleepFor()
+
+/*****************************************
+ Methods of class JitterStatistics:
+ *****************************************/
+
+/*
+ * JitterStatistics - Constructor for JitterStatistics class.
+ */
+JitterStatistics::JitterStatistics(void) :
+	count(0), overruns(0), minimum(0), maximum(0), mean(0.0), squares(0.0) {
+} // end JitterStatistics()
+
+/*
+ * record - Adds one run that happened \p lateness nanoseconds after its
+ * deadline (negative if early).
+ */
+void JitterStatistics::record(Int64 lateness) {
+	if (count == 0 || lateness < minimum) {
+		minimum = lateness;
+	}
+	if (count == 0 || lateness > maximum) {
+		maximum = lateness;
+	}
+	++count;
+	const double delta = double(lateness) - mean;
+	mean += delta / double(count);
+	squares += delta * (double(lateness) - mean);
+	histogram.record(lateness > 0 ? Uint64(lateness) : 0);
+} // end record()
+
+/*
+ * addOverruns - Counts deadlines that were skipped because the activity
+ * fell more than a period behind.
+ */
+void JitterStatistics::addOverruns(Uint64 _count) {
+	overruns += _count;
+} // end addOverruns()
+
+/*
+ * reset - Forgets everything recorded so far.
+ */
+void JitterStatistics::reset(void) {
+	*this = JitterStatistics();
+} // end reset()
+
+Uint64 JitterStatistics::getCount(void) const {
+	return count;
+} // end getCount()
+
+Uint64 JitterStatistics::getOverruns(void) const {
+	return overruns;
+} // end getOverruns()
+
+Int64 JitterStatistics::getMinimum(void) const {
+	return minimum;
+} // end getMinimum()
+
+Int64 JitterStatistics::getMaximum(void) const {
+	return maximum;
+} // end getMaximum()
+
+/*
+ * getMean - Returns the mean lateness in nanoseconds.
+ */
+double JitterStatistics::getMean(void) const {
+	return mean;
+} // end getMean()
+
+/*
+ * getStandardDeviation - Returns the standard deviation of the lateness in
+ * nanoseconds, i.e. the jitter.
+ */
+double JitterStatistics::getStandardDeviation(void) const {
+	return count > 1 ? std::sqrt(squares / double(count - 1)) : 0.0;
+} // end getStandardDeviation()
+
+/*
+ * getPercentile - Estimates a percentile of the lateness, counting early
+ * runs as on time.
+ *
+ * @return The power of two in nanoseconds that the percentile is below, as
+ *         for LockHistogram::getPercentile().
+ */
+Uint64 JitterStatistics::getPercentile(double percentile) const {
+	return histogram.getPercentile(percentile);
+} // end getPercentile()
+
+/*
+ * write - Prints the statistics as a two-line report.
+ *
+ * @param period The target period, in nanoseconds.
+ */
+void JitterStatistics::write(FILE* dest, const std::string& name,
+		Uint64 period) const {
+	fprintf(dest, "%s: %lu runs at a period of %.3f ms, %lu overruns\n",
+			name.c_str(), count, double(period) * 1e-6, overruns);
+	if (count != 0) {
+		fprintf(dest, "   late ns: mean %.0f  stddev %.0f  min %ld  max %ld  "
+			"p50 <%lu  p99 <%lu\n", mean, getStandardDeviation(), minimum,
+				maximum, getPercentile(50.0), getPercentile(99.0));
+	}
+} // end write()
+
+/*****************************************
+ Methods of class Pacer:
+ *****************************************/
+
+/*
+ * Pacer - Constructor for Pacer class.  The first deadline is one period
+ * after the first call of wait().
+ *
+ * @param _name   Names the pacer in its summary and metrics.
+ * @param _period The period in nanoseconds.
+ * @param _spin   See Timer::sleepUntil().
+ */
+Pacer::Pacer(const std::string& _name, Uint64 _period, Uint64 _spin) :
+	name(_name), period(_period), spin(_spin), nextDeadline(0) {
+	const std::string label = MetricsSnapshot::label("pacer", name);
+	latenessMetric = Metrics::histogram("rocket_pacer_lateness_seconds",
+			"How late paced loops woke up", Metrics::exponentialBounds(1e-6,
+					2.0, 16), label);
+	overrunsMetric = Metrics::counter("rocket_pacer_overruns_total",
+			"Deadlines of paced loops skipped after falling behind", label);
+} // end Pacer()
+
+/*
+ * wait - Sleeps until the next deadline.  The first call also lowers the
+ * calling thread's timer slack to 1 ns, since the default of 50 us lets the
+ * kernel wake it late by about as much as it spins.
+ *
+ * @return The number of deadlines skipped because the loop fell behind,
+ *         usually 0.  A caller that integrates over time can use it to
+ *         catch up.
+ */
+Uint64 Pacer::wait(void) {
+	if (nextDeadline == 0) {
+		prctl(PR_SET_TIMERSLACK, 1UL, 0UL, 0UL, 0UL);
+		nextDeadline = SystemPosix::getMonotonicNanoseconds() + period;
+	}
+	Timer::sleepUntil(nextDeadline, spin);
+
+	const Uint64 woke = SystemPosix::getMonotonicNanoseconds();
+	const Int64 lateness = Int64(woke - nextDeadline);
+	jitter.record(lateness);
+	latenessMetric.observe(double(lateness) * 1e-9);
+
+	Uint64 skipped = 0;
+	nextDeadline += period;
+	if (woke >= nextDeadline) {
+		skipped = (woke - nextDeadline) / period + 1;
+		nextDeadline += skipped * period;
+		jitter.addOverruns(skipped);
+		overrunsMetric.add(skipped);
+	}
+	return skipped;
+} // end wait()
+
+/*
+ * restart - Makes the next wait() start a new schedule, e.g. after the loop
+ * was paused.  The statistics are kept.
+ */
+void Pacer::restart(void) {
+	nextDeadline = 0;
+} // end restart()
+
+const std::string& Pacer::getName(void) const {
+	return name;
+} // end getName()
+
+Uint64 Pacer::getPeriod(void) const {
+	return period;
+} // end getPeriod()
+
+/*
+ * getNextDeadline - Returns the monotonic time the next wait() returns at,
+ * or 0 before the first wait().
+ */
+Uint64 Pacer::getNextDeadline(void) const {
+	return nextDeadline;
+} // end getNextDeadline()
+
+const JitterStatistics& Pacer::getJitter(void) const {
+	return jitter;
+} // end getJitter()
+
+/*
+ * writeSummary - Prints the jitter statistics.
+ */
+void Pacer::writeSummary(FILE* dest) const {
+	jitter.write(dest, name, period);
+} // end writeSummary()
+
+/*****************************************
+ Methods of class PhaseTimer:
+ *****************************************/
+
+/*
+ * PhaseTimer - Constructor for PhaseTimer class.  The first phase starts
+ * now.
+ *
+ * @param _name Names the sequence in the report and the metrics.
+ */
+PhaseTimer::PhaseTimer(const std::string& _name) :
+	name(_name), start(SystemPosix::getMonotonicNanoseconds()), last(start) {
+} // end PhaseTimer()
+
+/*
+ * mark - Ends the current phase, which started at the end of the previous
+ * one (or at construction), under the name \p phase.
+ *
+ * @return The monotonic time the phase ended, which starts the next one.
+ */
+Uint64 PhaseTimer::mark(const std::string& phase) {
+	const Uint64 now = SystemPosix::getMonotonicNanoseconds();
+	Phase entry = { phase, last, now, false };
+	phases.push_back(entry);
+	last = now;
+	return now;
+} // end mark()
+
+/*
+ * record - Adds a phase that ran from \p phaseStart to \p phaseEnd,
+ * concurrently with the marked ones.
+ */
+void PhaseTimer::record(const std::string& phase, Uint64 phaseStart,
+		Uint64 phaseEnd) {
+	Phase entry = { phase, phaseStart, std::max(phaseStart, phaseEnd), true };
+	phases.push_back(entry);
+} // end record()
+
+/*
+ * getStart - Returns the monotonic time the timer was constructed.
+ */
+Uint64 PhaseTimer::getStart(void) const {
+	return start;
+} // end getStart()
+
+/*
+ * getElapsed - Returns the nanoseconds from the start to the end of the
+ * last phase, marked or recorded.
+ */
+Uint64 PhaseTimer::getElapsed(void) const {
+	Uint64 end = last;
+	for (size_t p = 0; p < phases.size(); ++p) {
+		end = std::max(end, phases[p].end);
+	}
+	return end - start;
+} // end getElapsed()
+
+/*
+ * report - Logs each phase with its offset from the start and its
+ * duration, and exports the durations as the gauge rocket_phase_seconds,
+ * labelled with the timer and phase names.
+ */
+void PhaseTimer::report(void) const {
+	LOG_INFO("%s took %.1f ms:", name.c_str(), double(getElapsed()) * 1e-6);
+	const std::string timerLabel = MetricsSnapshot::label("timer", name);
+	for (size_t p = 0; p < phases.size(); ++p) {
+		const Phase& phase = phases[p];
+		const double seconds = double(phase.end - phase.start) * 1e-9;
+		LOG_INFO("  %-40s %9.1f ms  at %9.1f ms%s", phase.name.c_str(),
+				seconds * 1e3, double(phase.start - start) * 1e-6,
+				phase.concurrent ? "  (concurrent)" : "");
+		Metrics::gauge("rocket_phase_seconds",
+				"Duration of the phases of one-off sequences such as startup",
+				timerLabel + "," + MetricsSnapshot::label("phase", phase.name)).set(
+				seconds);
+	}
+} // end report()
+
+/*****************************************
+ Methods of class TimerWheel:
+ *****************************************/
+
+/*
+ * TimerWheel - Constructor for TimerWheel class.  Tick 0 is now.
+ *
+ * @param _resolution The length of a tick in nanoseconds.  Timers expire on
+ *        the first advance() at or after the end of their tick.
+ */
+TimerWheel::TimerWheel(Uint64 _resolution) :
+	resolution(_resolution), origin(SystemPosix::getMonotonicNanoseconds()),
+			currentTick(0), nextId(1), running(NULL) {
+	for (int level = 0; level < LEVELS; ++level) {
+		for (int slot = 0; slot < SLOTS; ++slot) {
+			slots[level][slot].next = &slots[level][slot];
+			slots[level][slot].previous = &slots[level][slot];
+		}
+	}
+} // end TimerWheel()
+
+/*
+ * ~TimerWheel - Destructor for TimerWheel class.  Pending timers are
+ * dropped without running.
+ */
+TimerWheel::~TimerWheel(void) {
+	for (FlatHashMap<TimerId, Entry*>::iterator it = timers.begin(); it
+			!= timers.end(); ++it) {
+		entries.destroy(it->second);
+	}
+} // end ~TimerWheel()
+
+/*
+ * schedule - Calls \p callback after \p delay nanoseconds, and then every
+ * \p period nanoseconds if that is not 0.
+ *
+ * @return The id for cancel().
+ */
+TimerWheel::TimerId TimerWheel::schedule(Uint64 delay, TimerCallback callback,
+		void* context, Uint64 period) {
+	return scheduleAt(SystemPosix::getMonotonicNanoseconds() + delay,
+			callback, context, period);
+} // end schedule()
+
+/*
+ * scheduleAt - Calls \p callback once the monotonic clock reaches
+ * \p deadline, and then every \p period nanoseconds if that is not 0.
+ * Periodic timers keep to their original schedule; runs that would have
+ * fallen between two advance() calls are skipped and counted as overruns.
+ *
+ * @return The id for cancel().
+ */
+TimerWheel::TimerId TimerWheel::scheduleAt(Uint64 deadline,
+		TimerCallback callback, void* context, Uint64 period) {
+	Uint64 expiry = deadline > origin ? (deadline - origin + resolution - 1)
+			/ resolution : 0;
+	if (expiry <= currentTick) {
+		expiry = currentTick + 1;
+	}
+
+	Entry* entry = entries.create();
+	entry->expiry = expiry;
+	entry->period = period != 0 ? std::max((period + resolution / 2)
+			/ resolution, Uint64(1)) : 0;
+	entry->callback = callback;
+	entry->context = context;
+	entry->id = nextId++;
+	entry->cancelled = false;
+	timers[entry->id] = entry;
+	place(entry);
+	return entry->id;
+} // end scheduleAt()
+
+/*
+ * cancel - Cancels a timer.  A periodic timer may cancel itself from its
+ * callback.
+ *
+ * @return \c false is returned if the timer already expired (one-shot
+ *         timers) or was cancelled before.
+ */
+bool TimerWheel::cancel(TimerId id) {
+	FlatHashMap<TimerId, Entry*>::iterator it = timers.find(id);
+	if (it == timers.end()) {
+		return false;
+	}
+	Entry* entry = it->second;
+	timers.erase(it);
+	if (entry == running) {
+		entry->cancelled = true;
+	} else {
+		unlink(entry);
+		entries.destroy(entry);
+	}
+	return true;
+} // end cancel()
+
+/*
+ * advance - Runs the callbacks of all timers that expired by \p now.
+ *
+ * @param now The current monotonic time in nanoseconds.
+ *
+ * @return The number of callbacks run.
+ */
+size_t TimerWheel::advance(Uint64 now) {
+	const Uint64 target = now > origin ? (now - origin) / resolution : 0;
+	size_t ran = 0;
+	while (currentTick < target) {
+		++currentTick;
+		for (int level = 1; level < LEVELS; ++level) {
+			const int shift = level * SLOT_BITS;
+			if ((currentTick & ((Uint64(1) << shift) - 1)) != 0) {
+				break;
+			}
+			cascade(level, (currentTick >> shift) & (SLOTS - 1));
+		}
+
+		Entry* slot = &slots[0][currentTick & (SLOTS - 1)];
+		if (slot->next == slot) {
+			continue;
+		}
+
+		/* Take the slot's list, since callbacks may add to it: */
+		Entry due;
+		due.next = slot->next;
+		due.previous = slot->previous;
+		due.next->previous = &due;
+		due.previous->next = &due;
+		slot->next = slot;
+		slot->previous = slot;
+
+		while (due.next != &due) {
+			Entry* entry = due.next;
+			unlink(entry);
+
+			jitter.record(Int64(now - (origin + entry->expiry * resolution)));
+			running = entry;
+			entry->callback(entry->context);
+			running = NULL;
+			++ran;
+
+			if (entry->period != 0 && !entry->cancelled) {
+				entry->expiry += entry->period;
+				if (entry->expiry <= target) {
+					const Uint64 skipped = (target - entry->expiry)
+							/ entry->period + 1;
+					entry->expiry += skipped * entry->period;
+					jitter.addOverruns(skipped);
+				}
+				place(entry);
+			} else {
+				if (!entry->cancelled) {
+					timers.erase(entry->id);
+				}
+				entries.destroy(entry);
+			}
+		}
+	}
+	return ran;
+} // end advance()
+
+/*
+ * getNextDeadline - Returns a monotonic time no later than the next expiry,
+ * for deciding how long to sleep before the next advance().  It is exact for
+ * timers due within SLOTS ticks.
+ *
+ * @return ~0 is returned if no timer is pending.
+ */
+Uint64 TimerWheel::getNextDeadline(void) const {
+	for (Uint64 tick = currentTick + 1; tick <= currentTick + SLOTS; ++tick) {
+		const Entry* slot = &slots[0][tick & (SLOTS - 1)];
+		if (slot->next != slot) {
+			return origin + tick * resolution;
+		}
+	}
+	for (int level = 1; level < LEVELS; ++level) {
+		const int shift = level * SLOT_BITS;
+		for (Uint64 index = (currentTick >> shift) + 1; index
+				<= (currentTick >> shift) + SLOTS; ++index) {
+			const Entry* slot = &slots[level][index & (SLOTS - 1)];
+			if (slot->next != slot) {
+				return origin + (index << shift) * resolution;
+			}
+		}
+	}
+	return ~Uint64(0);
+} // end getNextDeadline()
+
+size_t TimerWheel::getNumTimers(void) const {
+	return timers.size();
+} // end getNumTimers()
+
+Uint64 TimerWheel::getResolution(void) const {
+	return resolution;
+} // end getResolution()
+
+/*
+ * getJitter - Returns how late the callbacks ran against their deadlines,
+ * which depends mostly on how promptly advance() is called.
+ */
+const JitterStatistics& TimerWheel::getJitter(void) const {
+	return jitter;
+} // end getJitter()
+
+void TimerWheel::link(Entry* list, Entry* entry) {
+	entry->next = list;
+	entry->previous = list->previous;
+	list->previous->next = entry;
+	list->previous = entry;
+} // end link()
+
+void TimerWheel::unlink(Entry* entry) {
+	entry->previous->next = entry->next;
+	entry->next->previous = entry->previous;
+	entry->next = entry;
+	entry->previous = entry;
+} // end unlink()
+
+/*
+ * place - Puts an entry into the slot of the lowest level that reaches its
+ * expiry.
+ *
+ * @pre entry->expiry >= currentTick
+ */
+void TimerWheel::place(Entry* entry) {
+	const Uint64 delta = entry->expiry - currentTick;
+	for (int level = 0; level < LEVELS; ++level) {
+		const int shift = level * SLOT_BITS;
+		if (delta < (Uint64(1) << (shift + SLOT_BITS))) {
+			link(&slots[level][(entry->expiry >> shift) & (SLOTS - 1)], entry);
+			return;
+		}
+	}
+
+	/* Beyond the top level: wait in its furthest slot and come back. */
+	const int shift = (LEVELS - 1) * SLOT_BITS;
+	const Uint64 furthest = currentTick + (Uint64(1) << (LEVELS * SLOT_BITS))
+			- 1;
+	link(&slots[LEVELS - 1][(furthest >> shift) & (SLOTS - 1)], entry);
+} // end place()
+
+/*
+ * cascade - Moves the timers of one slot down to the levels that now
+ * reach them.
+ */
+void TimerWheel::cascade(int level, Uint64 index) {
+	Entry* slot = &slots[level][index];
+	while (slot->next != slot) {
+		Entry* entry = slot->next;
+		unlink(entry);
+		place(entry);
+	}
+} // end cascade()
@@ -0,0 +1,230 @@
+#ifndef TIMER_H_
+#define TIMER_H_
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+/* Boost includes */
+#include <boost/noncopyable.hpp>
+
+#include <SYNC/LockStatistics.h>
+#include <UTIL/FlatHashMap.h>
+#include <UTIL/Metrics.h>
+#include <UTIL/ObjectPool.h>
+#include <UTIL/Types.h>
+
+/**
+ * @example "Example of a paced loop"
+ *
+ * A Pacer wakes a loop at a fixed rate against absolute deadlines, so time
+ * spent in the loop body does not add up to drift:
+ *
+ * \code
+ * Pacer physics("physics", 1000000); // 1 kHz
+ * while (running) {
+ *     physics.wait();
+ *     step(0.001);
+ * }
+ * physics.writeSummary(stderr);
+ * \endcode
+ *
+ * Callbacks at other rates go on a TimerWheel advanced from the same loop:
+ *
+ * \code
+ * TimerWheel timers(1000000);
+ * timers.schedule(16666667, &sendTelemetry, this, 16666667); // 60 Hz
+ * ...
+ * timers.advance(SystemPosix::getMonotonicNanoseconds());
+ * \endcode
+ */
+
+/*
+ * Timer - Waits for deadlines on the monotonic clock.  All times are
+ * nanoseconds as returned by SystemPosix::getMonotonicNanoseconds().
+ */
+class Timer {
+public:
+	enum {
+		DEFAULT_SPIN = 50000 /**< Nanoseconds spun rather than slept */
+	};
+
+	static void sleepUntil(Uint64 deadline, Uint64 spin = DEFAULT_SPIN);
+	static void sleepFor(Uint64 duration, Uint64 spin = DEFAULT_SPIN);
+};
+
+/*
+ * JitterStatistics - How late a periodic activity ran against its
+ * deadlines: the lateness of each run, and the deadlines missed entirely.
+ * The statistics are written by the thread that runs the activity and are
+ * only consistent when read by that thread or after it stopped.
+ */
+class JitterStatistics {
+public:
+	JitterStatistics(void);
+
+	void record(Int64 lateness);
+	void addOverruns(Uint64 count);
+	void reset(void);
+
+	Uint64 getCount(void) const;
+	Uint64 getOverruns(void) const;
+	Int64 getMinimum(void) const;
+	Int64 getMaximum(void) const;
+	double getMean(void) const;
+	double getStandardDeviation(void) const;
+	Uint64 getPercentile(double percentile) const;
+
+	void write(FILE* dest, const std::string& name, Uint64 period) const;
+
+private:
+	Uint64 count;
+	Uint64 overruns;
+	Int64 minimum;
+	Int64 maximum;
+	double mean; /**< Running mean and sum of squared deviations (Welford) */
+	double squares;
+	LockHistogram histogram; /**< Lateness, counting early runs as 0 */
+};
+
+/*
+ * Pacer - Paces a loop at a fixed period.  wait() sleeps until the next
+ * deadline with Timer::sleepUntil(), then moves the deadline on by one
+ * period.  A loop that falls more than a period behind skips the missed
+ * deadlines instead of running them back to back; they count as overruns.
+ *
+ * Every wake-up is recorded in the jitter statistics and, under the name
+ * given, in the rocket_pacer_lateness_seconds and rocket_pacer_overruns_total
+ * metrics.
+ */
+class Pacer: boost::noncopyable {
+public:
+	Pacer(const std::string& _name, Uint64 _period, Uint64 _spin =
+			Timer::DEFAULT_SPIN);
+
+	Uint64 wait(void);
+	void restart(void);
+
+	const std::string& getName(void) const;
+	Uint64 getPeriod(void) const;
+	Uint64 getNextDeadline(void) const;
+	const JitterStatistics& getJitter(void) const;
+	void writeSummary(FILE* dest) const;
+
+private:
+	const std::string name;
+	const Uint64 period;
+	const Uint64 spin;
+	Uint64 nextDeadline; /**< 0 until the first wait() */
+	JitterStatistics jitter;
+	Histogram latenessMetric;
+	Counter overrunsMetric;
+};
+
+/*
+ * PhaseTimer - Breaks a one-off sequence such as the startup down into
+ * phases.  The thread that owns the timer marks the end of each phase as it
+ * goes; work that ran concurrently elsewhere (a background load) is added
+ * with its own start and end.  Not thread-safe.
+ */
+class PhaseTimer: boost::noncopyable {
+public:
+	explicit PhaseTimer(const std::string& _name);
+
+	Uint64 mark(const std::string& phase);
+	void record(const std::string& phase, Uint64 start, Uint64 end);
+
+	Uint64 getStart(void) const;
+	Uint64 getElapsed(void) const;
+	void report(void) const;
+
+private:
+	struct Phase {
+		std::string name;
+		Uint64 start;
+		Uint64 end;
+		bool concurrent; /**< Added with record() */
+	};
+
+	const std::string name;
+	const Uint64 start;
+	Uint64 last; /**< End of the last marked phase */
+	std::vector<Phase> phases;
+};
+
+/*
+ * TimerCallback - Called by a TimerWheel when a timer expires.
+ */
+typedef void (*TimerCallback)(void* context);
+
+/*
+ * TimerWheel - Hierarchical timing wheel for scheduled callbacks.  Time is
+ * counted in ticks of a fixed resolution; level 0 has one slot per tick for
+ * the next SLOTS ticks, and each further level has slots SLOTS times as
+ * wide.  Scheduling and cancelling take constant time, and advancing costs
+ * one slot per tick plus, every SLOTS ticks, moving the timers of one slot
+ * of the next level down.  Timers further out than the top level reaches
+ * wait in its last slot and are placed again when it comes around.
+ *
+ * The wheel is not thread-safe: one thread schedules, cancels and calls
+ * advance(), typically a loop paced by a Pacer.  Callbacks run inside
+ * advance() and may schedule and cancel timers, including their own.
+ */
+class TimerWheel: boost::noncopyable {
+public:
+	typedef Uint64 TimerId;
+
+	enum {
+		SLOT_BITS = 6,
+		SLOTS = 1 << SLOT_BITS,
+		LEVELS = 4
+	};
+
+	explicit TimerWheel(Uint64 _resolution = 1000000);
+	~TimerWheel(void);
+
+	TimerId schedule(Uint64 delay, TimerCallback callback, void* context,
+			Uint64 period = 0);
+	TimerId scheduleAt(Uint64 deadline, TimerCallback callback,
+			void* context, Uint64 period = 0);
+	bool cancel(TimerId id);
+	size_t advance(Uint64 now);
+
+	Uint64 getNextDeadline(void) const;
+	size_t getNumTimers(void) const;
+	Uint64 getResolution(void) const;
+	const JitterStatistics& getJitter(void) const;
+
+private:
+	/*
+	 * Entry - A scheduled timer.  Slots are circular lists with a sentinel,
+	 * so entries unlink themselves without knowing their slot.
+	 */
+	struct Entry {
+		Entry* next;
+		Entry* previous;
+		Uint64 expiry; /**< In ticks */
+		Uint64 period; /**< In ticks; 0 for a one-shot timer */
+		TimerCallback callback;
+		void* context;
+		TimerId id;
+		bool cancelled; /**< Cancelled while its callback ran */
+	};
+
+	static void link(Entry* list, Entry* entry);
+	static void unlink(Entry* entry);
+	void place(Entry* entry);
+	void cascade(int level, Uint64 index);
+
+	const Uint64 resolution; /**< Nanoseconds per tick */
+	const Uint64 origin; /**< Monotonic time of tick 0 */
+	Uint64 currentTick; /**< The last tick processed */
+	TimerId nextId;
+	Entry* running; /**< The entry whose callback runs, if any */
+	Entry slots[LEVELS][SLOTS]; /**< Sentinels */
+	ObjectPool<Entry> entries;
+	FlatHashMap<TimerId, Entry*> timers;
+	JitterStatistics jitter;
+};
+
+#endif /* TIMER_H_ */
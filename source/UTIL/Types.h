@@ -1,6 +1,9 @@
 #ifndef TYPES_H_
 #define TYPES_H_
 
+#include <cstddef>
+#include <cstring>
+
 typedef signed char Int8;
 typedef unsigned char Uint8;
 typedef short Int16;
@@ -13,22 +16,39 @@ typedef unsigned long Uint64;
 /* HASH Functions */
 
 /*
- * Uint64Hash - Nice little helper class for hashing a Uint64.
+ * Uint64Hash - Nice little helper class for hashing a Uint64.  It uses the
+ * MurmurHash3 finalizer, so every key bit affects every hash bit.  Keys that
+ * differ only in a few bits (sequential ids) or only in the order of their
+ * halves get unrelated hashes, as open addressing (FlatHashMap) needs.
  */
 struct Uint64Hash {
-	union Uint64_val {
-		Uint64 full;
-		struct {
-			Uint32 low32;
-			Uint32 high32;
-		} nested;
-	};
-
-	Uint32 operator()(Uint64 val) const {
-		Uint64_val temp;
-		temp.full = val;
-		return temp.nested.low32 + temp.nested.high32;
+	Uint64 operator()(Uint64 val) const {
+		val ^= val >> 33;
+		val *= 0xff51afd7ed558ccdUL;
+		val ^= val >> 33;
+		val *= 0xc4ceb9fe1a85ec53UL;
+		val ^= val >> 33;
+		return val;
 	}
 };
 
+/*
+ * hashBytes - Hashes \p size bytes eight at a time, mixing each word with
+ * the MurmurHash3 finalizer.  \p hash is the seed, or the hash of what came
+ * before.
+ */
+inline Uint64 hashBytes(const void* data, size_t size, Uint64 hash) {
+	const unsigned char* bytes = static_cast<const unsigned char*> (data);
+	const Uint64Hash mix;
+	size_t i = 0;
+	for (; i + 8 <= size; i += 8) {
+		Uint64 word;
+		std::memcpy(&word, bytes + i, 8);
+		hash = (hash ^ mix(word)) * 0x9e3779b97f4a7c15UL;
+	}
+	Uint64 tail = 0;
+	std::memcpy(&tail, bytes + i, size - i);
+	return mix(hash ^ mix(tail ^ Uint64(size)));
+}
+
 #endif   /* TYPES_H_ */